@@ -761,6 +761,7 @@ papi_vector_t _appio_vector = {
         .fast_virtual_timer    = 0,
         .attach                = 0,
         .attach_must_ptrace    = 0,
+        .parallel_init         = 1,
     },
 
     /* sizes of framework-opaque component-private structures */
@@ -5,6 +5,7 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "papi_node.h"
 
 #include "linux-coretemp.h"
 
@@ -367,16 +368,25 @@ done_error:
 }
 
 static long long
-getEventValue( int index ) 
+getEventValue( int index, int source )
 {
     char buf[PAPI_MAX_STR_LEN];
     FILE* fp;
     long result;
+    int len;
 
     if (_coretemp_native_events[index].stone) {
        return _coretemp_native_events[index].value;
     }
 
+    /* parse the node-wide snapshot in place if there is one */
+    len = _papi_node_read_source(source, buf, PAPI_MAX_STR_LEN - 1);
+    if (len >= 0) {
+       if (len == 0) return INVALID_RESULT;
+       buf[len] = '\0';
+       return strtoll(buf, NULL, 10);
+    }
+
     fp = fopen(_coretemp_native_events[index].path, "r");
     if (fp==NULL) {
        return INVALID_RESULT;
@@ -512,7 +522,8 @@ _coretemp_init_control_state( hwd_control_state_t * ctl)
     CORETEMP_control_state_t *coretemp_ctl = (CORETEMP_control_state_t *) ctl;
 
     for ( i=0; i < num_events; i++ ) {
-	coretemp_ctl->counts[i] = getEventValue(i);
+	coretemp_ctl->source[i] = -1;
+	coretemp_ctl->counts[i] = getEventValue(i, -1);
     }
 
     /* Set last access time for caching results */
@@ -525,7 +536,14 @@ static int
 _coretemp_start( hwd_context_t *ctx, hwd_control_state_t *ctl)
 {
   ( void ) ctx;
-  ( void ) ctl;
+  CORETEMP_control_state_t* control = (CORETEMP_control_state_t*) ctl;
+  int i;
+
+  /* resolved here so that reads are only a copy of the snapshots */
+  for ( i = 0; i < num_events; i++ ) {
+     if ( !_coretemp_native_events[i].stone )
+        control->source[i] = _papi_node_source(_coretemp_native_events[i].path);
+  }
 
   return PAPI_OK;
 }
@@ -546,7 +564,7 @@ _coretemp_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 
     if ( now - control->lastupdate > REFRESH_LAT ) {
 	for ( i = 0; i < num_events; i++ ) {
-	   control->counts[i] = getEventValue( i );
+	   control->counts[i] = getEventValue( i, control->source[i] );
 	}
 	control->lastupdate = now;
     }
@@ -566,7 +584,7 @@ _coretemp_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     int i;
 
     for ( i = 0; i < num_events; i++ ) {
-	control->counts[i] = getEventValue( i );
+	control->counts[i] = getEventValue( i, control->source[i] );
     }
 
     return PAPI_OK;
@@ -770,6 +788,8 @@ papi_vector_t _coretemp_vector = {
 				 .attach = 0,
 				 .attach_must_ptrace = 0,
 				 .kernel_multiplex = 1,
+				 .node_sampled = 1,
+				 .parallel_init = 1,
 				 }
 	,
 
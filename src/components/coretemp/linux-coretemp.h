@@ -71,6 +71,7 @@ typedef struct CORETEMP_reg_alloc
 typedef struct CORETEMP_control_state
 {
 	long long counts[CORETEMP_MAX_COUNTERS];	// used for caching
+	int source[CORETEMP_MAX_COUNTERS];	// node-wide snapshots, -1 if none
 	long long lastupdate;
 } CORETEMP_control_state_t;
 
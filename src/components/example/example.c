@@ -638,6 +638,7 @@ papi_vector_t _example_vector = {
 		.hardware_intr_sig =       PAPI_INT_SIGNAL,
 
 		/* component specific cmp_info initializations */
+		.parallel_init = 1,
 	},
 
 	/* sizes of framework-opaque component-private structures */
@@ -16,6 +16,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 /* Headers required by PAPI */
 #include "papi.h"
@@ -29,11 +32,15 @@ papi_vector_t _io_vector;
 
 // Maximum expected characters per line in file.
 #define FILE_LINE_SIZE 256
+// Maximum expected size of the whole file.
+#define FILE_SIZE 4096
 // Maximum expected events in file. ARBITRARY VALUE, 
 // set as needed, just avoiding malloc() and free().
 #define IO_COUNTERS 64
 // File name to access.
 #define IO_FILENAME "/proc/self/io"
+// File of a thread an EventSet is attached to.
+#define IO_TASK_FILENAME "/proc/%d/task/%d/io"
 
 // The following macro follows if a string function has an error. It should 
 // never happen; but it is necessary to prevent compiler warnings. We print 
@@ -58,6 +65,8 @@ typedef struct _io_control_state
    long long EventSetVal[IO_COUNTERS];
    long long EventSetReport[IO_COUNTERS];
    int EventSetIdx[IO_COUNTERS];
+   int tid;                            // Attached thread, 0 if none.
+   int fd;                             // Its task io file, -1 if not open.
 } _io_control_state_t;
 
 //-----------------------------------------------------------------------------
@@ -66,8 +75,9 @@ typedef struct _io_control_state
 typedef struct _io_context  
 {
    int  EventCount;
-   FILE *pFile;
-   char line[FILE_LINE_SIZE]; 
+   int  fd;                            // IO_FILENAME, kept open.
+   pid_t pid;                          // Process fd was opened in.
+   char buff[FILE_SIZE];
 } _io_context_t;
 
 // ----------------------- GLOBALS ----------------------------
@@ -77,13 +87,80 @@ typedef struct _io_context
 static int gEventCount;
 static IO_native_event_entry_t *io_native_table;
 
+// Reread a whole io file from the start into buff, z-terminated.
+// Returns the number of bytes, or -1 on error or if buff is too small.
+static int
+io_read_file(int fd, char *buff, int size)
+{
+    int len = 0, n;
+
+    while (len < size - 1) {
+        n = pread(fd, buff + len, size - 1 - len, len);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        len += n;
+    }
+    if (len == size - 1) return -1;
+    buff[len] = 0;
+
+    return len;
+} // END ROUTINE.
+
+// Parse the "name: value" lines of an io file. Stores up to max
+// values; returns the number of lines, or -1 on a bad line.
+static int
+io_parse_values(const char *p, long long *values, int max)
+{
+    int count = 0;
+    long long value;
+
+    while (*p) {
+        // Skip the name, which must be at least 1 character.
+        const char *name = p;
+        while (*p && *p != ':' && *p != '\n' && *p != ' ') p++;
+        if (*p != ':' || p == name) return -1;
+        p++;
+
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p < '0' || *p > '9') return -1;
+        value = 0;
+        while (*p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+        }
+        if (*p == '\n') p++;
+        else if (*p) return -1;
+
+        if (count < max) values[count] = value;
+        count++;
+    }
+
+    return count;
+} // END ROUTINE.
+
+// Open IO_FILENAME in the context, unless it is already open in this
+// process; a forked child must not read its parent's file.
+static int
+io_open_file(_io_context_t *ctx)
+{
+    pid_t pid = getpid();
+
+    if (ctx->fd >= 0 && ctx->pid == pid) return PAPI_OK;
+    if (ctx->fd >= 0) close(ctx->fd);
+
+    ctx->fd = open(IO_FILENAME, O_RDONLY);
+    ctx->pid = pid;
+    if (ctx->fd < 0) return PAPI_ENOCNTR;
+
+    return PAPI_OK;
+} // END ROUTINE.
+
 // Code to just count events in file, fills in a context.
 // This may be a dummy from init_component.
 static int io_count_events(_io_context_t *myCtx)
 {
     myCtx->EventCount = 0;
-    myCtx->pFile = fopen (IO_FILENAME,"r");
-    if (myCtx->pFile == NULL) {
+    myCtx->fd = -1;
+    if (io_open_file(myCtx) != PAPI_OK) {
         int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
         "Failed to open target file '%s'.", IO_FILENAME);
         _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
@@ -92,38 +169,30 @@ static int io_count_events(_io_context_t *myCtx)
     }
 
     // Just count the lines, basic vetting for ability to parse.
-    while (1) {
-        char *res;
-        // fgets guarantees z-terminator, reads at most FILE_LINE_SIZE-1 bytes.
-        res = fgets(myCtx->line, FILE_LINE_SIZE, myCtx->pFile);
-        if (res  == NULL) break;
-        // If the read filled the whole buffer, line is too long.
-        if (strlen(myCtx->line) == (FILE_LINE_SIZE-1)) {
-            fclose(myCtx->pFile);
-            int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
-            "File '%s' line %i too long.", IO_FILENAME, myCtx->EventCount+1);
-            _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
-            if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
-            return PAPI_ENOSUPP;
-        }
-
-        char dummy[FILE_LINE_SIZE] = {0};
-        long long tmplong = 0LL;
-        int nf = sscanf( myCtx->line, "%s %lld\n", dummy, &tmplong);
-        if (nf != 2 || strlen(dummy)<2 || dummy[strlen(dummy)-1] != ':') {
-            fclose(myCtx->pFile);
-            int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
-            "File '%s' line %i bad format.", IO_FILENAME, myCtx->EventCount+1);
-            _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
-            if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
-            return PAPI_ENOSUPP;
-        }
+    if (io_read_file(myCtx->fd, myCtx->buff, FILE_SIZE) < 0) {
+        close(myCtx->fd);
+        myCtx->fd = -1;
+        int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
+        "File '%s' could not be read or is too long.", IO_FILENAME);
+        _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
+        if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
+        return PAPI_ENOSUPP;
+    }
 
-        myCtx->EventCount++; 
-    } // END READING.
+    myCtx->EventCount = io_parse_values(myCtx->buff, NULL, 0);
+    if (myCtx->EventCount < 0) {
+        close(myCtx->fd);
+        myCtx->fd = -1;
+        myCtx->EventCount = 0;
+        int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
+        "File '%s' bad format.", IO_FILENAME);
+        _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
+        if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
+        return PAPI_ENOSUPP;
+    }
 
-    // NOTE: We intentionally leave file open; up to caller to close
-    // or rewind and continue.
+    // NOTE: We intentionally leave the file open, and its contents
+    // in the buffer; up to caller to close or keep reading it.
     return PAPI_OK;
 } // END ROUTINE.
 
@@ -134,28 +203,30 @@ static int io_count_events(_io_context_t *myCtx)
 static int 
 io_hardware_read(_io_context_t *ctx, _io_control_state_t *ctl)
 {
-    ctx->pFile = fopen(IO_FILENAME, "r");
-    if (ctx->pFile == NULL) return(PAPI_ENOCNTR); /* No counters */
-
-    /* Read each line */
-    int idx;
-    for (idx=0; idx<gEventCount; idx++) {
-        if (fgets(ctx->line, FILE_LINE_SIZE-1, ctx->pFile)) {
-            char dummy[FILE_LINE_SIZE] = {0};
-            long long tmplong = 0LL;
-            int nf = sscanf(ctx->line, "%s %lld\n", dummy, &tmplong);
-            if (nf != 2 || strlen(dummy)<2 || dummy[strlen(dummy)-1] != ':') {
-                return PAPI_ENOCNTR;
-            }
-
-            ctl->EventSetVal[idx] = tmplong;
-        } else {                            /* Did not read ALL counters. */
-            return(PAPI_EMISC);
+    char filename[PAPI_MIN_STR_LEN];
+    int fd, count;
+
+    if (ctl->tid > 0) {
+        // Attached: that thread's own counters.
+        if (ctl->fd < 0) {
+            snprintf(filename, sizeof(filename), IO_TASK_FILENAME,
+                ctl->tid, ctl->tid);
+            ctl->fd = open(filename, O_RDONLY);
+            if (ctl->fd < 0) return PAPI_ESYS;
         }
+        fd = ctl->fd;
+    } else {
+        if (io_open_file(ctx) != PAPI_OK) return PAPI_ENOCNTR; /* No counters */
+        fd = ctx->fd;
     }
 
-    fclose(ctx->pFile);
-    return(PAPI_OK);
+    if (io_read_file(fd, ctx->buff, FILE_SIZE) < 0) return PAPI_ESYS;
+
+    count = io_parse_values(ctx->buff, ctl->EventSetVal, IO_COUNTERS);
+    if (count < 0) return PAPI_ENOCNTR;
+    if (count < gEventCount) return PAPI_EMISC; /* Did not read ALL counters. */
+
+    return PAPI_OK;
 } // END FUNCTION.
 
 /********************************************************************/
@@ -171,6 +242,7 @@ _io_init_component( int cidx )
 {
     _io_context_t myCtx;
     int ret, fileIdx;
+    char *line, *colon;
     SUBDBG( "_io_init_component..." );
    
     ret = io_count_events(&myCtx);
@@ -181,15 +253,14 @@ _io_init_component( int cidx )
         if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
         goto fn_fail;
     }
- 
-    rewind(myCtx.pFile);
+
+    close(myCtx.fd);
 
     if (myCtx.EventCount > IO_COUNTERS) {
         int strErr=snprintf(_io_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
         "File '%s' has %i events, exceeds counter limit of %i.", IO_FILENAME, myCtx.EventCount, IO_COUNTERS);
         _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
         if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
-        fclose(myCtx.pFile);
         ret = PAPI_ENOSUPP;
         goto fn_fail;
     }
@@ -205,18 +276,18 @@ _io_init_component( int cidx )
         "Failed to allocate %lu bytes for _io_native_table.", gEventCount*sizeof(IO_native_event_entry_t));
         _io_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
         if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
-        fclose(myCtx.pFile);
         ret = PAPI_ENOMEM;
         goto fn_fail;
     }
 
+    // Names come from the buffer io_count_events() already vetted.
+    line = myCtx.buff;
     for (fileIdx = 0; fileIdx < gEventCount; fileIdx++) {
-        (void) fgets(myCtx.line, FILE_LINE_SIZE, myCtx.pFile);
         char name[FILE_LINE_SIZE] = {0};
-        long long tmplong = 0LL;
-        // No check for error here, we would have caught it in io_count_events().
-        (void) sscanf(myCtx.line, "%s %lld\n", name, &tmplong);
-        name[strlen(name)-1]=0;     // null terminate over ':' we found.
+        colon = strchr(line, ':');
+        snprintf(name, sizeof(name), "%.*s", (int) (colon - line), line);
+        line = strchr(colon, '\n');
+        line = (line == NULL) ? colon + strlen(colon) : line + 1;
         strncpy(io_native_table[fileIdx].name, name, PAPI_MAX_STR_LEN-1);
         io_native_table[fileIdx].fileIdx=fileIdx;
         io_native_table[fileIdx].desc[0]=0;         // flag for successful copy.
@@ -248,7 +319,6 @@ _io_init_component( int cidx )
         }
     } // END READING.
 
-    fclose(myCtx.pFile);
     // Export the total number of events available, at least on the init thread.
     _io_vector.cmp_info.num_native_events = gEventCount;
     _io_vector.cmp_info.num_cntrs = IO_COUNTERS;
@@ -277,12 +347,12 @@ _io_init_thread( hwd_context_t *ctx )
 
     // File mismatch on event count kills it.
     if (gEventCount > 0 && myCtx->EventCount != gEventCount) {
-        fclose(myCtx->pFile);
-        myCtx->pFile = NULL;
+        close(myCtx->fd);
+        myCtx->fd = -1;
         return PAPI_ENOSUPP;
     }
 
-    fclose(myCtx->pFile);
+    // Keep the file open, reads just pread it again.
     return PAPI_OK;
 } // END of init thread.
 
@@ -293,6 +363,7 @@ _io_init_control_state( hwd_control_state_t * ctl )
 {
     _io_control_state_t* control = ( _io_control_state_t* ) ctl;
     memset(control, 0, sizeof(_io_control_state_t));
+    control->fd = -1;
     return PAPI_OK;
 } // END.
 
@@ -312,8 +383,12 @@ _io_update_control_state( hwd_control_state_t *ctl,
 
     myCtl->EventSetCount = count;
     
-    /* if no events, return */
-    if (count==0) return PAPI_OK;
+    /* if no events, return; the EventSet may be on its way out */
+    if (count==0) {
+        if (myCtl->fd >= 0) close(myCtl->fd);
+        myCtl->fd = -1;
+        return PAPI_OK;
+    }
 
     for( i = 0; i < count; i++ ) {
         index = native[i].ni_event;
@@ -362,11 +437,12 @@ _io_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     (void) flags;
     _io_context_t *myCtx = (_io_context_t*) ctx;
     _io_control_state_t *myCtl = (_io_control_state_t*) ctl;
-    int i;
+    int i, ret;
     SUBDBG( "io_read... %p %d", ctx, flags );
 
     /* Read all counters into EventSetVal */
-    io_hardware_read(myCtx, myCtl);
+    ret = io_hardware_read(myCtx, myCtl);
+    if (ret != PAPI_OK) return ret;
     for (i=0; i<myCtl->EventSetCount; i++) {
         myCtl->EventSetReport[i]=myCtl->EventSetVal[myCtl->EventSetIdx[i]];
     }
@@ -416,24 +492,51 @@ _io_shutdown_component(void)
 static int
 _io_shutdown_thread( hwd_context_t *ctx )
 {
-    (void) ctx;
+    _io_context_t *myCtx = (_io_context_t*) ctx;
     SUBDBG( "io_shutdown_thread... %p", ctx );
+    if (myCtx->fd >= 0 && myCtx->pid == getpid()) close(myCtx->fd);
+    myCtx->fd = -1;
     return PAPI_OK;
 }
 
 /** This function sets various options in the component
   @param[in] ctx -- hardware context
   @param[in] code valid are PAPI_SET_DEFDOM, PAPI_SET_DOMAIN, 
-  PAPI_SETDEFGRN, PAPI_SET_GRANUL and PAPI_SET_INHERIT
+  PAPI_SETDEFGRN, PAPI_SET_GRANUL, PAPI_SET_INHERIT, PAPI_ATTACH
+  and PAPI_DETACH
   @param[in] option -- options to be set
  */
 static int
 _io_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 {
     (void) ctx;
-    (void) code;
-    (void) option;
+    _io_control_state_t *myCtl;
+    char filename[PAPI_MIN_STR_LEN];
+    int fd;
     SUBDBG( "io_ctl..." );
+
+    switch (code) {
+        case PAPI_ATTACH:
+            // Open it now, so a missing thread or permission fails here.
+            snprintf(filename, sizeof(filename), IO_TASK_FILENAME,
+                (int) option->attach.tid, (int) option->attach.tid);
+            fd = open(filename, O_RDONLY);
+            if (fd < 0) return (errno == EACCES) ? PAPI_EPERM : PAPI_ESYS;
+
+            myCtl = (_io_control_state_t*) option->attach.ESI->ctl_state;
+            if (myCtl->fd >= 0) close(myCtl->fd);
+            myCtl->fd = fd;
+            myCtl->tid = option->attach.tid;
+            return PAPI_OK;
+
+        case PAPI_DETACH:
+            myCtl = (_io_control_state_t*) option->attach.ESI->ctl_state;
+            if (myCtl->fd >= 0) close(myCtl->fd);
+            myCtl->fd = -1;
+            myCtl->tid = 0;
+            return PAPI_OK;
+    }
+
     return PAPI_OK;
 }
 
@@ -583,6 +686,9 @@ papi_vector_t _io_vector = {
         .hardware_intr_sig =       PAPI_INT_SIGNAL,
 
         /* component specific cmp_info initializations */
+        .attach =                  1,
+        .attach_must_ptrace =      0,
+        .parallel_init =           1,
     },
 
     /* sizes of framework-opaque component-private structures */
@@ -0,0 +1,138 @@
+/****************************/
+/* THIS IS OPEN SOURCE CODE */
+/****************************/
+
+/**
+ * @file    io_attach.c
+ * test case for I/O component
+ *
+ * @brief
+ *  Attaches an EventSet to a child process and checks that the
+ *  counts follow the child's writes, read from its
+ *  /proc/<pid>/task/<tid>/io, and not the writes of this process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_WRITES  1000
+#define WRITE_SIZE  1024
+
+static void
+write_devnull( int n )
+{
+    char buff[WRITE_SIZE];
+    int fd, i;
+
+    memset( buff, 0, sizeof ( buff ) );
+    fd = open( "/dev/null", O_WRONLY );
+    if ( fd < 0 ) return;
+    for ( i = 0; i < n; i++ ) {
+        if ( write( fd, buff, sizeof ( buff ) ) != sizeof ( buff ) ) break;
+    }
+    close( fd );
+}
+
+int main (int argc, char **argv)
+{
+    int retval, status, quiet, to_child[2], to_parent[2];
+    int EventSet = PAPI_NULL;
+    long long before[2], after[2], wchar, syscw;
+    PAPI_option_t opt;
+    pid_t pid;
+    char c;
+
+    /* Set TESTS_QUIET variable */
+    quiet = tests_quiet( argc, argv );
+
+    if ( pipe( to_child ) || pipe( to_parent ) )
+        test_fail( __FILE__, __LINE__, "pipe", PAPI_ESYS );
+
+    pid = fork();
+    if ( pid < 0 )
+        test_fail( __FILE__, __LINE__, "fork", PAPI_ESYS );
+    if ( pid == 0 ) {
+        /* wait for the go, write, report back, wait to be killed */
+        if ( read( to_child[0], &c, 1 ) != 1 ) _exit( 1 );
+        write_devnull( NUM_WRITES );
+        if ( write( to_parent[1], "d", 1 ) != 1 ) _exit( 1 );
+        pause();
+        _exit( 0 );
+    }
+
+    retval = PAPI_library_init( PAPI_VER_CURRENT );
+    if ( retval != PAPI_VER_CURRENT )
+        test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+    retval = PAPI_create_eventset( &EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+    retval = PAPI_add_named_event( EventSet, "io:::wchar" );
+    if ( retval == PAPI_OK )
+        retval = PAPI_add_named_event( EventSet, "io:::syscw" );
+    if ( retval != PAPI_OK ) {
+        kill( pid, SIGKILL );
+        waitpid( pid, &status, 0 );
+        test_skip( __FILE__, __LINE__, "io events not available", retval );
+    }
+
+    memset( &opt, 0, sizeof ( opt ) );
+    opt.attach.eventset = EventSet;
+    opt.attach.tid = pid;
+    retval = PAPI_set_opt( PAPI_ATTACH, &opt );
+    if ( retval != PAPI_OK ) {
+        kill( pid, SIGKILL );
+        waitpid( pid, &status, 0 );
+        if ( retval == PAPI_EPERM )
+            test_skip( __FILE__, __LINE__, "PAPI_attach", retval );
+        test_fail( __FILE__, __LINE__, "PAPI_attach", retval );
+    }
+
+    retval = PAPI_start( EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+    retval = PAPI_read( EventSet, before );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+
+    /* our own writes must not show up */
+    write_devnull( 2 * NUM_WRITES );
+
+    if ( write( to_child[1], "g", 1 ) != 1 ||
+         read( to_parent[0], &c, 1 ) != 1 )
+        test_fail( __FILE__, __LINE__, "child", PAPI_ESYS );
+
+    retval = PAPI_stop( EventSet, after );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+    kill( pid, SIGKILL );
+    waitpid( pid, &status, 0 );
+
+    /* the child's report to us is one more write */
+    wchar = after[0] - before[0];
+    syscw = after[1] - before[1];
+    if ( !quiet ) {
+        printf( "child wchar %lld (expected %d), syscw %lld (expected %d)\n",
+                wchar, NUM_WRITES * WRITE_SIZE + 1, syscw, NUM_WRITES + 1 );
+    }
+
+    if ( wchar != NUM_WRITES * WRITE_SIZE + 1 || syscw != NUM_WRITES + 1 )
+        test_fail( __FILE__, __LINE__, "attached counts", 0 );
+
+    PAPI_shutdown();
+
+    test_pass( __FILE__ );
+
+    return 0;
+}
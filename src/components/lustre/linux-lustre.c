@@ -14,18 +14,24 @@
 */
 
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "papi.h"
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
 
+struct lustre_fs_struct;
+
 /** describes a single counter with its properties */
 typedef struct counter_info_struct
 {
@@ -33,7 +39,9 @@ typedef struct counter_info_struct
 	char *name;
 	char *description;
 	char *unit;
-	unsigned long long value;
+	unsigned long long value;	/* last value seen by the sampler */
+	struct lustre_fs_struct *fs;	/* filesystem the counter belongs to */
+	int field;			/* LUSTRE_FIELD_* */
 } counter_info;
 
 typedef struct
@@ -48,12 +56,27 @@ typedef struct lustre_fs_struct
 {
 	char *proc_file;
 	char *proc_file_readahead;
+	int proc_fd;			/* kept open, read with pread */
+	int readahead_fd;
 	counter_info *write_cntr;
 	counter_info *read_cntr;
 	counter_info *readahead_cntr;
 	struct lustre_fs_struct *next;
 } lustre_fs;
 
+/* The values of a filesystem, read_bytes and write_bytes come from the
+   stats file, read but discarded from read_ahead_stats. */
+#define LUSTRE_FIELD_READ       0
+#define LUSTRE_FIELD_WRITE      1
+#define LUSTRE_FIELD_READAHEAD  2
+#define LUSTRE_NUM_FIELDS       3
+
+#define LUSTRE_STATS_FIELDS     ((1<<LUSTRE_FIELD_READ)|(1<<LUSTRE_FIELD_WRITE))
+#define LUSTRE_ALL_FIELDS       ((1<<LUSTRE_NUM_FIELDS)-1)
+
+/* initial size of a read buffer, grown as needed */
+#define LUSTRE_BUFFER_SIZE 4096
+
 #define LUSTRE_MAX_COUNTERS 100
 #define LUSTRE_MAX_COUNTER_TERMS  LUSTRE_MAX_COUNTERS
 
@@ -69,19 +92,28 @@ typedef struct LUSTRE_control_state
         long long difference[LUSTRE_MAX_COUNTERS];
         int which_counter[LUSTRE_MAX_COUNTERS];
 	int num_events;
+	/* filesystems of the EventSet, each file is parsed once per read */
+	lustre_fs *fs[LUSTRE_MAX_COUNTERS];
+	int fields[LUSTRE_MAX_COUNTERS];	/* mask of LUSTRE_FIELD_* per fs */
+	int slot[LUSTRE_MAX_COUNTERS];		/* fs index of an event */
+	int num_fs;
+	long long lastupdate;
+	long long refresh_latency;
 } LUSTRE_control_state_t;
 
 
 typedef struct LUSTRE_context
 {
 	LUSTRE_control_state_t state;
+	char *buffer;
+	int buffer_size;
 } LUSTRE_context_t;
 
-/* Default path to lustre stats */
+/* Default path to lustre stats, PAPI_LUSTRE_PROC_DIR overrides it */
 #ifdef FAKE_LUSTRE
-const char proc_base_path[] = "./components/lustre/fake_proc/fs/lustre/";
+static char proc_base_path[PATH_MAX] = "./components/lustre/fake_proc/fs/lustre/";
 #else
-const char proc_base_path[] = "/proc/fs/lustre/";
+static char proc_base_path[PATH_MAX] = "/proc/fs/lustre/";
 #endif
 
 static counter_info **lustre_native_table = NULL;
@@ -91,6 +123,28 @@ static int table_size = 32;
 /* mount Lustre fs are kept in a list */
 static lustre_fs *root_lustre_fs = NULL;
 
+/* Optional background refresh. When PAPI_LUSTRE_REFRESH_MS is set, a
+   sampler thread parses the files of every filesystem at that period
+   and stores the values in the native table; reads then only load
+   them, and may be up to one period old.  The thread does not survive
+   fork, so a child reads the files itself. */
+typedef struct _lustre_sampler
+{
+	int period_ms;
+	int running;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	char *buffer;
+	int buffer_size;
+	int atfork_done;
+} _lustre_sampler_t;
+
+static _lustre_sampler_t sampler = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+};
+
 papi_vector_t _lustre_vector;
 
 /******************************************************************************
@@ -120,9 +174,12 @@ static int resize_native_table() {
  * @param name the short name of the counter
  * @param desc a longer description
  * @param unit the unit for this counter
+ * @param fs the filesystem the counter is read from
+ * @param field which value of the filesystem, LUSTRE_FIELD_*
  */
 static counter_info *
-addCounter( const char *name, const char *desc, const char *unit )
+addCounter( const char *name, const char *desc, const char *unit,
+	    lustre_fs *fs, int field )
 {
    SUBDBG("ENTER: name: %s, desc: %s, unit: %s\n", name, desc, unit);
 
@@ -146,6 +203,8 @@ addCounter( const char *name, const char *desc, const char *unit )
     cntr->description = strdup( desc );
     cntr->unit = strdup( unit );
     cntr->value = 0;
+    cntr->fs = fs;
+    cntr->field = field;
 
     lustre_native_table[num_events]=cntr;
 
@@ -160,78 +219,47 @@ SUBDBG("EXIT: cntr: %p\n", cntr);
  * @param name fs name
  * @param procpath_general path to the 'stats' file in /proc/fs/lustre/... for this fs
  * @param procpath_readahead path to the 'readahead' file in /proc/fs/lustre/... for this fs
+ *
+ * Both files stay open until the component is shut down.
  */
 static int
 addLustreFS( const char *name,
-	     const char *procpath_general, 
+	     const char *procpath_general,
 	     const char *procpath_readahead )
 {
 	lustre_fs *fs, *last;
 	char counter_name[512];
-	FILE *fff;
 
 	SUBDBG("Adding lustre fs\n");
 
-	fs = malloc( sizeof ( lustre_fs ) );
+	fs = calloc( 1, sizeof ( lustre_fs ) );
 	if ( fs == NULL ) {
 	   SUBDBG("can not allocate memory for new Lustre FS description\n" );
 	   return PAPI_ENOMEM;
 	}
 
 	fs->proc_file=strdup(procpath_general);
-	fff = fopen( procpath_general, "r" );
-	if ( fff == NULL ) {
+	fs->proc_fd = open( procpath_general, O_RDONLY );
+	if ( fs->proc_fd < 0 ) {
 	  SUBDBG("can not open '%s'\n", procpath_general );
      free(fs->proc_file);                                   // strdup.
 	  free(fs);                                              // malloc.
 	  return PAPI_ESYS;
 	}
-	fclose(fff);
 
 	fs->proc_file_readahead = strdup(procpath_readahead);
-	fff = fopen( procpath_readahead, "r" );
-	if ( fff == NULL ) {
+	fs->readahead_fd = open( procpath_readahead, O_RDONLY );
+	if ( fs->readahead_fd < 0 ) {
 	  SUBDBG("can not open '%s'\n", procpath_readahead );
+     close(fs->proc_fd);
      free(fs->proc_file_readahead);                         // strdup.
      free(fs->proc_file);                                   // strdup.
 	  free(fs);                                              // malloc.
 	  return PAPI_ESYS;
 	}
-	fclose(fff);
-
-	sprintf( counter_name, "%s_llread", name );
-	if (NULL == (fs->read_cntr = addCounter( counter_name, 
-				    "bytes read on this lustre client", 
-				    "bytes" ))) {
-         free(fs->proc_file_readahead);                         // strdup.
-         free(fs->proc_file);                                   // strdup.
-	      free(fs);                                              // malloc.
-			return PAPI_ENOMEM;
-	}
-
-	sprintf( counter_name, "%s_llwrite", name );
-	if ( NULL == (fs->write_cntr = addCounter( counter_name, 
-				     "bytes written on this lustre client",
-				     "bytes" ))) {
-			free(fs->read_cntr);
-         free(fs->proc_file_readahead);                         // strdup.
-         free(fs->proc_file);                                   // strdup.
-	      free(fs);                                              // malloc.
-			return PAPI_ENOMEM;
-	}
-
-	sprintf( counter_name, "%s_wrong_readahead", name );
-	if ( NULL == (fs->readahead_cntr = addCounter( counter_name, 
-					 "bytes read but discarded due to readahead",
-					 "bytes" ))) {
-			free(fs->read_cntr);
-			free(fs->write_cntr);
-         free(fs->proc_file_readahead);                         // strdup.
-         free(fs->proc_file);                                   // strdup.
-	      free(fs);                                              // malloc.
-			return PAPI_ENOMEM;
-	}
 
+	/* from here on the counters are in the native table, which
+	   host_finalize() frees */
 	fs->next = NULL;
 
 	/* Insert into the linked list */
@@ -246,6 +274,28 @@ addLustreFS( const char *name,
 
 		last->next = fs;
 	}
+
+	sprintf( counter_name, "%s_llread", name );
+	if (NULL == (fs->read_cntr = addCounter( counter_name,
+				    "bytes read on this lustre client",
+				    "bytes", fs, LUSTRE_FIELD_READ ))) {
+			return PAPI_ENOMEM;
+	}
+
+	sprintf( counter_name, "%s_llwrite", name );
+	if ( NULL == (fs->write_cntr = addCounter( counter_name,
+				     "bytes written on this lustre client",
+				     "bytes", fs, LUSTRE_FIELD_WRITE ))) {
+			return PAPI_ENOMEM;
+	}
+
+	sprintf( counter_name, "%s_wrong_readahead", name );
+	if ( NULL == (fs->readahead_cntr = addCounter( counter_name,
+					 "bytes read but discarded due to readahead",
+					 "bytes", fs, LUSTRE_FIELD_READAHEAD ))) {
+			return PAPI_ENOMEM;
+	}
+
 	return PAPI_OK;
 }
 
@@ -300,11 +350,12 @@ init_lustre_counters( void  )
 
 	  /* Lustre paths are of type server-UUID */
 
-	  ptr = strstr(path,"llite/") + 6;
+	  ptr = strstr(path,"llite/");
 	 if (ptr == NULL) {
 	  SUBDBG("Path: %s, missing llite directory, performance event not created.\n", path);
 	  continue;
 	  }
+	 ptr += 6;
 
 	 strncpy(fs_name, ptr, sizeof(fs_name)-1);
 	 fs_name[sizeof(fs_name)-1] = '\0';
@@ -324,7 +375,10 @@ init_lustre_counters( void  )
 	  SUBDBG("Now checking for file %s\n", path_readahead);
 
 	  strcpy( ptr, "read_ahead_stats" );
-	  addLustreFS( fs_name, path_stats, path_readahead );
+	  if ( addLustreFS( fs_name, path_stats, path_readahead ) == PAPI_ENOMEM ) {
+		closedir( proc_dir );
+		return PAPI_ENOMEM;
+	  }
 	  found_luster_fs++;
 	}
 	closedir( proc_dir );
@@ -339,51 +393,249 @@ init_lustre_counters( void  )
 }
 
 /**
- * updates all Lustre related counters
+ * reads a whole proc file with pread, growing the buffer until it fits
+ * @return length read, -1 on error
  */
-static void
-read_lustre_counter( )
+static int
+read_proc_file( int fd, char **buffer, int *buffer_size )
 {
-	lustre_fs *fs = root_lustre_fs;
-	FILE *fff;
-	char buffer[BUFSIZ];
+	char *tmp;
+	ssize_t len;
 
-	while ( fs != NULL ) {
+	if ( *buffer == NULL ) {
+		*buffer = papi_malloc( LUSTRE_BUFFER_SIZE );
+		if ( *buffer == NULL ) return -1;
+		*buffer_size = LUSTRE_BUFFER_SIZE;
+	}
 
-	  /* read values from stats file */
-	  fff=fopen(fs->proc_file,"r" );
-	  if (fff != NULL) {
-		  while(1) {
-			if (fgets(buffer,BUFSIZ,fff)==NULL) break;
-	
-			if (strstr( buffer, "write_bytes" )) {
-			  sscanf(buffer,"%*s %*d %*s %*s %*d %*d %llu",&fs->write_cntr->value);
-			  SUBDBG("Read %llu write_bytes\n",fs->write_cntr->value);
-			}
-	
-			if (strstr( buffer, "read_bytes" )) {
-			  sscanf(buffer,"%*s %*d %*s %*s %*d %*d %llu",&fs->read_cntr->value);
-			  SUBDBG("Read %llu read_bytes\n",fs->read_cntr->value);
+	while ( 1 ) {
+		len = pread( fd, *buffer, *buffer_size - 1, 0 );
+		if ( len < 0 ) return -1;
+		if ( len < *buffer_size - 1 ) break;
+		tmp = papi_realloc( *buffer, 2 * *buffer_size );
+		if ( tmp == NULL ) return -1;
+		*buffer = tmp;
+		*buffer_size *= 2;
+	}
+	(*buffer)[len] = '\0';
+
+	return (int) len;
+}
+
+/**
+ * returns the n-th (from 0) blank separated number of the line at p
+ */
+static unsigned long long
+line_field( const char *p, const char *end, int n )
+{
+	unsigned long long value = 0;
+
+	while ( n-- > 0 ) {
+		while ( p < end && *p != ' ' && *p != '\t' ) p++;
+		while ( p < end && ( *p == ' ' || *p == '\t' ) ) p++;
+	}
+	while ( p < end && *p >= '0' && *p <= '9' ) {
+		value = value * 10 + ( unsigned long long ) ( *p - '0' );
+		p++;
+	}
+
+	return value;
+}
+
+/**
+ * reads the fields of a filesystem that are set in mask into values,
+ * parsing each file in a single pass that stops once every wanted
+ * line was seen
+ */
+static int
+read_lustre_fs( lustre_fs *fs, int mask, char **buffer, int *buffer_size,
+		unsigned long long *values )
+{
+	const char *p, *end, *eol;
+	int len, todo;
+
+	memset( values, 0, LUSTRE_NUM_FIELDS * sizeof ( values[0] ) );
+
+	todo = mask & LUSTRE_STATS_FIELDS;
+	if ( todo ) {
+		len = read_proc_file( fs->proc_fd, buffer, buffer_size );
+		if ( len < 0 ) return PAPI_ESYS;
+		p = *buffer;
+		end = p + len;
+		while ( todo && p < end ) {
+			eol = memchr( p, '\n', end - p );
+			if ( eol == NULL ) eol = end;
+
+			/* read_bytes 244645704 samples [bytes] 1 3539527 2698801595337 */
+			if ( ( todo & ( 1 << LUSTRE_FIELD_READ ) ) &&
+			     !strncmp( p, "read_bytes ", 11 ) ) {
+				values[LUSTRE_FIELD_READ] = line_field( p, eol, 6 );
+				todo &= ~( 1 << LUSTRE_FIELD_READ );
+			} else if ( ( todo & ( 1 << LUSTRE_FIELD_WRITE ) ) &&
+				    !strncmp( p, "write_bytes ", 12 ) ) {
+				values[LUSTRE_FIELD_WRITE] = line_field( p, eol, 6 );
+				todo &= ~( 1 << LUSTRE_FIELD_WRITE );
 			}
-		  }
-		  fclose(fff);
-	  }
+			p = eol + 1;
+		}
+	}
 
-	  fff=fopen(fs->proc_file_readahead,"r");
-	  if (fff != NULL) {
-		  while(1) {
-			if (fgets(buffer,BUFSIZ,fff)==NULL) break;
-	
-			if (strstr( buffer, "read but discarded")) {
-			   sscanf(buffer,"%*s %*s %*s %llu",&fs->readahead_cntr->value);
-			   SUBDBG("Read %llu discared\n",fs->readahead_cntr->value);
-			   break;
+	if ( mask & ( 1 << LUSTRE_FIELD_READAHEAD ) ) {
+		len = read_proc_file( fs->readahead_fd, buffer, buffer_size );
+		if ( len < 0 ) return PAPI_ESYS;
+		p = *buffer;
+		end = p + len;
+		while ( p < end ) {
+			eol = memchr( p, '\n', end - p );
+			if ( eol == NULL ) eol = end;
+
+			/* read but discarded        98955 */
+			if ( !strncmp( p, "read but discarded ", 19 ) ) {
+				values[LUSTRE_FIELD_READAHEAD] = line_field( p, eol, 3 );
+				break;
 			}
-	  	  }
-		  fclose(fff);
-	  }
-	  fs = fs->next;
+			p = eol + 1;
+		}
+	}
+
+	return PAPI_OK;
+}
+
+/**
+ * reads the counters of an EventSet into values
+ */
+static int
+read_lustre_counters( LUSTRE_context_t *ctx, LUSTRE_control_state_t *ctl,
+		      long long *values )
+{
+	unsigned long long fs_values[LUSTRE_MAX_COUNTERS][LUSTRE_NUM_FIELDS];
+	counter_info *cntr;
+	int i, retval;
+
+	if ( sampler.running ) {
+		for ( i = 0; i < ctl->num_events; i++ ) {
+			cntr = lustre_native_table[ctl->which_counter[i]];
+			values[i] = ( long long )
+				__atomic_load_n( &cntr->value, __ATOMIC_ACQUIRE );
+		}
+		return PAPI_OK;
+	}
+
+	for ( i = 0; i < ctl->num_fs; i++ ) {
+		retval = read_lustre_fs( ctl->fs[i], ctl->fields[i], &ctx->buffer,
+					 &ctx->buffer_size, fs_values[i] );
+		if ( retval != PAPI_OK ) return retval;
+	}
+
+	for ( i = 0; i < ctl->num_events; i++ ) {
+		cntr = lustre_native_table[ctl->which_counter[i]];
+		values[i] = ( long long ) fs_values[ctl->slot[i]][cntr->field];
+	}
+
+	return PAPI_OK;
+}
+
+/**
+ * parses every filesystem into the native table, used by the sampler
+ */
+static void
+sample_lustre_counters( void )
+{
+	unsigned long long values[LUSTRE_NUM_FIELDS];
+	lustre_fs *fs;
+
+	for ( fs = root_lustre_fs; fs != NULL; fs = fs->next ) {
+		if ( read_lustre_fs( fs, LUSTRE_ALL_FIELDS, &sampler.buffer,
+				     &sampler.buffer_size, values ) != PAPI_OK )
+			continue;
+		__atomic_store_n( &fs->read_cntr->value, values[LUSTRE_FIELD_READ],
+				  __ATOMIC_RELEASE );
+		__atomic_store_n( &fs->write_cntr->value, values[LUSTRE_FIELD_WRITE],
+				  __ATOMIC_RELEASE );
+		__atomic_store_n( &fs->readahead_cntr->value,
+				  values[LUSTRE_FIELD_READAHEAD], __ATOMIC_RELEASE );
+	}
+}
+
+static void *
+sampler_loop( void *arg )
+{
+	struct timespec deadline;
+
+	( void ) arg;
+
+	pthread_mutex_lock( &sampler.lock );
+	while ( sampler.running ) {
+		clock_gettime( CLOCK_REALTIME, &deadline );
+		deadline.tv_sec += sampler.period_ms / 1000;
+		deadline.tv_nsec += ( long ) ( sampler.period_ms % 1000 ) * 1000000L;
+		if ( deadline.tv_nsec >= 1000000000L ) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait( &sampler.wake, &sampler.lock, &deadline );
+		if ( sampler.running ) sample_lustre_counters(  );
 	}
+	pthread_mutex_unlock( &sampler.lock );
+
+	return NULL;
+}
+
+/**
+ * the child of a fork has no sampler thread, whatever the parent had
+ */
+static void
+sampler_atfork_child( void )
+{
+	sampler.running = 0;
+	pthread_mutex_init( &sampler.lock, NULL );
+	pthread_cond_init( &sampler.wake, NULL );
+}
+
+/**
+ * starts the sampler if PAPI_LUSTRE_REFRESH_MS asks for it
+ */
+static int
+start_sampler( void )
+{
+	char *env;
+
+	env = getenv( "PAPI_LUSTRE_REFRESH_MS" );
+	if ( env == NULL || atoi( env ) <= 0 ) return PAPI_OK;
+
+	/* the table is valid before the first read */
+	sample_lustre_counters(  );
+
+	if ( !sampler.atfork_done ) {
+		pthread_atfork( NULL, NULL, sampler_atfork_child );
+		sampler.atfork_done = 1;
+	}
+
+	sampler.period_ms = atoi( env );
+	sampler.running = 1;
+	if ( pthread_create( &sampler.thread, NULL, sampler_loop, NULL ) ) {
+		sampler.running = 0;
+		return PAPI_ESYS;
+	}
+
+	SUBDBG( "Refreshing lustre stats every %d ms\n", sampler.period_ms );
+	return PAPI_OK;
+}
+
+static void
+stop_sampler( void )
+{
+	if ( sampler.running ) {
+		pthread_mutex_lock( &sampler.lock );
+		sampler.running = 0;
+		pthread_cond_signal( &sampler.wake );
+		pthread_mutex_unlock( &sampler.lock );
+		pthread_join( sampler.thread, NULL );
+	}
+
+	if ( sampler.buffer ) papi_free( sampler.buffer );
+	sampler.buffer = NULL;
+	sampler.buffer_size = 0;
 }
 
 
@@ -397,13 +649,15 @@ host_finalize( void )
 	lustre_fs *fs, *next_fs;
 	counter_info *cntr;
 
+	stop_sampler(  );
+
 	for(i=0;i<num_events;i++) {
 	   cntr=lustre_native_table[i];
 	   if ( cntr != NULL ) {
 	      free( cntr->name );
 	      free( cntr->description );
 	      free( cntr->unit );
-	      free( cntr );	      
+	      free( cntr );
 	   }
 	   lustre_native_table[i]=NULL;
 	}
@@ -413,12 +667,13 @@ host_finalize( void )
 	num_events = 0;
    table_size = 32;
 
+	/* the counters were freed with the native table */
 	fs = root_lustre_fs;
 
 	while ( fs != NULL ) {
 		next_fs = fs->next;
-   	free(fs->read_cntr);
-   	free(fs->write_cntr);
+      close(fs->proc_fd);
+      close(fs->readahead_fd);
       free(fs->proc_file_readahead);                         // strdup.
       free(fs->proc_file);                                   // strdup.
       free(fs);                                              // malloc.
@@ -442,6 +697,12 @@ _lustre_init_component( int cidx )
 {
 	SUBDBG("ENTER:\n");
 	int ret = PAPI_OK;
+	char *env;
+
+	env = getenv("PAPI_LUSTRE_PROC_DIR");
+	if (env != NULL && env[0] != '\0') {
+	   snprintf(proc_base_path, sizeof(proc_base_path), "%s/", env);
+	}
 
 	resize_native_table();
 	ret=init_lustre_counters();
@@ -453,6 +714,14 @@ _lustre_init_component( int cidx )
        goto fn_fail;
 	}
 
+	ret=start_sampler();
+	if (ret!=PAPI_OK) {
+	   strncpy(_lustre_vector.cmp_info.disabled_reason,
+		   "Cannot start the lustre refresh thread",PAPI_MAX_STR_LEN);
+      host_finalize();                                         // cleanup.
+       goto fn_fail;
+	}
+
 	_lustre_vector.cmp_info.num_native_events=num_events;
 	_lustre_vector.cmp_info.CmpIdx = cidx;
 
@@ -474,7 +743,10 @@ _lustre_init_component( int cidx )
 static int
 _lustre_init_thread( hwd_context_t * ctx )
 {
-  (void) ctx;
+  LUSTRE_context_t *lustre_ctx = (LUSTRE_context_t *)ctx;
+
+  lustre_ctx->buffer = NULL;
+  lustre_ctx->buffer_size = 0;
 
   return PAPI_OK;
 }
@@ -498,7 +770,11 @@ _lustre_shutdown_component( void )
 static int
 _lustre_shutdown_thread( hwd_context_t * ctx )
 {
-	( void ) ctx;
+	LUSTRE_context_t *lustre_ctx = (LUSTRE_context_t *)ctx;
+
+	if ( lustre_ctx->buffer ) papi_free( lustre_ctx->buffer );
+	lustre_ctx->buffer = NULL;
+	lustre_ctx->buffer_size = 0;
 
 	return PAPI_OK;
 }
@@ -515,6 +791,8 @@ _lustre_init_control_state( hwd_control_state_t *ctl )
 
     memset(lustre_ctl->start_count,0,sizeof(long long)*LUSTRE_MAX_COUNTERS);
     memset(lustre_ctl->current_count,0,sizeof(long long)*LUSTRE_MAX_COUNTERS);
+    lustre_ctl->num_fs = 0;
+    lustre_ctl->refresh_latency = 0;
 
     return PAPI_OK;
 }
@@ -524,20 +802,35 @@ _lustre_init_control_state( hwd_control_state_t *ctl )
  *
  */
 static int
-_lustre_update_control_state( hwd_control_state_t *ctl, 
+_lustre_update_control_state( hwd_control_state_t *ctl,
 			      NativeInfo_t *native,
-			      int count, 
+			      int count,
 			      hwd_context_t *ctx )
 {
    SUBDBG("ENTER: ctl: %p, native: %p, count: %d, ctx: %p\n", ctl, native, count, ctx);
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
     ( void ) ctx;
-    int i, index;
+    int i, k, index;
+    counter_info *cntr;
 
+    lustre_ctl->num_fs = 0;
     for ( i = 0; i < count; i++ ) {
        index = native[i].ni_event;
        lustre_ctl->which_counter[i]=index;
        native[i].ni_position = i;
+
+       /* group the events by filesystem */
+       cntr = lustre_native_table[index];
+       for ( k = 0; k < lustre_ctl->num_fs; k++ ) {
+          if ( lustre_ctl->fs[k] == cntr->fs ) break;
+       }
+       if ( k == lustre_ctl->num_fs ) {
+          lustre_ctl->fs[k] = cntr->fs;
+          lustre_ctl->fields[k] = 0;
+          lustre_ctl->num_fs++;
+       }
+       lustre_ctl->fields[k] |= 1 << cntr->field;
+       lustre_ctl->slot[i] = k;
     }
 
     lustre_ctl->num_events=count;
@@ -552,21 +845,21 @@ _lustre_update_control_state( hwd_control_state_t *ctl,
 static int
 _lustre_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
-    ( void ) ctx;
-
+    LUSTRE_context_t *lustre_ctx = (LUSTRE_context_t *)ctx;
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
-    int i;
+    int retval;
 
-    read_lustre_counter(  );
-
-    for(i=0;i<lustre_ctl->num_events;i++) {
-       lustre_ctl->current_count[i]=
-                 lustre_native_table[lustre_ctl->which_counter[i]]->value;
-    }
+    retval = read_lustre_counters( lustre_ctx, lustre_ctl,
+				   lustre_ctl->current_count );
+    if ( retval != PAPI_OK ) return retval;
 
     memcpy( lustre_ctl->start_count,
 	    lustre_ctl->current_count,
 	    LUSTRE_MAX_COUNTERS * sizeof ( long long ) );
+    memset( lustre_ctl->difference, 0,
+	    LUSTRE_MAX_COUNTERS * sizeof ( long long ) );
+
+    lustre_ctl->lastupdate = PAPI_get_real_usec(  );
 
     return PAPI_OK;
 }
@@ -578,17 +871,19 @@ _lustre_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 static int
 _lustre_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
-
-    (void) ctx;
+    LUSTRE_context_t *lustre_ctx = (LUSTRE_context_t *)ctx;
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
-    int i;
+    int i, retval;
 
-    read_lustre_counter(  );
+    retval = read_lustre_counters( lustre_ctx, lustre_ctl,
+				   lustre_ctl->current_count );
+    if ( retval != PAPI_OK ) return retval;
 
     for(i=0;i<lustre_ctl->num_events;i++) {
-       lustre_ctl->current_count[i]=
-                 lustre_native_table[lustre_ctl->which_counter[i]]->value;
+       lustre_ctl->difference[i]=lustre_ctl->current_count[i]-
+	                                     lustre_ctl->start_count[i];
     }
+    lustre_ctl->lastupdate = PAPI_get_real_usec(  );
 
     return PAPI_OK;
 
@@ -603,19 +898,25 @@ static int
 _lustre_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 			 long long **events, int flags )
 {
-    (void) ctx;
     ( void ) flags;
 
+    LUSTRE_context_t *lustre_ctx = (LUSTRE_context_t *)ctx;
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
-    int i;
-
-    read_lustre_counter(  );
-
-    for(i=0;i<lustre_ctl->num_events;i++) {
-       lustre_ctl->current_count[i]=
-                 lustre_native_table[lustre_ctl->which_counter[i]]->value;
-       lustre_ctl->difference[i]=lustre_ctl->current_count[i]-
+    long long now = PAPI_get_real_usec(  );
+    int i, retval;
+
+    /* Only parse the files again if the cached values are too old */
+    if ( lustre_ctl->refresh_latency == 0 ||
+	 now - lustre_ctl->lastupdate > lustre_ctl->refresh_latency ) {
+       retval = read_lustre_counters( lustre_ctx, lustre_ctl,
+				      lustre_ctl->current_count );
+       if ( retval != PAPI_OK ) return retval;
+
+       for(i=0;i<lustre_ctl->num_events;i++) {
+          lustre_ctl->difference[i]=lustre_ctl->current_count[i]-
 	                                     lustre_ctl->start_count[i];
+       }
+       lustre_ctl->lastupdate = now;
     }
 
     *events = lustre_ctl->difference;
@@ -636,9 +937,7 @@ _lustre_reset( hwd_context_t * ctx, hwd_control_state_t * ctrl )
 
   /* re-initializes counter_start values to current */
 
-  _lustre_start(ctx,ctrl);
-
-  return PAPI_OK;
+  return _lustre_start(ctx,ctrl);
 }
 
 
@@ -662,19 +961,24 @@ _lustre_reset( hwd_context_t * ctx, hwd_control_state_t * ctrl )
 
 /* This function sets various options in the component
  * The valid codes being passed in are PAPI_SET_DEFDOM,
- * PAPI_SET_DOMAIN, PAPI_SETDEFGRN, PAPI_SET_GRANUL * and PAPI_SET_INHERIT
+ * PAPI_SET_DOMAIN, PAPI_SETDEFGRN, PAPI_SET_GRANUL,
+ * PAPI_SET_INHERIT and PAPI_REFRESH_LATENCY
  */
 static int
 _lustre_ctl( hwd_context_t * ctx, int code, _papi_int_option_t * option )
 {
 	( void ) ctx;
-	( void ) code;
-	( void ) option;
+
+	LUSTRE_control_state_t *lustre_ctl;
+
+	if ( code == PAPI_REFRESH_LATENCY ) {
+		lustre_ctl = (LUSTRE_control_state_t *)option->refresh.ESI->ctl_state;
+		lustre_ctl->refresh_latency = option->refresh.usec;
+	}
 
 	return PAPI_OK;
 }
 
-
 /*
  * This function can be used to set the event set level domains
  * where the events should be counted.  In particular: PAPI_DOM_USER,
@@ -796,6 +1100,8 @@ papi_vector_t _lustre_vector = {
        .fast_virtual_timer = 0,
        .attach = 0,
        .attach_must_ptrace = 0,
+       .refresh_latency = 1,
+       .parallel_init = 1,
        .available_domains = PAPI_DOM_ALL,
   },
 
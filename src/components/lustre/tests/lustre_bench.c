@@ -0,0 +1,329 @@
+/**
+ * @author PAPI team UTK/ICL
+ * Test case for lustre component
+ * @brief
+ *   Builds a synthetic /proc/fs/lustre tree with many llite filesystems,
+ *   in the format of the fake_proc tree, and gives it to the component
+ *   through PAPI_LUSTRE_PROC_DIR.  Checks the counted values, times
+ *   PAPI_read, checks PAPI_REFRESH_LATENCY and then does the same with
+ *   the background refresh of PAPI_LUSTRE_REFRESH_MS, which a forked
+ *   child does not inherit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_FS      256
+#define NUM_READS   20000
+#define DELTA       4096LL
+#define NUM_EVENTS  3
+
+static char proc_dir[] = "/tmp/papi_lustreXXXXXX";
+
+static void
+fs_dir( int i, char *path, int len )
+{
+    snprintf( path, len, "%s/llite/scratch%03d-ffff81022a%06x", proc_dir,
+              i, i );
+}
+
+/* filesystem i has read (i+1)*1000000 + step*DELTA bytes, written
+   twice that and discarded step*DELTA of the readahead */
+static void
+write_tree( int step, int create )
+{
+    char dir[PAPI_MAX_STR_LEN], path[PAPI_MAX_STR_LEN];
+    long long rd;
+    FILE *fff;
+    int i;
+
+    for ( i = 0; i < NUM_FS; i++ ) {
+        fs_dir( i, dir, sizeof ( dir ) );
+        if ( create )
+            mkdir( dir, 0700 );
+        rd = ( i + 1 ) * 1000000LL + step * DELTA;
+
+        /* rewritten in place, the component keeps the files open */
+        snprintf( path, sizeof ( path ), "%s/stats", dir );
+        fff = fopen( path, "w" );
+        if ( fff == NULL )
+            test_fail( __FILE__, __LINE__, path, PAPI_ESYS );
+        fprintf( fff, "snapshot_time             1211910176.321563 secs.usecs\n" );
+        fprintf( fff, "dirty_pages_hits          322117541 samples [regs]\n" );
+        fprintf( fff, "dirty_pages_misses        7250116 samples [regs]\n" );
+        fprintf( fff, "read_bytes                %d samples [bytes] 1 3539527 %lld\n",
+                 1000 + step, rd );
+        fprintf( fff, "write_bytes               %d samples [bytes] 1 2097152 %lld\n",
+                 2000 + step, 2 * rd );
+        fprintf( fff, "brw_read                  563 samples [pages] 4096 4096 2306048\n" );
+        fprintf( fff, "ioctl                     15931 samples [regs]\n" );
+        fprintf( fff, "open                      275052 samples [regs]\n" );
+        fprintf( fff, "close                     294462 samples [regs]\n" );
+        fprintf( fff, "mmap                      33735 samples [regs]\n" );
+        fprintf( fff, "seek                      282797295 samples [regs]\n" );
+        fprintf( fff, "fsync                     1028 samples [regs]\n" );
+        fprintf( fff, "setattr                   22387 samples [regs]\n" );
+        fprintf( fff, "truncate                  4412 samples [regs]\n" );
+        fprintf( fff, "getattr                   1763011 samples [regs]\n" );
+        fprintf( fff, "statfs                    1708 samples [regs]\n" );
+        fprintf( fff, "alloc_inode               374613 samples [regs]\n" );
+        fprintf( fff, "setxattr                  693 samples [regs]\n" );
+        fprintf( fff, "getxattr                  4528 samples [regs]\n" );
+        fprintf( fff, "inode_permission          9269889 samples [regs]\n" );
+        fclose( fff );
+
+        snprintf( path, sizeof ( path ), "%s/read_ahead_stats", dir );
+        fff = fopen( path, "w" );
+        if ( fff == NULL )
+            test_fail( __FILE__, __LINE__, path, PAPI_ESYS );
+        fprintf( fff, "snapshot_time:         1251851453.382275 (secs.usecs)\n" );
+        fprintf( fff, "pending issued pages:           0\n" );
+        fprintf( fff, "hits                      7301235\n" );
+        fprintf( fff, "misses                    10546\n" );
+        fprintf( fff, "readpage not consecutive  14369\n" );
+        fprintf( fff, "miss inside window        1\n" );
+        fprintf( fff, "failed grab_cache_page    6285314\n" );
+        fprintf( fff, "failed lock match         0\n" );
+        fprintf( fff, "read but discarded        %lld\n", step * DELTA );
+        fprintf( fff, "zero length file          0\n" );
+        fprintf( fff, "zero size window          3495\n" );
+        fprintf( fff, "read-ahead to EOF         172\n" );
+        fprintf( fff, "hit max r-a issue         783042\n" );
+        fprintf( fff, "wrong page from grab_cache_page 0\n" );
+        fclose( fff );
+    }
+}
+
+static void
+cleanup( void )
+{
+    char dir[PAPI_MAX_STR_LEN], path[PAPI_MAX_STR_LEN];
+    int i;
+
+    for ( i = 0; i < NUM_FS; i++ ) {
+        fs_dir( i, dir, sizeof ( dir ) );
+        snprintf( path, sizeof ( path ), "%s/stats", dir );
+        unlink( path );
+        snprintf( path, sizeof ( path ), "%s/read_ahead_stats", dir );
+        unlink( path );
+        rmdir( dir );
+    }
+    snprintf( path, sizeof ( path ), "%s/llite", proc_dir );
+    rmdir( path );
+    rmdir( proc_dir );
+}
+
+static void
+check( long long *values, int steps, const char *what )
+{
+    long long expected[NUM_EVENTS];
+    int i;
+
+    /* read of the last fs, write of the first, readahead of the last */
+    expected[0] = steps * DELTA;
+    expected[1] = 2 * steps * DELTA;
+    expected[2] = steps * DELTA;
+
+    for ( i = 0; i < NUM_EVENTS; i++ ) {
+        if ( !TESTS_QUIET )
+            printf( "%-10s %lld (expected %lld)\n", what, values[i],
+                    expected[i] );
+        if ( values[i] != expected[i] ) {
+            cleanup(  );
+            test_fail( __FILE__, __LINE__, what, 0 );
+        }
+    }
+}
+
+static int
+setup_eventset( void )
+{
+    const PAPI_component_info_t *cmpinfo = NULL;
+    char name[PAPI_MAX_STR_LEN], event[PAPI_MAX_STR_LEN];
+    int EventSet = PAPI_NULL;
+    int retval, cid, lustre_cid = -1;
+
+    retval = PAPI_library_init( PAPI_VER_CURRENT );
+    if ( retval != PAPI_VER_CURRENT )
+        test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+    for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+        cmpinfo = PAPI_get_component_info( cid );
+        if ( cmpinfo == NULL )
+            test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+        if ( strcmp( cmpinfo->name, "lustre" ) == 0 ) {
+            lustre_cid = cid;
+            break;
+        }
+    }
+
+    if ( lustre_cid < 0 || cmpinfo->disabled ) {
+        cleanup(  );
+        test_skip( __FILE__, __LINE__, "lustre component not available", 0 );
+    }
+
+    if ( cmpinfo->num_native_events != NUM_FS * 3 ) {
+        cleanup(  );
+        test_fail( __FILE__, __LINE__, "wrong number of events", 0 );
+    }
+
+    retval = PAPI_create_eventset( &EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+    /* the fs name is the directory with the stats file */
+    fs_dir( NUM_FS - 1, name, sizeof ( name ) );
+    snprintf( event, sizeof ( event ), "lustre:::%s/stats_llread",
+              strrchr( name, '/' ) + 1 );
+    retval = PAPI_add_named_event( EventSet, event );
+    if ( retval == PAPI_OK ) {
+        fs_dir( 0, name, sizeof ( name ) );
+        snprintf( event, sizeof ( event ), "lustre:::%s/stats_llwrite",
+                  strrchr( name, '/' ) + 1 );
+        retval = PAPI_add_named_event( EventSet, event );
+    }
+    if ( retval == PAPI_OK ) {
+        fs_dir( NUM_FS - 1, name, sizeof ( name ) );
+        snprintf( event, sizeof ( event ), "lustre:::%s/stats_wrong_readahead",
+                  strrchr( name, '/' ) + 1 );
+        retval = PAPI_add_named_event( EventSet, event );
+    }
+    if ( retval != PAPI_OK ) {
+        cleanup(  );
+        test_fail( __FILE__, __LINE__, event, retval );
+    }
+
+    return EventSet;
+}
+
+static void
+time_reads( int EventSet, const char *what )
+{
+    long long values[NUM_EVENTS], t0, t1;
+    int i, retval;
+
+    t0 = PAPI_get_real_usec(  );
+    for ( i = 0; i < NUM_READS; i++ ) {
+        retval = PAPI_read( EventSet, values );
+        if ( retval != PAPI_OK )
+            test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    }
+    t1 = PAPI_get_real_usec(  );
+
+    if ( !TESTS_QUIET )
+        printf( "PAPI_read, %d filesystems, %s: %.2f usec per call\n",
+                NUM_FS, what, ( double ) ( t1 - t0 ) / NUM_READS );
+}
+
+int
+main( int argc, char **argv )
+{
+    int retval, EventSet, status;
+    pid_t pid;
+    long long values[NUM_EVENTS];
+    char path[PAPI_MAX_STR_LEN];
+    PAPI_option_t opt;
+
+    tests_quiet( argc, argv );
+
+    if ( mkdtemp( proc_dir ) == NULL )
+        test_fail( __FILE__, __LINE__, "mkdtemp", PAPI_ESYS );
+    snprintf( path, sizeof ( path ), "%s/llite", proc_dir );
+    mkdir( path, 0700 );
+    write_tree( 0, 1 );
+
+    setenv( "PAPI_LUSTRE_PROC_DIR", proc_dir, 1 );
+    unsetenv( "PAPI_LUSTRE_REFRESH_MS" );
+
+    /* files parsed on every read */
+    EventSet = setup_eventset(  );
+
+    retval = PAPI_start( EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+    write_tree( 1, 0 );
+    retval = PAPI_read( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    check( values, 1, "read" );
+
+    time_reads( EventSet, "parsed" );
+
+    memset( &opt, 0, sizeof ( opt ) );
+    opt.refresh.eventset = EventSet;
+    opt.refresh.usec = 60000000LL;
+    retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_set_opt", retval );
+
+    write_tree( 2, 0 );
+    retval = PAPI_read( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    check( values, 1, "cached" );
+
+    opt.refresh.usec = 0;
+    retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_set_opt", retval );
+
+    retval = PAPI_stop( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+    check( values, 2, "stopped" );
+
+    PAPI_shutdown(  );
+
+    /* again with the background refresh */
+    write_tree( 0, 0 );
+    setenv( "PAPI_LUSTRE_REFRESH_MS", "5", 1 );
+    EventSet = setup_eventset(  );
+
+    retval = PAPI_start( EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+    write_tree( 3, 0 );
+    usleep( 100000 );
+    retval = PAPI_read( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    check( values, 3, "sampled" );
+
+    time_reads( EventSet, "sampled" );
+
+    /* the refresh thread is not forked, the child reads the files */
+    pid = fork(  );
+    if ( pid < 0 )
+        test_fail( __FILE__, __LINE__, "fork", PAPI_ESYS );
+    if ( pid == 0 ) {
+        write_tree( 4, 0 );
+        retval = PAPI_read( EventSet, values );
+        _exit( retval != PAPI_OK || values[0] != 4 * DELTA );
+    }
+    if ( waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) ||
+         WEXITSTATUS( status ) != 0 ) {
+        cleanup(  );
+        test_fail( __FILE__, __LINE__, "read in a forked child", 0 );
+    }
+
+    retval = PAPI_stop( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+    PAPI_shutdown(  );
+
+    cleanup(  );
+
+    test_pass( __FILE__ );
+
+    return 0;
+}
@@ -23,12 +23,14 @@
 #include <string.h>
 #include <net/if.h>
 #include <errno.h>
+#include <fcntl.h>
 
 /* Headers required by PAPI */
 #include "papi.h"
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "papi_node.h"
 
 #include "linux-net.h"
 
@@ -44,6 +46,9 @@ static long long NET_REFRESH_LATENCY = 1000000;
 
 #define NET_PROC_FILE          "/proc/net/dev"
 
+/* initial size of the per-thread copy of /proc/net/dev, grown as needed */
+#define NET_PROC_BUFF_LEN      16384
+
 /* /proc/net/dev line size
  * interface name + 8 RX counters + 8 TX counters + separators
  */
@@ -62,8 +67,16 @@ static NET_native_event_entry_t * _net_native_events=NULL;
 static int num_events       = 0;
 static int is_initialized   = 0;
 
-static long long _net_register_start[NET_MAX_COUNTERS];
-static long long _net_register_current[NET_MAX_COUNTERS];
+/* PAPI_NET_PROC_FILE overrides it, to read a saved or synthetic file */
+static char net_proc_file[PAPI_MAX_STR_LEN] = NET_PROC_FILE;
+
+/* interface of each block of NET_INTERFACE_COUNTERS native events */
+struct net_interface {
+    char name[PAPI_MIN_STR_LEN];
+    int len;
+};
+static struct net_interface *_net_interfaces = NULL;
+static int num_interfaces   = 0;
 
 /* temporary event */
 struct temp_event {
@@ -119,10 +132,10 @@ generateNetEventList( void )
     struct temp_event *last = NULL;
     int i, j;
 
-    fin = fopen(NET_PROC_FILE, "r");
+    fin = _papi_node_fopen(net_proc_file);
     if (fin == NULL) {
         SUBDBG("Can't find %s, are you sure the /proc file-system is mounted?\n",
-           NET_PROC_FILE);
+           net_proc_file);
         snprintf(_net_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN-2,
         "Failed to find /proc file-system.");
         _net_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;    // force null termination.
@@ -203,95 +216,159 @@ generateNetEventList( void )
 }
 
 
+/*
+ * Reread /proc/net/dev into the thread's buffer, which stays
+ * NUL-terminated.  The file is kept open and read with pread, or copied
+ * from the node-wide snapshot when node sampling is on.
+ */
 static int
-getInterfaceBaseIndex(const char *ifname)
+net_grow_buffer( NET_context_t *ctx )
 {
-    int i;
+    char *buff;
+
+    buff = papi_realloc(ctx->buff, 2 * ctx->buff_size);
+    if (buff == NULL)
+        return PAPI_ENOMEM;
+    ctx->buff = buff;
+    ctx->buff_size *= 2;
+
+    return PAPI_OK;
+}
+
+static int
+net_read_file( NET_context_t *ctx, int source )
+{
+    int len, n;
+
+    if (ctx->buff == NULL) {
+        ctx->buff = papi_malloc(NET_PROC_BUFF_LEN);
+        if (ctx->buff == NULL)
+            return NET_INVALID_RESULT;
+        ctx->buff_size = NET_PROC_BUFF_LEN;
+    }
+
+    for (;;) {
+        len = _papi_node_read_source(source, ctx->buff, ctx->buff_size - 1);
+        if (len < ctx->buff_size - 1 || ctx->buff_size > PAPI_NODE_DATA_LEN)
+            break;
+        if (net_grow_buffer(ctx) != PAPI_OK)
+            return NET_INVALID_RESULT;
+    }
+
+    if (len < 0) {
+        if (ctx->fd < 0) {
+            ctx->fd = open(net_proc_file, O_RDONLY);
+            if (ctx->fd < 0) {
+                SUBDBG("Can't open %s, are you sure the /proc file-system is mounted?\n",
+                   net_proc_file);
+                return NET_INVALID_RESULT;
+            }
+        }
 
-    for ( i=0; i<num_events; i+=NET_INTERFACE_COUNTERS ) {
-        if (strncmp(_net_native_events[i].name, ifname, strlen(ifname)) == 0) {
-            return i;
+        len = 0;
+        for (;;) {
+            n = pread(ctx->fd, ctx->buff + len, ctx->buff_size - 1 - len, len);
+            if (n < 0)
+                return NET_INVALID_RESULT;
+            if (n == 0)
+                break;
+            len += n;
+            if (len == ctx->buff_size - 1 && net_grow_buffer(ctx) != PAPI_OK)
+                return NET_INVALID_RESULT;
         }
     }
+    ctx->buff[len] = '\0';
 
-    return -1;  /* Not found */
+    return len;
 }
 
 
+/* Parse the next blank-separated decimal counter */
+static inline long long
+net_next_counter( const char **str )
+{
+    const char *p = *str;
+    long long value = 0;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+    while (*p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    *str = p;
+
+    return value;
+}
+
+
+/*
+ * Read the counters of the interfaces in the EventSet into values, one
+ * per position.  Lines of other interfaces are skipped without being
+ * decoded, and the scan stops once every interface has been seen.
+ */
 static int
-read_net_counters( long long *values )
+read_net_counters( NET_context_t *ctx, NET_control_state_t *ctl,
+    long long *values )
 {
-    FILE *fin;
-    char line[NET_PROC_MAX_LINE];
-    char *retval, *ifname, *data;
-    int i, nf, if_bidx;
+    long long counters[NET_INTERFACE_COUNTERS];
+    const char *line, *name, *colon, *eol, *data;
+    int i, k, ifx, namelen, found = 0;
 
-    fin = fopen(NET_PROC_FILE, "r");
-    if (fin == NULL) {
-        SUBDBG("Can't find %s, are you sure the /proc file-system is mounted?\n",
-           NET_PROC_FILE);
+    if (ctl->num_ifs == 0)
+        return 0;
+
+    if (net_read_file(ctx, ctl->source) < 0)
         return NET_INVALID_RESULT;
-    }
 
     /* skip the 2 header lines */
+    line = ctx->buff;
     for (i=0; i<2; i++) {
-        retval = fgets (line, NET_PROC_MAX_LINE, fin);
-        if (retval == NULL) {
-            SUBDBG("Not enough lines in %s\n", NET_PROC_FILE);
-			fclose(fin);
+        line = strchr(line, '\n');
+        if (line == NULL) {
+            SUBDBG("Not enough lines in %s\n", net_proc_file);
             return 0;
         }
+        line++;
     }
 
-    while ((fgets (line, NET_PROC_MAX_LINE, fin)) == line) {
+    for ( ; *line && found < ctl->num_ifs; line = eol + 1) {
+        eol = strchr(line, '\n');
+        if (eol == NULL)
+            eol = line + strlen(line) - 1;
 
         /* split the interface name from its 16 counters */
-        retval = strstr(line, ":");
-        if (retval == NULL) {
-            SUBDBG("Wrong line format <%s>\n", line);
+        colon = memchr(line, ':', eol - line);
+        if (colon == NULL) {
+            SUBDBG("Wrong line format <%.*s>\n", (int)(eol - line), line);
             continue;
         }
-
-        *retval = '\0';
-        data = retval + 1;
-        ifname = line;
-        while (isspace(*ifname)) { ifname++; }
-
-        if_bidx = getInterfaceBaseIndex(ifname);
-        if (if_bidx < 0) {
-            SUBDBG("Interface <%s> not found\n", ifname);
-        } else {
-            nf = sscanf( data,
-                "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
-                &values[if_bidx + 0],  &values[if_bidx + 1],
-                &values[if_bidx + 2],  &values[if_bidx + 3],
-                &values[if_bidx + 4],  &values[if_bidx + 5],
-                &values[if_bidx + 6],  &values[if_bidx + 7],
-                &values[if_bidx + 8],  &values[if_bidx + 9],
-                &values[if_bidx + 10], &values[if_bidx + 11],
-                &values[if_bidx + 12], &values[if_bidx + 13],
-                &values[if_bidx + 14], &values[if_bidx + 15]);
-
-            SUBDBG("\nRead "
-                "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
-                values[if_bidx + 0],  values[if_bidx + 1],
-                values[if_bidx + 2],  values[if_bidx + 3],
-                values[if_bidx + 4],  values[if_bidx + 5],
-                values[if_bidx + 6],  values[if_bidx + 7],
-                values[if_bidx + 8],  values[if_bidx + 9],
-                values[if_bidx + 10], values[if_bidx + 11],
-                values[if_bidx + 12], values[if_bidx + 13],
-                values[if_bidx + 14], values[if_bidx + 15]);
-
-            if ( nf != NET_INTERFACE_COUNTERS ) {
-                /* This shouldn't happen */
-                SUBDBG("/proc line with wrong number of fields\n");
-            }
+        name = line;
+        while (isspace(*name)) { name++; }
+        namelen = colon - name;
+
+        for (k=0; k<ctl->num_ifs; k++) {
+            ifx = ctl->ifs[k];
+            if (_net_interfaces[ifx].len == namelen &&
+                memcmp(_net_interfaces[ifx].name, name, namelen) == 0)
+                break;
         }
+        if (k == ctl->num_ifs)
+            continue;
 
+        data = colon + 1;
+        for (i=0; i<NET_INTERFACE_COUNTERS; i++) {
+            counters[i] = net_next_counter(&data);
+        }
+        for (i=0; i<ctl->num_events; i++) {
+            if (ctl->which[i] / NET_INTERFACE_COUNTERS == ifx)
+                values[i] = counters[ctl->which[i] % NET_INTERFACE_COUNTERS];
+        }
+        found++;
     }
 
-    fclose(fin);
+    if (found < ctl->num_ifs) {
+        SUBDBG("%d interfaces not found in %s\n", ctl->num_ifs - found,
+            net_proc_file);
+    }
 
     return 0;
 }
@@ -307,7 +384,11 @@ read_net_counters( long long *values )
 static int
 _net_init_thread( hwd_context_t *ctx )
 {
-    ( void ) ctx;
+    NET_context_t *net_ctx = (NET_context_t *) ctx;
+
+    net_ctx->fd = -1;
+    net_ctx->buff = NULL;
+    net_ctx->buff_size = 0;
 
     return PAPI_OK;
 }
@@ -323,14 +404,14 @@ _net_init_component( int cidx  )
     int retval = PAPI_OK;
     int i = 0;
     struct temp_event *t, *last;
+    char *proc_file, *colon;
 
     if ( is_initialized )
         goto fn_exit;
 
-    memset(_net_register_start, 0,
-    		NET_MAX_COUNTERS*sizeof(_net_register_start[0]));
-    memset(_net_register_current, 0, 
-    		NET_MAX_COUNTERS*sizeof(_net_register_current[0]));
+    proc_file = getenv("PAPI_NET_PROC_FILE");
+    if (proc_file != NULL)
+        snprintf(net_proc_file, sizeof(net_proc_file), "%s", proc_file);
 
     is_initialized = 1;
 
@@ -362,6 +443,25 @@ _net_init_component( int cidx  )
     } while (t != NULL);
     root = NULL;
 
+    /* Interface names, to match the lines of /proc/net/dev */
+    num_interfaces = num_events / NET_INTERFACE_COUNTERS;
+    _net_interfaces = (struct net_interface *)
+        papi_calloc(num_interfaces, sizeof(struct net_interface));
+    if (_net_interfaces == NULL) {
+        snprintf(_net_vector.cmp_info.disabled_reason, PAPI_MAX_STR_LEN,
+            "%s failed to allocate the interface table.", __func__);
+        retval = PAPI_ENOMEM;
+        goto fn_fail;
+    }
+    for (i=0; i<num_interfaces; i++) {
+        snprintf(_net_interfaces[i].name, PAPI_MIN_STR_LEN, "%s",
+            _net_native_events[i * NET_INTERFACE_COUNTERS].name);
+        colon = strchr(_net_interfaces[i].name, ':');
+        if (colon != NULL)
+            *colon = '\0';
+        _net_interfaces[i].len = strlen(_net_interfaces[i].name);
+    }
+
     /* Export the total number of events available */
     _net_vector.cmp_info.num_native_events = num_events;
 
@@ -401,7 +501,12 @@ _net_init_component( int cidx  )
 static int
 _net_init_control_state( hwd_control_state_t *ctl )
 {
-    ( void ) ctl;
+    NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
+
+    net_ctl->num_events = 0;
+    net_ctl->num_ifs = 0;
+    net_ctl->refresh_latency = NET_REFRESH_LATENCY;
+    net_ctl->source = -1;
 
     return PAPI_OK;
 }
@@ -410,14 +515,19 @@ _net_init_control_state( hwd_control_state_t *ctl )
 static int
 _net_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
-    ( void ) ctx;
-
+    NET_context_t *net_ctx = (NET_context_t *) ctx;
     NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
-    long long now = PAPI_get_real_usec();
+    long long now;
 
-    read_net_counters(_net_register_start);
-    memcpy(_net_register_current, _net_register_start,
-            NET_MAX_COUNTERS * sizeof(_net_register_start[0]));
+    /* resolved here so that reads are only a copy of the snapshot */
+    net_ctl->source = _papi_node_source(net_proc_file);
+    now = PAPI_get_real_usec();
+
+    /* interfaces missing from the file count from 0 */
+    memset(net_ctl->start, 0, net_ctl->num_events * sizeof(net_ctl->start[0]));
+    read_net_counters(net_ctx, net_ctl, net_ctl->start);
+    memcpy(net_ctl->current, net_ctl->start,
+            net_ctl->num_events * sizeof(net_ctl->start[0]));
 
     /* set initial values to 0 */
     memset(net_ctl->values, 0, NET_MAX_COUNTERS*sizeof(net_ctl->values[0]));
@@ -434,8 +544,8 @@ _net_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     long long ** events, int flags )
 {
     (void) flags;
-    (void) ctx;
 
+    NET_context_t *net_ctx = (NET_context_t *) ctx;
     NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
     long long now = PAPI_get_real_usec();
     int i;
@@ -444,10 +554,11 @@ _net_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
      * Only read new values from /proc if enough time has passed
      * since the last read.
      */
-    if ( now - net_ctl->lastupdate > NET_REFRESH_LATENCY ) {
-        read_net_counters(_net_register_current);
-        for ( i=0; i<NET_MAX_COUNTERS; i++ ) {
-            net_ctl->values[i] = _net_register_current[i] - _net_register_start[i];
+    if ( net_ctl->refresh_latency == 0 ||
+         now - net_ctl->lastupdate > net_ctl->refresh_latency ) {
+        read_net_counters(net_ctx, net_ctl, net_ctl->current);
+        for ( i=0; i<net_ctl->num_events; i++ ) {
+            net_ctl->values[i] = net_ctl->current[i] - net_ctl->start[i];
         }
         net_ctl->lastupdate = now;
     }
@@ -460,15 +571,14 @@ _net_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 static int
 _net_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
-    (void) ctx;
-
+    NET_context_t *net_ctx = (NET_context_t *) ctx;
     NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
     long long now = PAPI_get_real_usec();
     int i;
 
-    read_net_counters(_net_register_current);
-    for ( i=0; i<NET_MAX_COUNTERS; i++ ) {
-        net_ctl->values[i] = _net_register_current[i] - _net_register_start[i];
+    read_net_counters(net_ctx, net_ctl, net_ctl->current);
+    for ( i=0; i<net_ctl->num_events; i++ ) {
+        net_ctl->values[i] = net_ctl->current[i] - net_ctl->start[i];
     }
     net_ctl->lastupdate = now;
 
@@ -482,7 +592,15 @@ _net_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 static int
 _net_shutdown_thread( hwd_context_t *ctx )
 {
-    ( void ) ctx;
+    NET_context_t *net_ctx = (NET_context_t *) ctx;
+
+    if (net_ctx->fd >= 0) {
+        close(net_ctx->fd);
+        net_ctx->fd = -1;
+    }
+    if (net_ctx->buff) papi_free(net_ctx->buff);
+    net_ctx->buff = NULL;
+    net_ctx->buff_size = 0;
 
     return PAPI_OK;
 }
@@ -502,6 +620,12 @@ _net_shutdown_component( void )
          papi_free(_net_native_events);
          _net_native_events = NULL;
       }
+      if (_net_interfaces != NULL)
+      {
+         papi_free(_net_interfaces);
+         _net_interfaces = NULL;
+      }
+      num_interfaces = 0;
     }
 
     return PAPI_OK;
@@ -510,15 +634,20 @@ _net_shutdown_component( void )
 
 /* This function sets various options in the component
  * The valid codes being passed in are PAPI_SET_DEFDOM,
- * PAPI_SET_DOMAIN, PAPI_SETDEFGRN, PAPI_SET_GRANUL and
- * PAPI_SET_INHERIT
+ * PAPI_SET_DOMAIN, PAPI_SETDEFGRN, PAPI_SET_GRANUL,
+ * PAPI_SET_INHERIT and PAPI_REFRESH_LATENCY
  */
 static int
 _net_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 {
     ( void ) ctx;
-    ( void ) code;
-    ( void ) option;
+
+    NET_control_state_t *net_ctl;
+
+    if ( code == PAPI_REFRESH_LATENCY ) {
+        net_ctl = (NET_control_state_t *) option->refresh.ESI->ctl_state;
+        net_ctl->refresh_latency = option->refresh.usec;
+    }
 
     return PAPI_OK;
 }
@@ -529,14 +658,26 @@ _net_update_control_state( hwd_control_state_t *ctl,
         NativeInfo_t *native, int count, hwd_context_t *ctx )
 {
     ( void ) ctx;
-    ( void ) ctl;
 
-    int i, index;
+    NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
+    int i, k, index, ifx;
 
+    /* remember the interfaces, only their lines are decoded */
+    net_ctl->num_ifs = 0;
     for ( i = 0; i < count; i++ ) {
         index = native[i].ni_event;
-        native[i].ni_position = _net_native_events[index].resources.selector - 1;
+        net_ctl->which[i] = index;
+        native[i].ni_position = i;
+
+        ifx = index / NET_INTERFACE_COUNTERS;
+        for ( k = 0; k < net_ctl->num_ifs; k++ ) {
+            if ( net_ctl->ifs[k] == ifx ) break;
+        }
+        if ( k == net_ctl->num_ifs ) {
+            net_ctl->ifs[net_ctl->num_ifs++] = ifx;
+        }
     }
+    net_ctl->num_events = count;
 
     return PAPI_OK;
 }
@@ -704,6 +845,9 @@ papi_vector_t _net_vector = {
         .fast_virtual_timer    = 0,
         .attach                = 0,
         .attach_must_ptrace    = 0,
+        .refresh_latency       = 1,
+        .node_sampled          = 1,
+        .parallel_init         = 1,
     },
 
     /* sizes of framework-opaque component-private structures */
@@ -29,8 +29,9 @@
 
 /*************************  DEFINES SECTION  ***********************************
  *******************************************************************************/
-/* this number assumes that there will never be more events than indicated
- * 20 INTERFACES * 16 COUNTERS = 320 */
+/* this number assumes that there will never be more events in one EventSet
+ * than indicated: 20 INTERFACES * 16 COUNTERS = 320.  The number of
+ * interfaces on the system is not limited. */
 #define NET_MAX_COUNTERS 320
 
 /** Structure that stores private information of each event */
@@ -65,14 +66,25 @@ typedef struct NET_reg_alloc
 
 typedef struct NET_control_state
 {
+    int num_events;
+    int which[NET_MAX_COUNTERS];        // native event at each position
+    int num_ifs;
+    int ifs[NET_MAX_COUNTERS];          // interfaces used by the EventSet
+    long long start[NET_MAX_COUNTERS];
+    long long current[NET_MAX_COUNTERS];
     long long values[NET_MAX_COUNTERS]; // used for caching
     long long lastupdate;
+    long long refresh_latency;          // usec, see PAPI_REFRESH_LATENCY
+    int source;                         // node-wide snapshot, -1 if none
 } NET_control_state_t;
 
 
+/** Per-thread reader of /proc/net/dev */
 typedef struct NET_context
 {
-    NET_control_state_t state;
+    int fd;                             // kept open, reread with pread
+    int buff_size;
+    char *buff;
 } NET_context_t;
 
 
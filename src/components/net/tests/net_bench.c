@@ -0,0 +1,192 @@
+/**
+ * @author PAPI team UTK/ICL
+ * Test case for net component
+ * @brief
+ *   Times PAPI_read of net events on a synthetic /proc/net/dev with
+ *   hundreds of interfaces, as on a host running many containers with
+ *   their veth pairs.  The file is given to the component through
+ *   PAPI_NET_PROC_FILE.  Also checks the counted values and the
+ *   per-EventSet PAPI_REFRESH_LATENCY option.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_IFS     512
+#define NUM_READS   20000
+#define DELTA       1000LL
+
+static char proc_file[] = "/tmp/papi_net_devXXXXXX";
+
+static void
+ifname( int i, char *name, int len )
+{
+    if ( i == 0 )
+        snprintf( name, len, "lo" );
+    else if ( i == 1 )
+        snprintf( name, len, "eth0" );
+    else if ( i == 2 )
+        snprintf( name, len, "docker0" );
+    else
+        snprintf( name, len, "veth%04x", i );
+}
+
+/* counter j of interface i is (i + 1) * 1000000 + j * 1000 + step * DELTA */
+static void
+write_proc_file( int step )
+{
+    char name[PAPI_MIN_STR_LEN];
+    long long base;
+    FILE *fff;
+    int i, j;
+
+    fff = fopen( proc_file, "w" );
+    if ( fff == NULL )
+        test_fail( __FILE__, __LINE__, proc_file, PAPI_ESYS );
+
+    fprintf( fff, "Inter-|   Receive                                                |  Transmit\n" );
+    fprintf( fff, " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n" );
+    for ( i = 0; i < NUM_IFS; i++ ) {
+        ifname( i, name, sizeof ( name ) );
+        fprintf( fff, "%11s:", name );
+        base = ( i + 1 ) * 1000000LL + step * DELTA;
+        for ( j = 0; j < 16; j++ )
+            fprintf( fff, " %8lld", base + j * 1000LL );
+        fprintf( fff, "\n" );
+    }
+    fclose( fff );
+}
+
+static void
+check( long long *values, long long expected, const char *what )
+{
+    if ( !TESTS_QUIET )
+        printf( "%-24s %lld %lld (expected %lld)\n", what, values[0],
+                values[1], expected );
+    if ( values[0] != expected || values[1] != expected ) {
+        unlink( proc_file );
+        test_fail( __FILE__, __LINE__, what, 0 );
+    }
+}
+
+int
+main( int argc, char **argv )
+{
+    int retval, cid, net_cid = -1, numcmp, fd, i;
+    int EventSet = PAPI_NULL;
+    long long values[2], t0, t1;
+    char name[PAPI_MIN_STR_LEN], event[PAPI_MAX_STR_LEN];
+    const PAPI_component_info_t *cmpinfo = NULL;
+    PAPI_option_t opt;
+
+    tests_quiet( argc, argv );
+
+    fd = mkstemp( proc_file );
+    if ( fd < 0 )
+        test_fail( __FILE__, __LINE__, "mkstemp", PAPI_ESYS );
+    close( fd );
+    write_proc_file( 0 );
+
+    setenv( "PAPI_NET_PROC_FILE", proc_file, 1 );
+
+    retval = PAPI_library_init( PAPI_VER_CURRENT );
+    if ( retval != PAPI_VER_CURRENT )
+        test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+    numcmp = PAPI_num_components(  );
+    for ( cid = 0; cid < numcmp; cid++ ) {
+        cmpinfo = PAPI_get_component_info( cid );
+        if ( cmpinfo == NULL )
+            test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+        if ( strcmp( cmpinfo->name, "net" ) == 0 ) {
+            net_cid = cid;
+            break;
+        }
+    }
+
+    if ( net_cid < 0 || cmpinfo->disabled ) {
+        unlink( proc_file );
+        test_skip( __FILE__, __LINE__, "net component not available", 0 );
+    }
+
+    if ( !TESTS_QUIET )
+        printf( "%d interfaces, %d native events\n", NUM_IFS,
+                cmpinfo->num_native_events );
+    if ( cmpinfo->num_native_events != NUM_IFS * 16 ) {
+        unlink( proc_file );
+        test_fail( __FILE__, __LINE__, "wrong number of events", 0 );
+    }
+
+    retval = PAPI_create_eventset( &EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+    /* one interface near the top of the file, one at the very end */
+    retval = PAPI_add_named_event( EventSet, "net:::eth0:rx:byte" );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+    ifname( NUM_IFS - 1, name, sizeof ( name ) );
+    snprintf( event, sizeof ( event ), "net:::%s:tx:packet", name );
+    retval = PAPI_add_named_event( EventSet, event );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+
+    /* cache values for a long time first */
+    memset( &opt, 0, sizeof ( opt ) );
+    opt.refresh.eventset = EventSet;
+    opt.refresh.usec = 60000000LL;
+    retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_set_opt", retval );
+
+    retval = PAPI_start( EventSet );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+    write_proc_file( 1 );
+    retval = PAPI_read( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    check( values, 0, "cached" );
+
+    opt.refresh.usec = 0;
+    retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_set_opt", retval );
+
+    retval = PAPI_read( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    check( values, DELTA, "refreshed" );
+
+    t0 = PAPI_get_real_usec(  );
+    for ( i = 0; i < NUM_READS; i++ ) {
+        retval = PAPI_read( EventSet, values );
+        if ( retval != PAPI_OK )
+            test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+    }
+    t1 = PAPI_get_real_usec(  );
+
+    if ( !TESTS_QUIET )
+        printf( "PAPI_read over %d interfaces: %.2f usec per call\n",
+                NUM_IFS, ( double ) ( t1 - t0 ) / NUM_READS );
+
+    write_proc_file( 2 );
+    retval = PAPI_stop( EventSet, values );
+    if ( retval != PAPI_OK )
+        test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+    check( values, 2 * DELTA, "stopped" );
+
+    unlink( proc_file );
+
+    PAPI_shutdown(  );
+
+    test_pass( __FILE__ );
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file    papi_fastread.h
+ *
+ * @ingroup papi_components
+ *
+ * @brief
+ *  Inline self-monitoring reads of a running perf_event EventSet.
+ *
+ *  PAPI_fastread_bind() hands out the perf_event mmap control page of
+ *  every event in a started EventSet.  PAPI_fastread() then reads all
+ *  counters with the kernel's seqlock protected rdpmc sequence, without
+ *  calling into libpapi.  PAPI keeps ownership of the file descriptors
+ *  and pages, and the binding must only be used from the thread that
+ *  started the EventSet.  Stopping, cleaning up or destroying the EventSet clears
+ *  the binding, after which PAPI_fastread() returns PAPI_ENOTRUN, so
+ *  the PAPI_fastread_t must stay in place until then or until it is
+ *  released with PAPI_fastread_unbind().
+ *
+ *  If a counter cannot be read from user space (rdpmc disabled, event
+ *  not currently scheduled, unsupported architecture), or the kernel
+ *  time shared it and it needs scaling, PAPI_fastread() falls back to
+ *  PAPI_read() for that call.
+ */
+
+#ifndef _PAPI_FASTREAD_H
+#define _PAPI_FASTREAD_H
+
+#include "papi.h"
+
+#pragma GCC visibility push(default)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of events in an EventSet bound by PAPI_fastread_bind */
+#define PAPI_FASTREAD_MAX_EVENTS 64
+
+/** @ingroup papi_data_structures */
+typedef struct _papi_fastread {
+   int EventSet;                  /**< EventSet used for the PAPI_read fallback */
+   int num_events;                /**< number of events, in EventSet order, 0 once the binding is cleared */
+   void *page[PAPI_FASTREAD_MAX_EVENTS]; /**< perf_event_mmap_page of each event */
+   const long long *reset_count[PAPI_FASTREAD_MAX_EVENTS]; /**< counter value at the last PAPI_reset */
+   const unsigned int *reset_flag; /**< set once PAPI_reset was called while running */
+} PAPI_fastread_t;
+
+int PAPI_fastread_bind(int EventSet, PAPI_fastread_t *fr); /**< expose the mmap pages of a running perf_event EventSet */
+int PAPI_fastread_unbind(PAPI_fastread_t *fr); /**< release a binding before its EventSet is stopped */
+
+#ifndef PAPI_FASTREAD_DECLARATIONS_ONLY
+
+#include <stdint.h>
+#include <linux/perf_event.h>
+
+/* Same sequence as mmap_read_self() in components/perf_event/perf_helpers.h,
+   minus the time_enabled/time_running scaling: multiplexed EventSets
+   are refused by PAPI_fastread_bind(), and a counter that was not
+   running all the time it was enabled is left to PAPI_read(). */
+static inline int
+PAPI_fastread( const PAPI_fastread_t *fr, long long *values )
+{
+#if defined(__x86_64__) || defined(__i386__)
+	int i;
+
+	if ( fr->num_events == 0 )
+		return PAPI_ENOTRUN;
+
+	for ( i = 0; i < fr->num_events; i++ ) {
+		volatile struct perf_event_mmap_page *pc = fr->page[i];
+		uint32_t seq, index, low, high;
+		unsigned int width, reset;
+		int64_t count, pmc;
+
+		do {
+			seq = pc->lock;
+			__asm__ volatile( "" ::: "memory" );
+
+			/* 0 means the event is not on a counter right now */
+			index = pc->index;
+			if ( !pc->cap_user_rdpmc || !index ||
+			     pc->time_enabled != pc->time_running )
+				return PAPI_read( fr->EventSet, values );
+
+			width = pc->pmc_width;
+			reset = *fr->reset_flag;
+			count = reset ? 0 : ( int64_t ) pc->offset;
+
+			__asm__ volatile( "rdpmc" : "=a" ( low ), "=d" ( high )
+			                  : "c" ( index - 1 ) );
+			pmc = ( int64_t ) ( ( uint64_t ) low | ( ( uint64_t ) high << 32 ) );
+
+			if ( reset )
+				pmc -= *fr->reset_count[i];
+
+			/* sign extend to the counter width */
+			pmc = ( int64_t ) ( ( uint64_t ) pmc << ( 64 - width ) ) >> ( 64 - width );
+			count += pmc;
+
+			__asm__ volatile( "" ::: "memory" );
+		} while ( pc->lock != seq );
+
+		values[i] = count;
+	}
+
+	return PAPI_OK;
+#else
+	if ( fr->num_events == 0 )
+		return PAPI_ENOTRUN;
+
+	return PAPI_read( fr->EventSet, values );
+#endif
+}
+
+#endif /* PAPI_FASTREAD_DECLARATIONS_ONLY */
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma GCC visibility pop
+
+#endif /* _PAPI_FASTREAD_H */
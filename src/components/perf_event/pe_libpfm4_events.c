@@ -18,6 +18,7 @@
 #include "papi.h"
 #include "papi_internal.h"
 #include "papi_vector.h"
+#include "papi_cache.h"
 
 #include "papi_libpfm4_events.h"
 #include "pe_libpfm4_events.h"
@@ -26,14 +27,138 @@
 #include "perfmon/pfmlib.h"
 #include "perfmon/pfmlib_perf_event.h"
 
-#define NATIVE_EVENT_CHUNK 1024
-
 // used to step through the attributes when enumerating events
 static int attr_idx;
 
 /* alias flags to handle amd_fam17h, amd_fam17h_zen1 both present PMUs*/
 static int amd64_fam17h_zen1_present = 0;
 
+/** @class  arena_string
+ *  @brief  String at an offset of the string arena, for its string set
+ */
+
+static const char *
+arena_string(const void *pool, unsigned int offset) {
+
+	return native_event_string(pool, offset);
+}
+
+/** @class  intern_string
+ *  @brief  Offset of a string in the string arena, adding it if it is new
+ *
+ *  Caller holds NAMELIB_LOCK.  Strings are never removed or moved
+ *  before shutdown.
+ *
+ *  @param[out] offset
+ *             -- offset of the string
+ *
+ *  @retval PAPI_OK, PAPI_ENOMEM or PAPI_EBUF if it can not fit a block
+ */
+
+static int
+intern_string(struct native_event_table_t *event_table, const char *str,
+		uint32_t *offset) {
+
+	struct native_string_arena_t *arena = &event_table->strings;
+	papi_string_slot_t *slot;
+	unsigned int len = strlen(str) + 1;
+	unsigned int block, pos;
+
+	if (len == 1) {
+		*offset = 0;
+		return PAPI_OK;
+	}
+	if (len > NATIVE_STRING_BLOCK - 1) {
+		return PAPI_EBUF;
+	}
+
+	if (arena->set.at == NULL) {
+		_papi_hwi_string_set_init(&arena->set, arena_string, event_table);
+	}
+	slot = _papi_hwi_string_set_add(&arena->set, str);
+	if (slot == NULL) {
+		return PAPI_ENOMEM;
+	}
+	if (slot->offset != PAPI_STRING_NONE) {
+		*offset = slot->offset;
+		return PAPI_OK;
+	}
+
+	/* the first block starts with the empty string */
+	if (arena->blocks[0] == NULL) {
+		arena->blocks[0] = calloc(1, NATIVE_STRING_BLOCK);
+		if (arena->blocks[0] == NULL) {
+			return PAPI_ENOMEM;
+		}
+		arena->next = 1;
+	}
+
+	block = arena->next >> NATIVE_STRING_BLOCK_BITS;
+	pos = arena->next & (NATIVE_STRING_BLOCK - 1);
+	if (pos + len > NATIVE_STRING_BLOCK) {
+		block++;
+		pos = 0;
+	}
+	if (block >= NATIVE_STRING_MAX_BLOCKS) {
+		return PAPI_ENOMEM;
+	}
+	if (arena->blocks[block] == NULL) {
+		arena->blocks[block] = malloc(NATIVE_STRING_BLOCK);
+		if (arena->blocks[block] == NULL) {
+			return PAPI_ENOMEM;
+		}
+	}
+
+	memcpy(arena->blocks[block] + pos, str, len);
+	slot->offset = (block << NATIVE_STRING_BLOCK_BITS) + pos;
+	arena->next = slot->offset + len;
+
+	*offset = slot->offset;
+	return PAPI_OK;
+}
+
+/** @class  reserve_native_event
+ *  @brief  Make sure the chunk holding event idx exists
+ *
+ *  Caller holds NAMELIB_LOCK.
+ */
+
+static int
+reserve_native_event(struct native_event_table_t *event_table, int idx) {
+
+	int chunk = idx / NATIVE_EVENT_CHUNK;
+
+	if (chunk >= NATIVE_EVENT_MAX_CHUNKS) {
+		return PAPI_ENOMEM;
+	}
+	if (event_table->chunks[chunk] == NULL) {
+		SUBDBG("Allocating more room for native events (%d %ld)\n",
+			(chunk + 1) * NATIVE_EVENT_CHUNK,
+			(long)sizeof(struct native_event_chunk_t));
+		event_table->chunks[chunk] = calloc(1, sizeof(struct native_event_chunk_t));
+		if (event_table->chunks[chunk] == NULL) {
+			return PAPI_ENOMEM;
+		}
+		event_table->allocated_native_events = (chunk + 1) * NATIVE_EVENT_CHUNK;
+	}
+	return PAPI_OK;
+}
+
+/** @class  lookup_event
+ *  @brief  Index of the event with this allocated name, caller holds NAMELIB_LOCK
+ */
+
+static int
+lookup_event(const char *name, struct native_event_table_t *event_table) {
+
+	papi_string_slot_t *slot = _papi_hwi_string_set_find(&event_table->strings.set, name);
+
+	if ((slot == NULL) || (slot->offset == PAPI_STRING_NONE) || (slot->value < 0)) {
+		return PAPI_ENOEVNT;
+	}
+	return slot->value;
+}
+
 /** @class  find_existing_event
  *  @brief  looks up an event, returns it if it exists
  *
@@ -50,39 +175,172 @@ static int find_existing_event(const char *name,
                                struct native_event_table_t *event_table) {
   SUBDBG("Entry: name: %s, event_table: %p, num_native_events: %d\n", name, event_table, event_table->num_native_events);
 
-  int i,event=PAPI_ENOEVNT;
+  int event;
 
   _papi_hwi_lock( NAMELIB_LOCK );
-
-  for(i=0;i<event_table->num_native_events;i++) {
-    // Most names passed in will contain the pmu name, so first we compare to the allocated name (it has pmu name on front)
-    if (!strcmp(name,event_table->native_events[i].allocated_name)) {
-      SUBDBG("Found allocated_name: %s, libpfm4_idx: %#x, papi_event_code: %#x\n", 
-         event_table->native_events[i].allocated_name, event_table->native_events[i].libpfm4_idx, event_table->native_events[i].papi_event_code);
-      event=i;
-      break;
-    }
-    // some callers have an event name without the pmu name on the front, so we also compare to the base name (just the event name part)
-    if (!strcmp(name,event_table->native_events[i].base_name)) {
-      int nameLen = strlen(event_table->native_events[i].base_name);
-      // the name we are looking for must be the same length as this event table entry name for them to match
-      if (strlen(name) != nameLen + strlen(event_table->native_events[i].mask_string) + 1) {
-        continue;
-      }
-      if(!strcmp(name+nameLen+1, event_table->native_events[i].mask_string)) {
-          SUBDBG("Found base_name: %s, mask_string: %s, libpfm4_idx: %#x, papi_event_code: %#x\n",
-            event_table->native_events[i].base_name, event_table->native_events[i].mask_string , event_table->native_events[i].libpfm4_idx, event_table->native_events[i].papi_event_code);
-          event=i;
-          break;
-      }
-    }
-  }
+  event = lookup_event(name, event_table);
   _papi_hwi_unlock( NAMELIB_LOCK );
 
   SUBDBG("EXIT: returned: %#x\n", event);
   return event;
 }
 
+/** @class  find_event_by_code
+ *  @brief  Index of the event with this PAPI event code and libpfm4 index
+ *
+ *  The index PAPI keeps for the code is tried first, then the table
+ *  is searched backwards.
+ */
+
+static int
+find_event_by_code(int papi_event_code, unsigned int libpfm4_idx,
+		struct native_event_table_t *event_table) {
+
+	int num = __atomic_load_n(&event_table->num_native_events, __ATOMIC_ACQUIRE);
+	int eidx = _papi_hwi_get_ntv_idx(papi_event_code);
+
+	if ((eidx >= 0) && (eidx < num) &&
+		(NATIVE_EVENT_FIELD(event_table, papi_event_code, eidx) == papi_event_code) &&
+		((unsigned)NATIVE_EVENT_FIELD(event_table, libpfm4_idx, eidx) == libpfm4_idx)) {
+		return eidx;
+	}
+
+	for (eidx = num - 1; eidx >= 0; eidx--) {
+		if ((NATIVE_EVENT_FIELD(event_table, papi_event_code, eidx) == papi_event_code) &&
+			((unsigned)NATIVE_EVENT_FIELD(event_table, libpfm4_idx, eidx) == libpfm4_idx)) {
+			break;
+		}
+	}
+	return eidx;
+}
+
+/** @class  get_mask_description
+ *  @brief  Check the masks of an event and collect their descriptions
+ *
+ *  @param[in] masks
+ *             -- masks of the event, separated by ':'
+ *  @param[out] mask_desc
+ *             -- descriptions of the masks, separated by ':',
+ *                cut to fit len
+ *  @param[out] mask_attr
+ *             -- libpfm4 attribute index of the mask if there is
+ *                exactly one, else -1 (may be NULL)
+ *
+ *  @retval PAPI_OK
+ *  @retval PAPI_ENOEVNT a mask is not one of the event
+ */
+
+static int
+get_mask_description(int libpfm4_index, int nattrs, const char *masks,
+		char *mask_desc, int len, int *mask_attr) {
+
+	pfm_event_attr_info_t ainfo;
+	pfm_err_t ret;
+	char *msk_ptr, *ptr;
+	int found = -1;
+
+	mask_desc[0] = '\0';
+	if (mask_attr != NULL) {
+		*mask_attr = -1;
+	}
+	if ((masks == NULL) || (masks[0] == '\0')) {
+		return PAPI_OK;
+	}
+
+	msk_ptr = strdup(masks);
+	if (msk_ptr == NULL) {
+		return PAPI_ENOMEM;
+	}
+
+	// go get the descriptions for each of the
+	// masks provided with this event
+	ptr = msk_ptr;
+	SUBDBG("ptr: %p (%s)\n", ptr, ptr);
+	while (ptr != NULL) {
+		char *ptrm = strstr(ptr, ":");
+		if (ptrm != NULL) {
+			*ptrm = '\0';
+			ptrm++;
+		}
+
+		// get the length of the mask name
+		char *wrk = strchr(ptr, '=');
+		unsigned int msk_name_len;
+		if (wrk != NULL) {
+			msk_name_len = wrk - ptr;
+			SUBDBG("Found =, length=%d\n",msk_name_len);
+		} else {
+			msk_name_len = strlen (ptr);
+			SUBDBG("No =, length=%d\n",msk_name_len);
+		}
+
+		int i, mask_found=0;
+		for (i=0 ; i<nattrs ; i++) {
+			// get this events attribute information
+			// from libpfm4, if unavailable return
+			// event not found
+			memset (&ainfo, 0, sizeof(pfm_event_attr_info_t));
+			ainfo.size = sizeof(pfm_event_attr_info_t);
+			ret = pfm_get_event_attr_info(libpfm4_index,
+				i, PFM_OS_PERF_EVENT_EXT, &ainfo);
+			if (ret != PFM_SUCCESS) {
+				free (msk_ptr);
+				SUBDBG("EXIT: error libpfm4 find event: Attribute info not found, libpfm4_index: %#x, ret: %d\n", libpfm4_index, _papi_libpfm4_error(ret));
+				return PAPI_ENOEVNT;
+			}
+
+			// if this is the one we want,
+			// append its description
+			if ((msk_name_len == strlen(ainfo.name))  &&
+				(strncmp(ptr, ainfo.name, msk_name_len) == 0)) {
+				mask_found=1;
+				found = (ptr == msk_ptr) ? i : -1;
+				SUBDBG("Found mask: libpfm4=%s -- matches %s --  i: %d, %d %zu\n",
+					ainfo.name, ptr, i, msk_name_len, strlen(ainfo.name));
+				// find out how much space is left in the mask description work buffer we are building
+				unsigned int mskleft = len - strlen(mask_desc);
+				// if no space left, just discard this mask description
+				if (mskleft <= 1) {
+					SUBDBG("EXIT: Attribute description discarded: %s\n", ainfo.desc);
+					break;
+				}
+				// if description buffer is not empty, put in mask description separator
+				if (strlen(mask_desc) > 0) {
+					strcat (mask_desc, ":");
+					mskleft--;
+				}
+				// if new description will not all fit in buffer, report truncation
+				if (mskleft < (strlen(ainfo.desc) + 1)) {
+					SUBDBG("EXIT: Attribute description truncated: %s\n", ainfo.desc);
+				}
+				// move as much of this description as will fit
+				strncat (mask_desc, ainfo.desc, mskleft-1);
+				mask_desc[len-1] = '\0';
+				break;
+			}
+		}
+
+		/* See if we had a mask that wasn't found */
+		if (!mask_found) {
+			free(msk_ptr);
+			SUBDBG("EXIT: error libpfm4 find event: Mask not found: %s.\n", ptr);
+			return PAPI_ENOEVNT;
+		}
+
+		// if we have filled the work buffer, we can quit now
+		if ( (len - strlen(mask_desc))  <= 1) {
+			break;
+		}
+		ptr = ptrm;
+	}
+
+	if (mask_attr != NULL) {
+		*mask_attr = found;
+	}
+	free(msk_ptr);
+	return PAPI_OK;
+}
+
 
 static int pmu_is_present_and_right_type(pfm_pmu_info_t *pinfo, int type) {
 	SUBDBG("ENTER: pinfo: %s %p, pinfo->is_present: %d, "
@@ -123,11 +381,11 @@ static int pmu_is_present_and_right_type(pfm_pmu_info_t *pinfo, int type) {
  *  @param[in] event_table
  *             -- native event table struct
  *
- *  @returns returns a native_event_t or NULL
+ *  @returns returns the index of the event in the table or PAPI_ENOEVNT
  *
  */
 
-static struct native_event_t *allocate_native_event(
+static int allocate_native_event(
 		const char *name,
 		int libpfm4_index, int cidx,
 		struct native_event_table_t *event_table) {
@@ -146,53 +404,54 @@ static struct native_event_t *allocate_native_event(
 	char *event;
 	char *masks;
 	char fullname[BUFSIZ];
-	struct native_event_t *ntv_evt;
+	char mask_desc[PAPI_HUGE_STR_LEN];
+	perf_event_attr_t *attr;
+	int mask_attr;
+	uint32_t name_off, pmu_off, base_off, mask_off, full_off;
 
 	pfm_perf_encode_arg_t perf_arg;
 	pfm_event_info_t einfo;
-	pfm_event_attr_info_t ainfo;
 	pfm_pmu_info_t pinfo;
 
-	// if no place to put native events, report that allocate failed
-	if (event_table->native_events==NULL) {
-		SUBDBG("EXIT: no place to put native events\n");
-		return NULL;
-	}
-
-	// find out if this event is already known
-	event_num=find_existing_event(name, event_table);
-
 	/* add the event to our event table */
 	_papi_hwi_lock( NAMELIB_LOCK );
 
+	// find out if this event is already known
+	event_num=lookup_event(name, event_table);
+
 	// if we already know this event name,
 	// it was created as part of setting up the preset tables
 	// we need to use the event table which is already created
 	if (event_num >= 0) {
 		nevt_idx = event_num;
-		ntv_evt = &(event_table->native_events[event_num]);
 	} else {
 		// set to use a new event table
 		// (count of used events not bumped
 		// until we are sure setting it up does not get an errror)
 		nevt_idx = event_table->num_native_events;
-		ntv_evt = &(event_table->native_events[nevt_idx]);
 	}
 
-	SUBDBG("event_num: %d, nevt_idx: %d, ntv_evt: %p\n",
-		event_num, nevt_idx, ntv_evt);
+	// if no place to put native events, report that allocate failed
+	if (reserve_native_event(event_table, nevt_idx) != PAPI_OK) {
+		_papi_hwi_unlock( NAMELIB_LOCK );
+		SUBDBG("EXIT: no place to put native events\n");
+		return PAPI_ENOEVNT;
+	}
+	attr = &NATIVE_EVENT_FIELD(event_table, attr, nevt_idx);
+
+	SUBDBG("event_num: %d, nevt_idx: %d\n", event_num, nevt_idx);
 
 	/* clear the argument and attribute structures */
 	memset(&perf_arg,0,sizeof(pfm_perf_encode_arg_t));
-	memset(&(ntv_evt->attr),0,sizeof(struct perf_event_attr));
+	memset(attr,0,sizeof(struct perf_event_attr));
 
 	// set argument structure fields so the encode
 	// function can give us what we need
-	perf_arg.attr=&ntv_evt->attr;
+	perf_arg.attr=attr;
 	perf_arg.fstr=&event_string;
 
 	// set the size of the perf attr struct before getting pfm encoding
-	ntv_evt->attr.size = sizeof(struct perf_event_attr);
+	attr->size = sizeof(struct perf_event_attr);
 
 	/* use user provided name of the event to get the */
 	/* perf_event encoding and a fully qualified event string */
@@ -211,14 +470,14 @@ static struct native_event_t *allocate_native_event(
 		// the event table is used by the list so we put what we
 		// can get into it
 		// but the failure doing the encode causes us to
-		// return null to our caller
+		// return an error to our caller
 		encode_failed = 1;
 
 		// Noting the encode_failed error in the attr.config allows
 		// any later validate attempts to return an error value
 
 		// ??? .config is 64-bits? --vmw
-		ntv_evt->attr.config = 0xFFFFFF;
+		attr->config = 0xFFFFFF;
 
 		// we also want to make it look like a cpu number
 		// was not provided as an event mask
@@ -277,7 +536,7 @@ static struct native_event_t *allocate_native_event(
 			free(pmu_name);
 			_papi_hwi_unlock( NAMELIB_LOCK );
 			SUBDBG("EXIT: error from libpfm4 find event\n");
-			return NULL;
+			return PAPI_ENOEVNT;
 		}
 		SUBDBG("libpfm4_index: %#x\n", libpfm4_index);
 	}
@@ -292,7 +551,7 @@ static struct native_event_t *allocate_native_event(
 		free(pmu_name);
 		_papi_hwi_unlock( NAMELIB_LOCK );
 		SUBDBG("EXIT: pfm_get_event_info failed with %d\n", ret);
-		return NULL;
+		return PAPI_ENOEVNT;
 	}
 
 	// if pmu type is not one supported by this component,
@@ -305,188 +564,84 @@ static struct native_event_t *allocate_native_event(
 		free(pmu_name);
 		_papi_hwi_unlock( NAMELIB_LOCK );
 		SUBDBG("EXIT: PMU not supported by this component: einfo.pmu: %d, PFM_PMU_TYPE_CORE: %d\n", einfo.pmu, PFM_PMU_TYPE_CORE);
-		return NULL;
+		return PAPI_ENOEVNT;
 	}
 
 	if ((event_table->default_pmu.name) && (strcmp(pinfo.name, event_table->default_pmu.name)) != 0 && (strcmp(pinfo.name, pmu_name) != 0)) {
+		free(event_string);
+		free(pmu_name);
+		_papi_hwi_unlock( NAMELIB_LOCK );
 		SUBDBG("EXIT: The provided event %s lacks the necessary pmu prefix %s.\n", name, pinfo.name);
-		return NULL;
-	}
-
-	ntv_evt->allocated_name=strdup(name);
-	ntv_evt->mask_string=strdup(masks);
-	ntv_evt->component=cidx;
-	ntv_evt->pmu=pmu_name;
-	ntv_evt->base_name=strdup(event);
-	ntv_evt->pmu_plus_name=strdup(fullname);
-	ntv_evt->libpfm4_idx=libpfm4_index;
-	ntv_evt->event_description=strdup(einfo.desc);
-	ntv_evt->users=0;      /* is this needed? */
-	ntv_evt->cpu=perf_arg.cpu;
-
-	SUBDBG("ntv_evt->mask_string: %p (%s)\n",
-		ntv_evt->mask_string, ntv_evt->mask_string);
-	char *msk_ptr = strdup(masks);		// get a work copy of the mask string before we free the space it was in
-	free(event_string);
-
-	char mask_desc[PAPI_HUGE_STR_LEN] = "";
-
-	// if there is any mask data, collect their descriptions
-	if ((msk_ptr != NULL)  &&  (strlen(msk_ptr) > 0)) {
-		// go get the descriptions for each of the
-		// masks provided with this event
-		char *ptr = msk_ptr;
-		SUBDBG("ptr: %p (%s)\n", ptr, ptr);
-		while (ptr != NULL) {
-			char *ptrm = strstr(ptr, ":");
-			if (ptrm != NULL) {
-				*ptrm = '\0';
-				ptrm++;
-			}
-
-			// get the length of the mask name
-			char *wrk = strchr(ptr, '=');
-			unsigned int msk_name_len;
-			if (wrk != NULL) {
-				msk_name_len = wrk - ptr;
-				SUBDBG("Found =, length=%d\n",msk_name_len);
-			} else {
-				msk_name_len = strlen (ptr);
-				SUBDBG("No =, length=%d\n",msk_name_len);
-			}
-
-			int i, mask_found=0;
-			for (i=0 ; i<einfo.nattrs ; i++) {
-				// get this events attribute information
-				// from libpfm4, if unavailable return
-				// event not found (table must be cleared)
-				memset (&ainfo, 0,
-					sizeof(pfm_event_attr_info_t));
-				ainfo.size = sizeof(pfm_event_attr_info_t);
-				ret = pfm_get_event_attr_info(libpfm4_index,
-					i, PFM_OS_PERF_EVENT_EXT, &ainfo);
-				if (ret != PFM_SUCCESS) {
-               free (msk_ptr);
-               free(pmu_name);
-					SUBDBG("EXIT: error libpfm4 find event: Attribute info not found, libpfm4_index: %#x, ret: %d\n", libpfm4_index, _papi_libpfm4_error(ret));
-               _papi_hwi_unlock( NAMELIB_LOCK );
-					return NULL;
-				}
-
-				// if this is the one we want,
-				// append its description
-				if ((msk_name_len == strlen(ainfo.name))  &&
-					(strncmp(ptr, ainfo.name, msk_name_len) == 0)) {
-					mask_found=1;
-					SUBDBG("Found mask: libpfm4=%s -- matches %s --  i: %d, %d %zu\n",
-						ainfo.name, ptr, i, msk_name_len, strlen(ainfo.name));
-					// find out how much space is left in the mask description work buffer we are building
-					unsigned int mskleft = sizeof(mask_desc) - strlen(mask_desc);
-					// if no space left, just discard this mask description
-					if (mskleft <= 1) {
-						SUBDBG("EXIT: Attribute description discarded: %s\n", ainfo.desc);
-						break;
-					}
-					// if description buffer is not empty, put in mask description separator
-					if (strlen(mask_desc) > 0) {
-						strcat (mask_desc, ":");
-						mskleft--;
-					}
-					// if new description will not all fit in buffer, report truncation
-					if (mskleft < (strlen(ainfo.desc) + 1)) {
-						SUBDBG("EXIT: Attribute description truncated: %s\n", ainfo.desc);
-					}
-					// move as much of this description as will fit
-					strncat (mask_desc, ainfo.desc, mskleft-1);
-					mask_desc[mskleft-1] = '\0';
-					break;
-				}
-			}
-
-			/* See if we had a mask that wasn't found */
-			if (!mask_found) {
-            free(msk_ptr);
-            free(pmu_name);
-            SUBDBG("EXIT: error libpfm4 find event: Mask not found: %s.\n", ptr);
-            _papi_hwi_unlock( NAMELIB_LOCK );
-				return NULL;
-			}
+		return PAPI_ENOEVNT;
+	}
 
-			// if we have filled the work buffer, we can quit now
-			if ( (sizeof(mask_desc) - strlen(mask_desc))  <= 1) {
-				break;
-			}
-			ptr = ptrm;
-		}
+	// check the masks, their descriptions are asked from libpfm4
+	// again when the description of the event is wanted
+	if (get_mask_description(libpfm4_index, einfo.nattrs, masks,
+			mask_desc, sizeof(mask_desc), &mask_attr) != PAPI_OK) {
+		free(event_string);
+		free(pmu_name);
+		_papi_hwi_unlock( NAMELIB_LOCK );
+		return PAPI_ENOEVNT;
 	}
-	ntv_evt->mask_description=strdup(mask_desc);
-	SUBDBG("ntv_evt->mask_description: %p (%s)\n", ntv_evt->mask_description, ntv_evt->mask_description);
 
-	// give back space if we got any
-	if (msk_ptr != NULL) {
-		free (msk_ptr);
+	if ((intern_string(event_table, name, &name_off) != PAPI_OK) ||
+		(intern_string(event_table, pmu_name, &pmu_off) != PAPI_OK) ||
+		(intern_string(event_table, event, &base_off) != PAPI_OK) ||
+		(intern_string(event_table, masks, &mask_off) != PAPI_OK) ||
+		(intern_string(event_table, fullname, &full_off) != PAPI_OK)) {
+		free(event_string);
+		free(pmu_name);
+		_papi_hwi_unlock( NAMELIB_LOCK );
+		SUBDBG("EXIT: no room for the names of the event\n");
+		return PAPI_ENOEVNT;
 	}
+	free(event_string);
+	free(pmu_name);
+
+	NATIVE_EVENT_FIELD(event_table, allocated_name, nevt_idx) = name_off;
+	NATIVE_EVENT_FIELD(event_table, pmu, nevt_idx) = pmu_off;
+	NATIVE_EVENT_FIELD(event_table, base_name, nevt_idx) = base_off;
+	NATIVE_EVENT_FIELD(event_table, mask_string, nevt_idx) = mask_off;
+	NATIVE_EVENT_FIELD(event_table, pmu_plus_name, nevt_idx) = full_off;
+	NATIVE_EVENT_FIELD(event_table, libpfm4_idx, nevt_idx) = libpfm4_index;
+	NATIVE_EVENT_FIELD(event_table, cpu, nevt_idx) = perf_arg.cpu;
+	NATIVE_EVENT_FIELD(event_table, mask_attr, nevt_idx) = mask_attr;
+
+	SUBDBG("mask_string: %s, mask_description: %s\n", masks, mask_desc);
 
 	// create a papi table for this native event, put the index into the event sets array of native events into the papi table
-	int new_event_code = _papi_hwi_native_to_eventcode(cidx, libpfm4_index, nevt_idx, ntv_evt->allocated_name);
-	_papi_hwi_set_papi_event_string((const char *)ntv_evt->allocated_name);
+	int new_event_code = _papi_hwi_native_to_eventcode(cidx, libpfm4_index, nevt_idx, name);
+	_papi_hwi_set_papi_event_string(name);
 	_papi_hwi_set_papi_event_code(new_event_code, 1);
 
-	ntv_evt->papi_event_code=new_event_code;
+	NATIVE_EVENT_FIELD(event_table, papi_event_code, nevt_idx) = new_event_code;
 
-	SUBDBG("Using %#x as index for %s\n", ntv_evt->libpfm4_idx, fullname);
+	SUBDBG("Using %#x as index for %s\n", libpfm4_index, fullname);
 	SUBDBG("num_native_events: %d, allocated_native_events: %d\n", event_table->num_native_events, event_table->allocated_native_events);
-	SUBDBG("Native Event: papi_event_code: %#x, libpfm4_idx: %#x, pmu: %s, base_name: %s, mask_string: %s, allocated_name: %s\n",
-			ntv_evt->papi_event_code, ntv_evt->libpfm4_idx, ntv_evt->pmu, ntv_evt->base_name, ntv_evt->mask_string, ntv_evt->allocated_name);
-	SUBDBG("event_table->native_events[%d]: %p, cpu: %d, attr.config: 0x%"PRIx64", attr.config1: 0x%"PRIx64", attr.config2: 0x%"PRIx64", attr.type: 0x%"PRIx32", attr.exclude_user: %d, attr.exclude_kernel: %d, attr.exclude_guest: %d\n",
-		nevt_idx, &(event_table->native_events[nevt_idx]), ntv_evt->cpu, ntv_evt->attr.config,
-		ntv_evt->attr.config1, ntv_evt->attr.config2, ntv_evt->attr.type,
-		ntv_evt->attr.exclude_user, ntv_evt->attr.exclude_kernel, ntv_evt->attr.exclude_guest);
-
-	/* If we've used all of the allocated native events, */
-	/* then allocate more room */
-	if (event_table->num_native_events >=
-				event_table->allocated_native_events-1) {
-
-		SUBDBG("Allocating more room for native events (%d %ld)\n",
-			(event_table->allocated_native_events+NATIVE_EVENT_CHUNK),
-			(long)sizeof(struct native_event_t) *
-			(event_table->allocated_native_events+NATIVE_EVENT_CHUNK));
-
-		event_table->native_events=realloc(event_table->native_events,
-				sizeof(struct native_event_t) *
-				(event_table->allocated_native_events+NATIVE_EVENT_CHUNK));
-
-		event_table->allocated_native_events+=NATIVE_EVENT_CHUNK;
-
-		// we got new space so we need to reset
-		// the pointer to the correct native event in the new space
-		ntv_evt = &(event_table->native_events[nevt_idx]);
-	}
-
-
-	// if getting more space for native events failed,
-	// report that allocate failed
-	if (event_table->native_events==NULL) {
-		SUBDBG("EXIT: attempt to get more space for "
-			"native events failed\n");
-		return NULL;
-	}
+	SUBDBG("Native Event: papi_event_code: %#x, libpfm4_idx: %#x, allocated_name: %s\n",
+			new_event_code, libpfm4_index, name);
+	SUBDBG("event_table->native_events[%d]: cpu: %d, attr.config: 0x%"PRIx64", attr.config1: 0x%"PRIx64", attr.config2: 0x%"PRIx64", attr.type: 0x%"PRIx32", attr.exclude_user: %d, attr.exclude_kernel: %d, attr.exclude_guest: %d\n",
+		nevt_idx, perf_arg.cpu, attr->config,
+		attr->config1, attr->config2, attr->type,
+		attr->exclude_user, attr->exclude_kernel, attr->exclude_guest);
 
 	// if we created a new event, bump the number used
 	if (event_num < 0) {
-		event_table->num_native_events++;
+		_papi_hwi_string_set_find(&event_table->strings.set, name)->value = nevt_idx;
+		__atomic_store_n(&event_table->num_native_events,
+			event_table->num_native_events + 1, __ATOMIC_RELEASE);
 	}
 
 	_papi_hwi_unlock( NAMELIB_LOCK );
 
 	if (encode_failed != 0) {
 		SUBDBG("EXIT: encoding event failed\n");
-		return NULL;
+		return PAPI_ENOEVNT;
 	}
 
-	SUBDBG("EXIT: new_event: %p\n", ntv_evt);
-	return ntv_evt;
+	SUBDBG("EXIT: new_event: %d\n", nevt_idx);
+	return nevt_idx;
 }
 
 
@@ -590,27 +745,26 @@ _pe_libpfm4_ntv_name_to_code( const char *name, unsigned int *event_code,
 {
   SUBDBG( "ENTER: name: %s, event_code: %p, *event_code: %#x, event_table: %p\n", name, event_code, *event_code, event_table);
 
-  struct native_event_t *our_event;
   int event_num;
 
   // if we already know this event name, just return its native code
   event_num=find_existing_event(name, event_table);
   if (event_num >= 0) {
-	     *event_code=event_table->native_events[event_num].libpfm4_idx;
+	     *event_code=NATIVE_EVENT_FIELD(event_table, libpfm4_idx, event_num);
 	     // the following call needs to happen to prevent the internal layer from creating a new papi native event table
-	     _papi_hwi_set_papi_event_code(event_table->native_events[event_num].papi_event_code, 1);
-	     SUBDBG("EXIT: Found papi_event_code: %#x, libpfm4_idx: %#x\n", event_table->native_events[event_num].papi_event_code, event_table->native_events[event_num].libpfm4_idx);
+	     _papi_hwi_set_papi_event_code(NATIVE_EVENT_FIELD(event_table, papi_event_code, event_num), 1);
+	     SUBDBG("EXIT: Found papi_event_code: %#x, libpfm4_idx: %#x\n", NATIVE_EVENT_FIELD(event_table, papi_event_code, event_num), *event_code);
 	     return PAPI_OK;
   }
 
      // Try to allocate this event to see if it is known by libpfm4, if allocate fails tell the caller it is not valid
-     our_event=allocate_native_event(name, -1, cidx, event_table);
-     if (our_event==NULL) {
+     event_num=allocate_native_event(name, -1, cidx, event_table);
+     if (event_num < 0) {
     	 SUBDBG("EXIT: Allocating event: '%s' failed\n", name);
     	 return PAPI_ENOEVNT;
      }
 
-     *event_code = our_event->libpfm4_idx;
+     *event_code = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, event_num);
      SUBDBG("EXIT: Found code: %#x\n",*event_code);
      return PAPI_OK;
 }
@@ -652,13 +806,8 @@ _pe_libpfm4_ntv_code_to_name(unsigned int EventCode,
 		return PAPI_ENOEVNT;
 	}
 
-	// find our native event table for this papi event code (search list backwards because it improves chances of finding it quickly)
-	for (eidx=event_table->num_native_events-1 ; eidx>=0 ; eidx--) {
-		if ((papi_event_code == event_table->native_events[eidx].papi_event_code) && (EventCode == ((unsigned)event_table->native_events[eidx].libpfm4_idx))) {
-			SUBDBG("Found native_event[%d]: papi_event_code: %#x, libpfm4_idx: %#x\n", eidx, event_table->native_events[eidx].papi_event_code, event_table->native_events[eidx].libpfm4_idx);
-			break;
-		}
-	}
+	// find our native event table for this papi event code
+	eidx = find_event_by_code(papi_event_code, EventCode, event_table);
 
 	// if we did not find a match, return an error
 	if (eidx < 0) {
@@ -674,11 +823,11 @@ _pe_libpfm4_ntv_code_to_name(unsigned int EventCode,
 
 	// if this event is defined by the default pmu, then use only the event name
 	// if it is not defined by the default pmu, then use both the pmu name and event name
-	char *ename;
-	if ((event_table->default_pmu.name) && (strcmp(event_table->default_pmu.name, event_table->native_events[eidx].pmu) == 0)) {
-		ename = event_table->native_events[eidx].base_name;
+	const char *ename;
+	if ((event_table->default_pmu.name) && (strcmp(event_table->default_pmu.name, native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, pmu, eidx))) == 0)) {
+		ename = native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, base_name, eidx));
 	} else {
-		ename = event_table->native_events[eidx].pmu_plus_name;
+		ename = native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, pmu_plus_name, eidx));
 	}
 
 	// if it will not fit, return error
@@ -689,7 +838,7 @@ _pe_libpfm4_ntv_code_to_name(unsigned int EventCode,
 	strcpy (ntv_name, ename);
 
 	// if this event had masks, also add their names
-	char *mname = event_table->native_events[eidx].mask_string;
+	const char *mname = native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, mask_string, eidx));
 	if ((mname != NULL)  &&  (strlen(mname) > 0)) {
 		if ((strlen(ename) + 8 + strlen(mname)) >= (unsigned)len) {
 			SUBDBG("EXIT: Not enough room for event and mask descriptions: need: %u, have: %u", (unsigned)(strlen(ename) + 8 + strlen(mname)), (unsigned)len);
@@ -733,10 +882,12 @@ _pe_libpfm4_ntv_code_to_descr( unsigned int EventCode,
 {
 	SUBDBG("ENTER: EventCode: %#x, ntv_descr: %p, len: %d: event_table: %p\n", EventCode, ntv_descr, len, event_table);
 
-	int eidx;
+	int eidx, ret, mask_attr;
 	int papi_event_code;
-	char *mdesc;
-	char *edesc;
+	char mdesc[PAPI_HUGE_STR_LEN];
+	const char *edesc;
+	pfm_event_info_t einfo;
+	pfm_event_attr_info_t ainfo;
 
 	// get the attribute index for this papi event
 	papi_event_code = _papi_hwi_get_papi_event_code();
@@ -747,13 +898,8 @@ _pe_libpfm4_ntv_code_to_descr( unsigned int EventCode,
 		return PAPI_ENOEVNT;
 	}
 
-	// find our native event table for this papi event code (search list backwards because it improves chances of finding it quickly)
-	for (eidx=event_table->num_native_events-1 ; eidx>=0 ; eidx--) {
-		SUBDBG("native_event[%d]: papi_event_code: %#x, libpfm4_idx: %#x\n", eidx, event_table->native_events[eidx].papi_event_code, event_table->native_events[eidx].libpfm4_idx);
-		if ((papi_event_code == event_table->native_events[eidx].papi_event_code) && (EventCode == ((unsigned)event_table->native_events[eidx].libpfm4_idx))) {
-			break;
-		}
-	}
+	// find our native event table for this papi event code
+	eidx = find_event_by_code(papi_event_code, EventCode, event_table);
 
 	// if we did not find a match, return an error
 	if (eidx < 0) {
@@ -767,7 +913,17 @@ _pe_libpfm4_ntv_code_to_descr( unsigned int EventCode,
 		return PAPI_ENOEVNT;
 	}
 
-	edesc = event_table->native_events[eidx].event_description;
+	// the descriptions are not kept in the table, ask libpfm4 for them
+	memset( &einfo, 0, sizeof( pfm_event_info_t ));
+	einfo.size = sizeof(pfm_event_info_t);
+	if ((ret = pfm_get_event_info(EventCode, PFM_OS_PERF_EVENT_EXT, &einfo)) != PFM_SUCCESS) {
+		SUBDBG("EXIT: pfm_get_event_info returned: %d\n", ret);
+		return PAPI_ENOEVNT;
+	}
+	edesc = einfo.desc;
+	if (edesc == NULL) {
+		edesc = "";
+	}
 
 	// if it will not fit, return error
 	if (strlen (edesc) >= (unsigned)len) {
@@ -776,9 +932,26 @@ _pe_libpfm4_ntv_code_to_descr( unsigned int EventCode,
 	}
 	strcpy (ntv_descr, edesc);
 
-	// if this event had masks, also add their descriptions
-	mdesc = event_table->native_events[eidx].mask_description;
-	if ((mdesc != NULL)  &&  (strlen(mdesc) > 0)) {
+	// if this event had masks, also add their descriptions, a single
+	// mask is fetched straight by the attribute index found when the
+	// event was allocated, more are looked up by name again
+	mask_attr = NATIVE_EVENT_FIELD(event_table, mask_attr, eidx);
+	if (mask_attr >= 0) {
+		memset(&ainfo, 0, sizeof(pfm_event_attr_info_t));
+		ainfo.size = sizeof(pfm_event_attr_info_t);
+		mdesc[0] = '\0';
+		if ((pfm_get_event_attr_info(EventCode, mask_attr,
+				PFM_OS_PERF_EVENT_EXT, &ainfo) == PFM_SUCCESS) &&
+			(ainfo.desc != NULL)) {
+			strncpy(mdesc, ainfo.desc, sizeof(mdesc) - 1);
+			mdesc[sizeof(mdesc) - 1] = '\0';
+		}
+	} else if (get_mask_description(EventCode, einfo.nattrs,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, mask_string, eidx)),
+			mdesc, sizeof(mdesc), NULL) != PAPI_OK) {
+		mdesc[0] = '\0';
+	}
+	if (strlen(mdesc) > 0) {
 		if ((strlen(edesc) + 8 + strlen(mdesc)) >= (unsigned)len) {
 			SUBDBG("EXIT: Not enough room for event and mask descriptions: need: %u, have: %u", (unsigned)(strlen(edesc) + 8 + strlen(mdesc)), (unsigned)len);
 			return PAPI_EBUF;
@@ -845,7 +1018,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 	char event_string[BUFSIZ];
 	pfm_pmu_info_t pinfo;
 	pfm_event_info_t einfo;
-	struct native_event_t *our_event;
+	int our_event;
 
 	/* return first event if so specified */
 	if ( modifier == PAPI_ENUM_FIRST ) {
@@ -878,7 +1051,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 		SUBDBG("code: %#x, pmu: %s, event: %s, event_string: %s\n", code, pinfo.name, einfo.name, event_string);
 
 		// go allocate this event, need to create tables used by the get event info call that will probably follow
-		if ((our_event = allocate_native_event(event_string, code, cidx, event_table)) == NULL) {
+		if ((our_event = allocate_native_event(event_string, code, cidx, event_table)) < 0) {
 			// allocate may have created the event table but returned NULL to tell the caller the event string was invalid (attempt to encode it failed).
 			// if the caller wants to use this event to count something, it will report an error
 			// but if the caller is just interested in listing the event, then we need an event table with an event name and libpfm4 index
@@ -889,12 +1062,12 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 			}
 
 			// give back the new event code
-			*PapiEventCode = event_table->native_events[evt_idx].libpfm4_idx;
+			*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, evt_idx);
 			SUBDBG("EXIT: event code: %#x\n", *PapiEventCode);
 			return PAPI_OK;
 		}
 
-		*PapiEventCode = our_event->libpfm4_idx;
+		*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, our_event);
 
 		SUBDBG("EXIT: *PapiEventCode: %#x\n", *PapiEventCode);
 		return PAPI_OK;
@@ -950,7 +1123,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 		SUBDBG("code: %#x, pmu: %s, event: %s, event_string: %s\n", code, pinfo.name, einfo.name, event_string);
 
 		// go allocate this event, need to create tables used by the get event info call that will follow
-		if ((our_event = allocate_native_event(event_string, code, cidx, event_table)) == NULL) {
+		if ((our_event = allocate_native_event(event_string, code, cidx, event_table)) < 0) {
 			// allocate may have created the event table but returned NULL to tell the caller the event string was invalid (attempt to encode it failed).
 			// if the caller wants to use this event to count something, it will report an error
 			// but if the caller is just interested in listing the event, then we need an event table with an event name and libpfm4 index
@@ -961,13 +1134,13 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 			}
 
 			// give back the new event code
-			*PapiEventCode = event_table->native_events[evt_idx].libpfm4_idx;
+			*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, evt_idx);
 			SUBDBG("EXIT: event code: %#x\n", *PapiEventCode);
 			return PAPI_OK;
 		}
 
 		// give back the new event code
-		*PapiEventCode = our_event->libpfm4_idx;
+		*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, our_event);
 
 		SUBDBG("EXIT: *PapiEventCode: %#x\n", *PapiEventCode);
 		return PAPI_OK;
@@ -1001,12 +1174,13 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 
 		// find the event table for this event, we need the pmu name and event name without any masks
 		int ntv_idx = _papi_hwi_get_ntv_idx(_papi_hwi_get_papi_event_code());
-		if (ntv_idx < 0) {
+		if ((ntv_idx < 0) ||
+			(ntv_idx >= __atomic_load_n(&event_table->num_native_events, __ATOMIC_ACQUIRE))) {
 			SUBDBG("EXIT: _papi_hwi_get_ntv_idx returned: %d\n", ntv_idx);
-			return ntv_idx;
+			return (ntv_idx < 0) ? ntv_idx : PAPI_ENOEVNT;
 		}
-		char *ename = event_table->native_events[ntv_idx].pmu_plus_name;
-		if ((ename == NULL)  ||  (strlen(ename) >= sizeof(event_string))) {
+		const char *ename = native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, pmu_plus_name, ntv_idx));
+		if (strlen(ename) >= sizeof(event_string)) {
 			SUBDBG("EXIT: Event name will not fit into buffer\n");
 			return PAPI_EBUF;
 		}
@@ -1046,7 +1220,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 		}
 
 		// go allocate this event, need to create tables used by the get event info call that will follow
-		if ((our_event = allocate_native_event(event_string, *PapiEventCode, cidx, event_table)) == NULL) {
+		if ((our_event = allocate_native_event(event_string, *PapiEventCode, cidx, event_table)) < 0) {
 			// allocate may have created the event table but returned NULL to tell the caller the event string was invalid.
 			// if the caller wants to use this event to count something, it must report the error
 			// but if the caller is just interested in listing the event (like this code), then find the table that was created and return its libpfm4 index
@@ -1058,7 +1232,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 			// bump so next time we will use next attribute
 			attr_idx++;
 			// give back the new event code
-			*PapiEventCode = event_table->native_events[evt_idx].libpfm4_idx;
+			*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, evt_idx);
 			SUBDBG("EXIT: event code: %#x\n", *PapiEventCode);
 			return PAPI_OK;
 		}
@@ -1067,7 +1241,7 @@ _pe_libpfm4_ntv_enum_events( unsigned int *PapiEventCode,
 		attr_idx++;
 
 		// give back the new event code
-		*PapiEventCode = our_event->libpfm4_idx;
+		*PapiEventCode = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, our_event);
 
 		SUBDBG("EXIT: event code: %#x\n", *PapiEventCode);
 		return PAPI_OK;
@@ -1112,20 +1286,26 @@ _pe_libpfm4_shutdown(papi_vector_t *my_vector,
   /* clean out and free the native events structure */
   _papi_hwi_lock( NAMELIB_LOCK );
 
-  /* free memory allocated with strdup or malloc */
-  for( i=0; i<event_table->num_native_events; i++) {
-     free(event_table->native_events[i].base_name);
-     free(event_table->native_events[i].pmu_plus_name);
-     free(event_table->native_events[i].pmu);
-     free(event_table->native_events[i].allocated_name);
-     free(event_table->native_events[i].mask_string);
-     free(event_table->native_events[i].event_description);
-     if (event_table->native_events[i].mask_description != NULL) {
-          free(event_table->native_events[i].mask_description);
-     }
+  SUBDBG("%d native events in %d bytes, %u strings in %u bytes\n",
+     event_table->num_native_events,
+     (event_table->allocated_native_events / NATIVE_EVENT_CHUNK) *
+     (int)sizeof(struct native_event_chunk_t),
+     event_table->strings.set.count,
+     (unsigned)(((event_table->strings.next >> NATIVE_STRING_BLOCK_BITS) + 1) * NATIVE_STRING_BLOCK +
+     event_table->strings.set.num_slots * sizeof(papi_string_slot_t)));
+
+  for (i=0 ; i<NATIVE_EVENT_MAX_CHUNKS ; i++) {
+     free(event_table->chunks[i]);
+     event_table->chunks[i] = NULL;
+  }
+  for (i=0 ; i<NATIVE_STRING_MAX_BLOCKS ; i++) {
+     free(event_table->strings.blocks[i]);
   }
+  _papi_hwi_string_set_free(&event_table->strings.set);
+  memset(&event_table->strings, 0, sizeof(event_table->strings));
 
-  free(event_table->native_events);
+  __atomic_store_n(&event_table->num_native_events, 0, __ATOMIC_RELEASE);
+  event_table->allocated_native_events = 0;
 
   _papi_hwi_unlock( NAMELIB_LOCK );
 
@@ -1134,6 +1314,237 @@ _pe_libpfm4_shutdown(papi_vector_t *my_vector,
 }
 
 
+/* A native event as stored in the event cache, strings are offsets */
+/* into the string pool of the table.                                */
+struct pe_cache_event_t {
+	perf_event_attr_t attr;
+	int32_t libpfm4_idx;
+	int32_t papi_event_code;
+	int32_t cpu;
+	int32_t mask_attr;
+	uint32_t pmu;
+	uint32_t allocated_name;
+	uint32_t base_name;
+	uint32_t mask_string;
+	uint32_t pmu_plus_name;
+};
+
+/** @class  pe_cache_key
+ *  @brief  Describe what the event cache of this component depends on
+ *
+ *  The PMUs libpfm4 detected, the preset table source and the sizes
+ *  and versions that shape the cached records.
+ */
+
+static int
+pe_cache_key(papi_vector_t *component,
+		struct native_event_table_t *event_table,
+		char *key, int len) {
+
+	char presets[PATH_MAX+64];
+	int i, n;
+
+	if (_papi_preset_cache_key(presets, sizeof(presets)) != PAPI_OK) {
+		return PAPI_ENOSUPP;
+	}
+
+	n = snprintf(key, len, "libpfm %#x attr %d default %s %d;%s;pmus",
+		pfm_get_version(), (int)sizeof(perf_event_attr_t),
+		event_table->default_pmu.name, event_table->pmu_type, presets);
+	for (i = 0; (i < PAPI_PMU_MAX) && (n < len); i++) {
+		if (component->cmp_info.pmu_names[i] == NULL) {
+			break;
+		}
+		n += snprintf(key+n, len-n, " %s", component->cmp_info.pmu_names[i]);
+	}
+
+	return (n < len) ? PAPI_OK : PAPI_ENOSUPP;
+}
+
+/** @class  pe_cache_save
+ *  @brief  Stage the native event table for the event cache
+ */
+
+static int
+pe_cache_save(struct native_event_table_t *event_table) {
+
+	papi_cache_buf_t records, strings;
+	struct pe_cache_event_t rec;
+	int i, retval;
+
+	memset(&records, 0, sizeof(records));
+	memset(&strings, 0, sizeof(strings));
+
+	for (i = 0; i < event_table->num_native_events; i++) {
+		memset(&rec, 0, sizeof(rec));
+		rec.attr = NATIVE_EVENT_FIELD(event_table, attr, i);
+		rec.libpfm4_idx = NATIVE_EVENT_FIELD(event_table, libpfm4_idx, i);
+		rec.papi_event_code = NATIVE_EVENT_FIELD(event_table, papi_event_code, i);
+		rec.cpu = NATIVE_EVENT_FIELD(event_table, cpu, i);
+		rec.mask_attr = NATIVE_EVENT_FIELD(event_table, mask_attr, i);
+		rec.pmu = _papi_cache_buf_str(&strings,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, pmu, i)));
+		rec.allocated_name = _papi_cache_buf_str(&strings,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, allocated_name, i)));
+		rec.base_name = _papi_cache_buf_str(&strings,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, base_name, i)));
+		rec.mask_string = _papi_cache_buf_str(&strings,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, mask_string, i)));
+		rec.pmu_plus_name = _papi_cache_buf_str(&strings,
+			native_event_string(event_table, NATIVE_EVENT_FIELD(event_table, pmu_plus_name, i)));
+		_papi_cache_buf_add(&records, &rec, sizeof(rec));
+	}
+
+	retval = _papi_cache_stage_table(PAPI_CACHE_PE_EVENTS, &records,
+			event_table->num_native_events, sizeof(rec), &strings);
+
+	_papi_cache_buf_free(&records);
+	_papi_cache_buf_free(&strings);
+	return retval;
+}
+
+/** @class  pe_cache_intern
+ *  @brief  Intern a string of the event cache in the string arena
+ */
+
+static int
+pe_cache_intern(struct native_event_table_t *event_table,
+		const papi_cache_table_t *table, unsigned int off, uint32_t *offset) {
+
+	const char *str = _papi_cache_str(table, off);
+
+	if (str == NULL) {
+		return PAPI_ENOEVNT;
+	}
+	return intern_string(event_table, str, offset);
+}
+
+/** @class  pe_cache_load
+ *  @brief  Restore the native event table from the event cache
+ *
+ *  PAPI event codes are handed out in the order the events are
+ *  created, so the cached events are created again in their original
+ *  order and each must get back the code it had when the cache was
+ *  written; the cached presets refer to those codes.  Events restored
+ *  before a mismatch stay in the table, they are valid either way.
+ */
+
+static int
+pe_cache_load(int cidx, struct native_event_table_t *event_table) {
+
+	const struct pe_cache_event_t *recs;
+	papi_string_slot_t *slot;
+	papi_cache_table_t table;
+	papi_event_ctx_t ctx;
+	const char *name;
+	uint32_t name_off;
+	unsigned int i;
+	int code, retval = PAPI_OK;
+
+	if (_papi_cache_table(PAPI_CACHE_PE_EVENTS, sizeof(*recs), &table) != PAPI_OK) {
+		return PAPI_ENOEVNT;
+	}
+	recs = (const struct pe_cache_event_t *)table.records;
+
+	if (event_table->num_native_events != 0) {
+		return PAPI_ENOEVNT;
+	}
+
+	_papi_hwi_lock( NAMELIB_LOCK );
+
+	_papi_hwi_event_ctx_begin(&ctx);
+
+	for (i = 0; i < table.count; i++) {
+		name = _papi_cache_str(&table, recs[i].allocated_name);
+		if (name == NULL) {
+			retval = PAPI_ENOEVNT;
+			break;
+		}
+
+		if ((reserve_native_event(event_table, i) != PAPI_OK) ||
+			(intern_string(event_table, name, &name_off) != PAPI_OK) ||
+			(pe_cache_intern(event_table, &table, recs[i].pmu,
+				&NATIVE_EVENT_FIELD(event_table, pmu, i)) != PAPI_OK) ||
+			(pe_cache_intern(event_table, &table, recs[i].base_name,
+				&NATIVE_EVENT_FIELD(event_table, base_name, i)) != PAPI_OK) ||
+			(pe_cache_intern(event_table, &table, recs[i].mask_string,
+				&NATIVE_EVENT_FIELD(event_table, mask_string, i)) != PAPI_OK) ||
+			(pe_cache_intern(event_table, &table, recs[i].pmu_plus_name,
+				&NATIVE_EVENT_FIELD(event_table, pmu_plus_name, i)) != PAPI_OK)) {
+			retval = PAPI_ENOMEM;
+			break;
+		}
+		NATIVE_EVENT_FIELD(event_table, allocated_name, i) = name_off;
+		NATIVE_EVENT_FIELD(event_table, attr, i) = recs[i].attr;
+		NATIVE_EVENT_FIELD(event_table, libpfm4_idx, i) = recs[i].libpfm4_idx;
+		NATIVE_EVENT_FIELD(event_table, cpu, i) = recs[i].cpu;
+		NATIVE_EVENT_FIELD(event_table, mask_attr, i) = recs[i].mask_attr;
+
+		code = _papi_hwi_native_to_eventcode(cidx, recs[i].libpfm4_idx, i, name);
+		NATIVE_EVENT_FIELD(event_table, papi_event_code, i) = code;
+		slot = _papi_hwi_string_set_find(&event_table->strings.set, name);
+		if (slot->value < 0) {
+			slot->value = i;
+		}
+		__atomic_store_n(&event_table->num_native_events, i + 1, __ATOMIC_RELEASE);
+		if (code != recs[i].papi_event_code) {
+			SUBDBG("%s got %#x, cached %#x\n", name, code, recs[i].papi_event_code);
+			retval = PAPI_ENOEVNT;
+			break;
+		}
+	}
+
+	_papi_hwi_event_ctx_end(&ctx);
+
+	_papi_hwi_unlock( NAMELIB_LOCK );
+
+	SUBDBG("EXIT: %d of %u events from the event cache\n", event_table->num_native_events, table.count);
+	return retval;
+}
+
+/** @class  pe_load_presets
+ *  @brief  Load the presets, from the event cache if PAPI_EVENT_CACHE is set
+ *
+ *  On a hit the native events the presets use and the presets
+ *  themselves are restored without going through libpfm4 or the
+ *  event table.  Otherwise they are loaded as usual and written
+ *  to the cache.  User defined events are always loaded from
+ *  their file.
+ */
+
+static int
+pe_load_presets(papi_vector_t *component, int cidx,
+		struct native_event_table_t *event_table) {
+
+	char key[PAPI_HUGE_STR_LEN*4];
+	int cached, retval;
+
+	cached = (pe_cache_key(component, event_table, key, sizeof(key)) == PAPI_OK) ?
+		_papi_cache_open(key) : PAPI_ENOSUPP;
+
+	if ((cached == PAPI_OK) &&
+		(pe_cache_load(cidx, event_table) == PAPI_OK) &&
+		(_papi_preset_cache_load(cidx) == PAPI_OK)) {
+
+		_papi_cache_close();
+		return _papi_load_user_event_table( (char *)event_table->default_pmu.name,
+				event_table->default_pmu.pmu, cidx );
+	}
+
+	retval = _papi_load_preset_table( (char *)event_table->default_pmu.name,
+			event_table->default_pmu.pmu, cidx );
+
+	if ((retval == PAPI_OK) && (cached != PAPI_ENOSUPP)) {
+		if ((pe_cache_save(event_table) == PAPI_OK) &&
+			(_papi_preset_cache_save(cidx) == PAPI_OK)) {
+			_papi_cache_write();
+		}
+	}
+	_papi_cache_close();
+
+	return retval;
+}
+
 /** @class  _pe_libpfm4_init
  *  @brief  Initialize the libpfm4 code
  *
@@ -1169,14 +1580,10 @@ _pe_libpfm4_init(papi_vector_t *component, int cidx,
 	event_table->num_native_events=0;
 	event_table->pmu_type=pmu_type;
 
-	event_table->native_events=calloc(NATIVE_EVENT_CHUNK,
-					sizeof(struct native_event_t));
-	if (event_table->native_events==NULL) {
+	if (reserve_native_event(event_table, 0) != PAPI_OK) {
 		return PAPI_ENOMEM;
 	}
 
-	event_table->allocated_native_events=NATIVE_EVENT_CHUNK;
-
 	/* Count number of present PMUs */
 	detected_pmus=0;
 	ncnt=0;
@@ -1350,8 +1757,7 @@ _pe_libpfm4_init(papi_vector_t *component, int cidx,
 
 	/* Setup presets, only if Component 0 and default core PMU */
 	if ((cidx==0) && (found_default)) {
-		retval = _papi_load_preset_table( (char *)event_table->default_pmu.name,
-				event_table->default_pmu.pmu, cidx );
+		retval = pe_load_presets( component, cidx, event_table );
 		if ( retval!=PAPI_OK ) {
 			return PAPI_ENOEVNT;
 		}
@@ -1390,12 +1796,9 @@ _peu_libpfm4_init(papi_vector_t *my_vector, int cidx,
    event_table->num_native_events=0;
    event_table->pmu_type=pmu_type;
 
-   event_table->native_events=calloc(NATIVE_EVENT_CHUNK,
-					   sizeof(struct native_event_t));
-   if (event_table->native_events==NULL) {
+   if (reserve_native_event(event_table, 0) != PAPI_OK) {
       return PAPI_ENOMEM;
    }
-   event_table->allocated_native_events=NATIVE_EVENT_CHUNK;
 
    /* Count number of present PMUs */
    detected_pmus=0;
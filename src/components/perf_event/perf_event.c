@@ -56,6 +56,11 @@
 #include "perf_event_lib.h"
 #include "perf_helpers.h"
 
+/* The public header pulls in <linux/perf_event.h> for its inline reader, */
+/* which clashes with PEINCLUDE; we only need the declarations here.      */
+#define PAPI_FASTREAD_DECLARATIONS_ONLY
+#include "papi_fastread.h"
+
 /* Set to enable pre-Linux 2.6.34 perf_event workarounds   */
 /* If disabling them gets no complaints then we can remove */
 /* These in a future version of PAPI.                      */
@@ -563,14 +568,14 @@ check_scheduability( pe_context_t *ctx, pe_control_t *ctl, int idx )
 
       /* We have to reset all events because reset of group leader      */
       /* does not reset all.                                            */
-      /* we assume that the events are being added one by one and that  */
-      /* we do not need to reset higher events (doing so may reset ones */
-      /* that have not been initialized yet.                            */
+      /* we assume that the events up to idx are open and that we do    */
+      /* not need to reset higher events (doing so may reset ones that  */
+      /* have not been initialized yet.                                 */
 
       /* Note... PERF_EVENT_IOC_RESET does not reset time running       */
       /* info if multiplexing, so we should avoid coming here if        */
       /* we are multiplexing the event.                                 */
-      for( i = 0; i < idx; i++) {
+      for( i = 0; i <= idx; i++) {
 	 retval=ioctl( ctl->events[i].event_fd, PERF_EVENT_IOC_RESET, NULL );
 	 if (retval == -1) {
 	    PAPIERROR( "ioctl(PERF_EVENT_IOC_RESET) #%d/%d %d "
@@ -584,6 +589,126 @@ check_scheduability( pe_context_t *ctx, pe_control_t *ctl, int idx )
 }
 
 
+/* Memo of what check_scheduability() found for a group.  Adding events */
+/* one by one reopens the whole group every time, and tools build the    */
+/* same sets over and over, so the kernel is only asked once for each    */
+/* distinct group.  The key is what decides where the events can go:     */
+/* their PMU (attr.type), encodings, domains and cpus, and how the group */
+/* is opened.  Either answer is only remembered, and believed, while no  */
+/* other events of this process are open: those may be what took the     */
+/* counters, and a group that fit next to them may not fit next to       */
+/* others, so then the kernel is asked again.                            */
+
+#define SCHED_CACHE_SIZE	256
+#define SCHED_CACHE_EVENTS	32
+#define SCHED_KEY_WORDS		( 2 + 5 * SCHED_CACHE_EVENTS )
+
+struct sched_cache_entry {
+	uint64_t hash;
+	int result;
+	int words;
+	uint64_t *key;
+};
+
+static struct sched_cache_entry sched_cache[SCHED_CACHE_SIZE];
+static int pe_open_events;	/* events of this process that are open */
+
+static int
+sched_cache_key( pe_control_t *ctl, long pid, uint64_t *key, uint64_t *hash )
+{
+	struct perf_event_attr *attr;
+	int i, n = 0;
+
+	if ( ctl->num_events > SCHED_CACHE_EVENTS ) {
+		return 0;
+	}
+
+	key[n++] = ctl->num_events;
+	key[n++] = ( ( pid == 0 ) ? 0 : ( pid == -1 ) ? 1 : 2 ) |
+		( ctl->inherit << 2 ) | ( exclude_guest_unsupported << 3 );
+	for( i = 0; i < ctl->num_events; i++ ) {
+		attr = &ctl->events[i].attr;
+		key[n++] = attr->type;
+		key[n++] = attr->config;
+		key[n++] = attr->config1;
+		key[n++] = attr->config2;
+		key[n++] = ( ( uint64_t ) ( uint32_t ) ctl->events[i].cpu << 32 ) |
+			( attr->exclude_user ) | ( attr->exclude_kernel << 1 ) |
+			( attr->exclude_hv << 2 ) | ( attr->exclude_idle << 3 ) |
+			( attr->exclude_host << 4 ) | ( attr->exclude_guest << 5 ) |
+			( attr->precise_ip << 6 );
+	}
+
+	*hash = _papi_hwi_hash( key, n * sizeof ( uint64_t ) );
+
+	return n;
+}
+
+/* PAPI_OK or PAPI_ECNFLCT if the group is known, else PAPI_ENOEVNT */
+static int
+sched_cache_lookup( uint64_t *key, int words, uint64_t hash )
+{
+	struct sched_cache_entry *entry = &sched_cache[hash % SCHED_CACHE_SIZE];
+	int result = PAPI_ENOEVNT;
+
+	if ( __atomic_load_n( &pe_open_events, __ATOMIC_RELAXED ) != 0 ) {
+		return PAPI_ENOEVNT;
+	}
+
+	_papi_hwi_lock( COMPONENT_LOCK );
+	if ( ( entry->key != NULL ) && ( entry->hash == hash ) &&
+		( entry->words == words ) &&
+		( memcmp( entry->key, key, words * sizeof ( uint64_t ) ) == 0 ) ) {
+		result = entry->result;
+	}
+	_papi_hwi_unlock( COMPONENT_LOCK );
+
+	return result;
+}
+
+static void
+sched_cache_insert( uint64_t *key, int words, uint64_t hash, int result )
+{
+	struct sched_cache_entry *entry = &sched_cache[hash % SCHED_CACHE_SIZE];
+	uint64_t *copy;
+
+	if ( __atomic_load_n( &pe_open_events, __ATOMIC_RELAXED ) != 0 ) {
+		return;
+	}
+
+	copy = papi_malloc( words * sizeof ( uint64_t ) );
+	if ( copy == NULL ) {
+		return;
+	}
+	memcpy( copy, key, words * sizeof ( uint64_t ) );
+
+	_papi_hwi_lock( COMPONENT_LOCK );
+	if ( entry->key != NULL ) {
+		papi_free( entry->key );
+	}
+	entry->hash = hash;
+	entry->result = result;
+	entry->words = words;
+	entry->key = copy;
+	_papi_hwi_unlock( COMPONENT_LOCK );
+}
+
+static void
+sched_cache_clear( void )
+{
+	int i;
+
+	_papi_hwi_lock( COMPONENT_LOCK );
+	for( i = 0; i < SCHED_CACHE_SIZE; i++ ) {
+		if ( sched_cache[i].key != NULL ) {
+			papi_free( sched_cache[i].key );
+		}
+	}
+	memset( sched_cache, 0, sizeof ( sched_cache ) );
+	_papi_hwi_unlock( COMPONENT_LOCK );
+}
+
+
 /* Do some extra work on a perf_event fd if we're doing sampling  */
 /* This mostly means setting up the mmap buffer.                  */
 static int
@@ -699,6 +824,8 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 {
 
 	int i, ret = PAPI_OK;
+	int sched = PAPI_ENOEVNT, key_words = 0;
+	uint64_t key[SCHED_KEY_WORDS], key_hash = 0;
 	long pid;
 
 
@@ -720,6 +847,20 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 		}
 	}
 
+	/* This is not necessary if we are multiplexing, and in fact */
+	/* we cannot do this properly if multiplexed because         */
+	/* PERF_EVENT_IOC_RESET does not reset the time running info */
+	if (!ctl->multiplexed) {
+		key_words = sched_cache_key( ctl, pid, key, &key_hash );
+		if (key_words) {
+			sched = sched_cache_lookup( key, key_words, key_hash );
+		}
+		if (sched == PAPI_ECNFLCT) {
+			SUBDBG("EXIT: group of %d events known not to schedule\n", ctl->num_events);
+			return PAPI_ECNFLCT;
+		}
+	}
+
 	for( i = 0; i < ctl->num_events; i++ ) {
 
 		ctl->events[i].event_opened=0;
@@ -809,12 +950,17 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 		/* yet things will fail later.  So we need to double check    */
 		/* we actually can use the events we've set up.               */
 
-		/* This is not necessary if we are multiplexing, and in fact */
-		/* we cannot do this properly if multiplexed because         */
-		/* PERF_EVENT_IOC_RESET does not reset the time running info */
-		if (!ctl->multiplexed) {
+		/* All of the events are in the group of the first one, so   */
+		/* it is enough to check the whole group once it is opened,  */
+		/* and not at all if it is known to schedule.                */
+		if ((!ctl->multiplexed) && (sched != PAPI_OK) &&
+			(i == ctl->num_events - 1)) {
 			ret = check_scheduability( ctx, ctl, i );
 
+			if (key_words && ((ret == PAPI_OK) || (ret == PAPI_ECNFLCT))) {
+				sched_cache_insert( key, key_words, key_hash, ret );
+			}
+
 			if ( ret != PAPI_OK ) {
 				/* the last event did open, so we need to    */
 				/* bump the counter before doing the cleanup */
@@ -886,6 +1032,7 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 
 	/* Set num_evts only if completely successful */
 	ctx->state |= PERF_EVENTS_OPENED;
+	__atomic_add_fetch( &pe_open_events, ctl->num_events, __ATOMIC_RELAXED );
 
 	return PAPI_OK;
 
@@ -938,6 +1085,17 @@ close_event( pe_event_info_t *event )
 	return 0;
 }
 
+/* Clear the PAPI_fastread_bind() binding of an EventSet, if any, */
+/* before its counters stop or its pages go away.                 */
+static void
+clear_fastread( pe_control_t *pe_ctl )
+{
+	if ( pe_ctl->fastread != NULL ) {
+		pe_ctl->fastread->num_events = 0;
+		pe_ctl->fastread = NULL;
+	}
+}
+
 /* Close all of the opened events */
 static int
 close_pe_events( pe_context_t *ctx, pe_control_t *ctl )
@@ -951,6 +1109,8 @@ close_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 		SUBDBG("Closing without stopping first\n");
 	}
 
+	clear_fastread( ctl );
+
 	/* Close child events first */
 	/* Is that necessary? -- vmw */
 	for( i=0; i<ctl->num_events; i++ ) {
@@ -989,6 +1149,7 @@ close_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 	ctl->num_events=0;
 
 	ctx->state &= ~PERF_EVENTS_OPENED;
+	__atomic_sub_fetch( &pe_open_events, num_closed, __ATOMIC_RELAXED );
 
 	return PAPI_OK;
 }
@@ -1390,6 +1551,90 @@ _pe_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 	return PAPI_OK;
 }
 
+/* Hand out the mmap control pages of a running EventSet so that */
+/* PAPI_fastread() in papi_fastread.h can rdpmc them inline.       */
+/* Only the cases _pe_read() would service with _pe_rdpmc_read()  */
+/* and that need no multiplex scaling are accepted.               */
+int
+PAPI_fastread_bind( int EventSet, PAPI_fastread_t *fr )
+{
+	EventSetInfo_t *ESI;
+	pe_control_t *pe_ctl;
+	int i, pos;
+
+	if ( fr == NULL ) return PAPI_EINVAL;
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL ) return PAPI_ENOEVST;
+
+	if ( ESI->CmpIdx != our_cidx ) return PAPI_ECMP;
+
+	if ( !( ESI->state & PAPI_RUNNING ) ) return PAPI_ENOTRUN;
+
+	if ( ESI->NumberOfEvents > PAPI_FASTREAD_MAX_EVENTS ) return PAPI_ECNFLCT;
+
+	pe_ctl = ( pe_control_t * ) ESI->ctl_state;
+
+	if ( ( !_perf_event_vector.cmp_info.fast_counter_read ) ||
+		( pe_ctl->inherit ) ||
+		( pe_ctl->attached ) ||
+		( pe_ctl->granularity != PAPI_GRN_THR ) ) {
+		return PAPI_ENOSUPP;
+	}
+
+	if ( ( pe_ctl->multiplexed ) || ( _papi_hwi_is_sw_multiplex( ESI ) ) ) {
+		return PAPI_ECNFLCT;
+	}
+
+	for ( i = 0; i < ESI->NumberOfEvents; i++ ) {
+		if ( ESI->EventInfoArray[i].derived != NOT_DERIVED ) {
+			return PAPI_ECNFLCT;
+		}
+		pos = ESI->EventInfoArray[i].pos[0];
+		if ( ( pos < 0 ) || ( pe_ctl->events[pos].mmap_buf == NULL ) ) {
+			return PAPI_ENOSUPP;
+		}
+		fr->page[i] = pe_ctl->events[pos].mmap_buf;
+		fr->reset_count[i] = &pe_ctl->reset_counts[pos];
+	}
+
+	/* only one binding per EventSet is kept up to date */
+	if ( pe_ctl->fastread != fr ) {
+		clear_fastread( pe_ctl );
+	}
+
+	fr->EventSet = EventSet;
+	fr->num_events = ESI->NumberOfEvents;
+	fr->reset_flag = &pe_ctl->reset_flag;
+	pe_ctl->fastread = fr;
+
+	return PAPI_OK;
+}
+
+/* Forget a binding, so that PAPI no longer clears it when the */
+/* EventSet is stopped.                                        */
+int
+PAPI_fastread_unbind( PAPI_fastread_t *fr )
+{
+	EventSetInfo_t *ESI;
+	pe_control_t *pe_ctl;
+
+	if ( fr == NULL ) return PAPI_EINVAL;
+
+	if ( fr->num_events != 0 ) {
+		ESI = _papi_hwi_lookup_EventSet( fr->EventSet );
+		if ( ( ESI != NULL ) && ( ESI->CmpIdx == our_cidx ) ) {
+			pe_ctl = ( pe_control_t * ) ESI->ctl_state;
+			if ( pe_ctl->fastread == fr ) {
+				pe_ctl->fastread = NULL;
+			}
+		}
+		fr->num_events = 0;
+	}
+
+	return PAPI_OK;
+}
+
 #if (OBSOLETE_WORKAROUNDS==1)
 /* On kernels before 2.6.33 the TOTAL_TIME_ENABLED and TOTAL_TIME_RUNNING */
 /* fields are always 0 unless the counter is disabled.  So if we are on   */
@@ -1509,6 +1754,8 @@ _pe_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 	pe_context_t *pe_ctx = ( pe_context_t *) ctx;
 	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
 
+	clear_fastread( pe_ctl );
+
 	/* Just disable the group leaders */
 	for ( i = 0; i < pe_ctl->num_events; i++ ) {
 		if ( pe_ctl->events[i].group_leader_fd == -1 ) {
@@ -1551,8 +1798,8 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 	int i;
 	int j;
 	int ret;
+	int num_native;
 	int skipped_events=0;
-	struct native_event_t *ntv_evt;
 	pe_context_t *pe_ctx = ( pe_context_t *) ctx;
 	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
 
@@ -1568,6 +1815,10 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 		return PAPI_OK;
 	}
 
+	/* other threads can add events, read the count once */
+	num_native = __atomic_load_n( &pe_ctx->event_table->num_native_events,
+				      __ATOMIC_ACQUIRE );
+
 	/* set up all the events */
 	for( i = 0; i < count; i++ ) {
 		if ( native ) {
@@ -1580,33 +1831,32 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 			/* if native index is -1, then we have an event without a mask and need to find the right native index to use */
 			if (ntv_idx == -1) {
 				/* find the native event index we want by matching for the right papi event code */
-				for (j=0 ; j<pe_ctx->event_table->num_native_events ; j++) {
-					if (pe_ctx->event_table->native_events[j].papi_event_code == native[i].ni_papi_code) {
+				for (j=0 ; j<num_native ; j++) {
+					if (NATIVE_EVENT_FIELD(pe_ctx->event_table, papi_event_code, j) == native[i].ni_papi_code) {
 						ntv_idx = j;
 					}
 				}
 			}
 
 			/* if native index is still negative, we did not find event we wanted so just return error */
-			if (ntv_idx < 0) {
+			if ((ntv_idx < 0) || (ntv_idx >= num_native)) {
 				SUBDBG("papi_event_code: %#x not found in native event tables\n", native[i].ni_papi_code);
 				continue;
 			}
 
 			/* this native index is positive so there was a mask with the event, the ntv_idx identifies which native event to use */
-			ntv_evt = (struct native_event_t *)(&(pe_ctx->event_table->native_events[ntv_idx]));
-			SUBDBG("ntv_evt: %p\n", ntv_evt);
+			SUBDBG("ntv_idx: %d\n", ntv_idx);
 
-			SUBDBG("i: %d, pe_ctx->event_table->num_native_events: %d\n", i, pe_ctx->event_table->num_native_events);
+			SUBDBG("i: %d, pe_ctx->event_table->num_native_events: %d\n", i, num_native);
 
 			/* Move this events hardware config values and other attributes to the perf_events attribute structure */
-			memcpy (&pe_ctl->events[i].attr, &ntv_evt->attr, sizeof(perf_event_attr_t));
+			memcpy (&pe_ctl->events[i].attr, &NATIVE_EVENT_FIELD(pe_ctx->event_table, attr, ntv_idx), sizeof(perf_event_attr_t));
 
 			/* may need to update the attribute structure with information from event set level domain settings (values set by PAPI_set_domain) */
 			/* only done if the event mask which controls each counting domain was not provided */
 
 			/* get pointer to allocated name, will be NULL when adding preset events to event set */
-			char *aName = ntv_evt->allocated_name;
+			const char *aName = native_event_string(pe_ctx->event_table, NATIVE_EVENT_FIELD(pe_ctx->event_table, allocated_name, ntv_idx));
 			if ((aName == NULL)  ||  (strstr(aName, ":u=") == NULL)) {
 				SUBDBG("set exclude_user attribute from eventset level domain flags, encode: %d, eventset: %d\n", pe_ctl->events[i].attr.exclude_user, !(pe_ctl->domain & PAPI_DOM_USER));
 				pe_ctl->events[i].attr.exclude_user = !(pe_ctl->domain & PAPI_DOM_USER);
@@ -1629,7 +1879,7 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 
 
 			// set the cpu number provided with an event mask if there was one (will be -1 if mask not provided)
-			pe_ctl->events[i].cpu = ntv_evt->cpu;
+			pe_ctl->events[i].cpu = NATIVE_EVENT_FIELD(pe_ctx->event_table, cpu, ntv_idx);
 			// if cpu event mask not provided, then set the cpu to use to what may have been set on call to PAPI_set_opt (will still be -1 if not called)
 			if (pe_ctl->events[i].cpu == -1) {
 				pe_ctl->events[i].cpu = pe_ctl->cpu;
@@ -2325,6 +2575,9 @@ _pe_set_profile( EventSetInfo_t *ESI, int EventIndex, int threshold )
 static int
 _pe_shutdown_component( void ) {
 
+	/* forget which groups schedule */
+	sched_cache_clear();
+
 	/* deallocate our event table */
 	_pe_libpfm4_shutdown(&_perf_event_vector, &perf_native_event_table);
 
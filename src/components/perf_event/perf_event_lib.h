@@ -18,6 +18,7 @@ typedef struct
   uint64_t tail;                  /* current read location in mmap buffer */
   uint64_t mask;                  /* mask used for wrapping the pages     */
   int cpu;                        /* cpu associated with this event       */
+  int position;                   /* counts[] slot this fd is summed into */
   struct perf_event_attr attr;    /* perf_event config structure          */
 } pe_event_info_t;
 
@@ -34,10 +35,13 @@ typedef struct {
   int cidx;                       /* current component                 */
   int cpu;                        /* which cpu to measure              */
   pid_t tid;                      /* thread we are monitoring          */
+  int num_cpus;                   /* cpus in the PAPI_CPU_MASK, or 0   */
+  unsigned int *cpus;             /* PAPI_CPU_MASK, owned by the ESI   */
   pe_event_info_t events[PERF_EVENT_MAX_MPX_COUNTERS];
   long long counts[PERF_EVENT_MAX_MPX_COUNTERS];
   unsigned int reset_flag;
   long long reset_counts[PERF_EVENT_MAX_MPX_COUNTERS];
+  struct _papi_fastread *fastread; /* binding from PAPI_fastread_bind */
 } pe_control_t;
 
 
@@ -0,0 +1,93 @@
+/*
+ * This tests reading a running EventSet inline through
+ * PAPI_fastread_bind() / PAPI_fastread() from papi_fastread.h
+ * and compares the result with PAPI_read().  The binding must be
+ * cleared once the EventSet is stopped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "papi.h"
+#include "papi_test.h"
+#include "papi_fastread.h"
+
+#include "do_loops.h"
+
+int main( int argc, char **argv ) {
+
+	int retval, i, num_events, mask, PAPI_event;
+	int EventSet = PAPI_NULL;
+	long long fast[2], slow[2], stopped[2];
+	PAPI_fastread_t fr;
+	int quiet;
+
+	/* Set TESTS_QUIET variable */
+	quiet=tests_quiet( argc, argv );
+
+	/* Init the PAPI library */
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	EventSet = add_two_events( &num_events, &PAPI_event, &mask );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	retval = PAPI_fastread_bind( EventSet, &fr );
+	if ( retval == PAPI_ENOSUPP ) {
+		if (!quiet) printf("rdpmc reads not available\n");
+		test_skip( __FILE__, __LINE__, "PAPI_fastread_bind", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_fastread_bind", retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_fastread( &fr, fast );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_fastread", retval );
+	}
+
+	retval = PAPI_read( EventSet, slow );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+	}
+
+	retval = PAPI_stop( EventSet, stopped );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	/* stopping clears the binding */
+	retval = PAPI_fastread( &fr, fast );
+	if ( retval != PAPI_ENOTRUN ) {
+		test_fail( __FILE__, __LINE__, "PAPI_fastread after stop", retval );
+	}
+
+	if (!quiet) {
+		printf("\t%12s %12s %12s\n", "fastread", "read", "stop");
+		for ( i = 0; i < num_events; i++ ) {
+			printf("\t%12lld %12lld %12lld\n",
+				fast[i], slow[i], stopped[i]);
+		}
+	}
+
+	for ( i = 0; i < num_events; i++ ) {
+		if ( fast[i] <= 0 ) {
+			test_fail( __FILE__, __LINE__, "PAPI_fastread zero count", 1 );
+		}
+		if ( ( slow[i] < fast[i] ) || ( stopped[i] < slow[i] ) ) {
+			test_fail( __FILE__, __LINE__, "PAPI_fastread ordering", 1 );
+		}
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
@@ -309,6 +310,7 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 {
 
    int i, ret = PAPI_OK;
+   int grouped, leader;
    long pid;
 
    if (ctl->granularity==PAPI_GRN_SYS) {
@@ -318,6 +320,14 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
       pid = ctl->tid;
    }
 
+   /* Events of one PMU box on one cpu are put in a group, so that   */
+   /* _peu_read() gets all of their counts with a single read() of   */
+   /* the leader.  The kernel only accepts groups of events from the */
+   /* same PMU; sort_pmu_groups() placed them next to each other.    */
+   /* If we're multiplexed or inherit, everyone is a group leader.   */
+   grouped = !ctl->multiplexed && !ctl->inherit;
+   leader = -1;
+
    for( i = 0; i < ctl->num_events; i++ ) {
 
       ctl->events[i].event_opened=0;
@@ -325,63 +335,55 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
       /* set up the attr structure.  We don't set up all fields here */
       /* as some have already been set up previously.                */
 
-/*
- * The following code controls how the uncore component interfaces with the 
- * kernel for uncore events.  The code inside the ifdef will use grouping of 
- * uncore events which can make the cost of reading the results more efficient.
- * The problem with it is that the uncore component supports 20 different uncore 
- * PMU's.  The kernel requires that all events in a group must be for the same PMU.
- * This means that with grouping enabled papi applications can count events on only
- * one of the 20 PMU's during a run.
- * 
- * The code inside the else clause treats each event in the event set as 
- * independent.  When running in this mode the kernel allows the papi multiple 
- * uncore PMU's at the same time.
- * 
- * Example:
- *  An application wants to measure all the L3 cache write requests.
- *  The event to do this is part of a cbox pmu (there are 8 cbox pmu's).
- *  When built with the code in the ifdef, the application would have to be 
- *    run 8 times and count write requests from one pmu at a time.
- *  When built with the code in the else, the write requests in all 8 cbox 
- *    pmu's could be counted in the same run.
- * 
- */
-// #define GROUPIT 1       // remove the comment on this line to force event grouping
-#ifdef GROUPIT
-      /* group leader (event 0) is special                */
-      /* If we're multiplexed, everyone is a group leader */
-      if (( i == 0 ) || (ctl->multiplexed)) {
-         ctl->events[i].attr.pinned = !ctl->multiplexed;
-	 ctl->events[i].attr.disabled = 1;
-	 ctl->events[i].group_leader_fd=-1;
-         ctl->events[i].attr.read_format = get_read_format(ctl->multiplexed,
-							   ctl->inherit,
-							   !ctl->multiplexed );
-      } else {
+      if ( grouped && ( leader >= 0 ) &&
+	   ( ctl->events[i].attr.type == ctl->events[leader].attr.type ) &&
+	   ( ctl->events[i].cpu == ctl->events[leader].cpu ) ) {
 	 ctl->events[i].attr.pinned=0;
 	 ctl->events[i].attr.disabled = 0;
-	 ctl->events[i].group_leader_fd=ctl->events[0].event_fd,
+	 ctl->events[i].group_leader_fd=ctl->events[leader].event_fd;
          ctl->events[i].attr.read_format = get_read_format(ctl->multiplexed,
 							   ctl->inherit,
 							   0 );
-      }
-#else
-             ctl->events[i].attr.pinned = !ctl->multiplexed;
-         	 ctl->events[i].attr.disabled = 1;
-         	 ctl->inherit = 1;
-         	 ctl->events[i].group_leader_fd=-1;
-             ctl->events[i].attr.read_format = get_read_format(ctl->multiplexed, ctl->inherit, 0 );
-#endif
 
+	 ctl->events[i].event_fd = sys_perf_event_open( &ctl->events[i].attr,
+						     pid,
+						     ctl->events[i].cpu,
+			       ctl->events[i].group_leader_fd,
+						     0 /* flags */
+						     );
+
+	 /* The box may not fit the whole group, start a new one */
+	 if ( ctl->events[i].event_fd == -1 ) {
+	    SUBDBG("could not add event #%d to group of #%d: %s\n",
+		   i, leader, strerror( errno ) );
+	    leader = -1;
+	 }
+      }
+      else {
+	 leader = -1;
+      }
 
-      /* try to open */
-      ctl->events[i].event_fd = sys_perf_event_open( &ctl->events[i].attr,
+      if ( leader == -1 ) {
+         ctl->events[i].attr.pinned = !ctl->multiplexed;
+	 ctl->events[i].attr.disabled = 1;
+	 ctl->events[i].group_leader_fd=-1;
+	 /* Group leaders always report enabled/running times */
+	 /* so that _peu_read() can scale the group's counts. */
+         ctl->events[i].attr.read_format = get_read_format( grouped ||
+							    ctl->multiplexed,
+							    ctl->inherit,
+							    grouped );
+
+	 ctl->events[i].event_fd = sys_perf_event_open( &ctl->events[i].attr,
 						     pid,
 						     ctl->events[i].cpu,
 			       ctl->events[i].group_leader_fd,
 						     0 /* flags */
 						     );
+	 if ( grouped ) {
+	    leader = i;
+	 }
+      }
 
       /* Try to match Linux errors to PAPI errors */
       if ( ctl->events[i].event_fd == -1 ) {
@@ -724,6 +726,62 @@ _peu_shutdown_component( void ) {
 	return PAPI_OK;
 }
 
+/* Open every event that has no cpu= mask of its own once on each cpu  */
+/* of the PAPI_CPU_MASK.  Copies of an event keep its position so the  */
+/* read routine sums them into one value.  Entries only ever move to   */
+/* higher indices, so we can expand in place working backwards.        */
+static int
+expand_cpu_mask( pe_control_t *pe_ctl, int count )
+{
+   int i, k, c, total = 0;
+
+   for( i = 0; i < count; i++ ) {
+      total += ( pe_ctl->events[i].cpu == -1 ) ? pe_ctl->num_cpus : 1;
+   }
+
+   if ( total > PERF_EVENT_MAX_MPX_COUNTERS ) {
+      SUBDBG("EXIT: %d events on %d cpus need %d counters\n",
+	     count, pe_ctl->num_cpus, total);
+      return PAPI_ECOUNT;
+   }
+
+   for( i = count - 1, c = total; i >= 0; i-- ) {
+      if ( pe_ctl->events[i].cpu != -1 ) {
+	 pe_ctl->events[--c] = pe_ctl->events[i];
+	 continue;
+      }
+      for( k = pe_ctl->num_cpus - 1; k >= 0; k-- ) {
+	 pe_ctl->events[--c] = pe_ctl->events[i];
+	 pe_ctl->events[c].cpu = ( int ) pe_ctl->cpus[k];
+      }
+   }
+
+   return total;
+}
+
+/* Move events of the same PMU box and cpu next to each other, keeping */
+/* their order otherwise, so open_pe_events() can group them.  Each     */
+/* event keeps its position, so the order PAPI sees does not change.   */
+static void
+sort_pmu_groups( pe_control_t *pe_ctl )
+{
+   pe_event_info_t tmp;
+   int i, j;
+
+   for( i = 1; i < pe_ctl->num_events; i++ ) {
+      for( j = i; j > 0; j-- ) {
+	 if ( ( pe_ctl->events[j-1].attr.type < pe_ctl->events[j].attr.type ) ||
+	      ( ( pe_ctl->events[j-1].attr.type == pe_ctl->events[j].attr.type ) &&
+		( pe_ctl->events[j-1].cpu <= pe_ctl->events[j].cpu ) ) ) {
+	    break;
+	 }
+	 tmp = pe_ctl->events[j-1];
+	 pe_ctl->events[j-1] = pe_ctl->events[j];
+	 pe_ctl->events[j] = tmp;
+      }
+   }
+}
+
 /* This function clears the current contents of the control structure and
    updates it with whatever resources are allocated for all the native events
    in the native info structure array. */
@@ -736,8 +794,8 @@ _peu_update_control_state( hwd_control_state_t *ctl,
 	int i;
 	int j;
 	int ret;
+	int num_native;
 	int skipped_events=0;
-	struct native_event_t *ntv_evt;
    pe_context_t *pe_ctx = ( pe_context_t *) ctx;
    pe_control_t *pe_ctl = ( pe_control_t *) ctl;
 
@@ -753,6 +811,10 @@ _peu_update_control_state( hwd_control_state_t *ctl,
       return PAPI_OK;
    }
 
+   /* other threads can add events, read the count once */
+   num_native = __atomic_load_n( &pe_ctx->event_table->num_native_events,
+                                 __ATOMIC_ACQUIRE );
+
    /* set up all the events */
    for( i = 0; i < count; i++ ) {
       if ( native ) {
@@ -765,34 +827,32 @@ _peu_update_control_state( hwd_control_state_t *ctl,
 			// if native index is -1, then we have an event without a mask and need to find the right native index to use
 			if (ntv_idx == -1) {
 				// find the native event index we want by matching for the right papi event code
-				for (j=0 ; j<pe_ctx->event_table->num_native_events ; j++) {
-					if (pe_ctx->event_table->native_events[j].papi_event_code == native[i].ni_papi_code) {
+				for (j=0 ; j<num_native ; j++) {
+					if (NATIVE_EVENT_FIELD(pe_ctx->event_table, papi_event_code, j) == native[i].ni_papi_code) {
 						ntv_idx = j;
 					}
 				}
 			}
 
 			// if native index is still negative, we did not find event we wanted so just return error
-			if (ntv_idx < 0) {
+			if ((ntv_idx < 0) || (ntv_idx >= num_native)) {
 				SUBDBG("papi_event_code: %#x not found in native event tables\n", native[i].ni_papi_code);
 				continue;
 			}
 
 			// this native index is positive so there was a mask with the event, the ntv_idx identifies which native event to use
-			ntv_evt = (struct native_event_t *)(&(pe_ctx->event_table->native_events[ntv_idx]));
+			SUBDBG("ntv_idx: %d\n", ntv_idx);
 
-			SUBDBG("ntv_evt: %p\n", ntv_evt);
-
-			SUBDBG("i: %d, pe_ctx->event_table->num_native_events: %d\n", i, pe_ctx->event_table->num_native_events);
+			SUBDBG("i: %d, pe_ctx->event_table->num_native_events: %d\n", i, num_native);
 
 	    	// Move this events hardware config values and other attributes to the perf_events attribute structure
-			memcpy (&pe_ctl->events[i].attr, &ntv_evt->attr, sizeof(perf_event_attr_t));
+			memcpy (&pe_ctl->events[i].attr, &NATIVE_EVENT_FIELD(pe_ctx->event_table, attr, ntv_idx), sizeof(perf_event_attr_t));
 
 			// may need to update the attribute structure with information from event set level domain settings (values set by PAPI_set_domain)
 			// only done if the event mask which controls each counting domain was not provided
 
 			// get pointer to allocated name, will be NULL when adding preset events to event set
-			char *aName = ntv_evt->allocated_name;
+			const char *aName = native_event_string(pe_ctx->event_table, NATIVE_EVENT_FIELD(pe_ctx->event_table, allocated_name, ntv_idx));
 			if ((aName == NULL)  ||  (strstr(aName, ":u=") == NULL)) {
 				SUBDBG("set exclude_user attribute from eventset level domain flags, encode: %d, eventset: %d\n", pe_ctl->events[i].attr.exclude_user, !(pe_ctl->domain & PAPI_DOM_USER));
 				pe_ctl->events[i].attr.exclude_user = !(pe_ctl->domain & PAPI_DOM_USER);
@@ -803,11 +863,13 @@ _peu_update_control_state( hwd_control_state_t *ctl,
 			}
 
 			// set the cpu number provided with an event mask if there was one (will be -1 if mask not provided)
-			pe_ctl->events[i].cpu = ntv_evt->cpu;
+			pe_ctl->events[i].cpu = NATIVE_EVENT_FIELD(pe_ctx->event_table, cpu, ntv_idx);
 			// if cpu event mask not provided, then set the cpu to use to what may have been set on call to PAPI_set_opt (will still be -1 if not called)
-			if (pe_ctl->events[i].cpu == -1) {
+			// with a PAPI_CPU_MASK it stays -1 and expand_cpu_mask() opens it on every cpu of the mask
+			if ((pe_ctl->events[i].cpu == -1) && (pe_ctl->num_cpus == 0)) {
 				pe_ctl->events[i].cpu = pe_ctl->cpu;
 			}
+			pe_ctl->events[i].position = i;
       } else {
     	  // This case happens when called from _pe_set_overflow and _pe_ctl
           // Those callers put things directly into the pe_ctl structure so it is already set for the open call
@@ -832,6 +894,19 @@ _peu_update_control_state( hwd_control_state_t *ctl,
 
   pe_ctl->num_events = count - skipped_events;
 
+   if ( native && pe_ctl->num_cpus ) {
+      ret = expand_cpu_mask( pe_ctl, pe_ctl->num_events );
+      if ( ret < 0 ) {
+         pe_ctl->num_events = 0;
+         return ret;
+      }
+      pe_ctl->num_events = ret;
+   }
+
+   if ( native ) {
+      sort_pmu_groups( pe_ctl );
+   }
+
    /* actuall open the events */
    /* (why is this a separate function?) */
    ret = open_pe_events( pe_ctx, pe_ctl );
@@ -943,13 +1018,17 @@ _peu_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     SUBDBG("ENTER: ctx: %p, ctl: %p, events: %p, flags: %#x\n", ctx, ctl, events, flags);
 
    ( void ) flags;			 /*unused */
-   int i, ret = -1;
+   int i, j, ret = -1;
    /* pe_context_t *pe_ctx = ( pe_context_t *) ctx; */ 
    (void) ctx; /*unused*/
    pe_control_t *pe_ctl = ( pe_control_t *) ctl;
    long long papi_pe_buffer[READ_BUFFER_SIZE];
    long long tot_time_running, tot_time_enabled, scale;
 
+   /* Events spread over a PAPI_CPU_MASK have one fd per cpu, */
+   /* all summed into the slot given by their position.       */
+   memset( pe_ctl->counts, 0, pe_ctl->num_events * sizeof ( long long ) );
+
    /* Handle case where we are multiplexing */
    if (pe_ctl->multiplexed) {
 
@@ -989,7 +1068,7 @@ _peu_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 
          if (tot_time_running == tot_time_enabled) {
 	    /* No scaling needed */
-	    pe_ctl->counts[i] = papi_pe_buffer[0];
+	    pe_ctl->counts[pe_ctl->events[i].position] += papi_pe_buffer[0];
          } else if (tot_time_running && tot_time_enabled) {
 	    /* Scale factor of 100 to avoid overflows when computing */
 	    /*enabled/running */
@@ -997,7 +1076,7 @@ _peu_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 	    scale = (tot_time_enabled * 100LL) / tot_time_running;
 	    scale = scale * papi_pe_buffer[0];
 	    scale = scale / 100LL;
-	    pe_ctl->counts[i] = scale;
+	    pe_ctl->counts[pe_ctl->events[i].position] += scale;
 	 } else {
 	   /* This should not happen, but Phil reports it sometime does. */
 	    SUBDBG("perf_event kernel bug(?) count, enabled, "
@@ -1005,7 +1084,7 @@ _peu_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 		   papi_pe_buffer[0],tot_time_enabled,
 		   tot_time_running);
 
-	    pe_ctl->counts[i] = papi_pe_buffer[0];
+	    pe_ctl->counts[pe_ctl->events[i].position] += papi_pe_buffer[0];
 	 }
       }
    }
@@ -1039,56 +1118,66 @@ _peu_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 		pe_ctl->events[i].cpu, ret);
          SUBDBG("read: %lld\n",papi_pe_buffer[0]);
 
-	 pe_ctl->counts[i] = papi_pe_buffer[0];
+	 pe_ctl->counts[pe_ctl->events[i].position] += papi_pe_buffer[0];
       }
    }
 
 
-   /* Handle cases where we are using FORMAT_GROUP   */
-   /* We assume only one group leader, in position 0 */
+   /* Handle cases where we are using FORMAT_GROUP                */
+   /* open_pe_events() put each group's members right after their */
+   /* leader, so one read() per PMU box fills consecutive events. */
 
    else {
-      if (pe_ctl->events[0].group_leader_fd!=-1) {
-	 PAPIERROR("Was expecting group leader!\n");
-      }
+      for ( i = 0; i < pe_ctl->num_events; i += (int) papi_pe_buffer[0] ) {
 
-      ret = read( pe_ctl->events[0].event_fd, papi_pe_buffer,
-		  sizeof ( papi_pe_buffer ) );
+	 if (pe_ctl->events[i].group_leader_fd!=-1) {
+	    PAPIERROR("Was expecting group leader!\n");
+	    SUBDBG("EXIT: PAPI_EBUG\n");
+	    return PAPI_EBUG;
+	 }
 
-      if ( ret == -1 ) {
-	 PAPIERROR("read returned an error: %s", strerror( errno ));
-       SUBDBG("EXIT: PAPI_ESYS\n");
-	 return PAPI_ESYS;
-      }
+	 ret = read( pe_ctl->events[i].event_fd, papi_pe_buffer,
+		     sizeof ( papi_pe_buffer ) );
 
-      /* we read 1 64-bit value (number of events) then     */
-      /* num_events more 64-bit values that hold the counts */
-      if (ret<(signed)((1+pe_ctl->num_events)*sizeof(long long))) {
-	 PAPIERROR("Error! short read!\n");
-       SUBDBG("EXIT: PAPI_ESYS\n");
-	 return PAPI_ESYS;
-      }
+	 if ( ret == -1 ) {
+	    PAPIERROR("read returned an error: %s", strerror( errno ));
+	    SUBDBG("EXIT: PAPI_ESYS\n");
+	    return PAPI_ESYS;
+	 }
 
-      SUBDBG("read: fd: %2d, tid: %ld, cpu: %d, ret: %d\n",
-	     pe_ctl->events[0].event_fd,
-	     (long)pe_ctl->tid, pe_ctl->events[0].cpu, ret);
-      {
-	 int j;
-	 for(j=0;j<ret/8;j++) {
-            SUBDBG("read %d: %lld\n",j,papi_pe_buffer[j]);
+	 /* we read 1 64-bit value (number of events), the enabled */
+	 /* and running times, then that many 64-bit counts        */
+	 if ( ( ret < (signed)(3*sizeof(long long)) ) ||
+	      ( papi_pe_buffer[0] < 1 ) ||
+	      ( i + papi_pe_buffer[0] > pe_ctl->num_events ) ||
+	      ( ret < (signed)((3+papi_pe_buffer[0])*sizeof(long long)) ) ) {
+	    PAPIERROR("Error! short read!\n");
+	    SUBDBG("EXIT: PAPI_ESYS\n");
+	    return PAPI_ESYS;
 	 }
-      }
 
-      /* Make sure the kernel agrees with how many events we have */
-      if (papi_pe_buffer[0]!=pe_ctl->num_events) {
-	 PAPIERROR("Error!  Wrong number of events!\n");
-       SUBDBG("EXIT: PAPI_ESYS\n");
-	 return PAPI_ESYS;
-      }
+	 SUBDBG("read: fd: %2d, tid: %ld, cpu: %d, ret: %d, nr: %lld\n",
+		pe_ctl->events[i].event_fd,
+		(long)pe_ctl->tid, pe_ctl->events[i].cpu, ret,
+		papi_pe_buffer[0]);
+
+	 tot_time_enabled = papi_pe_buffer[1];
+	 tot_time_running = papi_pe_buffer[2];
 
-      /* put the count values in their proper location */
-      for(i=0;i<pe_ctl->num_events;i++) {
-         pe_ctl->counts[i] = papi_pe_buffer[1+i];
+	 for ( j = 0; j < papi_pe_buffer[0]; j++ ) {
+	    if ( ( tot_time_running == tot_time_enabled ) ||
+		 !tot_time_running || !tot_time_enabled ) {
+	       /* No scaling needed (or possible) */
+	       scale = papi_pe_buffer[3+j];
+	    } else {
+	       /* Scale factor of 100 to avoid overflows when computing */
+	       /*enabled/running */
+	       scale = (tot_time_enabled * 100LL) / tot_time_running;
+	       scale = scale * papi_pe_buffer[3+j];
+	       scale = scale / 100LL;
+	    }
+	    pe_ctl->counts[pe_ctl->events[i+j].position] += scale;
+	 }
       }
    }
 
@@ -1171,11 +1260,33 @@ _peu_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
    return PAPI_OK;
 }
 
+/* A cpu without an online file can not be taken offline */
+static int
+cpu_online( unsigned int cpu )
+{
+   char path[64];
+   FILE *fff;
+   int online = 0;
+
+   snprintf( path, sizeof ( path ), "/sys/devices/system/cpu/cpu%u/online", cpu );
+   fff = fopen( path, "r" );
+   if ( fff == NULL ) {
+      snprintf( path, sizeof ( path ), "/sys/devices/system/cpu/cpu%u", cpu );
+      return ( access( path, F_OK ) == 0 );
+   }
+   if ( fscanf( fff, "%d", &online ) != 1 ) {
+      online = 0;
+   }
+   fclose( fff );
+
+   return online;
+}
+
 /* Set various options on a control state */
 static int
 _peu_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 {
-   int ret;
+   int ret, i;
    pe_context_t *pe_ctx = ( pe_context_t *) ctx;
    pe_control_t *pe_ctl = NULL;
 
@@ -1218,6 +1329,27 @@ _peu_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 	   pe_ctl->tid = -1;
 
 	   pe_ctl->cpu = option->cpu.cpu_num;
+	   pe_ctl->num_cpus = 0;
+	   pe_ctl->cpus = NULL;
+
+	   return PAPI_OK;
+
+      case PAPI_CPU_MASK:
+	   pe_ctl = ( pe_control_t *) ( option->cpu_mask.ESI->ctl_state );
+
+	   for ( i = 0; i < option->cpu_mask.num_cpus; i++ ) {
+	      if ( !cpu_online( option->cpu_mask.cpus[i] ) ) {
+	         SUBDBG("EXIT: cpu %u is offline\n", option->cpu_mask.cpus[i]);
+	         return PAPI_EINVAL;
+	      }
+	   }
+
+	   /* Same as PAPI_CPU_ATTACH, but events are opened on every cpu */
+	   /* of the mask the next time the control state is updated.     */
+	   pe_ctl->tid = -1;
+	   pe_ctl->cpu = option->cpu_mask.cpus[0];
+	   pe_ctl->num_cpus = option->cpu_mask.num_cpus;
+	   pe_ctl->cpus = option->cpu_mask.cpus;
 
 	   return PAPI_OK;
 
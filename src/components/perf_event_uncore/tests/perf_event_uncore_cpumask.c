@@ -0,0 +1,241 @@
+/*
+ * This file tests counting an uncore event on one cpu of every
+ * package with a single EventSet, using PAPI_CPU_MASK, next to
+ * the same event counted on the package of cpu 0 only.  A mask
+ * with a cpu that does not exist, or a cpu given twice, is refused.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#include "perf_event_uncore_lib.h"
+
+#define MAX_PACKAGES 64
+
+/* Return one cpu of each package, lowest numbered first */
+static int
+get_package_cpus( unsigned int *cpus, int max )
+{
+	int packages[MAX_PACKAGES];
+	int num = 0, cpu, i, package;
+	char filename[BUFSIZ];
+	FILE *fff;
+
+	for ( cpu = 0; num < max; cpu++ ) {
+		sprintf( filename,
+			"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+			cpu );
+		fff = fopen( filename, "r" );
+		if ( fff == NULL ) break;
+		if ( fscanf( fff, "%d", &package ) != 1 ) package = -1;
+		fclose( fff );
+
+		for ( i = 0; i < num; i++ ) {
+			if ( packages[i] == package ) break;
+		}
+		if ( i == num ) {
+			packages[num] = package;
+			cpus[num++] = cpu;
+		}
+	}
+
+	return num;
+}
+
+static int
+setup_eventset( int *EventSet, int cidx, int option, PAPI_option_t *opt,
+		const char *event, int quiet )
+{
+	PAPI_granularity_option_t gran_opt;
+	PAPI_domain_option_t domain_opt;
+	int retval;
+
+	retval = PAPI_create_eventset( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_assign_eventset_component( *EventSet, cidx );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_assign_eventset_component", retval );
+	}
+
+	if ( option == PAPI_CPU_MASK ) {
+		opt->cpu_mask.eventset = *EventSet;
+	} else {
+		opt->cpu.eventset = *EventSet;
+	}
+	retval = PAPI_set_opt( option, opt );
+	if ( retval != PAPI_OK ) {
+		if ( !quiet ) {
+			printf( "Could not attach to the cpus\n" );
+		}
+		test_skip( __FILE__, __LINE__,
+			"this test; trying to attach to cpus; need to run as root",
+			retval );
+	}
+
+	gran_opt.def_cidx = 0;
+	gran_opt.eventset = *EventSet;
+	gran_opt.granularity = PAPI_GRN_SYS;
+	retval = PAPI_set_opt( PAPI_GRANUL, ( PAPI_option_t * ) &gran_opt );
+	if ( retval != PAPI_OK ) {
+		test_skip( __FILE__, __LINE__,
+			"this test; trying to set PAPI_GRN_SYS", retval );
+	}
+
+	domain_opt.def_cidx = 0;
+	domain_opt.eventset = *EventSet;
+	domain_opt.domain = PAPI_DOM_ALL;
+	retval = PAPI_set_opt( PAPI_DOMAIN, ( PAPI_option_t * ) &domain_opt );
+	if ( retval != PAPI_OK ) {
+		test_skip( __FILE__, __LINE__,
+			"this test; trying to set PAPI_DOM_ALL; need to run as root",
+			retval );
+	}
+
+	retval = PAPI_add_named_event( *EventSet, event );
+	if ( retval != PAPI_OK ) {
+		if ( !quiet ) {
+			printf( "Error trying to use event %s\n", event );
+		}
+		test_fail( __FILE__, __LINE__, "adding uncore event ", retval );
+	}
+
+	return PAPI_OK;
+}
+
+int main( int argc, char **argv ) {
+
+	int retval, quiet, num_cpus, i;
+	int EventSet = PAPI_NULL;
+	int EventSet2 = PAPI_NULL;
+	long long values[1], values2[1];
+	char *uncore_event = NULL;
+	char event_name[BUFSIZ];
+	unsigned int cpus[MAX_PACKAGES], bad[2];
+	int uncore_cidx = -1;
+	const PAPI_component_info_t *info;
+	const PAPI_hw_info_t *hwinfo;
+	PAPI_option_t opt, bad_opt;
+
+	/* Set TESTS_QUIET variable */
+	quiet = tests_quiet( argc, argv );
+
+	/* Init the PAPI library */
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	/* Find the uncore PMU */
+	uncore_cidx = PAPI_get_component_index( "perf_event_uncore" );
+	if ( uncore_cidx < 0 ) {
+		if ( !quiet ) {
+			printf( "perf_event_uncore component not found\n" );
+		}
+		test_skip( __FILE__, __LINE__, "perf_event_uncore component not found", 0 );
+	}
+
+	/* Check if component disabled */
+	info = PAPI_get_component_info( uncore_cidx );
+	if ( info->disabled ) {
+		if ( !quiet ) {
+			printf( "perf_event_uncore component disabled\n" );
+		}
+		test_skip( __FILE__, __LINE__, "uncore component disabled", 0 );
+	}
+
+	/* Get a relevant event name */
+	uncore_event = get_uncore_event( event_name, BUFSIZ );
+	if ( uncore_event == NULL ) {
+		if ( !quiet ) {
+			printf( "Could not find an uncore event for this processor\n" );
+		}
+		test_skip( __FILE__, __LINE__,
+			"PAPI does not support uncore on this processor",
+			PAPI_ENOSUPP );
+	}
+
+	num_cpus = get_package_cpus( cpus, MAX_PACKAGES );
+	if ( num_cpus < 1 ) {
+		test_skip( __FILE__, __LINE__, "cannot read cpu topology", 0 );
+	}
+
+	/* One EventSet spread over every package */
+	opt.cpu_mask.num_cpus = num_cpus;
+	opt.cpu_mask.cpus = cpus;
+	setup_eventset( &EventSet, uncore_cidx, PAPI_CPU_MASK, &opt,
+		uncore_event, quiet );
+
+	/* These are refused and leave the mask of the EventSet alone */
+	hwinfo = PAPI_get_hardware_info(  );
+	if ( hwinfo == NULL ) {
+		test_fail( __FILE__, __LINE__, "PAPI_get_hardware_info", 0 );
+	}
+	bad_opt.cpu_mask.eventset = EventSet;
+	bad_opt.cpu_mask.num_cpus = 2;
+	bad_opt.cpu_mask.cpus = bad;
+
+	bad[0] = cpus[0];
+	bad[1] = ( unsigned int ) hwinfo->totalcpus;
+	retval = PAPI_set_opt( PAPI_CPU_MASK, &bad_opt );
+	if ( retval != PAPI_EINVAL ) {
+		test_fail( __FILE__, __LINE__, "PAPI_CPU_MASK with no such cpu", retval );
+	}
+
+	bad[1] = cpus[0];
+	retval = PAPI_set_opt( PAPI_CPU_MASK, &bad_opt );
+	if ( retval != PAPI_EINVAL ) {
+		test_fail( __FILE__, __LINE__, "PAPI_CPU_MASK with a cpu twice", retval );
+	}
+
+	/* One EventSet on the package of cpu 0 */
+	opt.cpu.cpu_num = cpus[0];
+	setup_eventset( &EventSet2, uncore_cidx, PAPI_CPU_ATTACH, &opt,
+		uncore_event, quiet );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	/* Only one EventSet per component may run, so measure in turn */
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	retval = PAPI_start( EventSet2 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet2, values2 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "Uncore event on every package test:\n" );
+		printf( "Using uncore event %s on cpus", uncore_event );
+		for ( i = 0; i < num_cpus; i++ ) {
+			printf( " %u", cpus[i] );
+		}
+		printf( "\n\tall packages: %lld\n", values[0] );
+		printf( "\tcpu %u package: %lld\n", cpus[0], values2[0] );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -42,6 +42,7 @@ typedef struct _powercap_native_event_entry {
   int event_id;
   int type;
   int return_type;
+  long long max_energy_range;      /* wrap point of an energy counter */
   _powercap_register_t resources;
 } _powercap_native_event_entry_t;
 
@@ -49,11 +50,11 @@ typedef struct _powercap_reg_alloc {
     _powercap_register_t ra_bits;
 } _powercap_reg_alloc_t;
 
-static char read_buff[PAPI_MAX_STR_LEN];
-static char write_buff[PAPI_MAX_STR_LEN];
+/* Longest value read from a counter file, "18446744073709551615\n" */
+#define POWERCAP_VALUE_LEN 32
 
-static long long max_pkg_energy_count;
-static long long max_component_energy_count;
+/* Directory holding the intel-rapl zones, PAPI_POWERCAP_SYSFS_DIR */
+static char sysfs_dir[PAPI_MAX_STR_LEN] = "/sys/class/powercap";
 
 static int num_events=0;
 
@@ -97,16 +98,27 @@ static _powercap_native_event_entry_t powercap_ntv_events[(2 * (PKG_NUM_EVENTS +
 
 static int event_fds[POWERCAP_MAX_COUNTERS];
 
+// The energy_uj files wrap at max_energy_range_uj. Each EventSet keeps
+// the last raw value it read of every energy counter it has and folds
+// the difference into a 64-bit total, so a counter can wrap once
+// between any two reads and still count up. EventSets that read the
+// same zone keep separate totals.
+
 typedef struct _powercap_control_state {
   long long count[POWERCAP_MAX_COUNTERS];
   long long which_counter[POWERCAP_MAX_COUNTERS];
   long long need_difference[POWERCAP_MAX_COUNTERS];
+  long long last_value[POWERCAP_MAX_COUNTERS];   /* by position */
+  long long total_value[POWERCAP_MAX_COUNTERS];  /* by position */
   long long lastupdate;
   int active_counters;
 } _powercap_control_state_t;
 
+// The read buffers live in the context, so threads reading at the
+// same time do not share them.
+
 typedef struct _powercap_context {
-  long long start_value[POWERCAP_MAX_COUNTERS];
+  char read_buff[POWERCAP_MAX_COUNTERS][POWERCAP_VALUE_LEN];
   _powercap_control_state_t state;
 } _powercap_context_t;
 
@@ -131,22 +143,48 @@ static char * _local_strlcpy( char *dst, const char *src, size_t size )
   return( retval );
 }
 
-static long long read_powercap_value( int index )
+/* sysfs values are unsigned decimals followed by a newline */
+static long long parse_powercap_value( const char *buff, int len )
+{
+  long long value = 0;
+  int i;
+
+  for( i = 0; i < len && buff[i] >= '0' && buff[i] <= '9'; i++ ) {
+    value = value * 10 + ( buff[i] - '0' );
+  }
+  return value;
+}
+
+/* Issue the preads of every active counter, then parse them all */
+static void read_powercap_values( _powercap_context_t *context,
+                                  _powercap_control_state_t *control,
+                                  long long *values )
 {
-  int sz = pread(event_fds[index], read_buff, PAPI_MAX_STR_LEN, 0);
-  if (sz == -1) {
-    perror("Error in pread(): ");
-    return (long long) 0;
+  int len[POWERCAP_MAX_COUNTERS];
+  int c;
+
+  for( c = 0; c < control->active_counters; c++ ) {
+    len[c] = pread(event_fds[control->which_counter[c]],
+                   context->read_buff[c], POWERCAP_VALUE_LEN, 0);
   }
-  read_buff[sz] = '\0';
 
-  return atoll(read_buff);
+  for( c = 0; c < control->active_counters; c++ ) {
+    if (len[c] == -1) {
+      perror("Error in pread(): ");
+      values[c] = 0;
+      continue;
+    }
+    values[c] = parse_powercap_value(context->read_buff[c], len[c]);
+  }
 }
 
 static int write_powercap_value( int index, long long value )
 {
-  snprintf(write_buff, sizeof(write_buff), "%lld", value);
-  int sz = pwrite(event_fds[index], write_buff, PAPI_MAX_STR_LEN, 0);
+  char write_buff[POWERCAP_VALUE_LEN];
+  int len;
+
+  len = snprintf(write_buff, sizeof(write_buff), "%lld", value);
+  int sz = pwrite(event_fds[index], write_buff, len, 0);
   if(sz == -1) {
      perror("Error in pwrite(): ");
   }
@@ -174,9 +212,12 @@ static int _powercap_init_component( int cidx )
   int s = -1, e = -1, c = -1;
   long unsigned int strErr;
 
-  char events_dir[128];
-  char event_path[128];
-  char *strCpy;
+  char events_dir[PAPI_MAX_STR_LEN];
+  char event_path[PAPI_MAX_STR_LEN];
+  char read_buff[PAPI_MAX_STR_LEN];
+  char *strCpy, *env;
+  int zone_start, i;
+  long long zone_max;
 
   DIR *events;
 
@@ -184,6 +225,11 @@ static int _powercap_init_component( int cidx )
   const PAPI_hw_info_t *hw_info;
   hw_info=&( _papi_hwi_system_info.hw_info );
 
+  env = getenv("PAPI_POWERCAP_SYSFS_DIR");
+  if (env != NULL) {
+    _local_strlcpy(sysfs_dir, env, sizeof(sysfs_dir));
+  }
+
   // check if intel processor
   if ( hw_info->vendor!=PAPI_VENDOR_INTEL ) {
     strCpy=strncpy(_powercap_vector.cmp_info.disabled_reason, "Not an Intel processor", PAPI_MAX_STR_LEN);
@@ -202,7 +248,7 @@ static int _powercap_init_component( int cidx )
     // besides packages, such as "psys", that mess up the numbering, so we conduct an exhaustive search.
     int s_dir, found = 0;
     for(s_dir = 0; ; s_dir++) {
-      strErr=snprintf(event_path, sizeof(event_path), "/sys/class/powercap/intel-rapl:%d/%s", s_dir, pkg_sys_names[PKG_NAME]);
+      strErr=snprintf(event_path, sizeof(event_path), "%s/intel-rapl:%d/%s", sysfs_dir, s_dir, pkg_sys_names[PKG_NAME]);
       event_path[sizeof(event_path)-1]=0;
       if (strErr > sizeof(event_path)) HANDLE_STRING_ERROR;
 
@@ -210,7 +256,7 @@ static int _powercap_init_component( int cidx )
       event_fd = open(event_path, pkg_sys_flags[PKG_NAME]);
       if (event_fd == -1) { break; }
 
-      int sz = pread(event_fd, read_buff, PAPI_MAX_STR_LEN, 0);
+      int sz = pread(event_fd, read_buff, PAPI_MAX_STR_LEN-1, 0);
       if (sz == -1) HANDLE_STRING_ERROR;
       read_buff[sz] = '\0';
       close(event_fd);
@@ -223,7 +269,7 @@ static int _powercap_init_component( int cidx )
     if (!found) { continue; }
 
     // compose string of a pkg directory path
-    strErr=snprintf(events_dir, sizeof(events_dir), "/sys/class/powercap/intel-rapl:%d/", s_dir);
+    strErr=snprintf(events_dir, sizeof(events_dir), "%s/intel-rapl:%d/", sysfs_dir, s_dir);
     events_dir[sizeof(events_dir)-1]=0;
     if (strErr > sizeof(events_dir)) HANDLE_STRING_ERROR;
 
@@ -235,6 +281,8 @@ static int _powercap_init_component( int cidx )
     closedir(events);                                                // opendir has mallocs; so clean up.
 
     // loop through pkg events and create powercap event entries
+    zone_start = num_events;
+    zone_max = 0;
     for (e = 0; e < PKG_NUM_EVENTS; e++) {
 
       // compose string to individual event
@@ -258,7 +306,7 @@ static int _powercap_init_component( int cidx )
       event_fds[num_events] = open(event_path, O_SYNC|pkg_sys_flags[e]);
 
       if(powercap_ntv_events[num_events].type == PKG_NAME) {
-        int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN, 0);
+        int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN-1, 0);
         if (sz == -1) HANDLE_STRING_ERROR;
         read_buff[sz] = '\0';
         strErr=snprintf(powercap_ntv_events[num_events].description, sizeof(powercap_ntv_events[num_events].description), "%s", read_buff);
@@ -267,24 +315,30 @@ static int _powercap_init_component( int cidx )
       }
 
       if(powercap_ntv_events[num_events].type == PKG_MAX_ENERGY_RANGE) {
-        int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN, 0);
+        int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN-1, 0);
         if (sz == -1) HANDLE_STRING_ERROR;
         read_buff[sz] = '\0';
-        max_pkg_energy_count = atoll(read_buff);
+        zone_max = parse_powercap_value(read_buff, sz);
       }
 
       num_events++;
     }
 
+    for (i = zone_start; i < num_events; i++) {
+      if (powercap_ntv_events[i].type == PKG_ENERGY) powercap_ntv_events[i].max_energy_range = zone_max;
+    }
+
     // reset component count for each socket
     c = 0;
-    strErr=snprintf(events_dir, sizeof(events_dir), "/sys/class/powercap/intel-rapl:%d:%d/", s_dir, c);
+    strErr=snprintf(events_dir, sizeof(events_dir), "%s/intel-rapl:%d:%d/", sysfs_dir, s_dir, c);
     events_dir[sizeof(events_dir)-1]=0;
     if (strErr > sizeof(events_dir)) HANDLE_STRING_ERROR;
     while((events = opendir(events_dir)) != NULL) {
       closedir(events);                                                // opendir has mallocs; so clean up.
 
       // loop through pkg events and create powercap event entries
+      zone_start = num_events;
+      zone_max = 0;
       for (e = 0; e < COMPONENT_NUM_EVENTS; e++) {
 
         // compose string to individual event
@@ -308,7 +362,7 @@ static int _powercap_init_component( int cidx )
         event_fds[num_events] = open(event_path, O_SYNC|component_sys_flags[e]);
 
         if(powercap_ntv_events[num_events].type == COMPONENT_NAME) {
-          int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN, 0);
+          int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN-1, 0);
           if (sz == -1) HANDLE_STRING_ERROR;
           read_buff[sz] = '\0';
           strErr=snprintf(powercap_ntv_events[num_events].description, sizeof(powercap_ntv_events[num_events].description), "%s", read_buff);
@@ -317,20 +371,24 @@ static int _powercap_init_component( int cidx )
         }
 
         if(powercap_ntv_events[num_events].type == COMPONENT_MAX_ENERGY_RANGE) {
-          int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN, 0);
+          int sz = pread(event_fds[num_events], read_buff, PAPI_MAX_STR_LEN-1, 0);
           if (sz == -1) HANDLE_STRING_ERROR;
           read_buff[sz] = '\0';
-          max_component_energy_count = atoll(read_buff);
+          zone_max = parse_powercap_value(read_buff, sz);
         }
 
         num_events++;
       }
 
+      for (i = zone_start; i < num_events; i++) {
+        if (powercap_ntv_events[i].type == COMPONENT_ENERGY) powercap_ntv_events[i].max_energy_range = zone_max;
+      }
+
       // test for next component
       c++;
 
       // compose string of an pkg directory path
-      strErr=snprintf(events_dir, sizeof(events_dir), "/sys/class/powercap/intel-rapl:%d:%d/", s_dir, c);
+      strErr=snprintf(events_dir, sizeof(events_dir), "%s/intel-rapl:%d:%d/", sysfs_dir, s_dir, c);
       events_dir[sizeof(events_dir)-1]=0;
       if (strErr > sizeof(events_dir)) HANDLE_STRING_ERROR;
     }
@@ -376,11 +434,15 @@ static int _powercap_init_control_state( hwd_control_state_t *ctl )
 static int _powercap_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
     _powercap_context_t* context = ( _powercap_context_t* ) ctx;
-    (void) ctl;
+    _powercap_control_state_t* control = ( _powercap_control_state_t* ) ctl;
+    long long values[POWERCAP_MAX_COUNTERS];
+    int c;
 
-    int b;
-    for( b = 0; b < num_events; b++ ) {
-      context->start_value[b]=read_powercap_value(b);
+    read_powercap_values(context, control, values);
+
+    for( c = 0; c < control->active_counters; c++ ) {
+      control->last_value[c] = values[c];
+      control->total_value[c] = 0;
     }
 
     return PAPI_OK;
@@ -413,44 +475,36 @@ _powercap_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
   _powercap_control_state_t* control = ( _powercap_control_state_t* ) ctl;
   _powercap_context_t* context = ( _powercap_context_t* ) ctx;
 
-  long long start_val = 0;
-  long long curr_val = 0;
+  long long values[POWERCAP_MAX_COUNTERS];
+  long long delta;
   int c, i;
 
+  read_powercap_values(context, control, values);
+
   for( c = 0; c < control->active_counters; c++ ) {
     i = map_index_to_counter(ctl, c);
-    start_val = context->start_value[i];
-    curr_val = read_powercap_value(i);
-
-    SUBDBG("%d, start value: %lld, current value %lld\n", i, start_val, curr_val);
-
-    if(start_val) {
-
-      /* Make sure an event is a counter. */
-      if (control->need_difference[i] == 1) {
-
-        /* Wraparound. */
-        if(start_val > curr_val) {
-          SUBDBG("Wraparound!\nstart value:\t%lld,\tcurrent value:%lld\n", start_val, curr_val);
-          if( powercap_ntv_events[i].type == PKG_ENERGY ) {
-            curr_val += (max_pkg_energy_count - start_val);
-          } else if( powercap_ntv_events[i].type == COMPONENT_ENERGY ) {
-            curr_val += (max_component_energy_count - start_val);
-          } else {
-            curr_val += (0x100000000 - start_val);
-          }
-        }
 
-        /* Normal subtraction. */
-        else if (start_val < curr_val) {
-          SUBDBG("Normal subtraction!\nstart value:\t%lld,\tcurrent value:%lld\n", start_val, curr_val);
-          curr_val -= start_val;
-        }
-        SUBDBG("Final value: %lld\n", curr_val);
+    /* Not a counter, report the value as is */
+    if (control->need_difference[i] != 1) {
+      control->count[c] = values[c];
+      continue;
+    }
 
+    delta = values[c] - control->last_value[c];
+    if (delta < 0) {
+      SUBDBG("Wraparound!\nlast value:\t%lld,\tcurrent value:%lld\n", control->last_value[c], values[c]);
+      if (powercap_ntv_events[i].max_energy_range > 0) {
+        /* counts 0 ... max_energy_range_uj, then starts over at 0 */
+        delta += powercap_ntv_events[i].max_energy_range + 1;
+      } else {
+        delta += 0x100000000;
       }
     }
-    control->count[c]=curr_val;
+    control->last_value[c] = values[c];
+    control->total_value[c] += delta;
+    control->count[c] = control->total_value[c];
+
+    SUBDBG("%d, value: %lld, total %lld\n", i, values[c], control->total_value[c]);
   }
 
   *events = ( ( _powercap_control_state_t* ) ctl )->count;
@@ -621,6 +675,7 @@ papi_vector_t _powercap_vector = {
         .available_granularities = PAPI_GRN_SYS,
         .hardware_intr_sig = PAPI_INT_SIGNAL,
         .available_domains = PAPI_DOM_ALL,
+        .parallel_init = 1,
     },
 
     /* sizes of framework-opaque component-private structures */
@@ -0,0 +1,171 @@
+/**
+ * @author PAPI team UTK/ICL
+ * Test case for powercap component
+ * @brief
+ *   Reads the energy counters of a fake powercap sysfs tree while
+ *   they wrap at max_energy_range_uj, and checks that the reported
+ *   energy keeps counting up past the wrap point.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define MAX_RANGE 1000000LL
+#define NSTEPS 4
+
+static char sysfs_dir[] = "/tmp/papi_powercapXXXXXX";
+static const char *zones[] = { "intel-rapl:0", "intel-rapl:0:0" };
+static const char *zone_names[] = { "package-0", "core" };
+static const char *files[] = { "name", "energy_uj", "max_energy_range_uj" };
+
+/* raw energy_uj written at each step, and the expected totals: a wrap */
+/* adds MAX_RANGE + 1, energy_uj goes from 0 to MAX_RANGE inclusive     */
+static const long long raw[NSTEPS + 1] = { 900000, 100000, 600000, 50000, 999000 };
+static const long long expected[NSTEPS] = { 200001, 700001, 1150002, 2099002 };
+
+static void
+write_file( int zone, const char *file, const char *value )
+{
+	char path[PAPI_MAX_STR_LEN];
+	FILE *fff;
+
+	snprintf( path, sizeof ( path ), "%s/%s/%s", sysfs_dir, zones[zone], file );
+	fff = fopen( path, "w" );
+	if ( fff == NULL )
+		test_fail( __FILE__, __LINE__, path, PAPI_ESYS );
+	fprintf( fff, "%s\n", value );
+	fclose( fff );
+}
+
+static void
+write_energy( long long value )
+{
+	char buf[PAPI_MIN_STR_LEN];
+	int z;
+
+	snprintf( buf, sizeof ( buf ), "%lld", value );
+	for ( z = 0; z < 2; z++ )
+		write_file( z, "energy_uj", buf );
+}
+
+static void
+cleanup( void )
+{
+	char path[PAPI_MAX_STR_LEN];
+	int z, f;
+
+	for ( z = 0; z < 2; z++ ) {
+		for ( f = 0; f < 3; f++ ) {
+			snprintf( path, sizeof ( path ), "%s/%s/%s", sysfs_dir, zones[z], files[f] );
+			unlink( path );
+		}
+		snprintf( path, sizeof ( path ), "%s/%s", sysfs_dir, zones[z] );
+		rmdir( path );
+	}
+	rmdir( sysfs_dir );
+}
+
+int
+main( int argc, char **argv )
+{
+	int retval, cid, powercap_cid = -1, numcmp, i, z;
+	int EventSet = PAPI_NULL;
+	long long values[2];
+	char path[PAPI_MAX_STR_LEN], buf[PAPI_MIN_STR_LEN];
+	const PAPI_component_info_t *cmpinfo;
+
+	tests_quiet( argc, argv );
+
+	/* Build the fake tree before PAPI looks for it */
+	if ( mkdtemp( sysfs_dir ) == NULL )
+		test_fail( __FILE__, __LINE__, "mkdtemp", PAPI_ESYS );
+
+	snprintf( buf, sizeof ( buf ), "%lld", MAX_RANGE );
+	for ( z = 0; z < 2; z++ ) {
+		snprintf( path, sizeof ( path ), "%s/%s", sysfs_dir, zones[z] );
+		mkdir( path, 0700 );
+		write_file( z, "name", zone_names[z] );
+		write_file( z, "max_energy_range_uj", buf );
+	}
+	write_energy( raw[0] );
+
+	setenv( "PAPI_POWERCAP_SYSFS_DIR", sysfs_dir, 1 );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	numcmp = PAPI_num_components(  );
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+		if ( strstr( cmpinfo->name, "powercap" ) ) {
+			powercap_cid = cid;
+			if ( cmpinfo->disabled ) {
+				if ( !TESTS_QUIET )
+					printf( "powercap component disabled: %s\n",
+							cmpinfo->disabled_reason );
+				cleanup(  );
+				test_skip( __FILE__, __LINE__, "powercap component disabled", 0 );
+			}
+			break;
+		}
+	}
+
+	if ( powercap_cid < 0 ) {
+		cleanup(  );
+		test_skip( __FILE__, __LINE__, "No powercap component found", 0 );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+	retval = PAPI_add_named_event( EventSet, "powercap:::ENERGY_UJ:ZONE0" );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+
+	retval = PAPI_add_named_event( EventSet, "powercap:::ENERGY_UJ:ZONE0_SUBZONE0" );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+	for ( i = 0; i < NSTEPS; i++ ) {
+		write_energy( raw[i + 1] );
+
+		retval = PAPI_read( EventSet, values );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+
+		if ( !TESTS_QUIET )
+			printf( "energy_uj %7lld: read %lld %lld, expected %lld\n",
+					raw[i + 1], values[0], values[1], expected[i] );
+
+		if ( values[0] != expected[i] || values[1] != expected[i] ) {
+			cleanup(  );
+			test_fail( __FILE__, __LINE__, "energy across wrap", 0 );
+		}
+	}
+
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+	cleanup(  );
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
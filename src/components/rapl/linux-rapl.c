@@ -22,6 +22,10 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 /* Headers required by PAPI */
 #include "papi.h"
@@ -116,6 +120,9 @@ typedef struct _rapl_native_event_entry
   int type;
   int return_type;
   _rapl_register_t resources;
+  int package;               /* perf backend: package index */
+  int perf_slot;             /* perf backend: position in the package group */
+  double perf_scale;         /* perf backend: Joules per count */
 } _rapl_native_event_entry_t;
 
 typedef struct _rapl_reg_alloc
@@ -160,6 +167,71 @@ static int num_events		= 0;
 struct fd_array_t *fd_array=NULL;
 static int num_packages=0,num_cpus=0;
 
+/* Directory holding the <cpu>/msr device files, PAPI_RAPL_MSR_DIR */
+static char msr_dir[PAPI_MAX_STR_LEN] = "/dev/cpu";
+
+// Optional background accumulation of the _ENERGY_ MSRs. When
+// PAPI_RAPL_SAMPLE_MS is set, a sampler thread polls every energy MSR
+// at that period, well below the time the 32-bit counter needs to
+// wrap, and adds the difference to a 64-bit total per event. Reads
+// then only load the totals, with no lock and no MSR access, so any
+// number of wraps between two reads is accounted for; a read lags the
+// hardware by at most one period. Only the sampler writes the totals.
+
+typedef struct _rapl_sampler
+{
+  int period_ms;
+  int running;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int *sampled;              /* event index is an energy MSR */
+  long long *last;           /* last raw 32-bit value seen */
+  long long *total;          /* accumulated raw value since init */
+} _rapl_sampler_t;
+
+// The energy counters are also exposed by the kernel through the perf
+// "power" PMU, which needs no MSR access and keeps 64-bit counts. All
+// domains of a package are opened as one system-wide group on the cpu
+// that reads that package, so a read of the group returns every domain.
+// PAPI_RAPL_BACKEND selects "msr" or "perf"; by default the MSRs are
+// tried first and the power PMU is used if they are not usable.
+
+#define RAPL_BACKEND_AUTO  0
+#define RAPL_BACKEND_MSR   1
+#define RAPL_BACKEND_PERF  2
+
+#define RAPL_PERF_DOMAINS  5
+#define RAPL_PERF_PMU      "/sys/bus/event_source/devices/power"
+
+static const struct {
+  const char *name;
+  unsigned int msr;          /* MSR of the same domain, used as tag */
+} perf_domains[RAPL_PERF_DOMAINS] = {
+  { "energy-pkg",   MSR_INTEL_PKG_ENERGY_STATUS },
+  { "energy-cores", MSR_INTEL_PP0_ENERGY_STATUS },
+  { "energy-gpu",   MSR_PP1_ENERGY_STATUS },
+  { "energy-ram",   MSR_DRAM_ENERGY_STATUS },
+  { "energy-psys",  MSR_PLATFORM_ENERGY_STATUS },
+};
+
+typedef struct _rapl_perf_group
+{
+  int nr;                             /* events in the group */
+  int fd[RAPL_PERF_DOMAINS];          /* fd[0] is the leader */
+  int slot[RAPL_PERF_DOMAINS];        /* group position of a domain, or -1 */
+} _rapl_perf_group_t;
+
+static int rapl_backend = RAPL_BACKEND_AUTO;
+static int rapl_use_perf = 0;
+static _rapl_perf_group_t *perf_groups = NULL;
+static double perf_scale[RAPL_PERF_DOMAINS];
+
+static _rapl_sampler_t sampler = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .wake = PTHREAD_COND_INITIALIZER,
+};
+
 int power_divisor,time_divisor;
 int cpu_energy_divisor,dram_energy_divisor;
 unsigned int msr_rapl_power_unit;
@@ -201,10 +273,10 @@ static int open_fd(int offset) {
   char filename[BUFSIZ];
 
   if (fd_array[offset].open==0) {
-	  sprintf(filename,"/dev/cpu/%d/msr_safe",offset);
+	  snprintf(filename,BUFSIZ,"%s/%d/msr_safe",msr_dir,offset);
       fd = open(filename, O_RDONLY);
 	  if (fd<0) {
-		  sprintf(filename,"/dev/cpu/%d/msr",offset);
+		  snprintf(filename,BUFSIZ,"%s/%d/msr",msr_dir,offset);
           fd = open(filename, O_RDONLY);
 	  }
 	  if (fd>=0) {
@@ -228,6 +300,274 @@ static long long read_rapl_value(int index) {
 
 }
 
+static int is_energy_event(int index) {
+
+   return (rapl_native_events[index].type==PACKAGE_ENERGY ||
+           rapl_native_events[index].type==DRAM_ENERGY ||
+           rapl_native_events[index].type==PLATFORM_ENERGY ||
+           rapl_native_events[index].type==PACKAGE_ENERGY_CNT);
+}
+
+/* Fold the current value of every energy MSR into the 64-bit totals */
+static void sample_energy(void) {
+
+   int i;
+   long long now, delta;
+
+   for(i=0;i<num_events;i++) {
+      if (!sampler.sampled[i]) continue;
+      now = read_rapl_value(i) & 0xFFFFFFFF;
+      delta = (now - sampler.last[i]) & 0xFFFFFFFF;
+      sampler.last[i] = now;
+      __atomic_store_n(&sampler.total[i], sampler.total[i] + delta,
+                       __ATOMIC_RELEASE);
+   }
+}
+
+/* Total of an energy MSR as of the last sample */
+static long long sampled_energy(int index) {
+
+   return __atomic_load_n(&sampler.total[index], __ATOMIC_ACQUIRE);
+}
+
+static void *sampler_loop(void *arg) {
+
+   struct timespec deadline;
+
+   ( void ) arg;
+
+   pthread_mutex_lock(&sampler.lock);
+   while (sampler.running) {
+      sample_energy();
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += sampler.period_ms / 1000;
+      deadline.tv_nsec += (long)(sampler.period_ms % 1000) * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&sampler.wake, &sampler.lock, &deadline);
+   }
+   pthread_mutex_unlock(&sampler.lock);
+
+   return NULL;
+}
+
+/* Start the sampler if PAPI_RAPL_SAMPLE_MS asks for it */
+static int start_sampler(void) {
+
+   char *env;
+   int i;
+
+   env = getenv("PAPI_RAPL_SAMPLE_MS");
+   if (env == NULL || atoi(env) <= 0) return PAPI_OK;
+
+   sampler.sampled = papi_calloc(num_events, sizeof(int));
+   sampler.last = papi_calloc(num_events, sizeof(long long));
+   sampler.total = papi_calloc(num_events, sizeof(long long));
+   if (!sampler.sampled || !sampler.last || !sampler.total) return PAPI_ENOMEM;
+
+   /* Open every fd up front, the sampler must not touch fd_array */
+   for(i=0;i<num_events;i++) {
+      if (!is_energy_event(i)) continue;
+      if (open_fd(rapl_native_events[i].fd_offset) < 0) return PAPI_ESYS;
+      sampler.sampled[i] = 1;
+      sampler.last[i] = read_rapl_value(i) & 0xFFFFFFFF;
+   }
+
+   sampler.period_ms = atoi(env);
+   sampler.running = 1;
+   if (pthread_create(&sampler.thread, NULL, sampler_loop, NULL)) {
+      sampler.running = 0;
+      return PAPI_ESYS;
+   }
+
+   SUBDBG("Sampling energy MSRs every %d ms\n", sampler.period_ms);
+   return PAPI_OK;
+}
+
+static void stop_sampler(void) {
+
+   if (sampler.running) {
+      pthread_mutex_lock(&sampler.lock);
+      sampler.running = 0;
+      pthread_cond_signal(&sampler.wake);
+      pthread_mutex_unlock(&sampler.lock);
+      pthread_join(sampler.thread, NULL);
+   }
+
+   if (sampler.sampled) papi_free(sampler.sampled);
+   if (sampler.last) papi_free(sampler.last);
+   if (sampler.total) papi_free(sampler.total);
+   sampler.sampled = NULL;
+   sampler.last = NULL;
+   sampler.total = NULL;
+}
+
+/* Read the first line of a file of the perf power PMU */
+static int perf_read_sysfs(const char *name, char *buf, int len) {
+
+   char filename[BUFSIZ];
+   FILE *fff;
+
+   snprintf(filename, BUFSIZ, "%s/%s", RAPL_PERF_PMU, name);
+   fff = fopen(filename, "r");
+   if (fff == NULL) return PAPI_ENOSUPP;
+   if (fgets(buf, len, fff) == NULL) {
+      fclose(fff);
+      return PAPI_ESYS;
+   }
+   fclose(fff);
+
+   return PAPI_OK;
+}
+
+/* Add to the disabled reason, which may already say why MSRs failed */
+static void perf_disabled_reason(const char *why) {
+
+   char *reason = _rapl_vector.cmp_info.disabled_reason;
+   size_t len = strlen(reason);
+
+   snprintf(reason + len, PAPI_MAX_STR_LEN - len, "%s%s",
+            len ? "; " : "", why);
+}
+
+static void perf_close(void) {
+
+   int i, j;
+
+   if (perf_groups == NULL) return;
+
+   /* members before their leader */
+   for(i=0;i<num_packages;i++) {
+      for(j=perf_groups[i].nr-1;j>=0;j--) close(perf_groups[i].fd[j]);
+   }
+   papi_free(perf_groups);
+   perf_groups = NULL;
+   rapl_use_perf = 0;
+}
+
+/* Open one group per package with every power PMU domain it has */
+static int perf_init(int *cpu_to_use) {
+
+   struct perf_event_attr attr;
+   char buf[PAPI_MIN_STR_LEN], name[PAPI_MIN_STR_LEN];
+   unsigned int config;
+   int type, d, p, fd, leader, nopen = 0;
+
+   if (perf_read_sysfs("type", buf, sizeof(buf)) != PAPI_OK) {
+      perf_disabled_reason("No perf power PMU");
+      return PAPI_ENOSUPP;
+   }
+   type = atoi(buf);
+
+   perf_groups = papi_calloc(num_packages, sizeof(_rapl_perf_group_t));
+   if (perf_groups == NULL) return PAPI_ENOMEM;
+   for(p=0;p<num_packages;p++) {
+      for(d=0;d<RAPL_PERF_DOMAINS;d++) perf_groups[p].slot[d] = -1;
+   }
+
+   for(d=0;d<RAPL_PERF_DOMAINS;d++) {
+      snprintf(name, sizeof(name), "events/%s", perf_domains[d].name);
+      if (perf_read_sysfs(name, buf, sizeof(buf)) != PAPI_OK) continue;
+      if (sscanf(buf, "event=%x", &config) != 1) continue;
+
+      snprintf(name, sizeof(name), "events/%s.scale", perf_domains[d].name);
+      if (perf_read_sysfs(name, buf, sizeof(buf)) != PAPI_OK) continue;
+      perf_scale[d] = strtod(buf, NULL);
+
+      for(p=0;p<num_packages;p++) {
+         memset(&attr, 0, sizeof(attr));
+         attr.size = sizeof(attr);
+         attr.type = type;
+         attr.config = config;
+         attr.read_format = PERF_FORMAT_GROUP;
+
+         leader = perf_groups[p].nr ? perf_groups[p].fd[0] : -1;
+         fd = syscall(__NR_perf_event_open, &attr, -1, cpu_to_use[p], leader, 0);
+         if (fd < 0) break;
+         perf_groups[p].slot[d] = perf_groups[p].nr;
+         perf_groups[p].fd[perf_groups[p].nr++] = fd;
+      }
+
+      /* Only keep domains every package can count */
+      if (p < num_packages) {
+         SUBDBG("Can't open %s on cpu %d: %s\n", perf_domains[d].name,
+                cpu_to_use[p], strerror(errno));
+         while (p-- > 0) {
+            close(perf_groups[p].fd[--perf_groups[p].nr]);
+            perf_groups[p].slot[d] = -1;
+         }
+         continue;
+      }
+      nopen++;
+   }
+
+   if (nopen == 0) {
+      perf_close();
+      perf_disabled_reason("Can't open perf power PMU events");
+      return PAPI_ESYS;
+   }
+
+   rapl_use_perf = 1;
+   SUBDBG("Using the perf power PMU with %d domains\n", nopen);
+   return PAPI_OK;
+}
+
+static int perf_domain_avail(unsigned int msr) {
+
+   int d;
+
+   for(d=0;d<RAPL_PERF_DOMAINS;d++) {
+      if (perf_domains[d].msr == msr) return perf_groups[0].slot[d] >= 0;
+   }
+   return 0;
+}
+
+/* Point every event at its package group and slot */
+static void perf_bind_events(int *cpu_to_use) {
+
+   int i, p, d;
+
+   for(i=0;i<num_events;i++) {
+      for(p=0;p<num_packages;p++) {
+         if (cpu_to_use[p] == rapl_native_events[i].fd_offset) break;
+      }
+      for(d=0;d<RAPL_PERF_DOMAINS;d++) {
+         if (perf_domains[d].msr == (unsigned int)rapl_native_events[i].msr) break;
+      }
+      rapl_native_events[i].package = p;
+      rapl_native_events[i].perf_slot = perf_groups[p].slot[d];
+      rapl_native_events[i].perf_scale = perf_scale[d];
+   }
+}
+
+/* One group read per package that has a measured event */
+static int perf_read_values(_rapl_control_state_t *control, long long *values) {
+
+   long long buf[num_packages][1 + RAPL_PERF_DOMAINS];
+   int done[num_packages];
+   int i, p;
+   ssize_t len;
+
+   memset(done, 0, sizeof(done));
+
+   for(i=0;i<num_events && i<RAPL_MAX_COUNTERS;i++) {
+      if (!control->being_measured[i]) continue;
+      p = rapl_native_events[i].package;
+      if (!done[p]) {
+         len = read(perf_groups[p].fd[0], buf[p], sizeof(buf[p]));
+         if (len < (ssize_t)((1 + perf_groups[p].nr) * sizeof(long long))) {
+            return PAPI_ESYS;
+         }
+         done[p] = 1;
+      }
+      values[i] = buf[p][1 + rapl_native_events[i].perf_slot];
+   }
+
+   return PAPI_OK;
+}
+
 static long long convert_rapl_energy(int index, long long value) {
 
    union {
@@ -237,6 +577,12 @@ static long long convert_rapl_energy(int index, long long value) {
 
    return_val.ll = value; /* default case: return raw input value */
 
+   /* perf counts are in units of perf_scale Joules */
+   if (rapl_use_perf) {
+      if (rapl_native_events[index].type==PACKAGE_ENERGY_CNT) return value;
+      return (long long)((double)value*rapl_native_events[index].perf_scale*1e9);
+   }
+
    if (rapl_native_events[index].type==PACKAGE_ENERGY) {
       return_val.ll = (long long)(((double)value/cpu_energy_divisor)*1e9);
    }
@@ -339,12 +685,14 @@ _rapl_init_component( int cidx )
      char *strCpy;
 
 	int package_avail, dram_avail, pp0_avail, pp1_avail, psys_avail;
+	int info_avail;
 	int different_units;
 
      long long result;
      int package;
 
      const PAPI_hw_info_t *hw_info;
+     char *env;
 
      int nr_cpus = get_kernel_nr_cpus();
      int packages[nr_cpus];
@@ -353,6 +701,10 @@ _rapl_init_component( int cidx )
 	unsigned int msr_pkg_energy_status,msr_pp0_energy_status;
 
 
+     /* Start over if PAPI was shut down and initialized again */
+     num_packages = 0;
+     _rapl_vector.cmp_info.disabled_reason[0] = '\0';
+
      /* Fill with sentinel values */
      for (i=0; i<nr_cpus; ++i) {
        packages[i] = -1;
@@ -360,6 +712,84 @@ _rapl_init_component( int cidx )
      }
 
 
+     env=getenv("PAPI_RAPL_BACKEND");
+     if (env!=NULL) {
+        if (!strcmp(env,"msr")) rapl_backend=RAPL_BACKEND_MSR;
+        else if (!strcmp(env,"perf")) rapl_backend=RAPL_BACKEND_PERF;
+     }
+
+     env=getenv("PAPI_RAPL_MSR_DIR");
+     if (env!=NULL) {
+        strncpy(msr_dir,env,PAPI_MAX_STR_LEN-1);
+        msr_dir[PAPI_MAX_STR_LEN-1]=0;
+     }
+
+     /* Detect how many packages */
+     // Some code below may be flagged by Coverity due to uninitialized array
+     // entries of cpu_to_use[]. This is not a bug; the 'filename' listed below
+     // will have 'cpu0', 'cpu1', sequentially on up to the maximum.  Coverity
+     // cannot know that, so its code analysis allows the possibility that the
+     // cpu_to_use[] array is only partially filled in. [Tony C. 11-27-19].
+
+     j=0;
+     while(1) {
+       int num_read;
+
+       strErr=snprintf(filename, BUFSIZ, 
+	       "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",j);
+       filename[BUFSIZ-1]=0;
+       if (strErr > BUFSIZ) HANDLE_STRING_ERROR;
+       fff=fopen(filename,"r");
+       if (fff==NULL) break;
+       num_read=fscanf(fff,"%d",&package);
+       fclose(fff);
+       if (num_read!=1) {
+    		 strCpy=strcpy(_rapl_vector.cmp_info.disabled_reason, "Error reading file: ");
+          if (strCpy == NULL) HANDLE_STRING_ERROR;
+    		 strCpy=strncat(_rapl_vector.cmp_info.disabled_reason, filename, PAPI_MAX_STR_LEN - strlen(_rapl_vector.cmp_info.disabled_reason) - 1);
+    		 _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1] = '\0';
+          if (strCpy == NULL) HANDLE_STRING_ERROR;
+          retval = PAPI_ESYS;
+          goto fn_fail;
+       }
+
+       /* Check if a new package */
+       if ((package >= 0) && (package < nr_cpus)) {
+         if (packages[package] == -1) {
+           SUBDBG("Found package %d out of total %d\n",package,num_packages);
+	   packages[package]=package;
+	   cpu_to_use[package]=j;
+	   num_packages++;
+         }
+       } else {
+	 SUBDBG("Package outside of allowed range\n");
+	 strCpy=strncpy(_rapl_vector.cmp_info.disabled_reason,
+		"Package outside of allowed range",PAPI_MAX_STR_LEN);
+	 _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
+    if (strCpy == NULL) HANDLE_STRING_ERROR;
+    retval = PAPI_ESYS;
+    goto fn_fail;
+       }
+
+       j++;
+     }
+     num_cpus=j;
+
+     if (num_packages==0) {
+        SUBDBG("Can't access /dev/cpu/*/<msr_safe | msr>\n");
+    strCpy=strncpy(_rapl_vector.cmp_info.disabled_reason,
+		"Can't access /dev/cpu/*/<msr_safe | msr>",PAPI_MAX_STR_LEN);
+    _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
+    if (strCpy == NULL) HANDLE_STRING_ERROR;
+    retval = PAPI_ESYS;
+    goto fn_fail;
+     }
+
+     SUBDBG("Found %d packages with %d cpus\n",num_packages,num_cpus);
+
+
+	if (rapl_backend==RAPL_BACKEND_PERF) goto use_perf;
+
 	/* check if supported processor */
 	hw_info=&(_papi_hwi_system_info.hw_info);
 
@@ -376,7 +806,7 @@ _rapl_init_component( int cidx )
 			_rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
          if (strCpy == NULL) HANDLE_STRING_ERROR;
          retval = PAPI_ENOSUPP;
-         goto fn_fail;
+         goto msr_unavailable;
 	}
 
 
@@ -395,7 +825,7 @@ _rapl_init_component( int cidx )
 			_rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
          if (strCpy == NULL) HANDLE_STRING_ERROR;
          retval = PAPI_ENOIMPL;
-         goto fn_fail;
+         goto msr_unavailable;
 		}
 
 		/* Detect RAPL support */
@@ -505,7 +935,7 @@ _rapl_init_component( int cidx )
 			_rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
          if (strCpy == NULL) HANDLE_STRING_ERROR;
          retval = PAPI_ENOIMPL;
-         goto fn_fail;
+         goto msr_unavailable;
 		}
 	}
 
@@ -522,7 +952,7 @@ _rapl_init_component( int cidx )
 			_rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
          if (strCpy == NULL) HANDLE_STRING_ERROR;
          retval = PAPI_ENOIMPL;
-         goto fn_fail;
+         goto msr_unavailable;
 		}
 
 		package_avail=1;
@@ -534,69 +964,6 @@ _rapl_init_component( int cidx )
 	}
 
 
-     /* Detect how many packages */
-     // Some code below may be flagged by Coverity due to uninitialized array
-     // entries of cpu_to_use[]. This is not a bug; the 'filename' listed below
-     // will have 'cpu0', 'cpu1', sequentially on up to the maximum.  Coverity
-     // cannot know that, so its code analysis allows the possibility that the
-     // cpu_to_use[] array is only partially filled in. [Tony C. 11-27-19].
-
-     j=0;
-     while(1) {
-       int num_read;
-
-       strErr=snprintf(filename, BUFSIZ, 
-	       "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",j);
-       filename[BUFSIZ-1]=0;
-       if (strErr > BUFSIZ) HANDLE_STRING_ERROR;
-       fff=fopen(filename,"r");
-       if (fff==NULL) break;
-       num_read=fscanf(fff,"%d",&package);
-       fclose(fff);
-       if (num_read!=1) {
-    		 strCpy=strcpy(_rapl_vector.cmp_info.disabled_reason, "Error reading file: ");
-          if (strCpy == NULL) HANDLE_STRING_ERROR;
-    		 strCpy=strncat(_rapl_vector.cmp_info.disabled_reason, filename, PAPI_MAX_STR_LEN - strlen(_rapl_vector.cmp_info.disabled_reason) - 1);
-    		 _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1] = '\0';
-          if (strCpy == NULL) HANDLE_STRING_ERROR;
-          retval = PAPI_ESYS;
-          goto fn_fail;
-       }
-
-       /* Check if a new package */
-       if ((package >= 0) && (package < nr_cpus)) {
-         if (packages[package] == -1) {
-           SUBDBG("Found package %d out of total %d\n",package,num_packages);
-	   packages[package]=package;
-	   cpu_to_use[package]=j;
-	   num_packages++;
-         }
-       } else {
-	 SUBDBG("Package outside of allowed range\n");
-	 strCpy=strncpy(_rapl_vector.cmp_info.disabled_reason,
-		"Package outside of allowed range",PAPI_MAX_STR_LEN);
-	 _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
-    if (strCpy == NULL) HANDLE_STRING_ERROR;
-    retval = PAPI_ESYS;
-    goto fn_fail;
-       }
-
-       j++;
-     }
-     num_cpus=j;
-
-     if (num_packages==0) {
-        SUBDBG("Can't access /dev/cpu/*/<msr_safe | msr>\n");
-    strCpy=strncpy(_rapl_vector.cmp_info.disabled_reason,
-		"Can't access /dev/cpu/*/<msr_safe | msr>",PAPI_MAX_STR_LEN);
-    _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
-    if (strCpy == NULL) HANDLE_STRING_ERROR;
-    retval = PAPI_ESYS;
-    goto fn_fail;
-     }
-
-     SUBDBG("Found %d packages with %d cpus\n",num_packages,num_cpus);
-
      /* Init fd_array */
 
      fd_array=papi_calloc(num_cpus, sizeof(struct fd_array_t));
@@ -612,7 +979,7 @@ _rapl_init_component( int cidx )
         _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
         if (strErr > PAPI_MAX_STR_LEN) HANDLE_STRING_ERROR;
         retval = PAPI_ESYS;
-        goto fn_fail;
+        goto msr_unavailable;
      }
 
      /* Verify needed MSR is readable. In a guest VM it may not be readable*/
@@ -622,7 +989,7 @@ _rapl_init_component( int cidx )
         _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
         if (strCpy == NULL) HANDLE_STRING_ERROR;
         retval = PAPI_ESYS;
-        goto fn_fail;
+        goto msr_unavailable;
      }
 
      /* Calculate the units used */
@@ -651,6 +1018,33 @@ _rapl_init_component( int cidx )
      SUBDBG("DRAM Energy units = %.8fJ\n",1.0/dram_energy_divisor);
      SUBDBG("Time units = %.8fs\n",1.0/time_divisor);
 
+     info_avail = (hw_info->vendor==PAPI_VENDOR_INTEL);
+     goto create_events;
+
+  msr_unavailable:
+     /* Fall back to the perf power PMU unless MSRs were asked for */
+     if (rapl_backend==RAPL_BACKEND_MSR) goto fn_fail;
+
+  use_perf:
+     retval = perf_init(cpu_to_use);
+     if (retval != PAPI_OK) goto fn_fail;
+
+     /* The component works, so why the MSRs did not is no reason */
+     _rapl_vector.cmp_info.disabled_reason[0] = '\0';
+
+     package_avail = perf_domain_avail(MSR_INTEL_PKG_ENERGY_STATUS);
+     pp0_avail = perf_domain_avail(MSR_INTEL_PP0_ENERGY_STATUS);
+     pp1_avail = perf_domain_avail(MSR_PP1_ENERGY_STATUS);
+     dram_avail = perf_domain_avail(MSR_DRAM_ENERGY_STATUS);
+     psys_avail = perf_domain_avail(MSR_PLATFORM_ENERGY_STATUS);
+     msr_pkg_energy_status = MSR_INTEL_PKG_ENERGY_STATUS;
+     msr_pp0_energy_status = MSR_INTEL_PP0_ENERGY_STATUS;
+
+     /* The power info registers are only reachable through the MSRs */
+     info_avail = 0;
+
+  create_events:
+
      /* Allocate space for events */
      /* Include room for both counts and scaled values */
 
@@ -660,7 +1054,7 @@ _rapl_init_component( int cidx )
                  (dram_avail*num_packages) +
 		(psys_avail*num_packages)) * 2;
 
-	if (hw_info->vendor==PAPI_VENDOR_INTEL) {
+	if (info_avail) {
 		num_events+=(4*num_packages) * 2;
 	}
 
@@ -680,7 +1074,7 @@ _rapl_init_component( int cidx )
 
      /* Create events for package power info */
 
-	if (hw_info->vendor==PAPI_VENDOR_INTEL)
+	if (info_avail)
      for(j=0;j<num_packages;j++) {
         strErr=snprintf(rapl_native_events[i].name, PAPI_MAX_STR_LEN, 
 			"THERMAL_SPEC_CNT:PACKAGE%d",j);
@@ -720,7 +1114,7 @@ _rapl_init_component( int cidx )
 		k++;
      }
 
-	if (hw_info->vendor==PAPI_VENDOR_INTEL)
+	if (info_avail)
      for(j=0;j<num_packages;j++) {
         strErr=snprintf(rapl_native_events[i].name, PAPI_MAX_STR_LEN,
 			"MINIMUM_POWER_CNT:PACKAGE%d",j);
@@ -757,7 +1151,7 @@ _rapl_init_component( int cidx )
 		k++;
      }
 
-	if (hw_info->vendor==PAPI_VENDOR_INTEL)
+	if (info_avail)
      for(j=0;j<num_packages;j++) {
         strErr=snprintf(rapl_native_events[i].name, PAPI_MAX_STR_LEN,
 			"MAXIMUM_POWER_CNT:PACKAGE%d",j);
@@ -794,7 +1188,7 @@ _rapl_init_component( int cidx )
 		k++;
      }
 
-	if (hw_info->vendor==PAPI_VENDOR_INTEL)
+	if (info_avail)
      for(j=0;j<num_packages;j++) {
          strErr=snprintf(rapl_native_events[i].name, PAPI_MAX_STR_LEN,
 			"MAXIMUM_TIME_WINDOW_CNT:PACKAGE%d",j);
@@ -1034,10 +1428,24 @@ _rapl_init_component( int cidx )
      /* Export the component id */
      _rapl_vector.cmp_info.CmpIdx = cidx;
 
+     if (rapl_use_perf) perf_bind_events(cpu_to_use);
+
+     retval = rapl_use_perf ? PAPI_OK : start_sampler();
+     if (retval != PAPI_OK) {
+        stop_sampler();
+    perf_close();
+        strCpy=strncpy(_rapl_vector.cmp_info.disabled_reason,
+               "Unable to start the energy sampler thread",PAPI_MAX_STR_LEN);
+        _rapl_vector.cmp_info.disabled_reason[PAPI_MAX_STR_LEN-1]=0;
+        if (strCpy == NULL) HANDLE_STRING_ERROR;
+        goto fn_fail;
+     }
+
   fn_exit:
     _papi_hwd[cidx]->cmp_info.disabled = retval;
      return retval;
   fn_fail:
+     perf_close();
      goto fn_exit;
 }
 
@@ -1066,12 +1474,23 @@ _rapl_start( hwd_context_t *ctx, hwd_control_state_t *ctl)
   _rapl_context_t* context = (_rapl_context_t*) ctx;
   _rapl_control_state_t* control = (_rapl_control_state_t*) ctl;
   long long now = PAPI_get_real_usec();
-  int i;
+  long long values[RAPL_MAX_COUNTERS];
+  int i, retval;
+
+  if (rapl_use_perf) {
+     retval = perf_read_values(control, values);
+     if (retval != PAPI_OK) return retval;
+  }
 
-  
   for( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
      if ((control->being_measured[i]) && (control->need_difference[i])) {
-        context->start_value[i]=(read_rapl_value(i) & 0xFFFFFFFF);
+        if (rapl_use_perf) {
+           context->start_value[i]=values[i];
+        } else if (sampler.running) {
+           context->start_value[i]=sampled_energy(i);
+        } else {
+           context->start_value[i]=(read_rapl_value(i) & 0xFFFFFFFF);
+        }
         context->accumulated_value[i]=0;
      }
   }
@@ -1088,11 +1507,29 @@ _rapl_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
    _rapl_context_t* context = (_rapl_context_t*) ctx;
    _rapl_control_state_t* control = (_rapl_control_state_t*) ctl;
    long long now = PAPI_get_real_usec();
-   int i;
+   long long values[RAPL_MAX_COUNTERS];
+   int i, retval;
    long long temp, newstart;
 
+   if (rapl_use_perf) {
+      retval = perf_read_values(control, values);
+      if (retval != PAPI_OK) return retval;
+   }
+
    for ( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
       if (control->being_measured[i]) {
+         if (rapl_use_perf) {
+            /* 64-bit counts, the kernel handles the MSR wraps */
+            temp = values[i] - context->start_value[i];
+            control->count[i] = convert_rapl_energy( i, temp );
+            continue;
+         }
+         if (control->need_difference[i] && sampler.running) {
+            /* the sampler already did the wrap handling */
+            temp = sampled_energy(i) - context->start_value[i];
+            control->count[i] = convert_rapl_energy( i, temp );
+            continue;
+         }
          temp = read_rapl_value(i);
          if (control->need_difference[i]) {
             temp &= 0xFFFFFFFF;
@@ -1130,9 +1567,11 @@ int
 _rapl_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 	    long long **events, int flags)
 {
+    int retval;
     (void) flags;
 
-    _rapl_stop( ctx, ctl );
+    retval = _rapl_stop( ctx, ctl );
+    if (retval != PAPI_OK) return retval;
 
     /* Pass back a pointer to our results */
     *events = ((_rapl_control_state_t*) ctl)->count;
@@ -1149,6 +1588,8 @@ _rapl_shutdown_component( void )
 {
     int i;
 
+    stop_sampler();
+
     if (rapl_native_events) papi_free(rapl_native_events);
     if (fd_array) {
        for(i=0;i<num_cpus;i++) {
@@ -1199,11 +1640,7 @@ _rapl_update_control_state( hwd_control_state_t *ctl,
        control->being_measured[index]=1;
 
        /* Only need to subtract if it's a PACKAGE_ENERGY or ENERGY_CNT type */
-       control->need_difference[index]=
-	 	(rapl_native_events[index].type==PACKAGE_ENERGY ||
-		rapl_native_events[index].type==DRAM_ENERGY ||
-		rapl_native_events[index].type==PLATFORM_ENERGY ||
-	 	rapl_native_events[index].type==PACKAGE_ENERGY_CNT);
+       control->need_difference[index]=is_energy_event(index);
     }
 
     return PAPI_OK;
@@ -1351,6 +1788,7 @@ papi_vector_t _rapl_vector = {
        .available_granularities = PAPI_GRN_SYS,
        .hardware_intr_sig = PAPI_INT_SIGNAL,
        .available_domains = PAPI_DOM_ALL,
+       .parallel_init = 1,
     },
 
 	/* sizes of framework-opaque component-private structures */
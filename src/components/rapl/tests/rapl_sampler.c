@@ -0,0 +1,173 @@
+/* This file checks the background energy sampler of the RAPL	*/
+/* component against a fake /dev/cpu/N/msr tree.  The energy	*/
+/* status registers are advanced by 3/4 of their 32-bit range	*/
+/* several times between PAPI_start and PAPI_read, so the value	*/
+/* wraps more than once.  With PAPI_RAPL_SAMPLE_MS set, the	*/
+/* full amount must be reported.				*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NSTEPS 5
+#define STEP 0xC0000000ULL
+
+/* Intel and AMD unit and energy status MSRs */
+static const unsigned int unit_msrs[] = { 0x606, 0xc0010299 };
+static const unsigned int energy_msrs[] = {
+	0x611, 0x619, 0x639, 0x641, 0x64d, 0xc001029A, 0xc001029B
+};
+
+static char msr_dir[] = "/tmp/papi_rapl_msrXXXXXX";
+static long ncpus;
+
+static void
+write_msr( unsigned int msr, uint64_t value )
+{
+	char filename[PAPI_MAX_STR_LEN];
+	long cpu;
+	int fd;
+
+	for ( cpu = 0; cpu < ncpus; cpu++ ) {
+		snprintf( filename, sizeof ( filename ), "%s/%ld/msr", msr_dir, cpu );
+		fd = open( filename, O_WRONLY | O_CREAT, 0600 );
+		if ( fd < 0 ||
+			 pwrite( fd, &value, sizeof ( value ), msr ) != sizeof ( value ) )
+			test_fail( __FILE__, __LINE__, filename, PAPI_ESYS );
+		close( fd );
+	}
+}
+
+static void
+write_energy( uint64_t value )
+{
+	unsigned int i;
+
+	for ( i = 0; i < sizeof ( energy_msrs ) / sizeof ( energy_msrs[0] ); i++ )
+		write_msr( energy_msrs[i], value & 0xFFFFFFFF );
+}
+
+static void
+cleanup( void )
+{
+	char filename[PAPI_MAX_STR_LEN];
+	long cpu;
+
+	for ( cpu = 0; cpu < ncpus; cpu++ ) {
+		snprintf( filename, sizeof ( filename ), "%s/%ld/msr", msr_dir, cpu );
+		unlink( filename );
+		snprintf( filename, sizeof ( filename ), "%s/%ld", msr_dir, cpu );
+		rmdir( filename );
+	}
+	rmdir( msr_dir );
+}
+
+int
+main( int argc, char **argv )
+{
+	int retval, cid, rapl_cid = -1, numcmp, i;
+	int EventSet = PAPI_NULL;
+	long long value;
+	uint64_t raw;
+	char filename[PAPI_MAX_STR_LEN];
+	const PAPI_component_info_t *cmpinfo;
+	long cpu;
+
+	tests_quiet( argc, argv );
+
+	/* Build the fake tree before PAPI looks for it */
+	if ( mkdtemp( msr_dir ) == NULL )
+		test_fail( __FILE__, __LINE__, "mkdtemp", PAPI_ESYS );
+
+	ncpus = sysconf( _SC_NPROCESSORS_CONF );
+	for ( cpu = 0; cpu < ncpus; cpu++ ) {
+		snprintf( filename, sizeof ( filename ), "%s/%ld", msr_dir, cpu );
+		mkdir( filename, 0700 );
+	}
+
+	/* energy unit of 1 count, so the _CNT events equal the raw delta */
+	for ( i = 0; i < 2; i++ )
+		write_msr( unit_msrs[i], 0 );
+	raw = 0xFFFFF000ULL;
+	write_energy( raw );
+
+	setenv( "PAPI_RAPL_MSR_DIR", msr_dir, 1 );
+	setenv( "PAPI_RAPL_SAMPLE_MS", "1", 1 );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	numcmp = PAPI_num_components(  );
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+		if ( strstr( cmpinfo->name, "rapl" ) ) {
+			rapl_cid = cid;
+			if ( !TESTS_QUIET )
+				printf( "Found rapl component at cid %d\n", rapl_cid );
+			if ( cmpinfo->disabled ) {
+				if ( !TESTS_QUIET )
+					printf( "RAPL component disabled: %s\n",
+							cmpinfo->disabled_reason );
+				cleanup(  );
+				test_skip( __FILE__, __LINE__, "RAPL component disabled", 0 );
+			}
+			break;
+		}
+	}
+
+	if ( rapl_cid < 0 ) {
+		cleanup(  );
+		test_skip( __FILE__, __LINE__, "No rapl component found", 0 );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+	retval = PAPI_add_named_event( EventSet,
+								   "rapl:::PACKAGE_ENERGY_CNT:PACKAGE0" );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+
+	/* let the sampler pick up the initial value */
+	usleep( 50000 );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+	for ( i = 0; i < NSTEPS; i++ ) {
+		raw += STEP;
+		write_energy( raw );
+		usleep( 50000 );
+	}
+
+	retval = PAPI_stop( EventSet, &value );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+	if ( !TESTS_QUIET )
+		printf( "Energy counted: %#llx, expected %#llx\n",
+				value, ( long long ) ( NSTEPS * STEP ) );
+
+	cleanup(  );
+
+	if ( value != ( long long ) ( NSTEPS * STEP ) )
+		test_fail( __FILE__, __LINE__, "wrapped energy lost", 0 );
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
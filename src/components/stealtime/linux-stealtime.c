@@ -3,11 +3,22 @@
 * @author  Vince Weaver
 *          vweaver1@eecs.utk.edu
 * @brief A component that gather info on VM stealtime
+*
+* Per-cpu steal time comes from /proc/stat.  The THREAD_* events come
+* from /proc/self/task/<tid>/schedstat of the thread counting them: the
+* time it ran, the time it waited runnable on a runqueue (run_delay,
+* which does not include time stolen by the hypervisor), and the number
+* of its timeslices.
+*
+* Both files are kept open per thread and reread with pread.
+* PAPI_STEALTIME_PROC_DIR replaces /proc, so tests can use fake files.
 */
 
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdint.h>
@@ -17,6 +28,7 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "papi_node.h"
 
 struct counter_info
 {
@@ -34,20 +46,42 @@ typedef struct counter_info STEALTIME_reg_alloc_t;
 struct STEALTIME_control_state
 {
   long long *values;
+  long long *start_count;
+  long long *current_count;
   int *which_counter;
   int num_events;
+  int need_stat;             /* uses per-cpu events */
+  int need_schedstat;        /* uses THREAD_* events */
+  int stat_source;           /* node-wide snapshot of /proc/stat, or -1 */
+  long long lastupdate;
+  long long refresh_latency; /* usec, see PAPI_REFRESH_LATENCY */
 };
 
 
 struct STEALTIME_context
 {
-  long long *start_count;
-  long long *current_count;
-  long long *value;
+  int stat_fd;
+  int schedstat_fd;
+  int buffer_size;
+  char *buffer;
+  long long *steal;          /* steal ticks of each /proc/stat cpu line */
+  long long sched[3];        /* run ns, wait ns, timeslices */
 };
 
 
+/* THREAD_* events follow the per-cpu events */
+#define STEALTIME_THREAD_EVENTS 3
+
 static int num_events = 0;
+static int num_cpu_events = 0;
+static int num_thread_events = 0;
+static long long ticks_to_us = 0;
+
+/* PAPI_STEALTIME_REFRESH_LATENCY, in usec; 0 rereads on every call */
+static long long refresh_latency = 0;
+
+static char stat_file[PAPI_MAX_STR_LEN];
+static char proc_dir[PAPI_MAX_STR_LEN];
 
 static struct counter_info *event_info=NULL;
 
@@ -58,68 +92,171 @@ papi_vector_t _stealtime_vector;
  ********  BEGIN FUNCTIONS  USED INTERNALLY SPECIFIC TO THIS COMPONENT ********
  *****************************************************************************/
 
-struct statinfo {
-  long long user;
-  long long nice;
-  long long system;
-  long long idle;
-  long long iowait;
-  long long irq;
-  long long softirq;
-  long long steal;
-  long long guest;
-};
+/* Reread a file into the context buffer.  /proc/stat is shared: it  */
+/* may come from the node-wide snapshot source, and the buffer grows */
+/* until all of its cpu lines fit; the rest is not needed.  The      */
+/* per-thread schedstat file has no path and a source of -1.         */
+/* Returns the length read, or -1.                                   */
+static int
+read_file( struct STEALTIME_context *context, int *fd, const char *path,
+           int source )
+{
+  int len, n;
+  char *buffer;
+  const char *p;
+
+  for(;;) {
+     len=_papi_node_read_source(source,context->buffer,
+                                context->buffer_size-1);
+     if (len<0) {
+        if (*fd<0) {
+           *fd=open(path,O_RDONLY);
+           if (*fd<0) return -1;
+        }
+        len=0;
+        while(len<context->buffer_size-1) {
+           n=pread(*fd,context->buffer+len,context->buffer_size-1-len,len);
+           if (n<0) return -1;
+           if (n==0) break;
+           len+=n;
+        }
+     }
+     context->buffer[len]=0;
+
+     if (len<context->buffer_size-1 || path==NULL ||
+         context->buffer_size>=PAPI_NODE_DATA_LEN) {
+        return len;
+     }
+
+     /* done once a complete line does not start with "cpu" */
+     p=context->buffer;
+     while((p=strchr(p,'\n'))!=NULL) {
+        p++;
+        if (strlen(p)>=3 && strncmp(p,"cpu",3)) return len;
+        if (strlen(p)<3) break;
+     }
+
+     buffer=realloc(context->buffer,2*context->buffer_size);
+     if (buffer==NULL) return -1;
+     context->buffer=buffer;
+     context->buffer_size*=2;
+  }
+}
 
+/* Parse the next blank-separated decimal number */
+static inline long long
+next_number( const char **str )
+{
+  const char *p=*str;
+  long long value=0;
+
+  while(*p==' ' || *p=='\t') p++;
+  if (*p<'0' || *p>'9') {
+     *str=NULL;
+     return 0;
+  }
+  while(*p>='0' && *p<='9') value=value*10+(*p++-'0');
+  *str=p;
+
+  return value;
+}
+
+/* steal is the 8th value of every "cpu" line of /proc/stat */
 static int
-read_stealtime( struct STEALTIME_context *context, int starting) {
+read_proc_stat( struct STEALTIME_context *context, int source ) {
 
-  FILE *fff;
-  char buffer[BUFSIZ],*result;
-  int i,count;
-  struct statinfo our_stat;
+  const char *line,*p;
+  int i,j;
 
-  int hz=sysconf(_SC_CLK_TCK);
+  if (read_file(context,&context->stat_fd,stat_file,source)<0) {
+     return PAPI_ESYS;
+  }
 
+  line=context->buffer;
+  for(i=0;i<num_cpu_events;i++) {
+     if (strncmp(line,"cpu",3)) return PAPI_ESYS;
 
-  fff=fopen("/proc/stat","r");
-  if (fff==NULL) {
-     return PAPI_ESYS; 
+     p=line+3;
+     while(*p && *p!=' ') p++;
+     for(j=0;j<8 && p!=NULL;j++) {
+        context->steal[i]=next_number(&p);
+     }
+     if (p==NULL) return PAPI_ESYS;
+
+     line=strchr(p,'\n');
+     if (line==NULL) return (i==num_cpu_events-1)?PAPI_OK:PAPI_ESYS;
+     line++;
   }
 
-  for(i=0;i<num_events;i++) {
-    result=fgets(buffer,BUFSIZ,fff);
-    if (result==NULL) break;
-
-    count=sscanf(buffer,"%*s %lld %lld %lld %lld %lld %lld %lld %lld %lld",
-		 &our_stat.user,
-		 &our_stat.nice,
-		 &our_stat.system,
-		 &our_stat.idle,
-		 &our_stat.iowait,
-		 &our_stat.irq,
-		 &our_stat.softirq,
-		 &our_stat.steal,
-		 &our_stat.guest);
-    if (count<=7) {
-       fclose(fff);
-       return PAPI_ESYS;
-    }
+  return PAPI_OK;
+}
 
-    if (starting) {
-       context->start_count[i]=our_stat.steal;
-    }
-    context->current_count[i]=our_stat.steal;
+static int
+read_schedstat( struct STEALTIME_context *context ) {
+
+  char path[PAPI_MAX_STR_LEN];
+  const char *p;
+  int i;
+
+  /* opened by, and kept for, the thread that counts */
+  if (context->schedstat_fd<0) {
+     snprintf(path,sizeof(path),"%s/self/task/%ld/schedstat",
+              proc_dir,(long)syscall(SYS_gettid));
+     context->schedstat_fd=open(path,O_RDONLY);
+     if (context->schedstat_fd<0) return PAPI_ESYS;
+  }
+
+  if (read_file(context,&context->schedstat_fd,NULL,-1)<0) {
+     return PAPI_ESYS;
+  }
+
+  p=context->buffer;
+  for(i=0;i<STEALTIME_THREAD_EVENTS && p!=NULL;i++) {
+     context->sched[i]=next_number(&p);
+  }
+  if (p==NULL) return PAPI_ESYS;
+
+  return PAPI_OK;
+}
+
+/* Read the raw counts of the events of an EventSet */
+static int
+read_stealtime( struct STEALTIME_context *context,
+                struct STEALTIME_control_state *control,
+                long long *counts ) {
+
+  int i,index,retval;
 
-    /* convert to us */
-    context->value[i]=(context->current_count[i]-context->start_count[i])*
-      (1000000/hz);
+  if (control->need_stat) {
+     retval=read_proc_stat(context,control->stat_source);
+     if (retval!=PAPI_OK) return retval;
+  }
+  if (control->need_schedstat) {
+     retval=read_schedstat(context);
+     if (retval!=PAPI_OK) return retval;
   }
-  
 
-  fclose(fff);
+  for(i=0;i<control->num_events;i++) {
+     index=control->which_counter[i];
+     if (index<num_cpu_events) {
+        counts[i]=context->steal[index];
+     }
+     else {
+        counts[i]=context->sched[index-num_cpu_events];
+     }
+  }
 
   return PAPI_OK;
+}
 
+/* Convert a raw difference to the units of the event */
+static long long
+scale_count( int index, long long count ) {
+
+  if (index<num_cpu_events) return count*ticks_to_us;  /* ticks to us */
+  if (index-num_cpu_events<2) return count/1000;       /* ns to us */
+
+  return count;
 }
 
 
@@ -140,11 +277,24 @@ _stealtime_init_component( int cidx )
   (void)cidx;
 
 	FILE *fff;
-	char buffer[BUFSIZ],*result,string[BUFSIZ];
+	char buffer[BUFSIZ],*result,string[BUFSIZ],*env;
 	int i;
+	static const char *thread_events[STEALTIME_THREAD_EVENTS][2]={
+	   {"THREAD_RUNTIME","Time this thread ran on a cpu"},
+	   {"THREAD_WAIT","Time this thread was runnable but waited on a "
+	                  "runqueue for a cpu"},
+	   {"THREAD_TIMESLICES","Number of timeslices this thread ran"},
+	};
+
+	env=getenv("PAPI_STEALTIME_PROC_DIR");
+	snprintf(proc_dir,sizeof(proc_dir),"%s",env?env:"/proc");
+	snprintf(stat_file,sizeof(stat_file),"%s/stat",proc_dir);
+
+	env=getenv("PAPI_STEALTIME_REFRESH_LATENCY");
+	if (env!=NULL) refresh_latency=atoll(env);
 
 	/* Make sure /proc/stat exists */
-	fff=fopen("/proc/stat","r");
+	fff=_papi_node_fopen(stat_file);
 	if (fff==NULL) {
 	   strncpy(_stealtime_vector.cmp_info.disabled_reason,
 		   "Cannot open /proc/stat",PAPI_MAX_STR_LEN);
@@ -179,6 +329,12 @@ _stealtime_init_component( int cidx )
        retval = PAPI_ESYS;
        goto fn_fail;
 	}
+	num_cpu_events=num_events;
+
+	/* Per-thread scheduler statistics need CONFIG_SCHED_INFO */
+	snprintf(string,sizeof(string),"%s/self/schedstat",proc_dir);
+	num_thread_events=(access(string,R_OK)==0)?STEALTIME_THREAD_EVENTS:0;
+	num_events+=num_thread_events;
 
 	event_info=calloc(num_events,sizeof(struct counter_info));
 	if (event_info==NULL) {
@@ -187,13 +343,13 @@ _stealtime_init_component( int cidx )
         goto fn_fail;
 	}
 
-	
-	sysconf(_SC_CLK_TCK);
+
+	ticks_to_us=1000000/sysconf(_SC_CLK_TCK);
 	event_info[0].name=strdup("TOTAL");
 	event_info[0].description=strdup("Total amount of steal time");
 	event_info[0].units=strdup("us");
 
-	for(i=1;i<num_events;i++) {
+	for(i=1;i<num_cpu_events;i++) {
 	   sprintf(string,"CPU%d",i);
 	   event_info[i].name=strdup(string);
 	   sprintf(string,"Steal time for CPU %d",i);
@@ -201,6 +357,12 @@ _stealtime_init_component( int cidx )
 	   event_info[i].units=strdup("us");
         }
 
+	for(i=0;i<num_thread_events;i++) {
+	   event_info[num_cpu_events+i].name=strdup(thread_events[i][0]);
+	   event_info[num_cpu_events+i].description=strdup(thread_events[i][1]);
+	   event_info[num_cpu_events+i].units=strdup(i<2?"us":"");
+	}
+
 	//	printf("Found %d CPUs\n",num_events-1);
 
 	_stealtime_vector.cmp_info.num_native_events=num_events;
@@ -226,14 +388,16 @@ _stealtime_init_thread( hwd_context_t * ctx )
 {
   struct STEALTIME_context *context=(struct STEALTIME_context *)ctx;
 
-  context->start_count=calloc(num_events,sizeof(long long));
-  if (context->start_count==NULL) return PAPI_ENOMEM;
+  context->stat_fd=-1;
+  context->schedstat_fd=-1;
 
-  context->current_count=calloc(num_events,sizeof(long long));
-  if (context->current_count==NULL) return PAPI_ENOMEM;
+  /* room for the cpu lines, grown if they do not fit */
+  context->buffer_size=BUFSIZ;
+  context->buffer=malloc(context->buffer_size);
+  if (context->buffer==NULL) return PAPI_ENOMEM;
 
-  context->value=calloc(num_events,sizeof(long long));
-  if (context->value==NULL) return PAPI_ENOMEM;
+  context->steal=calloc(num_cpu_events+1,sizeof(long long));
+  if (context->steal==NULL) return PAPI_ENOMEM;
 
   return PAPI_OK;
 }
@@ -268,9 +432,15 @@ _stealtime_shutdown_thread( hwd_context_t * ctx )
 
   struct STEALTIME_context *context=(struct STEALTIME_context *)ctx;
 
-  if (context->start_count!=NULL) free(context->start_count);
-  if (context->current_count!=NULL) free(context->current_count);
-  if (context->value!=NULL) free(context->value);
+  if (context->stat_fd>=0) close(context->stat_fd);
+  if (context->schedstat_fd>=0) close(context->schedstat_fd);
+  context->stat_fd=-1;
+  context->schedstat_fd=-1;
+
+  if (context->buffer!=NULL) free(context->buffer);
+  if (context->steal!=NULL) free(context->steal);
+  context->buffer=NULL;
+  context->steal=NULL;
 
   return PAPI_OK;
 }
@@ -284,12 +454,19 @@ static int
 _stealtime_init_control_state( hwd_control_state_t *ctl )
 {
 
-    struct STEALTIME_control_state *control = 
+    struct STEALTIME_control_state *control =
       (struct STEALTIME_control_state *)ctl;
 
     control->values=NULL;
+    control->start_count=NULL;
+    control->current_count=NULL;
     control->which_counter=NULL;
     control->num_events=0;
+    control->need_stat=0;
+    control->need_schedstat=0;
+    control->stat_source=-1;
+    control->lastupdate=0;
+    control->refresh_latency=refresh_latency;
 
     return PAPI_OK;
 }
@@ -299,9 +476,9 @@ _stealtime_init_control_state( hwd_control_state_t *ctl )
  *
  */
 static int
-_stealtime_update_control_state( hwd_control_state_t *ctl, 
+_stealtime_update_control_state( hwd_control_state_t *ctl,
 			      NativeInfo_t *native,
-			      int count, 
+			      int count,
 			      hwd_context_t *ctx )
 {
 
@@ -318,14 +495,22 @@ _stealtime_update_control_state( hwd_control_state_t *ctl,
 				      count*sizeof(int));
        control->values=realloc(control->values,
 			       count*sizeof(long long));
-       
+       control->start_count=realloc(control->start_count,
+			       count*sizeof(long long));
+       control->current_count=realloc(control->current_count,
+			       count*sizeof(long long));
+
     }
 
 
+    control->need_stat=0;
+    control->need_schedstat=0;
     for ( i = 0; i < count; i++ ) {
        index = native[i].ni_event;
        control->which_counter[i]=index;
        native[i].ni_position = i;
+       if (index<num_cpu_events) control->need_stat=1;
+       else control->need_schedstat=1;
     }
 
     control->num_events=count;
@@ -341,19 +526,25 @@ static int
 _stealtime_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
 
-  (void)ctl;
-
-  //    struct STEALTIME_control_state *control;
+    struct STEALTIME_control_state *control;
     struct STEALTIME_context *context;
-    
-    //control = (struct STEALTIME_control_state *)ctl;
+    int retval;
+
+    control = (struct STEALTIME_control_state *)ctl;
     context = (struct STEALTIME_context *)ctx;
 
-    read_stealtime( context, 1 );
+    /* resolved here so that reads are only a copy of the snapshot */
+    if (control->need_stat) {
+       control->stat_source=_papi_node_source(stat_file);
+    }
+
+    retval=read_stealtime( context, control, control->start_count );
+    if (retval!=PAPI_OK) return retval;
 
-    /* no need to update control, as we assume only one EventSet  */
-    /* is active at once, so starting things at the context level */
-    /* is fine, since stealtime is system-wide                    */
+    memcpy(control->current_count,control->start_count,
+           control->num_events*sizeof(long long));
+    memset(control->values,0,control->num_events*sizeof(long long));
+    control->lastupdate=PAPI_get_real_usec();
 
     return PAPI_OK;
 }
@@ -366,17 +557,13 @@ static int
 _stealtime_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
 
-  (void) ctl;
-
-  //    struct STEALTIME_control_state *control;
+    struct STEALTIME_control_state *control;
     struct STEALTIME_context *context;
-    
-    //control = (struct STEALTIME_control_state *)ctl;
+
+    control = (struct STEALTIME_control_state *)ctl;
     context = (struct STEALTIME_context *)ctx;
 
-    read_stealtime( context, 0 );
-
-    return PAPI_OK;
+    return read_stealtime( context, control, control->current_count );
 
 }
 
@@ -393,17 +580,24 @@ _stealtime_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 
     struct STEALTIME_control_state *control;
     struct STEALTIME_context *context;
+    long long now;
+    int i, retval;
 
-    int i;
-    
     control = (struct STEALTIME_control_state *)ctl;
     context = (struct STEALTIME_context *)ctx;
 
-    read_stealtime( context, 0 );
+    /* reuse the last values if they are fresh enough */
+    now=PAPI_get_real_usec();
+    if (control->refresh_latency==0 ||
+        now-control->lastupdate>control->refresh_latency) {
+       retval=read_stealtime( context, control, control->current_count );
+       if (retval!=PAPI_OK) return retval;
+       control->lastupdate=now;
+    }
 
     for(i=0;i<control->num_events;i++) {
-       control->values[i]=
-                 context->value[control->which_counter[i]];
+       control->values[i]=scale_count(control->which_counter[i],
+                 control->current_count[i]-control->start_count[i]);
     }
 
     *events = control->values;
@@ -424,9 +618,7 @@ _stealtime_reset( hwd_context_t * ctx, hwd_control_state_t * ctrl )
 
   /* re-initializes counter_start values to current */
 
-  _stealtime_start(ctx,ctrl);
-
-  return PAPI_OK;
+  return _stealtime_start(ctx,ctrl);
 }
 
 
@@ -451,13 +643,19 @@ _stealtime_reset( hwd_context_t * ctx, hwd_control_state_t * ctrl )
 /* This function sets various options in the component
  * The valid codes being passed in are PAPI_SET_DEFDOM,
  * PAPI_SET_DOMAIN, PAPI_SETDEFGRN, PAPI_SET_GRANUL * and PAPI_SET_INHERIT
+ * and PAPI_REFRESH_LATENCY
  */
 static int
 _stealtime_ctl( hwd_context_t * ctx, int code, _papi_int_option_t * option )
 {
 	( void ) ctx;
-	( void ) code;
-	( void ) option;
+
+	struct STEALTIME_control_state *control;
+
+	if ( code == PAPI_REFRESH_LATENCY ) {
+	   control = (struct STEALTIME_control_state *)option->refresh.ESI->ctl_state;
+	   control->refresh_latency = option->refresh.usec;
+	}
 
 	return PAPI_OK;
 }
@@ -605,6 +803,9 @@ papi_vector_t _stealtime_vector = {
        .fast_virtual_timer = 0,
        .attach = 0,
        .attach_must_ptrace = 0,
+       .refresh_latency = 1,
+       .node_sampled = 1,
+       .parallel_init = 1,
        .available_domains = PAPI_DOM_USER | PAPI_DOM_KERNEL,
   },
 
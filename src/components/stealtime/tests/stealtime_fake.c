@@ -0,0 +1,206 @@
+/**
+ * @author  PAPI team UTK/ICL
+ *
+ * test case for stealtime component
+ *
+ *
+ * @brief
+ *   Checks the per-cpu and per-thread stealtime events against fake
+ *   /proc/stat and schedstat files (PAPI_STEALTIME_PROC_DIR), with
+ *   enough cpus that /proc/stat does not fit the initial buffer, and
+ *   checks the PAPI_REFRESH_LATENCY read cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_CPUS 300
+#define NUM_EVENTS 5
+
+static char proc_dir[] = "/tmp/papi_stealXXXXXX";
+static char task_dir[PAPI_MAX_STR_LEN];
+
+static const char *event_names[NUM_EVENTS] = {
+	"stealtime:::TOTAL", "stealtime:::CPU300", "stealtime:::THREAD_RUNTIME",
+	"stealtime:::THREAD_WAIT", "stealtime:::THREAD_TIMESLICES"
+};
+
+static void
+write_files( long long steal, long long run_ns, long long wait_ns,
+	     long long slices )
+{
+	char path[PAPI_MAX_STR_LEN];
+	FILE *fff;
+	int i;
+
+	/* rewritten in place, the component keeps them open */
+	snprintf(path,sizeof(path),"%s/stat",proc_dir);
+	fff=fopen(path,"w");
+	if (fff==NULL) test_fail(__FILE__,__LINE__,path,PAPI_ESYS);
+	fprintf(fff,"cpu  1000 0 1000 100000 0 0 0 %lld 0 0\n",NUM_CPUS*steal);
+	for(i=0;i<NUM_CPUS;i++) {
+	   fprintf(fff,"cpu%d 10 0 10 1000 0 0 0 %lld 0 0\n",i,steal);
+	}
+	fprintf(fff,"intr 0 0 0\nctxt 0\n");
+	fclose(fff);
+
+	snprintf(path,sizeof(path),"%s/schedstat",task_dir);
+	fff=fopen(path,"w");
+	if (fff==NULL) test_fail(__FILE__,__LINE__,path,PAPI_ESYS);
+	fprintf(fff,"%lld %lld %lld\n",run_ns,wait_ns,slices);
+	fclose(fff);
+}
+
+static void
+cleanup( void )
+{
+	char path[PAPI_MAX_STR_LEN];
+
+	snprintf(path,sizeof(path),"%s/schedstat",task_dir);
+	unlink(path);
+	rmdir(task_dir);
+	snprintf(path,sizeof(path),"%s/self/task",proc_dir);
+	rmdir(path);
+	snprintf(path,sizeof(path),"%s/self/schedstat",proc_dir);
+	unlink(path);
+	snprintf(path,sizeof(path),"%s/self",proc_dir);
+	rmdir(path);
+	snprintf(path,sizeof(path),"%s/stat",proc_dir);
+	unlink(path);
+	rmdir(proc_dir);
+}
+
+static void
+check( long long *values, long long steal, long long run_ns,
+       long long wait_ns, long long slices, const char *what )
+{
+	long long expected[NUM_EVENTS];
+	long long tick_us=1000000/sysconf(_SC_CLK_TCK);
+	int i;
+
+	expected[0]=NUM_CPUS*steal*tick_us;
+	expected[1]=steal*tick_us;
+	expected[2]=run_ns/1000;
+	expected[3]=wait_ns/1000;
+	expected[4]=slices;
+
+	for(i=0;i<NUM_EVENTS;i++) {
+	   if (!TESTS_QUIET) {
+	      printf("%-10s %-30s %lld (expected %lld)\n",what,
+		     event_names[i],values[i],expected[i]);
+	   }
+	   if (values[i]!=expected[i]) {
+	      cleanup();
+	      test_fail(__FILE__,__LINE__,what,0);
+	   }
+	}
+}
+
+int main (int argc, char **argv)
+{
+	int retval,i;
+	int EventSet = PAPI_NULL;
+	long long values[NUM_EVENTS];
+	char path[PAPI_MAX_STR_LEN];
+	PAPI_option_t opt;
+	FILE *fff;
+
+	/* Set TESTS_QUIET variable */
+	tests_quiet( argc, argv );
+
+	/* Build the fake tree before PAPI looks for it */
+	if (mkdtemp(proc_dir)==NULL) {
+	   test_fail(__FILE__,__LINE__,"mkdtemp",PAPI_ESYS);
+	}
+	snprintf(path,sizeof(path),"%s/self",proc_dir);
+	mkdir(path,0700);
+	snprintf(path,sizeof(path),"%s/self/task",proc_dir);
+	mkdir(path,0700);
+	snprintf(task_dir,sizeof(task_dir),"%s/self/task/%ld",proc_dir,
+		 (long)syscall(SYS_gettid));
+	mkdir(task_dir,0700);
+	snprintf(path,sizeof(path),"%s/self/schedstat",proc_dir);
+	fff=fopen(path,"w");
+	if (fff!=NULL) fclose(fff);
+
+	write_files(100,1000000,2000000,10);
+
+	setenv("PAPI_STEALTIME_PROC_DIR",proc_dir,1);
+
+	/* PAPI Initialization */
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+	   test_fail(__FILE__, __LINE__,"PAPI_library_init failed\n",retval);
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_create_eventset()",retval);
+	}
+
+	for(i=0;i<NUM_EVENTS;i++) {
+	   retval = PAPI_add_named_event( EventSet, event_names[i] );
+	   if (retval != PAPI_OK) {
+	      cleanup();
+	      if (i==0) test_skip(__FILE__,__LINE__,"stealtime not available",0);
+	      test_fail(__FILE__, __LINE__, event_names[i], retval);
+	   }
+	}
+
+	retval = PAPI_start( EventSet );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_start()",retval);
+	}
+
+	write_files(105,3000000,9000000,14);
+
+	retval = PAPI_read( EventSet, values );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_read()",retval);
+	}
+	check(values,5,2000000,7000000,4,"read");
+
+	/* values may now be a minute old */
+	memset(&opt,0,sizeof(opt));
+	opt.refresh.eventset=EventSet;
+	opt.refresh.usec=60000000LL;
+	retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_set_opt()",retval);
+	}
+
+	write_files(110,5000000,11000000,20);
+
+	retval = PAPI_read( EventSet, values );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_read()",retval);
+	}
+	check(values,5,2000000,7000000,4,"cached");
+
+	opt.refresh.usec=0;
+	retval = PAPI_set_opt( PAPI_REFRESH_LATENCY, &opt );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_set_opt()",retval);
+	}
+
+	retval = PAPI_stop( EventSet, values );
+	if (retval != PAPI_OK) {
+	   test_fail(__FILE__, __LINE__, "PAPI_stop()",retval);
+	}
+	check(values,10,4000000,9000000,10,"stopped");
+
+	cleanup();
+
+	PAPI_shutdown();
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
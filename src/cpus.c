@@ -270,6 +270,25 @@ insert_cpu( CpuInfo_t * entry )
 
 
 
+/* Call init_thread of a component that was just initialized for
+   every cpu that already exists.  Must be called with CPUS_LOCK held! */
+int
+_papi_hwi_init_cmp_cpus( int cidx )
+{
+   CpuInfo_t *tmp;
+   int retval = PAPI_OK;
+
+   for ( tmp = _papi_hwi_cpu_head; tmp != NULL; tmp = tmp->next ) {
+      retval = _papi_hwd[cidx]->init_thread( tmp->context[cidx] );
+      if ( retval != PAPI_OK )
+         break;
+      if ( tmp->next == _papi_hwi_cpu_head )
+         break;
+   }
+
+   return retval;
+}
+
 /* Must be called with CPUS_LOCK held! */
 int
 _papi_hwi_initialize_cpu( CpuInfo_t **dest, unsigned int cpu_num )
@@ -285,11 +304,15 @@ _papi_hwi_initialize_cpu( CpuInfo_t **dest, unsigned int cpu_num )
       return PAPI_ENOMEM;
    }
 
-   /* Call the component to fill in anything special. */
+   /* Call the component to fill in anything special.  Deferred
+      components are initialized with CPUS_LOCK held, so they can not
+      miss this cpu. */
    for ( i = 0; i < papi_num_components; i++ ) {
       if (_papi_hwd[i]->cmp_info.disabled &&
           _papi_hwd[i]->cmp_info.disabled != PAPI_EDELAY_INIT)
           continue;
+      if ( _papi_hwi_cmp_deferred( i ) )
+          continue;
       retval = _papi_hwd[i]->init_thread( cpu->context[i] );
       if ( retval ) {
 	 free_cpu( &cpu );
@@ -0,0 +1,173 @@
+/*
+* File:    add_events_batch.c
+*/
+
+/* This file checks PAPI_add_events.
+
+   An array of events added at once must give the same event set, in
+   the same order, as adding them one by one, and must count.  When one
+   of them can not be added, the number added before it is returned, as
+   it always was.  The time of building the same set over and over
+   both ways is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_EVENTS 4
+#define NUM_BUILDS 200
+
+static const char *names[NUM_EVENTS] = {
+	"perf::TASK-CLOCK",
+	"perf::PAGE-FAULTS",
+	"perf::CONTEXT-SWITCHES",
+	"perf::CPU-MIGRATIONS",
+};
+
+/* build, start, stop and clean up a set of the events, return usec */
+static long long
+build_set( int *events, int num, int batch )
+{
+	long long values[NUM_EVENTS], t0, t1;
+	int EventSet = PAPI_NULL, retval, i;
+
+	t0 = PAPI_get_real_usec(  );
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+	if ( batch ) {
+		retval = PAPI_add_events( EventSet, events, num );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_add_events", retval );
+	} else {
+		for ( i = 0; i < num; i++ ) {
+			retval = PAPI_add_event( EventSet, events[i] );
+			if ( retval != PAPI_OK )
+				test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+		}
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+	t1 = PAPI_get_real_usec(  );
+
+	return t1 - t0;
+}
+
+int
+main( int argc, char **argv )
+{
+	int events[NUM_EVENTS + 1], listed[NUM_EVENTS + 1];
+	long long values[NUM_EVENTS], one_usec = 0, batch_usec = 0;
+	int EventSet = PAPI_NULL, retval, num = 0, n, i;
+
+	tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	for ( i = 0; i < NUM_EVENTS; i++ ) {
+		if ( PAPI_event_name_to_code( names[i], &events[num] ) == PAPI_OK )
+			num++;
+	}
+	if ( num < 2 )
+		test_skip( __FILE__, __LINE__, "perf software events", 0 );
+
+	/* the whole array */
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	retval = PAPI_add_events( EventSet, events, num );
+	if ( retval == PAPI_ECNFLCT || retval == PAPI_EPERM ||
+	     retval == PAPI_ESYS )
+		test_skip( __FILE__, __LINE__, "PAPI_add_events", retval );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_add_events", retval );
+
+	n = NUM_EVENTS + 1;
+	retval = PAPI_list_events( EventSet, listed, &n );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_list_events", retval );
+	if ( n != num || memcmp( listed, events, num * sizeof ( int ) ) )
+		test_fail( __FILE__, __LINE__, "events listed differ", n );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	for ( i = 0; i < 1000000; i++ )
+		free( malloc( 64 ) );
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	if ( values[0] <= 0 )
+		test_fail( __FILE__, __LINE__, names[0], ( int ) values[0] );
+
+	/* a duplicate after the first two adds those two */
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	events[num] = events[2];
+	events[2] = events[0];
+	retval = PAPI_add_events( EventSet, events, num );
+	if ( retval != 2 )
+		test_fail( __FILE__, __LINE__, "PAPI_add_events duplicate", retval );
+	n = NUM_EVENTS + 1;
+	retval = PAPI_list_events( EventSet, listed, &n );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_list_events", retval );
+	if ( n != 2 || memcmp( listed, events, 2 * sizeof ( int ) ) )
+		test_fail( __FILE__, __LINE__, "events listed differ", n );
+	events[2] = events[num];
+
+	/* an invalid code first adds nothing */
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	events[num] = events[0];
+	events[0] = 0;
+	retval = PAPI_add_events( EventSet, events, num );
+	if ( retval >= 0 )
+		test_fail( __FILE__, __LINE__, "PAPI_add_events invalid", retval );
+	retval = PAPI_num_events( EventSet );
+	if ( retval != 0 )
+		test_fail( __FILE__, __LINE__, "events left in the set", retval );
+	events[0] = events[num];
+
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+
+	for ( i = 0; i < NUM_BUILDS; i++ ) {
+		one_usec += build_set( events, num, 0 );
+		batch_usec += build_set( events, num, 1 );
+	}
+
+	if ( !TESTS_QUIET ) {
+		printf( "%d builds of a set of %d events\n", NUM_BUILDS, num );
+		printf( "one by one:      %8lld usec\n", one_usec );
+		printf( "PAPI_add_events: %8lld usec\n", batch_usec );
+	}
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,210 @@
+/*
+* File:    event_cache.c
+*/
+
+/* This file checks the event cache (PAPI_EVENT_CACHE).
+
+   The first PAPI_library_init writes the cache, the second must use
+   it as is, and a cache file that is truncated or corrupted must be
+   ignored and written again.  Each time the available presets, with
+   the native events and codes they are built from, must be the same,
+   and a preset must still count if it can be added.  The init times are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define SNAPSHOT_LEN	( 1024 * 1024 )
+
+static char cache_file[] = "/tmp/papi_evcXXXXXX";
+static int add_retval = 1;          /* of the first PAPI_add_event */
+
+/* print the available presets and what they are made of */
+static int
+snapshot_presets( char *buf, int len )
+{
+	PAPI_event_info_t info;
+	int code = PAPI_PRESET_MASK, n = 0, num = 0;
+	unsigned int i;
+
+	buf[0] = '\0';
+	if ( PAPI_enum_event( &code, PAPI_ENUM_FIRST ) != PAPI_OK )
+		return 0;
+	do {
+		if ( PAPI_get_event_info( code, &info ) != PAPI_OK || info.count == 0 )
+			continue;
+		n += snprintf( buf + n, len - n, "%s %s %s %s:", info.symbol,
+			       info.derived, info.postfix, info.long_descr );
+		for ( i = 0; i < info.count && n < len; i++ ) {
+			n += snprintf( buf + n, len - n, " %#x %s", info.code[i],
+				       info.name[i] );
+		}
+		n += snprintf( buf + n, len - n, "\n" );
+		if ( n >= len )
+			test_fail( __FILE__, __LINE__, "snapshot too large", 0 );
+		num++;
+	} while ( PAPI_enum_event( &code, PAPI_PRESET_ENUM_AVAIL ) == PAPI_OK );
+
+	return num;
+}
+
+/* init PAPI, count a preset and shut down again */
+static int
+run( char *snapshot, const char *what )
+{
+	long long t0, t1, value;
+	volatile double x = 0.5;
+	int retval, i, num, EventSet = PAPI_NULL;
+
+	t0 = PAPI_get_real_usec(  );
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	t1 = PAPI_get_real_usec(  );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	num = snapshot_presets( snapshot, SNAPSHOT_LEN );
+	if ( !TESTS_QUIET )
+		printf( "%-10s PAPI_library_init %6lld usec, %d presets\n", what,
+			t1 - t0, num );
+
+	/* adding may fail where the counters are not accessible, but
+	   then it must fail the same way with the cache */
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	retval = PAPI_add_event( EventSet, PAPI_TOT_INS );
+	if ( add_retval == 1 )
+		add_retval = retval;
+	if ( retval != add_retval )
+		test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+	if ( retval == PAPI_OK ) {
+		retval = PAPI_start( EventSet );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+		for ( i = 0; i < 1000000; i++ )
+			x = x * 0.999 + 0.001;
+		retval = PAPI_stop( EventSet, &value );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+		if ( value < 1000000 )
+			test_fail( __FILE__, __LINE__, "PAPI_TOT_INS too low", 0 );
+	}
+
+	PAPI_shutdown(  );
+
+	return num;
+}
+
+static ino_t
+cache_inode( void )
+{
+	struct stat st;
+
+	if ( stat( cache_file, &st ) < 0 )
+		return 0;
+	return st.st_ino;
+}
+
+static void
+damage_cache( int truncate )
+{
+	struct stat st;
+	char *data;
+	FILE *fff;
+
+	if ( stat( cache_file, &st ) < 0 ||
+	     ( data = malloc( st.st_size ) ) == NULL )
+		test_fail( __FILE__, __LINE__, cache_file, PAPI_ESYS );
+
+	fff = fopen( cache_file, "r" );
+	if ( fff == NULL || fread( data, 1, st.st_size, fff ) != ( size_t ) st.st_size )
+		test_fail( __FILE__, __LINE__, cache_file, PAPI_ESYS );
+	fclose( fff );
+
+	/* a new file, so that a rewrite shows as a new inode */
+	unlink( cache_file );
+	fff = fopen( cache_file, "w" );
+	if ( fff == NULL )
+		test_fail( __FILE__, __LINE__, cache_file, PAPI_ESYS );
+	if ( truncate ) {
+		fwrite( data, 1, st.st_size / 2, fff );
+	} else {
+		data[st.st_size / 2] ^= 0xff;
+		fwrite( data, 1, st.st_size, fff );
+	}
+	fclose( fff );
+	free( data );
+}
+
+int
+main( int argc, char **argv )
+{
+	char *first, *snapshot;
+	ino_t inode;
+	int fd, num;
+
+	tests_quiet( argc, argv );
+
+	fd = mkstemp( cache_file );
+	if ( fd < 0 )
+		test_fail( __FILE__, __LINE__, "mkstemp", PAPI_ESYS );
+	close( fd );
+	unlink( cache_file );
+	setenv( "PAPI_EVENT_CACHE", cache_file, 1 );
+
+	first = malloc( SNAPSHOT_LEN );
+	snapshot = malloc( SNAPSHOT_LEN );
+	if ( first == NULL || snapshot == NULL )
+		test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+
+	num = run( first, "written" );
+	inode = cache_inode(  );
+	if ( inode == 0 ) {
+		/* only the perf_event component has a cache */
+		test_skip( __FILE__, __LINE__, "no event cache written", 0 );
+	}
+	if ( num == 0 ) {
+		unlink( cache_file );
+		test_skip( __FILE__, __LINE__, "no presets", 0 );
+	}
+
+	run( snapshot, "cached" );
+	if ( strcmp( first, snapshot ) )
+		test_fail( __FILE__, __LINE__, "presets differ with the cache", 0 );
+	if ( cache_inode(  ) != inode )
+		test_fail( __FILE__, __LINE__, "valid cache was rewritten", 0 );
+
+	damage_cache( 1 );
+	inode = cache_inode(  );
+	run( snapshot, "truncated" );
+	if ( strcmp( first, snapshot ) )
+		test_fail( __FILE__, __LINE__, "presets differ after truncation", 0 );
+	if ( cache_inode(  ) == inode )
+		test_fail( __FILE__, __LINE__, "truncated cache was kept", 0 );
+
+	damage_cache( 0 );
+	inode = cache_inode(  );
+	run( snapshot, "corrupted" );
+	if ( strcmp( first, snapshot ) )
+		test_fail( __FILE__, __LINE__, "presets differ after corruption", 0 );
+	if ( cache_inode(  ) == inode )
+		test_fail( __FILE__, __LINE__, "corrupted cache was kept", 0 );
+
+	run( snapshot, "cached" );
+	if ( strcmp( first, snapshot ) )
+		test_fail( __FILE__, __LINE__, "presets differ with the cache", 0 );
+
+	unlink( cache_file );
+	free( first );
+	free( snapshot );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
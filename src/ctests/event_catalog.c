@@ -0,0 +1,162 @@
+/*
+* File:    event_catalog.c
+*/
+
+/* This file checks PAPI_get_event_catalog.
+
+   For each active component the catalog must list the same events, in
+   the same order and with the same names, descriptions and units, as
+   PAPI_enum_cmp_event with PAPI_get_event_info, and the unit masks of
+   each event as its qualifiers.  The presets of the catalog must be
+   the available ones.  The time of both ways is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+/* the catalog entry must match the event info; components that do
+   not name their events get new codes on each enumeration, so the
+   code is only checked to give the same name */
+static void
+check_entry( const PAPI_catalog_entry_t *e, const PAPI_event_info_t *info )
+{
+	char name[PAPI_HUGE_STR_LEN];
+
+	if ( PAPI_event_code_to_name( ( int ) e->event_code, name ) != PAPI_OK ||
+	     strncmp( name, e->symbol, PAPI_MAX_STR_LEN - 1 ) ||
+	     strcmp( e->symbol, info->symbol ) ||
+	     strcmp( e->short_descr, info->short_descr ) ||
+	     strcmp( e->long_descr, info->long_descr ) ||
+	     strcmp( e->units, info->units ) ) {
+		if ( !TESTS_QUIET )
+			printf( "catalog %#x %s, info %#x %s\n", e->event_code,
+				e->symbol, info->event_code, info->symbol );
+		test_fail( __FILE__, __LINE__, "catalog entry differs", 0 );
+	}
+}
+
+/* walk the native events with PAPI_enum_cmp_event and compare */
+static long long
+compare_events( int cid, const PAPI_event_catalog_t *catalog,
+		const PAPI_catalog_entry_t *e )
+{
+	PAPI_event_info_t info;
+	long long t0, t1;
+	int code = PAPI_NATIVE_MASK, k, n;
+
+	t0 = PAPI_get_real_usec(  );
+	if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK ) {
+		if ( e != NULL )
+			test_fail( __FILE__, __LINE__, "extra events in the catalog", 0 );
+		return 0;
+	}
+	do {
+		if ( PAPI_get_event_info( code, &info ) != PAPI_OK )
+			continue;
+		if ( e == NULL )
+			test_fail( __FILE__, __LINE__, "event missing in the catalog", 0 );
+		check_entry( e, &info );
+
+		n = info.num_quals;
+		k = code;
+		while ( PAPI_enum_cmp_event( &k, PAPI_NTV_ENUM_UMASKS, cid ) == PAPI_OK ) {
+			if ( PAPI_get_event_info( k, &info ) == PAPI_OK )
+				n++;
+		}
+		if ( e->num_quals != n )
+			test_fail( __FILE__, __LINE__, e->symbol, e->num_quals );
+		for ( k = 0; k < e->num_quals; k++ ) {
+			if ( e->quals[k] == NULL || e->quals_descrs[k] == NULL ||
+			     e->quals[k][0] == '\0' )
+				test_fail( __FILE__, __LINE__, e->symbol, k );
+		}
+
+		e = PAPI_catalog_next( catalog, e );
+	} while ( PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	t1 = PAPI_get_real_usec(  );
+
+	if ( e != NULL )
+		test_fail( __FILE__, __LINE__, "extra events in the catalog", 0 );
+
+	return t1 - t0;
+}
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	const PAPI_catalog_entry_t *e;
+	PAPI_event_catalog_t *catalog;
+	PAPI_event_info_t info;
+	long long t0, t1, enum_usec;
+	int retval, cid, numcmp, tested = 0;
+
+	tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	retval = PAPI_get_event_catalog( 0, 0, NULL );
+	if ( retval != PAPI_EINVAL )
+		test_fail( __FILE__, __LINE__, "PAPI_get_event_catalog NULL", retval );
+	retval = PAPI_get_event_catalog( -1, 0, &catalog );
+	if ( retval != PAPI_ENOCMP )
+		test_fail( __FILE__, __LINE__, "PAPI_get_event_catalog -1", retval );
+
+	if ( !TESTS_QUIET )
+		printf( "%-24s %8s %8s %10s %12s %12s\n", "component", "events",
+			"quals", "bytes", "catalog usec", "enum usec" );
+
+	numcmp = PAPI_num_components(  );
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+		if ( cmpinfo->disabled )
+			continue;
+
+		t0 = PAPI_get_real_usec(  );
+		retval = PAPI_get_event_catalog( cid, PAPI_CATALOG_PRESETS |
+						 PAPI_CATALOG_QUALIFIERS, &catalog );
+		t1 = PAPI_get_real_usec(  );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_get_event_catalog", retval );
+		if ( catalog->component_index != cid ||
+		     strcmp( catalog->component, cmpinfo->name ) )
+			test_fail( __FILE__, __LINE__, cmpinfo->name, 0 );
+
+		/* the available presets come first */
+		e = PAPI_catalog_next( catalog, NULL );
+		while ( e != NULL && ( e->event_code & PAPI_PRESET_MASK ) ) {
+			retval = PAPI_get_event_info( ( int ) e->event_code, &info );
+			if ( retval != PAPI_OK || info.count == 0 )
+				test_fail( __FILE__, __LINE__, e->symbol, retval );
+			check_entry( e, &info );
+			e = PAPI_catalog_next( catalog, e );
+		}
+
+		enum_usec = compare_events( cid, catalog, e );
+
+		if ( !TESTS_QUIET )
+			printf( "%-24s %8d %8d %10lu %12lld %12lld\n", cmpinfo->name,
+				catalog->num_events, catalog->num_quals,
+				( unsigned long ) catalog->size, t1 - t0, enum_usec );
+
+		PAPI_free_event_catalog( catalog );
+		tested++;
+	}
+
+	PAPI_shutdown(  );
+
+	if ( tested == 0 )
+		test_skip( __FILE__, __LINE__, "no active components", 0 );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/* This file checks EventSet handles while many threads create	*/
+/* and destroy EventSets concurrently.  Every thread keeps more	*/
+/* EventSets alive than fit in one chunk of the EventSet table,	*/
+/* so the table has to grow while other threads look up their	*/
+/* handles.  A destroyed handle must not resolve any more, even	*/
+/* after its slot has been handed out again.  Meanwhile one more	*/
+/* thread keeps looking up handles of the slots being recycled.	*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NITER 20
+#define NSETS 300
+
+/* Handles are (generation << 18) | slot.  No slot reaches the last
+   generation in this test, so these handles never resolve, but their
+   lookups look at the EventSets being destroyed. */
+#define PROBE_HANDLE( slot ) ( ( 8191 << 18 ) | ( slot ) )
+
+static volatile int done;
+static long nslots;
+
+static void *
+Probe( void *data )
+{
+	int state;
+	long i = 0;
+
+	( void ) data;
+
+	while ( !done ) {
+		if ( PAPI_state( PROBE_HANDLE( i ), &state ) != PAPI_ENOEVST )
+			test_fail( __FILE__, __LINE__, "probe handle resolved", 0 );
+		if ( ++i == nslots )
+			i = 0;
+	}
+
+	return ( NULL );
+}
+
+static void *
+Thread( void *data )
+{
+	int sets[NSETS];
+	int i, j, k, ret, state, stale;
+
+	( void ) data;
+
+	if ( ( ret = PAPI_register_thread(  ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_register_thread", ret );
+
+	for ( i = 0; i < NITER; i++ ) {
+		for ( j = 0; j < NSETS; j++ ) {
+			sets[j] = PAPI_NULL;
+			if ( ( ret = PAPI_create_eventset( &sets[j] ) ) != PAPI_OK )
+				test_fail( __FILE__, __LINE__, "PAPI_create_eventset", ret );
+		}
+
+		for ( j = 0; j < NSETS; j++ ) {
+			if ( ( ret = PAPI_state( sets[j], &state ) ) != PAPI_OK )
+				test_fail( __FILE__, __LINE__, "PAPI_state", ret );
+			for ( k = 0; k < j; k++ ) {
+				if ( sets[k] == sets[j] )
+					test_fail( __FILE__, __LINE__, "duplicate EventSet", 0 );
+			}
+		}
+
+		for ( j = 0; j < NSETS; j++ ) {
+			stale = sets[j];
+			if ( ( ret = PAPI_destroy_eventset( &sets[j] ) ) != PAPI_OK )
+				test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", ret );
+			if ( PAPI_state( stale, &state ) != PAPI_ENOEVST )
+				test_fail( __FILE__, __LINE__, "destroyed EventSet still valid", 0 );
+		}
+	}
+
+	if ( ( ret = PAPI_unregister_thread(  ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_unregister_thread", ret );
+
+	return ( NULL );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	pthread_t *th, probe;
+	int i, ret, state, stale, fresh;
+	long nthr;
+	const PAPI_hw_info_t *hwinfo;
+
+	tests_quiet( argc, argv );	/*Set TESTS_QUIET variable */
+
+	ret = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( ret != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", ret );
+
+	if ( ( ret =
+		   PAPI_thread_init( ( unsigned
+							   long ( * )( void ) ) ( pthread_self ) ) ) !=
+		 PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_thread_init", ret );
+
+	/* A reused slot must give out a new handle */
+	stale = PAPI_NULL;
+	if ( ( ret = PAPI_create_eventset( &stale ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", ret );
+	i = stale;
+	if ( ( ret = PAPI_destroy_eventset( &i ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", ret );
+
+	fresh = PAPI_NULL;
+	if ( ( ret = PAPI_create_eventset( &fresh ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", ret );
+	if ( fresh == stale )
+		test_fail( __FILE__, __LINE__, "EventSet handle reused", 0 );
+	if ( PAPI_state( stale, &state ) != PAPI_ENOEVST )
+		test_fail( __FILE__, __LINE__, "stale EventSet resolved", 0 );
+	if ( ( ret = PAPI_destroy_eventset( &fresh ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", ret );
+
+	if ( ( hwinfo = PAPI_get_hardware_info(  ) ) == NULL )
+		test_fail( __FILE__, __LINE__, "PAPI_get_hardware_info", 0 );
+
+	nthr = hwinfo->ncpu;
+	if ( nthr < 4 )
+		nthr = 4;
+
+	if ( !TESTS_QUIET ) {
+		printf( "Creating %ld threads, each creating and destroying "
+				"%d EventSets %d times\n", nthr, NSETS, NITER );
+	}
+
+	th = ( pthread_t * ) malloc( ( size_t ) nthr * sizeof ( pthread_t ) );
+	if ( th == NULL )
+		test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+
+	nslots = nthr * NSETS;
+	ret = pthread_create( &probe, NULL, &Probe, NULL );
+	if ( ret )
+		test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+
+	for ( i = 0; i < nthr; i++ ) {
+		ret = pthread_create( &th[i], NULL, &Thread, NULL );
+		if ( ret )
+			test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+	}
+
+	for ( i = 0; i < nthr; i++ ) {
+		pthread_join( th[i], NULL );
+	}
+
+	done = 1;
+	pthread_join( probe, NULL );
+
+	free( th );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
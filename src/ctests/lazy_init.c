@@ -0,0 +1,123 @@
+/*
+* File:    lazy_init.c
+*/
+
+/* This file checks the deferred initialization of components.
+
+   PAPI_library_init only initializes perf_event and perf_event_uncore,
+   the other components are initialized by the first
+   PAPI_get_component_info.  The time of PAPI_library_init and of the
+   initialization of each component is printed.  The components must
+   end up the same as with PAPI_EAGER_COMPONENT_INIT set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+typedef struct {
+	int disabled;
+	int num_native_events;
+} cmp_state_t;
+
+static long long
+init_library( void )
+{
+	long long t0, t1;
+	int retval;
+
+	t0 = PAPI_get_real_usec(  );
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	t1 = PAPI_get_real_usec(  );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	return t1 - t0;
+}
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	cmp_state_t *lazy;
+	long long t0, t1, total, init;
+	int cid, numcmp;
+
+	tests_quiet( argc, argv );
+
+	unsetenv( "PAPI_EAGER_COMPONENT_INIT" );
+	init = init_library(  );
+	total = init;
+
+	numcmp = PAPI_num_components(  );
+	lazy = calloc( numcmp, sizeof ( cmp_state_t ) );
+	if ( lazy == NULL )
+		test_fail( __FILE__, __LINE__, "calloc", PAPI_ENOMEM );
+
+	if ( !TESTS_QUIET ) {
+		printf( "%-24s %10s  %s\n", "component", "init usec", "events" );
+		printf( "%-24s %10lld\n", "PAPI_library_init", init );
+	}
+
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		t0 = PAPI_get_real_usec(  );
+		cmpinfo = PAPI_get_component_info( cid );
+		t1 = PAPI_get_real_usec(  );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+		total += t1 - t0;
+
+		lazy[cid].disabled = cmpinfo->disabled;
+		lazy[cid].num_native_events = cmpinfo->num_native_events;
+
+		if ( cmpinfo->disabled == PAPI_EDELAY_INIT )
+			test_fail( __FILE__, __LINE__, cmpinfo->name, cmpinfo->disabled );
+
+		/* the second call must not initialize it again */
+		if ( PAPI_get_component_info( cid ) != cmpinfo ||
+		     cmpinfo->num_native_events != lazy[cid].num_native_events )
+			test_fail( __FILE__, __LINE__, cmpinfo->name, 0 );
+
+		if ( !TESTS_QUIET ) {
+			printf( "%-24s %10lld  %d%s\n", cmpinfo->name, t1 - t0,
+				cmpinfo->num_native_events,
+				cmpinfo->disabled ? " (disabled)" : "" );
+		}
+	}
+
+	PAPI_shutdown(  );
+
+	/* everything at PAPI_library_init */
+	setenv( "PAPI_EAGER_COMPONENT_INIT", "1", 1 );
+	init = init_library(  );
+
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+		if ( cmpinfo->disabled != lazy[cid].disabled ||
+		     cmpinfo->num_native_events != lazy[cid].num_native_events ) {
+			if ( !TESTS_QUIET )
+				printf( "%s: disabled %d, %d events eager, %d, %d deferred\n",
+					cmpinfo->name, cmpinfo->disabled,
+					cmpinfo->num_native_events, lazy[cid].disabled,
+					lazy[cid].num_native_events );
+			test_fail( __FILE__, __LINE__, "deferred init differs", 0 );
+		}
+	}
+
+	if ( !TESTS_QUIET ) {
+		printf( "%-24s %10lld\n", "all, deferred", total );
+		printf( "%-24s %10lld\n", "all, eager", init );
+	}
+
+	PAPI_shutdown(  );
+	free( lazy );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+* File:    name_cache.c
+*/
+
+/* This file checks the cache of PAPI_event_name_to_code.
+
+   The native events of each active component are looked up by name
+   twice; the second lookup, served from the cache, must give the same
+   code, and the code must give back the name.  A name that does not
+   exist must keep failing, and the codes must still be right after
+   the library is shut down and initialized again.  The times of both
+   passes are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define MAX_NAMES	2000
+
+static char names[MAX_NAMES][PAPI_MAX_STR_LEN];
+static int codes[MAX_NAMES];
+static int errors[MAX_NAMES];
+
+/* the names of the first native events of every active component */
+static int
+collect_names( void )
+{
+	const PAPI_component_info_t *cmpinfo;
+	int cid, code, n = 0;
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL || cmpinfo->disabled )
+			continue;
+		code = PAPI_NATIVE_MASK;
+		if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+			continue;
+		do {
+			if ( PAPI_event_code_to_name( code, names[n] ) == PAPI_OK )
+				n++;
+		} while ( n < MAX_NAMES &&
+			  PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	}
+	return n;
+}
+
+/* look up every name, checking it against the first pass if check */
+static long long
+lookup_names( int n, int check )
+{
+	char name[PAPI_MAX_STR_LEN];
+	long long t0;
+	int i, code, retval;
+
+	t0 = PAPI_get_real_usec(  );
+	for ( i = 0; i < n; i++ ) {
+		code = 0;
+		retval = PAPI_event_name_to_code( names[i], &code );
+		if ( !check ) {
+			codes[i] = code;
+			errors[i] = retval;
+			continue;
+		}
+		/* names that did not resolve were not cached */
+		if ( errors[i] != PAPI_OK )
+			continue;
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, names[i], retval );
+		if ( code != codes[i] ) {
+			if ( !TESTS_QUIET )
+				printf( "%s: %#x then %#x\n", names[i], codes[i], code );
+			test_fail( __FILE__, __LINE__, "cached code differs", 0 );
+		}
+		retval = PAPI_event_code_to_name( code, name );
+		if ( retval != PAPI_OK || strcmp( name, names[i] ) )
+			test_fail( __FILE__, __LINE__, names[i], retval );
+	}
+	return PAPI_get_real_usec(  ) - t0;
+}
+
+int
+main( int argc, char **argv )
+{
+	long long first, second;
+	int retval, n, i, code;
+
+	tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	n = collect_names(  );
+	if ( n == 0 )
+		test_skip( __FILE__, __LINE__, "no native events", 0 );
+
+	first = lookup_names( n, 0 );
+	second = lookup_names( n, 1 );
+	if ( !TESTS_QUIET )
+		printf( "%d names: first lookup %lld usec, cached %lld usec\n",
+			n, first, second );
+
+	for ( i = 0; i < 2; i++ ) {
+		if ( PAPI_event_name_to_code( "no::SUCH_EVENT_NAME", &code ) == PAPI_OK )
+			test_fail( __FILE__, __LINE__, "no::SUCH_EVENT_NAME", 0 );
+	}
+
+	PAPI_shutdown(  );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	lookup_names( n, 0 );
+	lookup_names( n, 1 );
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
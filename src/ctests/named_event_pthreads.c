@@ -0,0 +1,182 @@
+/* This file checks event name lookups from many threads at once.	*/
+/* Over a hundred threads resolve the same native event names,	*/
+/* most of them for the first time, before they register with	*/
+/* PAPI, then create EventSets and add the events by name.  All	*/
+/* threads must get the same code for a name, and the code must	*/
+/* give back the name and its event info.			*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NTHREADS 128
+#define NITER 2
+#define MAX_NAMES 256
+
+static char names[MAX_NAMES][PAPI_MAX_STR_LEN];
+static int num_names;
+static int addable[MAX_NAMES];     /* can be added to an EventSet alone */
+static int codes[NTHREADS][MAX_NAMES];
+
+/* native event names of the active components, with unit masks */
+static void
+collect_names( void )
+{
+	const PAPI_component_info_t *cmpinfo;
+	int cid, code, umask;
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL || cmpinfo->disabled )
+			continue;
+		code = PAPI_NATIVE_MASK;
+		if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+			continue;
+		do {
+			umask = code;
+			if ( PAPI_enum_cmp_event( &umask, PAPI_NTV_ENUM_UMASKS, cid ) == PAPI_OK &&
+			     num_names < MAX_NAMES &&
+			     PAPI_event_code_to_name( umask, names[num_names] ) == PAPI_OK )
+				num_names++;
+			if ( num_names < MAX_NAMES &&
+			     PAPI_event_code_to_name( code, names[num_names] ) == PAPI_OK )
+				num_names++;
+		} while ( num_names < MAX_NAMES && num_names < ( cid + 1 ) * 48 &&
+			  PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	}
+}
+
+static void *
+Thread( void *data )
+{
+	long id = ( long ) data;
+	PAPI_event_info_t info;
+	char name[PAPI_MAX_STR_LEN];
+	int i, j, k, ret, code, EventSet;
+
+	/* lookups, not registered yet */
+	for ( i = 0; i < NITER; i++ ) {
+		for ( k = 0; k < num_names; k++ ) {
+			j = ( int ) ( ( k + id ) % num_names );
+			ret = PAPI_event_name_to_code( names[j], &code );
+			if ( ret != PAPI_OK )
+				code = ret;
+			if ( i == 0 )
+				codes[id][j] = code;
+			else if ( codes[id][j] != code )
+				test_fail( __FILE__, __LINE__, names[j], code );
+			if ( ret != PAPI_OK )
+				continue;
+			ret = PAPI_event_code_to_name( code, name );
+			if ( ret != PAPI_OK || strcmp( name, names[j] ) )
+				test_fail( __FILE__, __LINE__, names[j], ret );
+			ret = PAPI_get_event_info( code, &info );
+			if ( ret != PAPI_OK || strcmp( info.symbol, names[j] ) )
+				test_fail( __FILE__, __LINE__, names[j], ret );
+		}
+	}
+
+	if ( ( ret = PAPI_register_thread(  ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_register_thread", ret );
+
+	for ( k = 0; k < num_names; k++ ) {
+		j = ( int ) ( ( k + id ) % num_names );
+		if ( !addable[j] )
+			continue;
+		EventSet = PAPI_NULL;
+		if ( ( ret = PAPI_create_eventset( &EventSet ) ) != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_create_eventset", ret );
+		if ( ( ret = PAPI_add_named_event( EventSet, names[j] ) ) != PAPI_OK )
+			test_fail( __FILE__, __LINE__, names[j], ret );
+		if ( ( ret = PAPI_cleanup_eventset( EventSet ) ) != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", ret );
+		if ( ( ret = PAPI_destroy_eventset( &EventSet ) ) != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", ret );
+	}
+
+	if ( ( ret = PAPI_unregister_thread(  ) ) != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_unregister_thread", ret );
+
+	return ( NULL );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	pthread_t th[NTHREADS];
+	long long t0, t1;
+	int i, j, ret, code, EventSet, resolved = 0;
+
+	tests_quiet( argc, argv );	/*Set TESTS_QUIET variable */
+
+	ret = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( ret != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", ret );
+
+	if ( ( ret =
+		   PAPI_thread_init( ( unsigned
+							   long ( * )( void ) ) ( pthread_self ) ) ) !=
+		 PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_thread_init", ret );
+
+	collect_names(  );
+	if ( num_names == 0 )
+		test_skip( __FILE__, __LINE__, "no native events", 0 );
+
+	/* only a few events are added, the rest is resolved by the */
+	/* threads first                                            */
+	for ( i = 0; i < num_names; i += 16 ) {
+		EventSet = PAPI_NULL;
+		if ( ( ret = PAPI_create_eventset( &EventSet ) ) != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_create_eventset", ret );
+		addable[i] = PAPI_add_named_event( EventSet, names[i] ) == PAPI_OK;
+		PAPI_cleanup_eventset( EventSet );
+		PAPI_destroy_eventset( &EventSet );
+	}
+
+	if ( !TESTS_QUIET ) {
+		printf( "Creating %d threads, each resolving %d event names "
+				"%d times\n", NTHREADS, num_names, NITER );
+	}
+
+	t0 = PAPI_get_real_usec(  );
+	for ( i = 0; i < NTHREADS; i++ ) {
+		ret = pthread_create( &th[i], NULL, &Thread, ( void * ) ( long ) i );
+		if ( ret )
+			test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+	}
+
+	for ( i = 0; i < NTHREADS; i++ ) {
+		pthread_join( th[i], NULL );
+	}
+	t1 = PAPI_get_real_usec(  );
+
+	/* every thread got the same code for a name */
+	for ( j = 0; j < num_names; j++ ) {
+		for ( i = 1; i < NTHREADS; i++ ) {
+			if ( codes[i][j] != codes[0][j] ) {
+				if ( !TESTS_QUIET )
+					printf( "%s: %#x in thread 0, %#x in thread %d\n",
+						names[j], codes[0][j], codes[i][j], i );
+				test_fail( __FILE__, __LINE__, "codes differ", 0 );
+			}
+		}
+		if ( PAPI_event_name_to_code( names[j], &code ) == PAPI_OK ) {
+			if ( code != codes[0][j] )
+				test_fail( __FILE__, __LINE__, names[j], code );
+			resolved++;
+		}
+	}
+
+	if ( !TESTS_QUIET )
+		printf( "%d of %d names resolved, %lld usec\n", resolved, num_names,
+			t1 - t0 );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
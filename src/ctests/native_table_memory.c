@@ -0,0 +1,94 @@
+/*
+* File:    native_table_memory.c
+*/
+
+/* This file reports the memory used by the native event tables.
+
+   All native events of the perf_event components are enumerated with
+   their unit masks, and their names and descriptions are read, so every
+   event ends up in the tables.  The heap in use before and after, the
+   number of events and the time taken are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+static size_t
+heap_in_use( void )
+{
+#if defined(__GLIBC__) && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 33 ) )
+	struct mallinfo2 mi = mallinfo2(  );
+#else
+	struct mallinfo mi = mallinfo(  );
+#endif
+	return ( size_t ) mi.uordblks + ( size_t ) mi.hblkhd;
+}
+
+static void
+visit( int code, int *count )
+{
+	PAPI_event_info_t info;
+
+	if ( PAPI_get_event_info( code, &info ) == PAPI_OK )
+		( *count )++;
+}
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	size_t before, after;
+	long long t0, t1;
+	int retval, cid, code, umask, count = 0, tested = 0;
+
+	tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	before = heap_in_use(  );
+	t0 = PAPI_get_real_usec(  );
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL || cmpinfo->disabled ||
+		     strncmp( cmpinfo->name, "perf_event", 10 ) )
+			continue;
+		tested++;
+
+		code = PAPI_NATIVE_MASK;
+		if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+			continue;
+		do {
+			visit( code, &count );
+			umask = code;
+			while ( PAPI_enum_cmp_event( &umask, PAPI_NTV_ENUM_UMASKS, cid ) == PAPI_OK )
+				visit( umask, &count );
+		} while ( PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	}
+
+	t1 = PAPI_get_real_usec(  );
+	after = heap_in_use(  );
+
+	if ( tested == 0 )
+		test_skip( __FILE__, __LINE__, "no perf_event component", 0 );
+
+	if ( !TESTS_QUIET )
+		printf( "%d events: heap %lu -> %lu bytes (+%lu, %lu per event), %lld usec\n",
+			count, ( unsigned long ) before, ( unsigned long ) after,
+			( unsigned long ) ( after - before ),
+			count ? ( unsigned long ) ( ( after - before ) / count ) : 0UL,
+			t1 - t0 );
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+/*
+* File:    node_sampler.c
+*/
+
+/* This file checks node-wide sampling (PAPI_NODE_SAMPLE_MS).
+
+   The parent initializes PAPI first and so owns the publisher, which
+   samples a fake /proc tree (PAPI_NODE_SAMPLE_ROOT).  Only the
+   publisher applies the root, so the fake values the child counts
+   through the net and stealtime components can only come from the
+   shared segment, which is gone once both processes shut down.
+
+         fork();
+         /    \
+     parent   child
+     PAPI_library_init()
+              PAPI_library_init()
+              PAPI_start()
+     update fake /proc
+              PAPI_stop()
+     wait()
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define RX_START	1000LL
+#define RX_DELTA	123456LL
+#define STEAL_START	500LL
+#define STEAL_DELTA	42LL
+
+static char root[] = "/tmp/papi_nodeXXXXXX";
+static char shm_name[PAPI_MIN_STR_LEN];
+
+static void
+write_proc( long long rx, long long steal )
+{
+	char path[PAPI_MAX_STR_LEN];
+	FILE *fff;
+
+	/* rewrite in place, the publisher keeps the files open */
+	snprintf( path, sizeof ( path ), "%s/proc/net/dev", root );
+	fff = fopen( path, "w" );
+	if ( fff == NULL )
+		test_fail( __FILE__, __LINE__, path, PAPI_ESYS );
+	fprintf( fff, "Inter-|   Receive                            "
+			 "                    |  Transmit\n" );
+	fprintf( fff, " face |bytes    packets errs drop fifo frame "
+			 "compressed multicast|bytes    packets errs drop fifo colls "
+			 "carrier compressed\n" );
+	fprintf( fff, "  eth0: %lld 10 0 0 0 0 0 0 2000 20 0 0 0 0 0 0\n", rx );
+	fclose( fff );
+
+	snprintf( path, sizeof ( path ), "%s/proc/stat", root );
+	fff = fopen( path, "w" );
+	if ( fff == NULL )
+		test_fail( __FILE__, __LINE__, path, PAPI_ESYS );
+	fprintf( fff, "cpu  100 0 100 1000 0 0 0 %lld 0 0\n", steal );
+	fprintf( fff, "cpu0 100 0 100 1000 0 0 0 %lld 0 0\n", steal );
+	fprintf( fff, "intr 0\n" );
+	fclose( fff );
+}
+
+static void
+cleanup( void )
+{
+	char path[PAPI_MAX_STR_LEN];
+
+	snprintf( path, sizeof ( path ), "%s/proc/net/dev", root );
+	unlink( path );
+	snprintf( path, sizeof ( path ), "%s/proc/stat", root );
+	unlink( path );
+	snprintf( path, sizeof ( path ), "%s/proc/net", root );
+	rmdir( path );
+	snprintf( path, sizeof ( path ), "%s/proc", root );
+	rmdir( path );
+	rmdir( root );
+	shm_unlink( shm_name );
+}
+
+static int
+component_enabled( const char *name )
+{
+	const PAPI_component_info_t *cmpinfo;
+	int cid;
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo && !strcmp( cmpinfo->name, name ) )
+			return !cmpinfo->disabled;
+	}
+	return 0;
+}
+
+/* Returns 0 on success, 1 on a wrong count, 2 if the components are
+   not there */
+static int
+child( int go, int done )
+{
+	int retval, NetSet = PAPI_NULL, StealSet = PAPI_NULL;
+	long long values[2], expected[2];
+	char c;
+
+	if ( read( go, &c, 1 ) != 1 )
+		return 1;
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		return 1;
+
+	if ( !component_enabled( "net" ) || !component_enabled( "stealtime" ) )
+		return 2;
+
+	/* one EventSet per component */
+	if ( PAPI_create_eventset( &NetSet ) != PAPI_OK ||
+		 PAPI_create_eventset( &StealSet ) != PAPI_OK )
+		return 1;
+	if ( PAPI_add_named_event( NetSet, "net:::eth0:rx:byte" ) != PAPI_OK )
+		return 1;
+	if ( PAPI_add_named_event( StealSet, "stealtime:::TOTAL" ) != PAPI_OK )
+		return 1;
+	if ( PAPI_start( NetSet ) != PAPI_OK || PAPI_start( StealSet ) != PAPI_OK )
+		return 1;
+
+	/* let the parent change the files, then give the publisher time */
+	if ( write( done, "s", 1 ) != 1 || read( go, &c, 1 ) != 1 )
+		return 1;
+	usleep( 100000 );
+
+	if ( PAPI_stop( NetSet, &values[0] ) != PAPI_OK ||
+		 PAPI_stop( StealSet, &values[1] ) != PAPI_OK )
+		return 1;
+
+	expected[0] = RX_DELTA;
+	expected[1] = STEAL_DELTA * ( 1000000 / sysconf( _SC_CLK_TCK ) );
+
+	if ( !TESTS_QUIET )
+		printf( "child: rx bytes %lld (expected %lld), steal %lld "
+				"(expected %lld)\n",
+				values[0], expected[0], values[1], expected[1] );
+
+	PAPI_shutdown(  );
+
+	return ( values[0] == expected[0] && values[1] == expected[1] ) ? 0 : 1;
+}
+
+int
+main( int argc, char **argv )
+{
+	int retval, status, to_child[2], to_parent[2];
+	char path[PAPI_MAX_STR_LEN], c;
+	pid_t pid;
+
+	tests_quiet( argc, argv );	/* Set TESTS_QUIET variable */
+
+	if ( mkdtemp( root ) == NULL )
+		test_fail( __FILE__, __LINE__, "mkdtemp", PAPI_ESYS );
+	snprintf( path, sizeof ( path ), "%s/proc", root );
+	mkdir( path, 0700 );
+	snprintf( path, sizeof ( path ), "%s/proc/net", root );
+	mkdir( path, 0700 );
+	write_proc( RX_START, STEAL_START );
+
+	snprintf( shm_name, sizeof ( shm_name ), "/papi_node_test.%d",
+			  ( int ) getpid(  ) );
+	setenv( "PAPI_NODE_SHM_NAME", shm_name, 1 );
+	setenv( "PAPI_NODE_SAMPLE_MS", "5", 1 );
+	setenv( "PAPI_NODE_SAMPLE_ROOT", root, 1 );
+	setenv( "PAPI_NET_REFRESH_LATENCY", "0", 1 );
+
+	if ( pipe( to_child ) || pipe( to_parent ) )
+		test_fail( __FILE__, __LINE__, "pipe", PAPI_ESYS );
+
+	pid = fork(  );
+	if ( pid < 0 )
+		test_fail( __FILE__, __LINE__, "fork", PAPI_ESYS );
+	if ( pid == 0 ) {
+		close( to_child[1] );
+		close( to_parent[0] );
+		exit( child( to_child[0], to_parent[1] ) );
+	}
+	close( to_child[0] );
+	close( to_parent[1] );
+
+	/* the parent creates the segment and publishes */
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	/* the components that read through it attach at init */
+	retval = shm_open( shm_name, O_RDONLY, 0 );
+	if ( retval < 0 && component_enabled( "net" ) ) {
+		kill( pid, SIGKILL );
+		cleanup(  );
+		test_fail( __FILE__, __LINE__, "no node segment after init", 0 );
+	}
+	if ( retval >= 0 )
+		close( retval );
+
+	if ( write( to_child[1], "g", 1 ) != 1 )
+		test_fail( __FILE__, __LINE__, "write", PAPI_ESYS );
+
+	/* child started its counters */
+	if ( read( to_parent[0], &c, 1 ) == 1 ) {
+		write_proc( RX_START + RX_DELTA, STEAL_START + STEAL_DELTA );
+		if ( write( to_child[1], "g", 1 ) != 1 )
+			test_fail( __FILE__, __LINE__, "write", PAPI_ESYS );
+	}
+
+	if ( waitpid( pid, &status, 0 ) != pid )
+		test_fail( __FILE__, __LINE__, "waitpid", PAPI_ESYS );
+
+	PAPI_shutdown(  );
+
+	/* the last process to detach removes the segment */
+	retval = shm_open( shm_name, O_RDONLY, 0 );
+	if ( retval >= 0 )
+		close( retval );
+
+	cleanup(  );
+
+	if ( retval >= 0 )
+		test_fail( __FILE__, __LINE__, "node segment left behind", 0 );
+
+	if ( !WIFEXITED( status ) )
+		test_fail( __FILE__, __LINE__, "child did not exit", 0 );
+	if ( WEXITSTATUS( status ) == 2 )
+		test_skip( __FILE__, __LINE__, "net or stealtime component disabled",
+				   0 );
+	if ( WEXITSTATUS( status ) != 0 )
+		test_fail( __FILE__, __LINE__, "counts from the node segment", 0 );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+* File:    parallel_init.c
+*/
+
+/* This file checks the parallel initialization of components.
+
+   PAPI_library_init runs once with all components initialized one
+   after the other (PAPI_EAGER_COMPONENT_INIT) and once on several
+   threads (PAPI_COMPONENT_INIT_THREADS).  The components and their
+   native events must be the same both times.  The init time of each
+   component, from PAPI_get_cmp_opt(PAPI_COMPONENT_INIT_USEC), and of
+   PAPI_library_init are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define SNAPSHOT_LEN	( 256 * 1024 )
+#define NUM_THREADS	"4"
+
+typedef struct {
+	int disabled;
+	char disabled_reason[PAPI_MAX_STR_LEN];
+	int num_native_events;
+	int num_cntrs;
+	int init_usec;
+	char *events;
+} cmp_state_t;
+
+/* native event names of a component, one per line */
+static void
+snapshot_events( int cid, char *buf, int len )
+{
+	char name[PAPI_MAX_STR_LEN];
+	int code = PAPI_NATIVE_MASK, n = 0;
+
+	buf[0] = '\0';
+	if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+		return;
+	do {
+		if ( PAPI_event_code_to_name( code, name ) != PAPI_OK )
+			continue;
+		n += snprintf( buf + n, len - n, "%s\n", name );
+		if ( n >= len )
+			test_fail( __FILE__, __LINE__, "snapshot too large", 0 );
+	} while ( PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+}
+
+static void
+run( cmp_state_t *state, int numcmp, const char *what )
+{
+	const PAPI_component_info_t *cmpinfo;
+	long long t0, t1;
+	int retval, cid;
+
+	t0 = PAPI_get_real_usec(  );
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	t1 = PAPI_get_real_usec(  );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	if ( PAPI_num_components(  ) != numcmp )
+		test_fail( __FILE__, __LINE__, "PAPI_num_components", 0 );
+
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo == NULL )
+			test_fail( __FILE__, __LINE__, "PAPI_get_component_info", 0 );
+
+		state[cid].init_usec =
+			PAPI_get_cmp_opt( PAPI_COMPONENT_INIT_USEC, NULL, cid );
+		if ( state[cid].init_usec < 0 )
+			test_fail( __FILE__, __LINE__, "PAPI_get_cmp_opt",
+				   state[cid].init_usec );
+
+		state[cid].disabled = cmpinfo->disabled;
+		strcpy( state[cid].disabled_reason, cmpinfo->disabled_reason );
+		state[cid].num_native_events = cmpinfo->num_native_events;
+		state[cid].num_cntrs = cmpinfo->num_cntrs;
+		state[cid].events = malloc( SNAPSHOT_LEN );
+		if ( state[cid].events == NULL )
+			test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+		snapshot_events( cid, state[cid].events, SNAPSHOT_LEN );
+	}
+
+	if ( !TESTS_QUIET )
+		printf( "%-24s %10lld usec\n", what, t1 - t0 );
+
+	PAPI_shutdown(  );
+}
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	cmp_state_t *serial, *parallel;
+	int retval, cid, numcmp;
+
+	tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	numcmp = PAPI_num_components(  );
+	PAPI_shutdown(  );
+
+	serial = calloc( numcmp, sizeof ( cmp_state_t ) );
+	parallel = calloc( numcmp, sizeof ( cmp_state_t ) );
+	if ( serial == NULL || parallel == NULL )
+		test_fail( __FILE__, __LINE__, "calloc", PAPI_ENOMEM );
+
+	unsetenv( "PAPI_COMPONENT_INIT_THREADS" );
+	setenv( "PAPI_EAGER_COMPONENT_INIT", "1", 1 );
+	run( serial, numcmp, "serial" );
+
+	unsetenv( "PAPI_EAGER_COMPONENT_INIT" );
+	setenv( "PAPI_COMPONENT_INIT_THREADS", NUM_THREADS, 1 );
+	run( parallel, numcmp, NUM_THREADS " threads" );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	if ( !TESTS_QUIET )
+		printf( "%-24s %10s %10s  %s\n", "component", "serial",
+			"parallel", "events" );
+
+	for ( cid = 0; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+
+		if ( !TESTS_QUIET )
+			printf( "%-24s %10d %10d  %d%s\n", cmpinfo->name,
+				serial[cid].init_usec, parallel[cid].init_usec,
+				parallel[cid].num_native_events,
+				parallel[cid].disabled ? " (disabled)" : "" );
+
+		if ( serial[cid].disabled != parallel[cid].disabled ||
+		     strcmp( serial[cid].disabled_reason,
+			     parallel[cid].disabled_reason ) ||
+		     serial[cid].num_native_events !=
+		     parallel[cid].num_native_events ||
+		     serial[cid].num_cntrs != parallel[cid].num_cntrs ||
+		     strcmp( serial[cid].events, parallel[cid].events ) )
+			test_fail( __FILE__, __LINE__, cmpinfo->name, 0 );
+
+		free( serial[cid].events );
+		free( parallel[cid].events );
+	}
+
+	PAPI_shutdown(  );
+	free( serial );
+	free( parallel );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+* File:    preset_table.c
+*/
+
+/* This file checks the compiled preset table (papi_events_compile).
+
+   The presets loaded from the table built into the library, from
+   papi_events.csv (PAPI_CSV_EVENT_FILE) and from papi_events.bin
+   (PAPI_BIN_EVENT_FILE) must be the same, with the native events and
+   codes they are built from.  A compiled table that is truncated or is
+   not one at all must be ignored.  The init times are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define SNAPSHOT_LEN	( 1024 * 1024 )
+
+static char bad_file[] = "/tmp/papi_pstXXXXXX";
+
+/* print the available presets and what they are made of */
+static int
+snapshot_presets( char *buf, int len )
+{
+	PAPI_event_info_t info;
+	int code = PAPI_PRESET_MASK, n = 0, num = 0;
+	unsigned int i;
+
+	buf[0] = '\0';
+	if ( PAPI_enum_event( &code, PAPI_ENUM_FIRST ) != PAPI_OK )
+		return 0;
+	do {
+		if ( PAPI_get_event_info( code, &info ) != PAPI_OK || info.count == 0 )
+			continue;
+		n += snprintf( buf + n, len - n, "%s %s %s %s %s:", info.symbol,
+			       info.derived, info.postfix, info.short_descr,
+			       info.long_descr );
+		for ( i = 0; i < info.count && n < len; i++ ) {
+			n += snprintf( buf + n, len - n, " %#x %s", info.code[i],
+				       info.name[i] );
+		}
+		n += snprintf( buf + n, len - n, "\n" );
+		if ( n >= len )
+			test_fail( __FILE__, __LINE__, "snapshot too large", 0 );
+		num++;
+	} while ( PAPI_enum_event( &code, PAPI_PRESET_ENUM_AVAIL ) == PAPI_OK );
+
+	return num;
+}
+
+static int
+run( char *snapshot, const char *what )
+{
+	long long t0, t1;
+	int retval, num;
+
+	t0 = PAPI_get_real_usec(  );
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	t1 = PAPI_get_real_usec(  );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	num = snapshot_presets( snapshot, SNAPSHOT_LEN );
+	if ( !TESTS_QUIET )
+		printf( "%-10s PAPI_library_init %6lld usec, %d presets\n", what,
+			t1 - t0, num );
+
+	PAPI_shutdown(  );
+
+	return num;
+}
+
+/* the first of the candidates that exists */
+static const char *
+find_file( const char *a, const char *b )
+{
+	if ( access( a, R_OK ) == 0 )
+		return a;
+	if ( access( b, R_OK ) == 0 )
+		return b;
+	return NULL;
+}
+
+/* the first half of the file, or a text file */
+static void
+write_bad_table( const char *table, int truncate )
+{
+	struct stat st;
+	char *data;
+	FILE *fff, *in;
+
+	fff = fopen( bad_file, "w" );
+	if ( fff == NULL )
+		test_fail( __FILE__, __LINE__, bad_file, PAPI_ESYS );
+	if ( truncate ) {
+		if ( stat( table, &st ) < 0 ||
+		     ( data = malloc( st.st_size ) ) == NULL )
+			test_fail( __FILE__, __LINE__, table, PAPI_ESYS );
+		in = fopen( table, "r" );
+		if ( in == NULL ||
+		     fread( data, 1, st.st_size, in ) != ( size_t ) st.st_size )
+			test_fail( __FILE__, __LINE__, table, PAPI_ESYS );
+		fclose( in );
+		fwrite( data, 1, st.st_size / 2, fff );
+		free( data );
+	} else {
+		fprintf( fff, "CPU,nothing\nPRESET,PAPI_TOT_INS,NOT_DERIVED,NONE\n" );
+	}
+	fclose( fff );
+}
+
+int
+main( int argc, char **argv )
+{
+	char *first, *snapshot;
+	const char *csv, *bin;
+	int fd, num;
+
+	tests_quiet( argc, argv );
+
+	unsetenv( "PAPI_EVENT_CACHE" );
+	unsetenv( "PAPI_CSV_EVENT_FILE" );
+	unsetenv( "PAPI_BIN_EVENT_FILE" );
+
+	first = malloc( SNAPSHOT_LEN );
+	snapshot = malloc( SNAPSHOT_LEN );
+	if ( first == NULL || snapshot == NULL )
+		test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+
+	num = run( first, "builtin" );
+	if ( num == 0 )
+		test_skip( __FILE__, __LINE__, "no presets", 0 );
+
+	csv = find_file( "papi_events.csv", "../papi_events.csv" );
+	if ( csv != NULL ) {
+		setenv( "PAPI_CSV_EVENT_FILE", csv, 1 );
+		run( snapshot, "csv" );
+		unsetenv( "PAPI_CSV_EVENT_FILE" );
+		if ( strcmp( first, snapshot ) )
+			test_fail( __FILE__, __LINE__, "presets differ with the csv file", 0 );
+	}
+
+	bin = find_file( "papi_events.bin", "../papi_events.bin" );
+	if ( bin != NULL ) {
+		setenv( "PAPI_BIN_EVENT_FILE", bin, 1 );
+		run( snapshot, "bin" );
+		if ( strcmp( first, snapshot ) )
+			test_fail( __FILE__, __LINE__, "presets differ with the bin file", 0 );
+
+		fd = mkstemp( bad_file );
+		if ( fd < 0 )
+			test_fail( __FILE__, __LINE__, "mkstemp", PAPI_ESYS );
+		close( fd );
+		setenv( "PAPI_BIN_EVENT_FILE", bad_file, 1 );
+
+		write_bad_table( bin, 1 );
+		run( snapshot, "truncated" );
+		if ( strcmp( first, snapshot ) )
+			test_fail( __FILE__, __LINE__, "truncated table was used", 0 );
+
+		write_bad_table( bin, 0 );
+		run( snapshot, "text" );
+		if ( strcmp( first, snapshot ) )
+			test_fail( __FILE__, __LINE__, "text file was used as a table", 0 );
+
+		unlink( bad_file );
+		unsetenv( "PAPI_BIN_EVENT_FILE" );
+	}
+
+	free( first );
+	free( snapshot );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
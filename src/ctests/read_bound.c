@@ -0,0 +1,111 @@
+/* This test checks that PAPI_read_bound() on a handle from
+   PAPI_bind_reader() returns the same counts as PAPI_read(),
+   and that the handle is invalidated by PAPI_stop().
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+int
+main( int argc, char **argv )
+{
+	int retval, num_events, mask, PAPI_event, i;
+	int EventSet = PAPI_NULL;
+	long long bound[2], plain[2], stopped[2];
+	PAPI_reader_t reader = NULL;
+	int quiet;
+
+	/* Set TESTS_QUIET variable */
+	quiet = tests_quiet( argc, argv );
+
+	/* Init the PAPI library */
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	EventSet = add_two_events( &num_events, &PAPI_event, &mask );
+
+	/* Binding a stopped EventSet is an error */
+	retval = PAPI_bind_reader( EventSet, &reader );
+	if ( retval != PAPI_ENOTRUN ) {
+		test_fail( __FILE__, __LINE__, "PAPI_bind_reader (stopped)", retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	retval = PAPI_bind_reader( EventSet, &reader );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_bind_reader", retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_read_bound( reader, bound );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_read_bound", retval );
+	}
+
+	retval = PAPI_read( EventSet, plain );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_read", retval );
+	}
+
+	retval = PAPI_stop( EventSet, stopped );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "PAPI_read_bound test.\n" );
+		printf( "%-12s %16s %16s %16s\n", "Event", "read_bound",
+			"read", "stop" );
+		for ( i = 0; i < num_events; i++ ) {
+			printf( "%-12d %16lld %16lld %16lld\n", i,
+				bound[i], plain[i], stopped[i] );
+		}
+	}
+
+	/* Counters only go up, so each later read must be at least as large */
+	for ( i = 0; i < num_events; i++ ) {
+		if ( bound[i] <= 0 ) {
+			test_fail( __FILE__, __LINE__, "PAPI_read_bound zero count", 1 );
+		}
+		if ( ( plain[i] < bound[i] ) || ( stopped[i] < plain[i] ) ) {
+			test_fail( __FILE__, __LINE__, "PAPI_read_bound ordering", 1 );
+		}
+	}
+
+	/* PAPI_stop() invalidates the handle */
+	retval = PAPI_read_bound( reader, bound );
+	if ( retval != PAPI_ENOTRUN ) {
+		test_fail( __FILE__, __LINE__, "PAPI_read_bound after stop", retval );
+	}
+
+	retval = PAPI_unbind_reader( &reader );
+	if ( ( retval != PAPI_OK ) || ( reader != NULL ) ) {
+		test_fail( __FILE__, __LINE__, "PAPI_unbind_reader", retval );
+	}
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	}
+
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -86,6 +86,19 @@ main( int argc, char **argv )
 
 	print_shlib_info_map(shinfo, quiet);
 
+	/* Nothing was loaded or unloaded, so the cached map is returned */
+	{
+		const PAPI_address_map_t *oldmap = shinfo->map;
+		int oldcount = shinfo->count;
+
+		if ( ( shinfo = PAPI_get_shared_lib_info(  ) ) == NULL ) {
+			test_fail( __FILE__, __LINE__, "PAPI_get_shared_lib_info", 1 );
+		}
+		if ( ( shinfo->count != oldcount ) || ( shinfo->map != oldmap ) ) {
+			test_fail( __FILE__, __LINE__, "PAPI_get_shared_lib_info cache", 1 );
+		}
+	}
+
 	/* Needed for debugging, so you can ^Z and stop the process, */
 	/* inspect /proc to see if it's right */
 	sleep( 1 );
@@ -1762,11 +1762,10 @@ static void _internal_hl_clean_up_all(bool deactivate)
 static int _internal_hl_check_for_clean_thread_states()
 {
    EventSetInfo_t *ESI;
-   DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
    int i;
 
-   for( i = 0; i < map->totalSlots; i++ ) {
-      ESI = map->dataSlotArray[i];
+   for( i = 0; i < _papi_hwi_system_info.global_eventset_map.totalSlots; i++ ) {
+      ESI = _papi_hwi_EventSet_in_slot( i );
       if ( ESI ) {
          if ( ESI->state & PAPI_RUNNING ) 
             return ( PAPI_EISRUN );
@@ -0,0 +1,165 @@
+/*
+ * find_events.c - time event name lookups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of libpfm, a performance monitoring support library for
+ * applications on Linux.
+ *
+ * Resolves the name of every event of the active PMUs with pfm_find_event(),
+ * once with and once without the PMU prefix, and checks that each lookup
+ * returns an event of that name. The first pass includes building the name
+ * indexes. With LIBPFM_ENCODE_INACTIVE=1 all PMU tables are on the active
+ * list, e.g. to measure lookups with the large uncore tables on any host.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <perfmon/err.h>
+
+#include <perfmon/pfmlib.h>
+
+typedef struct {
+	char	*fqstr;		/* pmu::event */
+	char	*name;		/* event */
+	int	idx;
+	int	present;	/* PMU detected on this host */
+	int	equiv;		/* alias, resolves to another event */
+} event_t;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * look up all events, return the number of wrong answers
+ */
+static int
+lookup_all(event_t *ev, int n, int fq, double *t, int *nlookups)
+{
+	pfm_event_info_t info;
+	double t0;
+	int i, idx, errors = 0;
+
+	*nlookups = 0;
+	t0 = now();
+	for (i = 0; i < n; i++) {
+		/*
+		 * without the PMU prefix only detected PMUs are searched
+		 * and the first one having the name wins
+		 */
+		if (!fq && !ev[i].present)
+			continue;
+		(*nlookups)++;
+		idx = pfm_find_event(fq ? ev[i].fqstr : ev[i].name);
+		if (idx < 0) {
+			warnx("cannot find %s: %s", fq ? ev[i].fqstr : ev[i].name, pfm_strerror(idx));
+			errors++;
+			continue;
+		}
+		/* duplicate names resolve to the first one */
+		if (idx == ev[i].idx || ev[i].equiv)
+			continue;
+		memset(&info, 0, sizeof(info));
+		if (pfm_get_event_info(idx, PFM_OS_NONE, &info) != PFM_SUCCESS
+		    || strcasecmp(info.name, ev[i].name)) {
+			warnx("%s resolved to wrong event %d", ev[i].fqstr, idx);
+			errors++;
+		}
+	}
+	*t = now() - t0;
+
+	return errors;
+}
+
+int
+main(void)
+{
+	pfm_pmu_info_t pinfo;
+	pfm_event_info_t info;
+	event_t *ev = NULL;
+	double t;
+	int inactive = getenv("LIBPFM_ENCODE_INACTIVE") != NULL;
+	int i, n = 0, max = 0, ret, errors = 0, pass, fq, nlookups;
+	pfm_pmu_t pmu;
+
+	ret = pfm_initialize();
+	if (ret != PFM_SUCCESS)
+		errx(1, "cannot initialize library: %s", pfm_strerror(ret));
+
+	pfm_for_all_pmus(pmu) {
+		memset(&pinfo, 0, sizeof(pinfo));
+		ret = pfm_get_pmu_info(pmu, &pinfo);
+		if (ret != PFM_SUCCESS || (!pinfo.is_present && !inactive))
+			continue;
+
+		for (i = pinfo.first_event; i != -1; i = pfm_get_event_next(i)) {
+			memset(&info, 0, sizeof(info));
+			ret = pfm_get_event_info(i, PFM_OS_NONE, &info);
+			if (ret != PFM_SUCCESS)
+				errx(1, "cannot get event info: %s", pfm_strerror(ret));
+			if (n == max) {
+				max = max ? 2 * max : 1024;
+				ev = realloc(ev, max * sizeof(*ev));
+				if (!ev)
+					errx(1, "out of memory");
+			}
+			ev[n].idx = i;
+			ev[n].present = pinfo.is_present;
+			ev[n].equiv = info.equiv != NULL;
+			ev[n].name = strdup(info.name);
+			ev[n].fqstr = malloc(strlen(pinfo.name) + strlen(info.name) + 3);
+			if (!ev[n].name || !ev[n].fqstr)
+				errx(1, "out of memory");
+			sprintf(ev[n].fqstr, "%s::%s", pinfo.name, info.name);
+			n++;
+		}
+		printf("%-24s %6d events\n", pinfo.name, pinfo.nevents);
+	}
+	printf("%d events\n", n);
+
+	for (pass = 0; pass < 2; pass++) {
+		for (fq = 1; fq >= 0; fq--) {
+			errors += lookup_all(ev, n, fq, &t, &nlookups);
+			printf("pass %d, %-12s %6d lookups %10.3f ms, %8.3f usec per lookup\n",
+				pass, fq ? "pmu::event" : "event", nlookups,
+				t * 1e3, nlookups ? t * 1e6 / nlookups : 0.0);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		free(ev[i].name);
+		free(ev[i].fqstr);
+	}
+	free(ev);
+
+	pfm_terminate();
+
+	if (errors)
+		errx(1, "%d lookups failed", errors);
+
+	return 0;
+}
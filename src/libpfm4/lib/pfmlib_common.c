@@ -1505,6 +1505,7 @@ pfm_terminate(void)
 {
 	pfmlib_node_t *n;
 	pfmlib_pmu_t *pmu;
+	int i;
 
 	if (PFMLIB_INITIALIZED() == 0)
 		return;
@@ -1518,6 +1519,11 @@ pfm_terminate(void)
 		if (pmu->pmu_terminate)
 			pmu->pmu_terminate(pmu);
 	}
+	/* tables may differ on the next pfm_initialize() */
+	pfmlib_for_each_pmu(i) {
+		free(pfmlib_pmus[i]->name_index);
+		pfmlib_pmus[i]->name_index = NULL;
+	}
 	pfm_cfg.initdone = 0;
 
 	pfmlib_node_init(&pfmlib_active_pmus_list);
@@ -1816,12 +1822,118 @@ match_event(void *this, pfmlib_event_desc_t *d, const char *e, const char *s)
 	return strcasecmp(e, s);
 }
 
+static inline unsigned int
+pfmlib_name_hash(const char *s)
+{
+	unsigned int h = 2166136261U; /* FNV-1a */
+
+	while (*s) {
+		h ^= (unsigned char)tolower((unsigned char)*s++);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static pfmlib_name_index_t *
+pfmlib_build_name_index(pfmlib_pmu_t *pmu)
+{
+	pfmlib_name_index_t *idx;
+	pfm_event_info_t einfo;
+	unsigned int size = 16, h, k;
+	int i, n = 0;
+
+	pfmlib_for_each_pmu_event(pmu, i)
+		n++;
+
+	while (size < 2U * n)
+		size <<= 1;
+
+	idx = malloc(sizeof(*idx) + size * sizeof(idx->slots[0]));
+	if (!idx)
+		return NULL;
+
+	idx->mask = size - 1;
+	for (k = 0; k < size; k++)
+		idx->slots[k].pidx = -1;
+
+	/*
+	 * inserted in enumeration order so that with duplicate
+	 * names the lookup finds the same event as a linear scan
+	 */
+	pfmlib_for_each_pmu_event(pmu, i) {
+		if (pmu->get_event_info(pmu, i, &einfo) != PFM_SUCCESS) {
+			free(idx);
+			return NULL;
+		}
+		h = pfmlib_name_hash(einfo.name);
+		for (k = h & idx->mask; idx->slots[k].pidx != -1; k = (k + 1) & idx->mask)
+			;
+		idx->slots[k].hash = h;
+		idx->slots[k].pidx = i;
+	}
+	DPRINT("%s: indexed %d events in %u slots\n", pmu->name, n, size);
+
+	return idx;
+}
+
+/*
+ * return private index of the first event of pmu matching s, and
+ * its info in einfo, or an error (PFM_ERR_NOTFOUND if none).
+ *
+ * PMUs using the default name matching are looked up in a hash index
+ * built on first use; PMUs with their own match_event() are scanned.
+ */
+static int
+pfmlib_find_pmu_event(pfmlib_pmu_t *pmu, pfmlib_event_desc_t *d, const char *s, pfm_event_info_t *einfo)
+{
+	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+	pfmlib_name_index_t *idx = NULL;
+	unsigned int h, k;
+	int i, ret;
+
+	match = pmu->match_event ? pmu->match_event : match_event;
+
+	if (match == match_event) {
+		idx = pmu->name_index;
+		if (!idx) {
+			idx = pfmlib_build_name_index(pmu);
+			/* another thread may have been faster */
+			if (idx && !__sync_bool_compare_and_swap(&pmu->name_index, NULL, idx)) {
+				free(idx);
+				idx = pmu->name_index;
+			}
+		}
+	}
+
+	if (idx) {
+		h = pfmlib_name_hash(s);
+		for (k = h & idx->mask; idx->slots[k].pidx != -1; k = (k + 1) & idx->mask) {
+			if (idx->slots[k].hash != h)
+				continue;
+			ret = pmu->get_event_info(pmu, idx->slots[k].pidx, einfo);
+			if (ret != PFM_SUCCESS)
+				return ret;
+			if (!strcasecmp(einfo->name, s))
+				return idx->slots[k].pidx;
+		}
+		return PFM_ERR_NOTFOUND;
+	}
+
+	pfmlib_for_each_pmu_event(pmu, i) {
+		ret = pmu->get_event_info(pmu, i, einfo);
+		if (ret != PFM_SUCCESS)
+			return ret;
+		if (!match(pmu, d, einfo->name, s))
+			return i;
+	}
+	return PFM_ERR_NOTFOUND;
+}
+
 static int
 pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 {
 	pfmlib_pmu_t *pmu = d->pmu;
 	pfm_event_info_t einfo;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	char *str, *s, *p;
 	int i;
 	int ret;
@@ -1838,14 +1950,12 @@ pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 	/* if (p)
 	 *p++ = '\0'; */
 
-	match = pmu->match_event ? pmu->match_event : match_event;
-
-	pfmlib_for_each_pmu_event(pmu, i) {
-		ret = pmu->get_event_info(pmu, i, &einfo);
-		if (ret != PFM_SUCCESS)
-			goto error;
-		if (!match(pmu, d, einfo.name, s))
-			goto found;
+	i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
+	if (i >= 0)
+		goto found;
+	if (i != PFM_ERR_NOTFOUND) {
+		ret = i;
+		goto error;
 	}
 	free(str);
 	return PFM_ERR_NOTFOUND;
@@ -1881,7 +1991,6 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 	pfm_event_info_t einfo;
 	char *str, *s, *p;
 	pfmlib_pmu_t *pmu;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	const char *pname = NULL;
 	int i, ret;
 
@@ -1943,16 +2052,12 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 		if (pname && !pfmlib_pmu_active(pmu) && !pfm_cfg.inactive)
 			continue;
 
-		match = pmu->match_event ? pmu->match_event : match_event;
-		/*
-		 * for each event
-		 */
-		pfmlib_for_each_pmu_event(pmu, i) {
-			ret = pmu->get_event_info(pmu, i, &einfo);
-			if (ret != PFM_SUCCESS)
-				goto error;
-			if (!match(pmu, d, einfo.name, s))
-				goto found;
+		i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
+		if (i >= 0)
+			goto found;
+		if (i != PFM_ERR_NOTFOUND) {
+			ret = i;
+			goto error;
 		}
 	}
 	free(str);
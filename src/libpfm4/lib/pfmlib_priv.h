@@ -133,6 +133,20 @@ typedef struct pfmlib_node {
 	struct pfmlib_node *prev;
 } pfmlib_node_t;
 
+/*
+ * case-insensitive hash index of the event names of a PMU,
+ * built at the first lookup on that PMU (open addressing)
+ */
+typedef struct {
+	unsigned int	hash;			/* hash of the event name */
+	int		pidx;			/* private event index, -1 if empty */
+} pfmlib_name_slot_t;
+
+typedef struct {
+	unsigned int		mask;		/* number of slots - 1 */
+	pfmlib_name_slot_t	slots[];
+} pfmlib_name_index_t;
+
 typedef struct pfmlib_pmu {
 	const char 	*desc;			/* PMU description */
 	const char 	*name;			/* pmu short name */
@@ -179,6 +193,8 @@ typedef struct pfmlib_pmu {
 	int 		 (*get_num_events)(void *this);
 	void		 (*display_reg)(void *this, pfmlib_event_desc_t *e, void *val);
 	int 		 (*match_event)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+
+	pfmlib_name_index_t *name_index;	/* event name index, NULL until first lookup */
 } pfmlib_pmu_t;
 
 typedef struct {
@@ -21,6 +21,8 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <link.h>
+#include <stddef.h>
 
 #include "papi.h"
 #include "papi_internal.h"
@@ -1529,8 +1531,70 @@ _linux_get_memory_info( PAPI_hw_info_t * hwinfo, int cpu_type )
     return retval;
 }
 
+/* The dynamic linker bumps dlpi_adds/dlpi_subs every time an object is
+ * loaded or unloaded.  We remember the values seen at the last parse of
+ * /proc/<pid>/maps and only re-parse when they (or the pid) change, so
+ * repeated PAPI_get_shared_lib_info() calls are cheap. */
+static int _linux_parse_shlib_info( papi_mdi_t *mdi );
+
+static struct {
+    pid_t pid;
+    unsigned long long adds;
+    unsigned long long subs;
+    int valid;
+} shlib_cache;
+
+static int
+shlib_phdr_counters( struct dl_phdr_info *info, size_t size, void *data )
+{
+    unsigned long long *counters = ( unsigned long long * ) data;
+
+    if ( size < offsetof( struct dl_phdr_info, dlpi_subs ) +
+                sizeof ( info->dlpi_subs ) )
+        return -1;
+
+    counters[0] = info->dlpi_adds;
+    counters[1] = info->dlpi_subs;
+
+    /* Counters are global, the first object is enough */
+    return 1;
+}
+
 int
 _linux_update_shlib_info( papi_mdi_t *mdi )
+{
+    unsigned long long counters[2] = { 0, 0 };
+    int have_counters, retval;
+
+    have_counters = ( dl_iterate_phdr( shlib_phdr_counters, counters ) == 1 );
+
+    if ( have_counters && shlib_cache.valid &&
+         mdi->shlib_info.map != NULL &&
+         shlib_cache.pid == mdi->pid &&
+         shlib_cache.adds == counters[0] &&
+         shlib_cache.subs == counters[1] ) {
+        SUBDBG( "shlib map unchanged (adds %llu subs %llu), using cache\n",
+                counters[0], counters[1] );
+        return PAPI_OK;
+    }
+
+    shlib_cache.valid = 0;
+    retval = _linux_parse_shlib_info( mdi );
+    if ( retval != PAPI_OK )
+        return retval;
+
+    if ( have_counters ) {
+        shlib_cache.pid = mdi->pid;
+        shlib_cache.adds = counters[0];
+        shlib_cache.subs = counters[1];
+        shlib_cache.valid = 1;
+    }
+
+    return PAPI_OK;
+}
+
+static int
+_linux_parse_shlib_info( papi_mdi_t *mdi )
 {
 
     char fname[PAPI_HUGE_STR_LEN];
@@ -633,6 +633,7 @@ valid_component( int cidx )
 {
 	if ( _papi_hwi_invalid_cmp( cidx ) )
 		return ( PAPI_ENOCMP );
+	_papi_hwi_init_deferred_cmp( cidx );
 	return ( cidx );
 }
 
@@ -1026,6 +1027,17 @@ PAPI_set_thr_specific( int tag, void *ptr )
  *	It must be called before any low level PAPI functions can be used. 
  *	If your application is making use of threads PAPI_thread_init must also be 
  *	called prior to making any calls to the library other than PAPI_library_init() . 
+ *	Only the perf_event and perf_event_uncore components are initialized here.
+ *	The others are initialized when their events are first looked up or
+ *	enumerated, an EventSet is assigned to them, or PAPI_get_component_info()
+ *	is called for them.  Set the environment variable PAPI_EAGER_COMPONENT_INIT
+ *	to initialize all components in PAPI_library_init(), or set
+ *	PAPI_COMPONENT_INIT_THREADS to a number of threads to initialize them
+ *	all there, concurrently for the components that set
+ *	cmp_info.parallel_init.  With PAPI_NODE_SAMPLE_MS set, the components that
+ *	read through the node-wide samples (cmp_info.node_sampled) are also
+ *	initialized there.  PAPI_get_cmp_opt(PAPI_COMPONENT_INIT_USEC, ...)
+ *	returns how long a component took.
  *	@par Examples:
  *	@code
  *		int retval;
@@ -1373,8 +1385,11 @@ PAPI_get_component_info( int cidx )
    APIDBG( "Entry: Component Index %d\n", cidx);
    if ( _papi_hwi_invalid_cmp( cidx ) )
       return ( NULL );
-   else
-      return ( &( _papi_hwd[cidx]->cmp_info ) );
+
+   /* the info is only complete once the component is initialized */
+   _papi_hwi_init_deferred_cmp( cidx );
+
+   return ( &( _papi_hwd[cidx]->cmp_info ) );
 }
 
 /* PAPI_get_event_info:
@@ -1434,6 +1449,128 @@ PAPI_get_event_info( int EventCode, PAPI_event_info_t *info )
 	papi_return( PAPI_ENOTPRESET );
 }
 
+/** @class PAPI_get_event_catalog
+ *	@brief Get the events of a component with their descriptions at once.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	int PAPI_get_event_catalog( int cidx, int flags, PAPI_event_catalog_t **catalog );
+ *
+ *	PAPI_get_event_catalog lists the native events of a component, with
+ *	names, descriptions, units and qualifiers, in a single allocation
+ *	where each string is stored once.  This is what a loop of
+ *	PAPI_enum_cmp_event and PAPI_get_event_info finds, without a
+ *	PAPI_event_info_t to fill and copy for every event.
+ *	The catalog is a snapshot owned by the caller and must be released
+ *	with PAPI_free_event_catalog.
+ *
+ *	@param cidx
+ *		index of the component
+ *	@param flags
+ *		0 or a combination of
+ *		<ul>
+ *		   <li> PAPI_CATALOG_PRESETS -- also list the available presets
+ *		        of the component, before the native events
+ *		   <li> PAPI_CATALOG_QUALIFIERS -- list the unit masks of each
+ *		        native event (PAPI_NTV_ENUM_UMASKS) as its qualifiers
+ *		</ul>
+ *	@param catalog
+ *		receives the catalog @ref PAPI_event_catalog_t
+ *
+ *	@retval PAPI_EINVAL 
+ *		One or more of the arguments is invalid.
+ *	@retval PAPI_ENOCMP 
+ *		The component index is invalid or the component is disabled.
+ *	@retval PAPI_ENOMEM
+ *		Insufficient memory to complete the operation.
+ *
+ *	@par Examples:
+ *	@code
+ *	PAPI_event_catalog_t *catalog;
+ *	const PAPI_catalog_entry_t *e = NULL;
+ *	if ( PAPI_get_event_catalog( 0, PAPI_CATALOG_QUALIFIERS, &catalog ) != PAPI_OK )
+ *	handle_error( 1 );
+ *	while ( ( e = PAPI_catalog_next( catalog, e ) ) != NULL )
+ *	printf( "%#x %s: %s, %d qualifiers\n", e->event_code, e->symbol,
+ *	        e->long_descr, e->num_quals );
+ *	PAPI_free_event_catalog( catalog );
+ *	@endcode
+ *
+ *	@see PAPI_catalog_next
+ *	@see PAPI_free_event_catalog
+ *	@see PAPI_enum_cmp_event
+ *	@see PAPI_get_event_info
+ */
+int
+PAPI_get_event_catalog( int cidx, int flags, PAPI_event_catalog_t **catalog )
+{
+	APIDBG( "Entry: cidx: %d, flags: %#x, catalog: %p\n", cidx, flags, catalog);
+
+	if ( catalog == NULL ||
+	     ( flags & ~( PAPI_CATALOG_PRESETS | PAPI_CATALOG_QUALIFIERS ) ) )
+		papi_return( PAPI_EINVAL );
+	*catalog = NULL;
+
+	if ( _papi_hwi_invalid_cmp( cidx ) )
+		papi_return( PAPI_ENOCMP );
+
+	_papi_hwi_init_deferred_cmp( cidx );
+
+	if ( _papi_hwd[cidx]->cmp_info.disabled &&
+	     _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT )
+		papi_return( PAPI_ENOCMP );
+
+	papi_return( _papi_hwi_get_event_catalog( cidx, flags, catalog ) );
+}
+
+/** @class PAPI_catalog_next
+ *	@brief Iterate over the events of a catalog.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	const PAPI_catalog_entry_t *PAPI_catalog_next( const PAPI_event_catalog_t *catalog, const PAPI_catalog_entry_t *entry );
+ *
+ *	@param catalog
+ *		a catalog from PAPI_get_event_catalog
+ *	@param entry
+ *		the current event, or NULL for the first one
+ *
+ *	@returns the next event, or NULL after the last one.
+ *	The events can also be indexed directly, as catalog->events[i] for
+ *	i below catalog->num_events.
+ *
+ *	@see PAPI_get_event_catalog
+ */
+const PAPI_catalog_entry_t *
+PAPI_catalog_next( const PAPI_event_catalog_t *catalog,
+		   const PAPI_catalog_entry_t *entry )
+{
+	if ( catalog == NULL )
+		return NULL;
+	entry = ( entry == NULL ) ? catalog->events : entry + 1;
+	if ( entry >= catalog->events + catalog->num_events )
+		return NULL;
+	return entry;
+}
+
+/** @class PAPI_free_event_catalog
+ *	@brief Release a catalog from PAPI_get_event_catalog.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	void PAPI_free_event_catalog( PAPI_event_catalog_t *catalog );
+ *
+ *	The entries and strings of the catalog are released with it.  This
+ *	can be done after PAPI_shutdown.
+ *
+ *	@see PAPI_get_event_catalog
+ */
+void
+PAPI_free_event_catalog( PAPI_event_catalog_t *catalog )
+{
+	free( catalog );
+}
+
 
 /** @class PAPI_event_code_to_name
  *	@brief Convert a numeric hardware event code to a name.
@@ -1504,6 +1641,7 @@ PAPI_event_code_to_name( int EventCode, char *out )
         if( compIdx < 0 ) {
             return PAPI_ENOEVNT;
         }
+        _papi_hwi_init_deferred_cmp( compIdx );
         if ( _papi_hwd[compIdx]->cmp_info.disabled == PAPI_EDELAY_INIT ) {
             unsigned int junk;
             _papi_hwd[compIdx]->ntv_enum_events(&junk, PAPI_ENUM_FIRST);
@@ -1549,6 +1687,8 @@ PAPI_event_code_to_name( int EventCode, char *out )
  *
  *	PAPI_event_name_to_code is used to translate an ASCII PAPI event name 
  *	into an integer PAPI event code. 
+ *	The codes of native and user defined events are cached, so looking up
+ *	the same name again does not search the components.
  *
  *	@param *EventCode 
  *		The numeric code for the event. 
@@ -1591,7 +1731,7 @@ int
 PAPI_event_name_to_code( const char *in, int *out )
 {
    APIDBG("Entry: in: %p, name: %s, out: %p\n", in, in, out);
-	int i;
+	int i, retval;
 
 	if ( ( in == NULL ) || ( out == NULL ) )
 		papi_return( PAPI_EINVAL );
@@ -1631,6 +1771,7 @@ PAPI_event_name_to_code( const char *in, int *out )
                  && ( strcasecmp( _papi_hwi_list[i].symbol, evt_base_name ) == 0) ) {
                      *out = ( int ) ( (i + _papi_hwi_start_idx[cmpnt]) | PAPI_PRESET_MASK );
 
+                     _papi_hwi_init_deferred_cmp( cmpnt );
                      if ( _papi_hwd[cmpnt]->cmp_info.disabled == PAPI_EDELAY_INIT ) {
                          unsigned int junk;
                          _papi_hwd[cmpnt]->ntv_enum_events(&junk, PAPI_ENUM_FIRST);
@@ -1668,6 +1809,10 @@ PAPI_event_name_to_code( const char *in, int *out )
        }
     }
 
+	/* user defined and native events resolved before */
+	if ( _papi_hwi_name_cache_lookup( in, out ) == PAPI_OK )
+		papi_return( PAPI_OK );
+
 	// check to see if it is a user defined event
 	for ( i=0; i < user_defined_events_count ; i++ ) {
 		APIDBG("&user_defined_events[%d]: %p, user_defined_events[%d].symbol: %s, user_defined_events[%d].count: %d\n",
@@ -1678,12 +1823,16 @@ PAPI_event_name_to_code( const char *in, int *out )
 			break;
 		if ( strcasecmp( user_defined_events[i].symbol, in ) == 0 ) {
 			*out = (int) ( i | PAPI_UE_MASK );
+			_papi_hwi_name_cache_insert( in, *out, -1 );
 			papi_return( PAPI_OK );
 		}
 	}
 
 	// go look for native events defined by one of the components
-	papi_return( _papi_hwi_native_name_to_code( in, out ) );
+	retval = _papi_hwi_native_name_to_code( in, out );
+	if ( retval == PAPI_OK )
+		_papi_hwi_name_cache_insert( in, *out, _papi_hwi_component_index( *out ) );
+	papi_return( retval );
 }
 
 /* Updates EventCode to next valid value, or returns error; 
@@ -1774,8 +1923,6 @@ PAPI_enum_event( int *EventCode, int modifier )
 	int i = *EventCode;
 	int retval;
 	int cidx;
-	int event_code;
-	char *evt_name;
 
 	cidx = _papi_hwi_component_index( *EventCode );
 	if (cidx < 0) return PAPI_ENOCMP;
@@ -1818,6 +1965,7 @@ PAPI_enum_event( int *EventCode, int modifier )
             do {
                 cidx = _papi_hwi_component_index( (int)(i | PAPI_PRESET_MASK) );
                 if (cidx < 0) return PAPI_ENOCMP;
+                _papi_hwi_init_deferred_cmp( cidx );
                 if ( _papi_hwd[cidx]->cmp_info.disabled == PAPI_EDELAY_INIT ) {
                     APIDBG("Triggered forced initialization of component ID=%d.\n", cidx);
                     unsigned int junk;
@@ -1854,6 +2002,7 @@ PAPI_enum_event( int *EventCode, int modifier )
                 return ( PAPI_ENOEVNT );
             }
 
+            _papi_hwi_init_deferred_cmp( first_comp_with_presets );
             if ( _papi_hwd[first_comp_with_presets]->cmp_info.disabled == PAPI_EDELAY_INIT ) {
                 unsigned int junk;
                 _papi_hwd[first_comp_with_presets]->ntv_enum_events(&junk, PAPI_ENUM_FIRST);
@@ -1886,22 +2035,7 @@ PAPI_enum_event( int *EventCode, int modifier )
     }
 
 	if ( IS_NATIVE(i) ) {
-	    // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
-	    _papi_hwi_set_papi_event_code(*EventCode, 0);
-
-		/* Should check against num native events here */
-
-	    event_code=_papi_hwi_eventcode_to_native((int)*EventCode);
-	    retval = _papi_hwd[cidx]->ntv_enum_events((unsigned int *)&event_code, modifier );
-
-	    if (retval!=PAPI_OK) {
-	       APIDBG("VMW: retval=%d\n",retval);
-	       return PAPI_EINVAL;
-	    }
-
-	    evt_name = _papi_hwi_get_papi_event_string();
-    	*EventCode = _papi_hwi_native_to_eventcode(cidx, event_code, -1, evt_name);
-	    _papi_hwi_free_papi_event_string();
+	    retval = _papi_hwi_enum_native_event( cidx, EventCode, modifier );
 
 	    APIDBG("EXIT: *EventCode: %#x\n", *EventCode);
 	    return retval;
@@ -2057,13 +2191,13 @@ PAPI_enum_cmp_event( int *EventCode, int modifier, int cidx )
 	APIDBG( "Entry: EventCode: %#x, modifier: %d, cidx: %d\n", *EventCode, modifier, cidx);
 	int i = *EventCode;
 	int retval;
-	int event_code;
-	char *evt_name;
 
 	if ( _papi_hwi_invalid_cmp(cidx) ) {
 		return PAPI_ENOCMP;
 	}
 
+	_papi_hwi_init_deferred_cmp( cidx );
+
 	if (_papi_hwd[cidx]->cmp_info.disabled &&
         _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT) {
 	  return PAPI_ENOCMP;
@@ -2115,23 +2249,8 @@ PAPI_enum_cmp_event( int *EventCode, int modifier, int cidx )
     }
 
 	if ( IS_NATIVE(i) ) {
-	    // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
-	    _papi_hwi_set_papi_event_code(*EventCode, 0);
-
-		/* Should we check against num native events here? */
-	    event_code=_papi_hwi_eventcode_to_native(*EventCode);
-	    retval = _papi_hwd[cidx]->ntv_enum_events((unsigned int *)&event_code, modifier );
-
-	    if (retval!=PAPI_OK) {
-	       APIDBG("EXIT: PAPI_EINVAL retval=%d\n",retval);
-	       return PAPI_EINVAL;
-	    }
-
-	    evt_name = _papi_hwi_get_papi_event_string();
-	    *EventCode = _papi_hwi_native_to_eventcode(cidx, event_code, -1, evt_name);
-	    _papi_hwi_free_papi_event_string();
-
-	    APIDBG("EXIT: *EventCode: %#x\n", *EventCode);
+	    retval = _papi_hwi_enum_native_event( cidx, EventCode, modifier );
+	    APIDBG("EXIT: *EventCode: %#x, retval: %d\n", *EventCode, retval);
 	    return retval;
 	} 
 
@@ -3054,6 +3173,9 @@ PAPI_stop( int EventSet, long long *values )
 	if ( !( ESI->state & PAPI_RUNNING ) )
 		papi_return( PAPI_ENOTRUN );
 
+	/* Handles from PAPI_bind_reader are only valid while running */
+	_papi_hwi_invalidate_bound_reader( ESI );
+
 	/* If multiplexing is enabled for this eventset, turn if off */
 
 	if ( _papi_hwi_is_sw_multiplex( ESI ) ) {
@@ -3418,6 +3540,212 @@ PAPI_read_ts( int EventSet, long long *values, long long *cycles )
 	return PAPI_OK;
 }
 
+/** @class PAPI_bind_reader
+ *  @brief Resolve a running event set once for repeated low-overhead reads.
+ *
+ *  @par C Interface:
+ *  \#include <papi.h> @n
+ *  int PAPI_bind_reader( int EventSet, PAPI_reader_t *handle );
+ *
+ *  PAPI_bind_reader() performs the EventSet lookup, component and state
+ *  validation and context resolution that PAPI_read() repeats on every
+ *  call, and stores the result together with the mapping from counters
+ *  to events in a handle.  The handle is then passed to PAPI_read_bound().
+ *
+ *  The handle is only valid while the event set is running.  PAPI_stop()
+ *  invalidates it, after which PAPI_read_bound() returns PAPI_ENOTRUN;
+ *  call PAPI_bind_reader() again after the next PAPI_start().  Binding
+ *  an event set that already has a handle invalidates the previous one.
+ *  Software multiplexed event sets cannot be bound.
+ *
+ *  @param[in] EventSet
+ *     -- an integer handle for a PAPI Event Set as created 
+ *        by PAPI_create_eventset()
+ *  @param[out] *handle
+ *     -- receives the reader handle
+ *
+ *  @retval PAPI_EINVAL 
+ *	    One or more of the arguments is invalid, or the event set
+ *	    uses software multiplexing.
+ *  @retval PAPI_ENOEVST 
+ *	    The event set specified does not exist. 
+ *  @retval PAPI_ENOTRUN 
+ *	    The event set is currently not running.
+ *  @retval PAPI_ENOMEM
+ *	    Insufficient memory to complete the operation.
+ *
+ * @par Examples
+ * @code
+ * PAPI_reader_t reader;
+ * long long values[2];
+ *
+ * if ( PAPI_start( EventSet ) != PAPI_OK ) handle_error( 1 );
+ * if ( PAPI_bind_reader( EventSet, &reader ) != PAPI_OK ) handle_error( 1 );
+ * for ( i = 0; i < n; i++ ) {
+ *     work( i );
+ *     PAPI_read_bound( reader, values );
+ * }
+ * PAPI_stop( EventSet, values );
+ * PAPI_unbind_reader( &reader );
+ * @endcode
+ *
+ * @see PAPI_read_bound
+ * @see PAPI_unbind_reader
+ * @see PAPI_read 
+ */
+int
+PAPI_bind_reader( int EventSet, PAPI_reader_t *handle )
+{
+	APIDBG( "Entry: EventSet: %d, handle: %p\n", EventSet, handle);
+	EventSetInfo_t *ESI;
+	PAPI_bound_reader_t *reader;
+	int cidx, i;
+
+	if ( handle == NULL )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( !( ESI->state & PAPI_RUNNING ) )
+		papi_return( PAPI_ENOTRUN );
+
+	if ( _papi_hwi_is_sw_multiplex( ESI ) )
+		papi_return( PAPI_EINVAL );
+
+	reader = papi_calloc( 1, sizeof ( PAPI_bound_reader_t ) );
+	if ( reader == NULL )
+		papi_return( PAPI_ENOMEM );
+
+	reader->pos = papi_calloc( ( size_t ) ( ESI->NumberOfEvents > 0 ?
+	                                        ESI->NumberOfEvents : 1 ),
+	                           sizeof ( int ) );
+	if ( reader->pos == NULL ) {
+		papi_free( reader );
+		papi_return( PAPI_ENOMEM );
+	}
+
+	reader->context = _papi_hwi_get_context( ESI, NULL );
+	reader->ctl_state = ESI->ctl_state;
+	reader->read = _papi_hwd[cidx]->read;
+	reader->num_events = ESI->NumberOfEvents;
+	reader->direct = 1;
+	for ( i = 0; i < ESI->NumberOfEvents; i++ ) {
+		reader->pos[i] = ESI->EventInfoArray[i].pos[0];
+		if ( ( ESI->EventInfoArray[i].derived != NOT_DERIVED ) ||
+		     ( reader->pos[i] < 0 ) )
+			reader->direct = 0;
+	}
+
+	_papi_hwi_invalidate_bound_reader( ESI );
+	reader->ESI = ESI;
+	ESI->bound_reader = reader;
+
+	*handle = reader;
+
+	APIDBG( "PAPI_bind_reader: %d events, direct: %d\n",
+		reader->num_events, reader->direct );
+	return PAPI_OK;
+}
+
+/** @class PAPI_read_bound
+ *  @brief Read hardware counters through a handle from PAPI_bind_reader.
+ *
+ *  @par C Interface:
+ *  \#include <papi.h> @n
+ *  int PAPI_read_bound( PAPI_reader_t handle, long long *values );
+ *
+ *  PAPI_read_bound() returns the same values as PAPI_read() on the bound
+ *  event set.  It goes straight to the component read routine and, when
+ *  the event set contains no derived events, copies the counters through
+ *  the position map computed at bind time.  No argument checking is done
+ *  beyond detecting a handle invalidated by PAPI_stop().
+ *
+ *  @param[in] handle
+ *     -- a reader handle obtained from PAPI_bind_reader()
+ *  @param[out] *values 
+ *     -- an array to hold the counter values of the counting events 
+ *
+ *  @retval PAPI_ENOTRUN 
+ *	    The event set was stopped since the handle was bound.
+ *  @retval PAPI_ESYS 
+ *	    A system or C library call failed inside PAPI, see the 
+ *          errno variable.
+ *
+ * @see PAPI_bind_reader
+ * @see PAPI_read 
+ */
+int
+PAPI_read_bound( PAPI_reader_t handle, long long *values )
+{
+	PAPI_bound_reader_t *reader = handle;
+	long long *dp = NULL;
+	int i, retval;
+
+	if ( reader->ESI == NULL )
+		return PAPI_ENOTRUN;
+
+	if ( !reader->direct ) {
+		retval = _papi_hwi_read( reader->context, reader->ESI, values );
+		if ( retval != PAPI_OK )
+			papi_return( retval );
+		return PAPI_OK;
+	}
+
+	retval = reader->read( reader->context, reader->ctl_state, &dp,
+			       reader->ESI->state );
+	if ( retval != PAPI_OK )
+		papi_return( retval );
+
+	for ( i = 0; i < reader->num_events; i++ )
+		values[i] = dp[reader->pos[i]];
+
+	return PAPI_OK;
+}
+
+/** @class PAPI_unbind_reader
+ *  @brief Release a handle obtained from PAPI_bind_reader.
+ *
+ *  @par C Interface:
+ *  \#include <papi.h> @n
+ *  int PAPI_unbind_reader( PAPI_reader_t *handle );
+ *
+ *  PAPI_unbind_reader() frees the handle and sets it to NULL.  It may be
+ *  called whether or not the event set is still running.
+ *
+ *  @param[in,out] *handle
+ *     -- the reader handle to release
+ *
+ *  @retval PAPI_EINVAL 
+ *	    The handle is invalid.
+ *
+ * @see PAPI_bind_reader
+ */
+int
+PAPI_unbind_reader( PAPI_reader_t *handle )
+{
+	APIDBG( "Entry: handle: %p\n", handle);
+	PAPI_bound_reader_t *reader;
+
+	if ( ( handle == NULL ) || ( *handle == NULL ) )
+		papi_return( PAPI_EINVAL );
+
+	reader = *handle;
+	if ( reader->ESI != NULL )
+		_papi_hwi_invalidate_bound_reader( reader->ESI );
+
+	papi_free( reader->pos );
+	papi_free( reader );
+	*handle = NULL;
+
+	return PAPI_OK;
+}
+
 /**	@class PAPI_accum
  *	@brief Accumulate and reset counters in an EventSet.
  *	
@@ -4145,6 +4473,15 @@ PAPI_set_multiplex( int EventSet )
  *					specified in in ptr->attach.tid.
  * PAPI_CPU_ATTACH	Attach EventSet specified in ptr->cpu.eventset to cpu specified in in
  *					ptr->cpu.cpu_num.
+ * PAPI_CPU_MASK	Count the EventSet specified in ptr->cpu_mask.eventset on each of the
+ *					ptr->cpu_mask.num_cpus cpus in ptr->cpu_mask.cpus; each event reads
+ *					as the sum over those cpus. Events given an explicit cpu= mask still
+ *					count on that cpu only.
+ * PAPI_REFRESH_LATENCY	Set how old, in microseconds, the values of the EventSet specified
+ *					in ptr->refresh.eventset may be before PAPI_read rereads them
+ *					(ptr->refresh.usec). Only for components that cache values read
+ *					from files (net, stealtime, lustre), others return PAPI_ECMP; 0
+ *					rereads on every call.
  * PAPI_DETACH		Detach EventSet specified in ptr->attach.eventset from any thread
  *					or process id.
  * PAPI_DOMAIN		Set domain for EventSet specified in ptr->domain.eventset. 
@@ -4172,6 +4509,8 @@ PAPI_set_multiplex( int EventSet )
  * <tr><td>PAPI_DEF_ITIMER_NS</td><td>See PAPI_DEF_MPX_NS.</td></tr>
  * <tr><td>PAPI_ATTACH</td><td>Attach EventSet specified in ptr->attach.eventset to thread or process id specified in in ptr->attach.tid.</td></tr>
  * <tr><td>PAPI_CPU_ATTACH</td><td>Attach EventSet specified in ptr->cpu.eventset to cpu specified in in ptr->cpu.cpu_num.</td></tr>
+ * <tr><td>PAPI_CPU_MASK</td><td>Count the EventSet specified in ptr->cpu_mask.eventset on each of the ptr->cpu_mask.num_cpus cpus in ptr->cpu_mask.cpus; each event reads as the sum over those cpus. Events given an explicit cpu= mask still count on that cpu only.</td></tr>
+ * <tr><td>PAPI_REFRESH_LATENCY</td><td>Set how old, in microseconds, the values of the EventSet specified in ptr->refresh.eventset may be before PAPI_read rereads them (ptr->refresh.usec). Only for components that cache values read from files (net, stealtime, lustre), others return PAPI_ECMP; 0 rereads on every call.</td></tr>
  * <tr><td>PAPI_DETACH</td><td>Detach EventSet specified in ptr->attach.eventset from any thread or process id.</td></tr>
  * <tr><td>PAPI_DOMAIN</td><td>Set domain for EventSet specified in ptr->domain.eventset. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_GRANUL</td><td>Set granularity for EventSet specified in ptr->granularity.eventset. Will error if eventset is not bound to a component.</td></tr>
@@ -4314,6 +4653,101 @@ PAPI_set_opt( int option, PAPI_option_t * ptr )
 		internal.cpu.ESI->state |= PAPI_CPU_ATTACHED;
 		return ( PAPI_OK );
 	}
+	case PAPI_CPU_MASK:
+	{
+		CpuInfo_t *cpu;
+		int i, j;
+
+		APIDBG("eventset: %d, num_cpus: %d\n", ptr->cpu_mask.eventset, ptr->cpu_mask.num_cpus);
+		internal.cpu_mask.ESI = _papi_hwi_lookup_EventSet( ptr->cpu_mask.eventset );
+		if ( internal.cpu_mask.ESI == NULL )
+			papi_return( PAPI_ENOEVST );
+
+		if ( ( ptr->cpu_mask.num_cpus <= 0 ) || ( ptr->cpu_mask.cpus == NULL ) )
+			papi_return( PAPI_EINVAL );
+
+		/* every cpu must exist, and be given once */
+		for ( i = 0; i < ptr->cpu_mask.num_cpus; i++ ) {
+			if ( ptr->cpu_mask.cpus[i] >=
+				 ( unsigned int ) _papi_hwi_system_info.hw_info.totalcpus )
+				papi_return( PAPI_EINVAL );
+			for ( j = 0; j < i; j++ ) {
+				if ( ptr->cpu_mask.cpus[j] == ptr->cpu_mask.cpus[i] )
+					papi_return( PAPI_EINVAL );
+			}
+		}
+
+		cidx = valid_ESI_component( internal.cpu_mask.ESI );
+		if ( cidx < 0 )
+			papi_return( cidx );
+
+		if ( _papi_hwd[cidx]->cmp_info.cpu == 0 )
+			papi_return( PAPI_ECMP );
+
+		if ( internal.cpu_mask.ESI->state & (PAPI_ATTACHED | PAPI_INHERIT) )
+			papi_return( PAPI_EINVAL );
+
+		if ( ( internal.cpu_mask.ESI->state & PAPI_STOPPED ) == 0 )
+			papi_return( PAPI_EISRUN );
+
+		/* The EventSet keeps its own copy, the component points to it */
+		internal.cpu_mask.num_cpus = ptr->cpu_mask.num_cpus;
+		internal.cpu_mask.cpus = papi_malloc( ( size_t ) ptr->cpu_mask.num_cpus *
+											  sizeof ( unsigned int ) );
+		if ( internal.cpu_mask.cpus == NULL )
+			papi_return( PAPI_ENOMEM );
+		memcpy( internal.cpu_mask.cpus, ptr->cpu_mask.cpus,
+				( size_t ) ptr->cpu_mask.num_cpus * sizeof ( unsigned int ) );
+
+		/* The EventSet is tracked as attached to the first cpu of the mask */
+		retval = _papi_hwi_lookup_or_create_cpu( &cpu, internal.cpu_mask.cpus[0] );
+		if( retval != PAPI_OK) {
+			papi_free( internal.cpu_mask.cpus );
+			papi_return( retval );
+		}
+
+		context = _papi_hwi_get_context( internal.cpu_mask.ESI, NULL );
+		retval = _papi_hwd[cidx]->ctl( context, PAPI_CPU_MASK, &internal );
+		if ( retval != PAPI_OK ) {
+			_papi_hwi_shutdown_cpu( cpu );
+			papi_free( internal.cpu_mask.cpus );
+			papi_return( retval );
+		}
+
+		/* only now let go of what a previous attach or mask held */
+		if ( internal.cpu_mask.ESI->CpuInfo )
+			_papi_hwi_shutdown_cpu( internal.cpu_mask.ESI->CpuInfo );
+		if ( internal.cpu_mask.ESI->cpu.cpus )
+			papi_free( internal.cpu_mask.ESI->cpu.cpus );
+
+		internal.cpu_mask.ESI->CpuInfo = cpu;
+		internal.cpu_mask.ESI->cpu.num_cpus = internal.cpu_mask.num_cpus;
+		internal.cpu_mask.ESI->cpu.cpus = internal.cpu_mask.cpus;
+		internal.cpu_mask.ESI->state |= PAPI_CPU_ATTACHED;
+		return ( PAPI_OK );
+	}
+	case PAPI_REFRESH_LATENCY:
+	{
+		APIDBG("eventset: %d, usec: %lld\n", ptr->refresh.eventset, ptr->refresh.usec);
+		internal.refresh.ESI = _papi_hwi_lookup_EventSet( ptr->refresh.eventset );
+		if ( internal.refresh.ESI == NULL )
+			papi_return( PAPI_ENOEVST );
+
+		if ( ptr->refresh.usec < 0 )
+			papi_return( PAPI_EINVAL );
+		internal.refresh.usec = ptr->refresh.usec;
+
+		cidx = valid_ESI_component( internal.refresh.ESI );
+		if ( cidx < 0 )
+			papi_return( cidx );
+
+		if ( _papi_hwd[cidx]->cmp_info.refresh_latency == 0 )
+			papi_return( PAPI_ECMP );
+
+		context = _papi_hwi_get_context( internal.refresh.ESI, NULL );
+		retval = _papi_hwd[cidx]->ctl( context, PAPI_REFRESH_LATENCY, &internal );
+		papi_return( retval );
+	}
 	case PAPI_DEF_MPX_NS:
 	{
 		cidx = 0;			 /* xxxx for now, assume we only check against cpu component */
@@ -4828,6 +5262,7 @@ PAPI_get_multiplex( int EventSet )
  * PAPI_MAX_MPX_CTRS	Get maximum number of multiplexing counters. Requires a component index.
  * PAPI_SHLIBINFO	Get shared library information used by the program.
  * PAPI_COMPONENTINFO	Get the PAPI features the specified component supports. Requires a component index.
+ * PAPI_COMPONENT_INIT_USEC	Get the time the component took to initialize, in usec. Requires a component index.
  * @endmanonly
  * @htmlonly
  * <table class="doxtable">
@@ -4856,6 +5291,7 @@ PAPI_get_multiplex( int EventSet )
  * <tr><td>PAPI_MAX_MPX_CTRS</td><td>Get maximum number of multiplexing counters. Requires a component index.</td></tr>
  * <tr><td>PAPI_SHLIBINFO</td><td>Get shared library information used by the program.</td></tr>
  * <tr><td>PAPI_COMPONENTINFO</td><td>Get the PAPI features the specified component supports. Requires a component index.</td></tr>
+ * <tr><td>PAPI_COMPONENT_INIT_USEC</td><td>Get the time the component took to initialize, in usec. Requires a component index.</td></tr>
  * </table>
  * @endhtmlonly
  *
@@ -5009,6 +5445,7 @@ PAPI_get_opt( int option, PAPI_option_t * ptr )
 	case PAPI_DEFGRN:
 	case PAPI_SHLIBINFO:
 	case PAPI_COMPONENTINFO:
+	case PAPI_COMPONENT_INIT_USEC:
 		return ( PAPI_get_cmp_opt( option, ptr, 0 ) );
 	default:
 		papi_return( PAPI_EINVAL );
@@ -5066,6 +5503,8 @@ PAPI_get_cmp_opt( int option, PAPI_option_t * ptr, int cidx )
      return PAPI_ECMP;
   }
 
+	_papi_hwi_init_deferred_cmp( cidx );
+
 	switch ( option ) {
 		/* For now, MAX_HWCTRS and MAX CTRS are identical.
 		   At some future point, they may map onto different values.
@@ -5092,6 +5531,8 @@ PAPI_get_cmp_opt( int option, PAPI_option_t * ptr, int cidx )
 			papi_return( PAPI_EINVAL );
 		ptr->cmp_info = &( _papi_hwd[cidx]->cmp_info );
 		return PAPI_OK;
+	case PAPI_COMPONENT_INIT_USEC:
+		return ( ( int ) _papi_hwi_cmp_init_usec( cidx ) );
 	default:
 	  papi_return( PAPI_EINVAL );
 	}
@@ -5184,7 +5625,6 @@ PAPI_shutdown( void )
 
         EventSetInfo_t *ESI;
         ThreadInfo_t *master;
-        DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
         int i, j = 0, k, retval;
 
 
@@ -5205,16 +5645,16 @@ PAPI_shutdown( void )
 #ifdef DEBUG
 again:
 #endif
-   for( i = 0; i < map->totalSlots; i++ ) {
-      ESI = map->dataSlotArray[i];
+   for( i = 0; i < _papi_hwi_system_info.global_eventset_map.totalSlots; i++ ) {
+      ESI = _papi_hwi_EventSet_in_slot( i );
       if ( ESI ) {
 	 if ( ESI->master == master ) {
 	    if ( ESI->state & PAPI_RUNNING ) {
-	       if((retval = PAPI_stop( i, NULL )) != PAPI_OK) {
+	       if((retval = PAPI_stop( ESI->EventSetIndex, NULL )) != PAPI_OK) {
 	    	   APIDBG("Call to PAPI_stop failed: %d\n", retval);
 	       }
 	    }
-	    retval=PAPI_cleanup_eventset( i );
+	    retval=PAPI_cleanup_eventset( ESI->EventSetIndex );
 	    if (retval!=PAPI_OK) PAPIERROR("Error during cleanup.");
 	    _papi_hwi_free_EventSet( ESI );
 	 } 
@@ -6512,6 +6952,11 @@ PAPI_set_cmp_domain( int domain, int cidx )
  *		It should be noted that PAPI_add_events can partially succeed, 
  *		exactly like PAPI_remove_events. 
  *
+ *	The events are first added all together, with a single update of
+ *	the component, so the counters are set up and checked once for the
+ *	whole array.  If that fails they are added one at a time to find
+ *	the first one that can not be added.
+ *
  *	@retval Positive-Integer
  *		The number of consecutive elements that succeeded before the error. 
  *	@retval PAPI_EINVAL 
@@ -6563,11 +7008,27 @@ int
 PAPI_add_events( int EventSet, int *Events, int number )
 {
 	APIDBG( "Entry: EventSet: %d, Events: %p, number: %d\n", EventSet, Events, number);
+	EventSetInfo_t *ESI;
 	int i, retval;
 
 	if ( ( Events == NULL ) || ( number <= 0 ) )
 		papi_return( PAPI_EINVAL );
 
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	for ( i = 0; i < number; i++ ) {
+		if ( ( ( Events[i] & PAPI_PRESET_MASK ) == 0 ) &&
+			 ( Events[i] & PAPI_NATIVE_MASK ) == 0 )
+			break;
+	}
+
+	/* all at once when they look valid, it adds all of them or none */
+	if ( ( number > 1 ) && ( i == number ) && !( ESI->state & PAPI_RUNNING ) &&
+		 ( _papi_hwi_add_events( ESI, Events, number ) == PAPI_OK ) )
+		return ( PAPI_OK );
+
 	for ( i = 0; i < number; i++ ) {
 		retval = PAPI_add_event( EventSet, Events[i] );
 		if ( retval != PAPI_OK ) {
@@ -7332,14 +7793,11 @@ int  PAPI_get_component_index(const char *name)
 	APIDBG( "Entry: name: %s\n", name);
   int cidx;
 
-  const PAPI_component_info_t *cinfo;
-
+  /* Not PAPI_get_component_info, the name is known without
+     initializing a deferred component */
   for(cidx=0;cidx<papi_num_components;cidx++) {
 
-     cinfo=PAPI_get_component_info(cidx); 
-     if (cinfo==NULL) return PAPI_ENOCMP;
-
-     if (!strcmp(name,cinfo->name)) {
+     if (!strcmp(name,_papi_hwd[cidx]->cmp_info.name)) {
         return cidx;
      }
   }
@@ -466,6 +466,9 @@ All of the functions in the PerfAPI should use the following set of constants.
 #define PAPI_CPU_ATTACH		27      /**< Specify a cpu number the event set should be tied to */
 #define PAPI_INHERIT		28      /**< Option to set counter inheritance flag */
 #define PAPI_USER_EVENTS_FILE 29	/**< Option to set file from where to parse user defined events */
+#define PAPI_CPU_MASK		30      /**< Specify a set of cpus the event set should count on, values are summed over them */
+#define PAPI_REFRESH_LATENCY	31	/**< How long the values of an event set read from files may be cached, in usec */
+#define PAPI_COMPONENT_INIT_USEC	32	/**< How long the component took to initialize, in usec */
 
 #define PAPI_INIT_SLOTS    64     /*Number of initialized slots in
                                    DynamicArray of EventSets */
@@ -580,6 +583,9 @@ read the documentation carefully.  */
 
 typedef void *vptr_t;
 
+   /** Opaque handle to an EventSet reader pre-bound by PAPI_bind_reader() */
+   typedef struct _papi_bound_reader *PAPI_reader_t;
+
 	/** @ingroup papi_data_structures */
    typedef struct _papi_sprofil {
       void *pr_base;          /**< buffer base */
@@ -668,7 +674,10 @@ typedef void *vptr_t;
      /* This should be a granularity option */
      unsigned int cpu:1;                   /**< Supports specifying cpu number to use with event set */
      unsigned int inherit:1;               /**< Supports child processes inheriting parents counters */
-     unsigned int reserved_bits:19;
+     unsigned int refresh_latency:1;       /**< Supports PAPI_REFRESH_LATENCY */
+     unsigned int node_sampled:1;          /**< Reads through the node segment, initialized at library init with PAPI_NODE_SAMPLE_MS */
+     unsigned int parallel_init:1;         /**< init_component may run next to others on its own thread, see PAPI_COMPONENT_INIT_THREADS */
+     unsigned int reserved_bits:16;
    } PAPI_component_info_t;
 
 /**  @ingroup papi_data_structures*/
@@ -825,6 +834,19 @@ typedef char* PAPI_user_defined_events_file_t;
          unsigned int cpu_num;
       } PAPI_cpu_option_t;
 
+/**  @ingroup papi_data_structures*/
+      typedef struct _papi_cpu_mask_option {
+         int eventset;
+         int num_cpus;           /**< number of entries in cpus */
+         unsigned int *cpus;     /**< cpus to open every event on */
+      } PAPI_cpu_mask_option_t;
+
+/**  @ingroup papi_data_structures*/
+      typedef struct _papi_refresh_option {
+         int eventset;
+         long long usec;         /**< longest time PAPI_read may return cached values */
+      } PAPI_refresh_option_t;
+
 /** @ingroup papi_data_structures */
    typedef struct _papi_multiplex_option {
       int eventset;
@@ -857,6 +879,8 @@ typedef char* PAPI_user_defined_events_file_t;
 		PAPI_domain_option_t defdomain;
 		PAPI_attach_option_t attach;
 		PAPI_cpu_option_t cpu;
+		PAPI_cpu_mask_option_t cpu_mask;
+		PAPI_refresh_option_t refresh;
 		PAPI_multiplex_option_t multiplex;
 		PAPI_itimer_option_t itimer;
 		PAPI_hw_info_t *hw_info;
@@ -1022,6 +1046,36 @@ enum {
      char quals_descrs[PAPI_MAX_COMP_QUALS][PAPI_HUGE_STR_LEN];  /**< qualifier descriptions */
    } PAPI_event_info_t;
 
+/* flags of PAPI_get_event_catalog */
+#define PAPI_CATALOG_PRESETS     0x1   /**< also list the available presets of the component */
+#define PAPI_CATALOG_QUALIFIERS  0x2   /**< list the unit masks of native events as qualifiers */
+
+/** @ingroup papi_data_structures
+ *  One event of a PAPI_event_catalog_t; the strings are part of the catalog */
+   typedef struct event_catalog_entry {
+      unsigned int event_code;       /**< preset or native event code */
+      int component_index;           /**< component this event belongs to */
+      const char *symbol;            /**< name of the event */
+      const char *short_descr;       /**< short description, may be empty */
+      const char *long_descr;        /**< long description */
+      const char *units;             /**< units event is measured in, may be empty */
+      int num_quals;                 /**< number of qualifiers */
+      const char **quals;            /**< qualifiers, as ":umask" or "name=value" */
+      const char **quals_descrs;     /**< qualifier descriptions */
+   } PAPI_catalog_entry_t;
+
+/** @ingroup papi_data_structures
+ *  The events of a component, in a single allocation made by
+ *  PAPI_get_event_catalog and released by PAPI_free_event_catalog */
+   typedef struct event_catalog {
+      int component_index;           /**< component the events belong to */
+      const char *component;         /**< name of that component */
+      int num_events;                /**< entries in events */
+      int num_quals;                 /**< qualifiers of all the events */
+      size_t size;                   /**< bytes of the allocation */
+      PAPI_catalog_entry_t *events;  /**< the events, presets first */
+   } PAPI_event_catalog_t;
+
 
 /** @ingroup papi_data_structures
  * PAPI_dev_type_id_e - enum device types
@@ -1153,6 +1207,7 @@ typedef enum {
    int   PAPI_add_events(int EventSet, int *Events, int number); /**< add array of PAPI preset or native hardware events to an event set */
    int   PAPI_assign_eventset_component(int EventSet, int cidx); /**< assign a component index to an existing but empty eventset */
    int   PAPI_attach(int EventSet, unsigned long tid); /**< attach specified event set to a specific process or thread id */
+   int   PAPI_bind_reader(int EventSet, PAPI_reader_t *handle); /**< resolve a running event set once for repeated PAPI_read_bound calls */
    int   PAPI_cleanup_eventset(int EventSet); /**< remove all PAPI events from an event set */
    int   PAPI_create_eventset(int *EventSet); /**< create a new empty PAPI event set */
    int   PAPI_detach(int EventSet); /**< detach specified event set from a previously specified process or thread id */
@@ -1163,6 +1218,9 @@ typedef enum {
    int   PAPI_event_name_to_code(const char *in, int *out); /**< translate an ASCII PAPI preset or native name into an integer PAPI event code */
    int  PAPI_get_dmem_info(PAPI_dmem_info_t *dest); /**< get dynamic memory usage information */
    int   PAPI_get_event_info(int EventCode, PAPI_event_info_t * info); /**< get the name and descriptions for a given preset or native event code */
+   int   PAPI_get_event_catalog(int cidx, int flags, PAPI_event_catalog_t **catalog); /**< get the events of a component with their descriptions in one allocation */
+   const PAPI_catalog_entry_t *PAPI_catalog_next(const PAPI_event_catalog_t *catalog, const PAPI_catalog_entry_t *entry); /**< iterate over the events of a catalog */
+   void  PAPI_free_event_catalog(PAPI_event_catalog_t *catalog); /**< release a catalog from PAPI_get_event_catalog */
    const PAPI_exe_info_t *PAPI_get_executable_info(void); /**< get the executable's address space information */
    const PAPI_hw_info_t *PAPI_get_hardware_info(void); /**< get information about the system hardware */
    const PAPI_component_info_t *PAPI_get_component_info(int cidx); /**< get information about the component features */
@@ -1196,6 +1254,7 @@ typedef enum {
    int   PAPI_query_named_event(const char *EventName); /**< query if a named PAPI event exists */
    int   PAPI_read(int EventSet, long long * values); /**< read hardware events from an event set with no reset */
    int   PAPI_read_ts(int EventSet, long long * values, long long *cyc); /**< read from an eventset with a real-time cycle timestamp */
+   int   PAPI_read_bound(PAPI_reader_t handle, long long * values); /**< read an event set through a handle from PAPI_bind_reader */
    int   PAPI_register_thread(void); /**< inform PAPI of the existence of a new thread */
    int   PAPI_remove_event(int EventSet, int EventCode); /**< remove a hardware event from a PAPI event set */
    int   PAPI_remove_named_event(int EventSet, const char *EventName); /**< remove a named event from a PAPI event set */
@@ -1218,6 +1277,7 @@ typedef enum {
    unsigned long PAPI_thread_id(void); /**< get the thread identifier of the current thread */
    int   PAPI_thread_init(unsigned long (*id_fn) (void)); /**< initialize thread support in the PAPI library */
    int   PAPI_unlock(int); /**< unlock one of two PAPI internal user mutex variables */
+   int   PAPI_unbind_reader(PAPI_reader_t *handle); /**< release a handle obtained from PAPI_bind_reader */
    int   PAPI_unregister_thread(void); /**< inform PAPI that a previously registered thread is disappearing */
    int   PAPI_write(int EventSet, long long * values); /**< write counter values into counters */
    int   PAPI_get_event_component(int EventCode);  /**< return which component an EventCode belongs to */
@@ -0,0 +1,447 @@
+/****************************/
+/* THIS IS OPEN SOURCE CODE */
+/****************************/
+
+/*
+* File:    papi_cache.c
+*
+* On-disk cache of the init time event tables, see papi_cache.h.
+*
+* The file starts with a fixed header: magic, format version, file
+* size and a directory of sections, followed by the key string and
+* the sections, each aligned to 8 bytes.  A table section is a
+* papi_cache_table_hdr_t, the records and then a string pool that the
+* records refer to by offset.  Checking a file costs one fstat, one
+* mmap, a compare of the key and a checksum over the 8 byte words of
+* the file; nothing in it is parsed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+#include "papi.h"
+#include "papi_internal.h"
+#include "papi_memory.h"
+#include "papi_cache.h"
+
+#define PAPI_CACHE_MAGIC   "PAPIEVC"
+#define PAPI_CACHE_FORMAT  1
+#define PAPI_CACHE_ALIGN(x)  ( ( ( x ) + 7 ) & ~( ( size_t ) 7 ) )
+
+typedef struct _papi_cache_dir {
+	uint32_t id;
+	uint32_t pad;
+	uint64_t offset;
+	uint64_t len;
+} papi_cache_dir_t;
+
+typedef struct _papi_cache_hdr {
+	char magic[8];
+	uint32_t format;
+	uint32_t nsections;
+	uint64_t size;                   /* of the whole file */
+	uint64_t key_len;                /* key follows the header */
+	uint64_t checksum;               /* of everything after the header */
+	papi_cache_dir_t section[PAPI_CACHE_MAX_SECTIONS];
+} papi_cache_hdr_t;
+
+typedef struct _papi_cache_table_hdr {
+	uint32_t count;
+	uint32_t size;
+	uint64_t strings_len;
+} papi_cache_table_hdr_t;
+
+static struct {
+	const char *path;
+	char *key;
+	char *map;
+	size_t map_len;
+	int nstaged;
+	papi_cache_dir_t staged[PAPI_CACHE_MAX_SECTIONS];
+	char *staged_data[PAPI_CACHE_MAX_SECTIONS];
+} cache;
+
+/* the part of the key that every cache shares */
+static char *
+cache_make_key( const char *key )
+{
+	const PAPI_hw_info_t *hw = &_papi_hwi_system_info.hw_info;
+	struct utsname uts;
+	char *full;
+	int len;
+
+	if ( uname( &uts ) < 0 )
+		return NULL;
+
+	len = snprintf( NULL, 0, "papi %#x;cpu %d %d %d %d %s;kernel %s;%s",
+			PAPI_VERSION, hw->vendor, hw->cpuid_family,
+			hw->cpuid_model, hw->cpuid_stepping, hw->model_string,
+			uts.release, key );
+	full = papi_malloc( len + 1 );
+	if ( full == NULL )
+		return NULL;
+	snprintf( full, len + 1, "papi %#x;cpu %d %d %d %d %s;kernel %s;%s",
+		  PAPI_VERSION, hw->vendor, hw->cpuid_family, hw->cpuid_model,
+		  hw->cpuid_stepping, hw->model_string, uts.release, key );
+	return full;
+}
+
+/* map the file and check everything the readers rely on */
+static int
+cache_map( void )
+{
+	const papi_cache_hdr_t *hdr;
+	struct stat st;
+	size_t key_len = strlen( cache.key );
+	unsigned int i;
+	void *map;
+	int fd;
+
+	fd = open( cache.path, O_RDONLY | O_CLOEXEC );
+	if ( fd < 0 )
+		return PAPI_ENOEVNT;
+
+	if ( fstat( fd, &st ) < 0 ||
+	     ( size_t ) st.st_size < sizeof ( papi_cache_hdr_t ) + key_len ) {
+		close( fd );
+		return PAPI_ENOEVNT;
+	}
+
+	map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED )
+		return PAPI_ENOEVNT;
+
+	cache.map = map;
+	cache.map_len = st.st_size;
+
+	hdr = ( const papi_cache_hdr_t * ) cache.map;
+	if ( memcmp( hdr->magic, PAPI_CACHE_MAGIC, sizeof ( hdr->magic ) ) ||
+	     hdr->format != PAPI_CACHE_FORMAT ||
+	     hdr->size != cache.map_len ||
+	     hdr->nsections > PAPI_CACHE_MAX_SECTIONS ||
+	     hdr->key_len != key_len ||
+	     memcmp( cache.map + sizeof ( *hdr ), cache.key, key_len ) ) {
+		SUBDBG( "%s does not match this host\n", cache.path );
+		return PAPI_ENOEVNT;
+	}
+
+	if ( hdr->checksum != _papi_hwi_hash( cache.map + sizeof ( *hdr ),
+					      cache.map_len - sizeof ( *hdr ) ) ) {
+		SUBDBG( "%s is corrupted\n", cache.path );
+		return PAPI_ENOEVNT;
+	}
+
+	for ( i = 0; i < hdr->nsections; i++ ) {
+		if ( hdr->section[i].offset > cache.map_len ||
+		     hdr->section[i].len > cache.map_len - hdr->section[i].offset ||
+		     ( hdr->section[i].offset & 7 ) ) {
+			SUBDBG( "%s is truncated\n", cache.path );
+			return PAPI_ENOEVNT;
+		}
+	}
+
+	return PAPI_OK;
+}
+
+int
+_papi_cache_open( const char *key )
+{
+	int retval;
+
+	_papi_cache_close(  );
+
+	cache.path = getenv( "PAPI_EVENT_CACHE" );
+	if ( cache.path == NULL || cache.path[0] == '\0' ) {
+		cache.path = NULL;
+		return PAPI_ENOSUPP;
+	}
+
+	cache.key = cache_make_key( key );
+	if ( cache.key == NULL ) {
+		cache.path = NULL;
+		return PAPI_ENOSUPP;
+	}
+
+	retval = cache_map(  );
+	if ( retval != PAPI_OK && cache.map != NULL ) {
+		munmap( cache.map, cache.map_len );
+		cache.map = NULL;
+	}
+	SUBDBG( "%s: %s\n", cache.path, retval == PAPI_OK ? "hit" : "miss" );
+
+	return retval;
+}
+
+const void *
+_papi_cache_section( unsigned int id, size_t *len )
+{
+	const papi_cache_hdr_t *hdr = ( const papi_cache_hdr_t * ) cache.map;
+	unsigned int i;
+
+	if ( hdr == NULL )
+		return NULL;
+
+	for ( i = 0; i < hdr->nsections; i++ ) {
+		if ( hdr->section[i].id == id ) {
+			*len = hdr->section[i].len;
+			return cache.map + hdr->section[i].offset;
+		}
+	}
+	return NULL;
+}
+
+int
+_papi_cache_table( unsigned int id, size_t size, papi_cache_table_t *table )
+{
+	const papi_cache_table_hdr_t *hdr;
+	const char *data;
+	size_t len, records_len;
+
+	data = _papi_cache_section( id, &len );
+	if ( data == NULL || len < sizeof ( *hdr ) )
+		return PAPI_ENOEVNT;
+
+	hdr = ( const papi_cache_table_hdr_t * ) data;
+	if ( hdr->size != size )
+		return PAPI_ENOEVNT;
+
+	records_len = PAPI_CACHE_ALIGN( ( size_t ) hdr->count * size );
+	if ( records_len > len - sizeof ( *hdr ) ||
+	     hdr->strings_len != len - sizeof ( *hdr ) - records_len )
+		return PAPI_ENOEVNT;
+
+	table->records = data + sizeof ( *hdr );
+	table->count = hdr->count;
+	table->strings = table->records + records_len;
+	table->strings_len = hdr->strings_len;
+
+	/* so that no string can run past the pool */
+	if ( table->strings_len > 0 &&
+	     table->strings[table->strings_len - 1] != '\0' )
+		return PAPI_ENOEVNT;
+
+	return PAPI_OK;
+}
+
+const char *
+_papi_cache_str( const papi_cache_table_t *table, unsigned int off )
+{
+	if ( off == PAPI_CACHE_NULL || off >= table->strings_len )
+		return NULL;
+	return table->strings + off;
+}
+
+void
+_papi_cache_buf_add( papi_cache_buf_t *buf, const void *data, size_t len )
+{
+	char *new_data;
+	size_t new_size;
+
+	if ( buf->failed )
+		return;
+
+	if ( buf->len + len > buf->size ) {
+		new_size = buf->size ? buf->size : 4096;
+		while ( new_size < buf->len + len )
+			new_size *= 2;
+		new_data = realloc( buf->data, new_size );
+		if ( new_data == NULL ) {
+			buf->failed = 1;
+			return;
+		}
+		buf->data = new_data;
+		buf->size = new_size;
+	}
+	memcpy( buf->data + buf->len, data, len );
+	buf->len += len;
+}
+
+static const char *
+cache_buf_at( const void *pool, unsigned int offset )
+{
+	return ( ( const papi_cache_buf_t * ) pool )->data + offset;
+}
+
+unsigned int
+_papi_cache_buf_str( papi_cache_buf_t *buf, const char *str )
+{
+	papi_string_slot_t *slot;
+	size_t off = buf->len;
+
+	if ( str == NULL || buf->failed )
+		return PAPI_CACHE_NULL;
+
+	if ( buf->strings.at == NULL )
+		_papi_hwi_string_set_init( &buf->strings, cache_buf_at, buf );
+	slot = _papi_hwi_string_set_add( &buf->strings, str );
+	if ( slot == NULL ) {
+		buf->failed = 1;
+		return PAPI_CACHE_NULL;
+	}
+	if ( slot->offset != PAPI_STRING_NONE )
+		return slot->offset;
+
+	_papi_cache_buf_add( buf, str, strlen( str ) + 1 );
+	if ( buf->failed || off >= PAPI_CACHE_NULL ) {
+		buf->failed = 1;
+		return PAPI_CACHE_NULL;
+	}
+	slot->offset = ( unsigned int ) off;
+	return slot->offset;
+}
+
+void
+_papi_cache_buf_free( papi_cache_buf_t *buf )
+{
+	_papi_hwi_string_set_free( &buf->strings );
+	free( buf->data );
+	memset( buf, 0, sizeof ( *buf ) );
+}
+
+int
+_papi_cache_stage( unsigned int id, const void *data, size_t len )
+{
+	char *copy;
+
+	if ( cache.path == NULL )
+		return PAPI_ENOSUPP;
+	if ( cache.nstaged == PAPI_CACHE_MAX_SECTIONS )
+		return PAPI_ENOMEM;
+
+	copy = papi_malloc( len ? len : 1 );
+	if ( copy == NULL )
+		return PAPI_ENOMEM;
+	memcpy( copy, data, len );
+
+	cache.staged[cache.nstaged].id = id;
+	cache.staged[cache.nstaged].len = len;
+	cache.staged_data[cache.nstaged] = copy;
+	cache.nstaged++;
+
+	return PAPI_OK;
+}
+
+int
+_papi_cache_stage_table( unsigned int id, const papi_cache_buf_t *records,
+			 unsigned int count, size_t size,
+			 const papi_cache_buf_t *strings )
+{
+	papi_cache_buf_t section;
+	papi_cache_table_hdr_t hdr;
+	static const char zero[8];
+	int retval;
+
+	if ( records->failed || strings->failed ||
+	     records->len != ( size_t ) count * size )
+		return PAPI_ENOMEM;
+
+	memset( &hdr, 0, sizeof ( hdr ) );
+	hdr.count = count;
+	hdr.size = size;
+	hdr.strings_len = strings->len;
+
+	memset( &section, 0, sizeof ( section ) );
+	_papi_cache_buf_add( &section, &hdr, sizeof ( hdr ) );
+	_papi_cache_buf_add( &section, records->data, records->len );
+	_papi_cache_buf_add( &section, zero,
+			     PAPI_CACHE_ALIGN( records->len ) - records->len );
+	_papi_cache_buf_add( &section, strings->data, strings->len );
+
+	if ( section.failed )
+		retval = PAPI_ENOMEM;
+	else
+		retval = _papi_cache_stage( id, section.data, section.len );
+
+	_papi_cache_buf_free( &section );
+	return retval;
+}
+
+int
+_papi_cache_write( void )
+{
+	papi_cache_hdr_t hdr;
+	papi_cache_buf_t file;
+	static const char zero[8];
+	char tmp[PATH_MAX];
+	size_t off, key_len;
+	int i, fd, ok;
+
+	if ( cache.path == NULL )
+		return PAPI_ENOSUPP;
+
+	key_len = strlen( cache.key );
+
+	memset( &hdr, 0, sizeof ( hdr ) );
+	memcpy( hdr.magic, PAPI_CACHE_MAGIC, sizeof ( hdr.magic ) );
+	hdr.format = PAPI_CACHE_FORMAT;
+	hdr.nsections = cache.nstaged;
+	hdr.key_len = key_len;
+
+	memset( &file, 0, sizeof ( file ) );
+	_papi_cache_buf_add( &file, &hdr, sizeof ( hdr ) );
+	_papi_cache_buf_add( &file, cache.key, key_len );
+	for ( i = 0; i < cache.nstaged; i++ ) {
+		off = file.len;
+		_papi_cache_buf_add( &file, zero, PAPI_CACHE_ALIGN( off ) - off );
+		hdr.section[i] = cache.staged[i];
+		hdr.section[i].offset = file.len;
+		_papi_cache_buf_add( &file, cache.staged_data[i], cache.staged[i].len );
+	}
+	off = file.len;
+	_papi_cache_buf_add( &file, zero, PAPI_CACHE_ALIGN( off ) - off );
+	if ( file.failed ) {
+		_papi_cache_buf_free( &file );
+		return PAPI_ENOMEM;
+	}
+	hdr.size = file.len;
+	hdr.checksum = _papi_hwi_hash( file.data + sizeof ( hdr ),
+				       file.len - sizeof ( hdr ) );
+	memcpy( file.data, &hdr, sizeof ( hdr ) );
+
+	/* readers either see the old file or the complete new one */
+	ok = snprintf( tmp, sizeof ( tmp ), "%s.%d", cache.path,
+		       ( int ) getpid(  ) ) < ( int ) sizeof ( tmp );
+	fd = ok ? open( tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) : -1;
+	if ( fd < 0 ) {
+		SUBDBG( "cannot create %s: %s\n", tmp, strerror( errno ) );
+		_papi_cache_buf_free( &file );
+		return PAPI_ESYS;
+	}
+
+	ok = write( fd, file.data, file.len ) == ( ssize_t ) file.len;
+	if ( close( fd ) < 0 )
+		ok = 0;
+	_papi_cache_buf_free( &file );
+
+	if ( !ok || rename( tmp, cache.path ) < 0 ) {
+		SUBDBG( "cannot write %s: %s\n", cache.path, strerror( errno ) );
+		unlink( tmp );
+		return PAPI_ESYS;
+	}
+
+	return PAPI_OK;
+}
+
+void
+_papi_cache_close( void )
+{
+	int i;
+
+	if ( cache.map != NULL )
+		munmap( cache.map, cache.map_len );
+	for ( i = 0; i < cache.nstaged; i++ )
+		papi_free( cache.staged_data[i] );
+	if ( cache.key != NULL )
+		papi_free( cache.key );
+
+	memset( &cache, 0, sizeof ( cache ) );
+}
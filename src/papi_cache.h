@@ -0,0 +1,100 @@
+#ifndef PAPI_CACHE_H
+#define PAPI_CACHE_H
+
+/* On-disk cache of the event tables built at PAPI_library_init.
+
+   With PAPI_EVENT_CACHE set to a file name, the tables a component
+   resolves at init time are written to that file in a binary format
+   that is used in place through mmap.  The file is keyed by the PAPI
+   version, the cpu, the kernel release and a component supplied
+   string (PMU list, event table source, ...).  A later init with the
+   same key restores the tables from the file instead of resolving
+   them again; on any mismatch the file is ignored and rewritten. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "papi_hash.h"
+
+#define PAPI_CACHE_MAX_SECTIONS  8
+#define PAPI_CACHE_NULL          0xffffffffu   /* string offset of NULL */
+
+/* section ids */
+#define PAPI_CACHE_PE_EVENTS     1   /* perf_event native event table */
+#define PAPI_CACHE_PRESETS       2   /* preset table of that component */
+#define PAPI_CACHE_PRESET_COUNT  3   /* its num_preset_events */
+
+/** Growing buffer used to lay out a section before it is staged.
+    @internal */
+typedef struct _papi_cache_buf {
+	char *data;
+	size_t len;
+	size_t size;
+	int failed;                      /* an allocation failed */
+	papi_string_set_t strings;       /* of a string pool */
+} papi_cache_buf_t;
+
+/** Records of a table section, as mapped from the file.
+    @internal */
+typedef struct _papi_cache_table {
+	const char *records;
+	unsigned int count;
+	const char *strings;
+	size_t strings_len;
+} papi_cache_table_t;
+
+/** Map the cache file if PAPI_EVENT_CACHE is set.  Returns PAPI_OK if
+    the file matches key, PAPI_ENOEVNT if it is missing or stale (it is
+    then rewritten by _papi_cache_write) and PAPI_ENOSUPP if caching
+    is off.
+    @internal */
+int _papi_cache_open( const char *key );
+
+/** Data of a section of the mapped file, NULL if it has none.
+    @internal */
+const void *_papi_cache_section( unsigned int id, size_t *len );
+
+/** Records and string pool of a table section with records of size
+    bytes.  Returns PAPI_ENOEVNT if the section is missing or malformed.
+    @internal */
+int _papi_cache_table( unsigned int id, size_t size, papi_cache_table_t *table );
+
+/** String at offset off of the string pool of a table, NULL for
+    PAPI_CACHE_NULL or an offset out of the pool.
+    @internal */
+const char *_papi_cache_str( const papi_cache_table_t *table, unsigned int off );
+
+/** Append len bytes to a buffer.
+    @internal */
+void _papi_cache_buf_add( papi_cache_buf_t *buf, const void *data, size_t len );
+
+/** Offset of a string in a string pool, appending it if it is not
+    there yet.  PAPI_CACHE_NULL for NULL or when an allocation failed.
+    @internal */
+unsigned int _papi_cache_buf_str( papi_cache_buf_t *buf, const char *str );
+
+/** Free a buffer.
+    @internal */
+void _papi_cache_buf_free( papi_cache_buf_t *buf );
+
+/** Stage a section to be written by _papi_cache_write.
+    @internal */
+int _papi_cache_stage( unsigned int id, const void *data, size_t len );
+
+/** Stage a table section of count records of size bytes and the
+    string pool their offsets refer to.
+    @internal */
+int _papi_cache_stage_table( unsigned int id, const papi_cache_buf_t *records,
+			     unsigned int count, size_t size,
+			     const papi_cache_buf_t *strings );
+
+/** Write the staged sections under the key given to _papi_cache_open.
+    The file is replaced atomically.
+    @internal */
+int _papi_cache_write( void );
+
+/** Unmap the file and drop the staged sections.
+    @internal */
+void _papi_cache_close( void );
+
+#endif /* PAPI_CACHE_H */
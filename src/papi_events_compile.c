@@ -0,0 +1,372 @@
+/*
+* File:    papi_events_compile.c
+*
+* Compiles a preset event file (papi_events.csv) into the binary form
+* described in papi_preset_bin.h, which papi_preset.c uses without
+* parsing any text.  This runs at build time, on the build host:
+*
+*   papi_events_compile <events.csv> <events.bin> [<header.h>]
+*
+* The header, if given, defines the same bytes as the array
+* papi_events_bin, to be built into the library.  The parsing follows
+* papi_load_derived_events: fields are split at commas and trimmed of
+* blanks, descriptions lose a pair of enclosing quotes or brackets and
+* DERIVED_INFIX formulas are converted to DERIVED_POSTFIX.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "papi_preset_bin.h"
+#include "papi_preset_parse.h"
+#include "papi_hash.h"
+
+#define MAX_LINE      65536
+
+typedef struct {
+	unsigned char *data;
+	size_t len, size;
+} buf_t;
+
+/* the string pool, with a string set to keep each string once */
+static buf_t strings;
+static papi_string_set_t string_set;
+
+static buf_t records, terms;
+static uint32_t num_records, num_terms;
+
+typedef struct {
+	char *key;
+	uint32_t first;
+} section_t;
+
+static section_t *sections;
+static uint32_t num_sections, max_sections;
+
+static void
+fail( const char *what )
+{
+	fprintf( stderr, "papi_events_compile: %s\n", what );
+	exit( 1 );
+}
+
+static void
+buf_add( buf_t *buf, const void *data, size_t len )
+{
+	if ( buf->len + len > buf->size ) {
+		buf->size = ( buf->len + len ) * 2 + 4096;
+		buf->data = realloc( buf->data, buf->size );
+		if ( buf->data == NULL )
+			fail( "out of memory" );
+	}
+	memcpy( buf->data + buf->len, data, len );
+	buf->len += len;
+}
+
+static void
+buf_word( buf_t *buf, uint32_t w )
+{
+	unsigned char b[4];
+
+	pb_put_word( b, w );
+	buf_add( buf, b, 4 );
+}
+
+static const char *
+string_at( const void *pool, unsigned int offset )
+{
+	return ( const char * ) ( ( const buf_t * ) pool )->data + offset;
+}
+
+/* offset of a string in the pool, PB_NONE for NULL or "" */
+static uint32_t
+add_string( const char *s )
+{
+	papi_string_slot_t *slot;
+	uint32_t off;
+
+	if ( s == NULL || *s == '\0' )
+		return PB_NONE;
+
+	if ( string_set.at == NULL )
+		_papi_hwi_string_set_init( &string_set, string_at, &strings );
+	slot = _papi_hwi_string_set_add( &string_set, s );
+	if ( slot == NULL )
+		fail( "out of memory" );
+	if ( slot->offset != PAPI_STRING_NONE )
+		return slot->offset;
+
+	off = ( uint32_t ) strings.len;
+	buf_add( &strings, s, strlen( s ) + 1 );
+	slot->offset = off;
+	return off;
+}
+
+static char *
+next_field( char **save )
+{
+	char *t = _papi_preset_trim_string( strtok_r( NULL, ",", save ) );
+
+	return ( t != NULL && *t != '\0' ) ? t : NULL;
+}
+
+static void
+add_section( const char *kind, const char *name, uint32_t first )
+{
+	char *key, *p;
+	uint32_t i;
+
+	key = malloc( strlen( kind ) + strlen( name ) + 2 );
+	if ( key == NULL )
+		fail( "out of memory" );
+	sprintf( key, "%s,%s", kind, name );
+	for ( p = key; *p; p++ )
+		*p = ( char ) tolower( ( unsigned char ) *p );
+
+	for ( i = 0; i < num_sections; i++ ) {
+		if ( strcmp( sections[i].key, key ) == 0 ) {
+			free( key );
+			return;
+		}
+	}
+	if ( num_sections == max_sections ) {
+		max_sections = max_sections ? 2 * max_sections : 256;
+		sections = realloc( sections, max_sections * sizeof ( section_t ) );
+		if ( sections == NULL )
+			fail( "out of memory" );
+	}
+	sections[num_sections].key = key;
+	sections[num_sections].first = first;
+	num_sections++;
+}
+
+static int
+compare_sections( const void *a, const void *b )
+{
+	return strcmp( ( ( const section_t * ) a )->key,
+		       ( ( const section_t * ) b )->key );
+}
+
+static void
+add_record( uint32_t *rec )
+{
+	int i;
+
+	for ( i = 0; i < PB_REC_WORDS; i++ )
+		buf_word( &records, rec[i] );
+	num_records++;
+}
+
+/* CPU,<name>[,<qualifier>] or <component>,<arch>[,...] */
+static void
+compile_header( char *kind, char **save, int line_no )
+{
+	uint32_t rec[PB_REC_WORDS];
+	char *name, *qual;
+	int value;
+
+	memset( rec, 0, sizeof ( rec ) );
+	rec[PB_REC_TYPE] = PB_HEADER;
+	rec[PB_REC_LINE] = ( uint32_t ) line_no;
+	rec[PB_REC_KIND] = add_string( kind );
+	rec[PB_REC_QUAL] = PB_QUAL_NONE;
+
+	name = next_field( save );
+	rec[PB_REC_NAME] = add_string( name );
+	if ( name != NULL ) {
+		add_section( kind, name, num_records );
+		qual = next_field( save );
+		if ( qual != NULL ) {
+			if ( sscanf( qual, "%d", &value ) == 1 ) {
+				rec[PB_REC_QUAL] = PB_QUAL_NUMBER;
+				rec[PB_REC_QUAL_VALUE] = ( uint32_t ) value;
+			} else {
+				rec[PB_REC_QUAL] = PB_QUAL_OTHER;
+			}
+		}
+	}
+	add_record( rec );
+}
+
+/* PRESET,<symbol>,<derived>[,<formula>],<term>...[,SDESC|LDESC|NOTE,<text>]... */
+static void
+compile_event( char **save, int line_no )
+{
+	uint32_t rec[PB_REC_WORDS];
+	char postfix[2 * PAPI_PRESET_MAX_FORMULA + 2];
+	char *t, *field, *derived;
+	uint32_t count = 0;
+
+	memset( rec, 0, sizeof ( rec ) );
+	rec[PB_REC_TYPE] = PB_EVENT;
+	rec[PB_REC_LINE] = ( uint32_t ) line_no;
+	rec[PB_REC_DERIVED] = rec[PB_REC_POSTFIX] = PB_NONE;
+	rec[PB_REC_SHORT_DESCR] = rec[PB_REC_LONG_DESCR] = PB_NONE;
+	rec[PB_REC_NOTE] = PB_NONE;
+	rec[PB_REC_FIRST_TERM] = num_terms;
+
+	rec[PB_REC_SYMBOL] = add_string( next_field( save ) );
+	if ( rec[PB_REC_SYMBOL] == PB_NONE )
+		goto done;
+
+	derived = next_field( save );
+	if ( derived == NULL )
+		goto done;
+	if ( strcasecmp( derived, "DERIVED_POSTFIX" ) == 0 ||
+	     strcasecmp( derived, "DERIVED_INFIX" ) == 0 ) {
+		t = next_field( save );
+		if ( t != NULL && strcasecmp( derived, "DERIVED_INFIX" ) == 0 ) {
+			t = _papi_preset_infix_to_postfix( t, postfix, sizeof ( postfix ) );
+			if ( t == NULL )
+				fail( "infix formula too long" );
+			derived = "DERIVED_POSTFIX";
+		}
+		rec[PB_REC_DERIVED] = add_string( derived );
+		rec[PB_REC_POSTFIX] = add_string( t );
+		if ( t == NULL )
+			goto done;
+	} else {
+		rec[PB_REC_DERIVED] = add_string( derived );
+	}
+
+	do {
+		t = next_field( save );
+		if ( t == NULL || strcasecmp( t, "NOTE" ) == 0 ||
+		     strcasecmp( t, "LDESC" ) == 0 || strcasecmp( t, "SDESC" ) == 0 )
+			break;
+		buf_word( &terms, add_string( t ) );
+		num_terms++;
+		count++;
+	} while ( count < PB_MAX_TERMS );
+
+	if ( count == PB_MAX_TERMS )
+		t = next_field( save );
+
+	while ( t != NULL ) {
+		field = t;
+		t = _papi_preset_trim_note( strtok_r( NULL, ",", save ) );
+		if ( t == NULL || *t == '\0' )
+			break;
+		if ( strcasecmp( field, "SDESC" ) == 0 )
+			rec[PB_REC_SHORT_DESCR] = add_string( t );
+		if ( strcasecmp( field, "LDESC" ) == 0 )
+			rec[PB_REC_LONG_DESCR] = add_string( t );
+		if ( strcasecmp( field, "NOTE" ) == 0 )
+			rec[PB_REC_NOTE] = add_string( t );
+		t = next_field( save );
+	}
+
+  done:
+	rec[PB_REC_NUM_TERMS] = count;
+	add_record( rec );
+}
+
+static void
+write_file( const char *path, const unsigned char *data, size_t len )
+{
+	FILE *fff = fopen( path, "wb" );
+
+	if ( fff == NULL || fwrite( data, 1, len, fff ) != len || fclose( fff ) )
+		fail( path );
+}
+
+static void
+write_header( const char *path, const unsigned char *data, size_t len )
+{
+	FILE *fff = fopen( path, "w" );
+	size_t i;
+
+	if ( fff == NULL )
+		fail( path );
+	fprintf( fff, "/* Generated by papi_events_compile, do not edit. */\n" );
+	fprintf( fff, "static const unsigned char papi_events_bin[%lu] = {",
+		 ( unsigned long ) len );
+	for ( i = 0; i < len; i++ )
+		fprintf( fff, "%s%u,", ( i % 20 ) ? "" : "\n", data[i] );
+	fprintf( fff, "\n};\n" );
+	if ( fclose( fff ) )
+		fail( path );
+}
+
+int
+main( int argc, char **argv )
+{
+	char *line, *t, *save;
+	unsigned char word[4];
+	buf_t out = { NULL, 0, 0 };
+	uint32_t hdr[PB_HDR_WORDS], i;
+	size_t len;
+	int line_no = 0;
+	FILE *csv;
+
+	if ( argc != 3 && argc != 4 ) {
+		fprintf( stderr, "usage: %s <events.csv> <events.bin> [<header.h>]\n",
+			 argv[0] );
+		return 1;
+	}
+
+	csv = fopen( argv[1], "r" );
+	line = malloc( MAX_LINE );
+	if ( csv == NULL || line == NULL )
+		fail( argv[1] );
+
+	while ( fgets( line, MAX_LINE, csv ) != NULL ) {
+		line_no++;
+		len = strlen( line );
+		if ( len == MAX_LINE - 1 && line[len - 1] != '\n' )
+			fail( "line too long" );
+		if ( len > 0 && line[len - 1] == '\n' )
+			line[--len] = '\0';
+
+		save = NULL;
+		t = _papi_preset_trim_string( strtok_r( line, ",", &save ) );
+		if ( t == NULL || *t == '\0' || *t == '#' )
+			continue;
+
+		if ( strcasecmp( t, "PRESET" ) == 0 || strcasecmp( t, "EVENT" ) == 0 )
+			compile_event( &save, line_no );
+		else
+			compile_header( t, &save, line_no );
+	}
+	fclose( csv );
+
+	qsort( sections, num_sections, sizeof ( section_t ), compare_sections );
+
+	/* layout: magic, header, records, sections, terms, strings */
+	hdr[PB_HDR_VERSION] = PB_VERSION;
+	hdr[PB_HDR_NUM_RECORDS] = num_records;
+	hdr[PB_HDR_RECORDS] = PB_MAGIC_LEN + 4 * PB_HDR_WORDS;
+	hdr[PB_HDR_NUM_SECTIONS] = num_sections;
+	hdr[PB_HDR_SECTIONS] = hdr[PB_HDR_RECORDS] + ( uint32_t ) records.len;
+	hdr[PB_HDR_NUM_TERMS] = num_terms;
+	hdr[PB_HDR_TERMS] = hdr[PB_HDR_SECTIONS] + 4 * PB_SEC_WORDS * num_sections;
+	hdr[PB_HDR_STRINGS] = hdr[PB_HDR_TERMS] + ( uint32_t ) terms.len;
+
+	/* section keys go into the pool too, which must be complete first */
+	for ( i = 0; i < num_sections; i++ )
+		add_string( sections[i].key );
+	hdr[PB_HDR_STRINGS_LEN] = ( uint32_t ) strings.len;
+	hdr[PB_HDR_SIZE] = hdr[PB_HDR_STRINGS] + ( uint32_t ) strings.len;
+
+	buf_add( &out, PB_MAGIC, PB_MAGIC_LEN );
+	for ( i = 0; i < PB_HDR_WORDS; i++ ) {
+		pb_put_word( word, hdr[i] );
+		buf_add( &out, word, 4 );
+	}
+	buf_add( &out, records.data, records.len );
+	for ( i = 0; i < num_sections; i++ ) {
+		buf_word( &out, add_string( sections[i].key ) );
+		buf_word( &out, sections[i].first );
+	}
+	buf_add( &out, terms.data, terms.len );
+	buf_add( &out, strings.data, strings.len );
+
+	write_file( argv[2], out.data, out.len );
+	if ( argc == 4 )
+		write_header( argv[3], out.data, out.len );
+
+	return 0;
+}
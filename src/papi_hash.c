@@ -0,0 +1,119 @@
+/*
+* File:    papi_hash.c
+*
+* Hashes and string sets, see papi_hash.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "papi_hash.h"
+
+#define STRING_SET_MIN_SLOTS 1024
+
+unsigned int
+_papi_hwi_string_hash( const char *str )
+{
+	unsigned int h = 2166136261u;
+
+	while ( *str )
+		h = ( h ^ ( unsigned char ) *str++ ) * 16777619u;
+	return h;
+}
+
+unsigned long long
+_papi_hwi_hash( const void *data, size_t len )
+{
+	const unsigned char *byte = data;
+	uint64_t h = 14695981039346656037ULL, word;
+	size_t i;
+
+	for ( i = 0; i + sizeof ( word ) <= len; i += sizeof ( word ) ) {
+		memcpy( &word, byte + i, sizeof ( word ) );
+		h = ( h ^ word ) * 1099511628211ULL;
+	}
+	for ( ; i < len; i++ )
+		h = ( h ^ byte[i] ) * 1099511628211ULL;
+	return h;
+}
+
+void
+_papi_hwi_string_set_init( papi_string_set_t *set, papi_string_at_t at,
+						   const void *pool )
+{
+	memset( set, 0, sizeof ( *set ) );
+	set->at = at;
+	set->pool = pool;
+}
+
+papi_string_slot_t *
+_papi_hwi_string_set_find( const papi_string_set_t *set, const char *str )
+{
+	papi_string_slot_t *slot;
+	unsigned int i;
+
+	if ( set->slots == NULL )
+		return NULL;
+
+	i = _papi_hwi_string_hash( str ) & ( set->num_slots - 1 );
+	while ( 1 ) {
+		slot = &set->slots[i];
+		if ( slot->offset == PAPI_STRING_NONE ||
+			 strcmp( set->at( set->pool, slot->offset ), str ) == 0 )
+			return slot;
+		i = ( i + 1 ) & ( set->num_slots - 1 );
+	}
+}
+
+/* double the slots, putting the strings back in */
+static int
+string_set_grow( papi_string_set_t *set )
+{
+	papi_string_slot_t *old = set->slots;
+	unsigned int old_num = set->num_slots, i;
+
+	set->num_slots = old_num ? 2 * old_num : STRING_SET_MIN_SLOTS;
+	set->slots = malloc( set->num_slots * sizeof ( papi_string_slot_t ) );
+	if ( set->slots == NULL ) {
+		set->slots = old;
+		set->num_slots = old_num;
+		return -1;
+	}
+	for ( i = 0; i < set->num_slots; i++ ) {
+		set->slots[i].offset = PAPI_STRING_NONE;
+		set->slots[i].value = -1;
+	}
+
+	for ( i = 0; i < old_num; i++ ) {
+		if ( old[i].offset != PAPI_STRING_NONE )
+			*_papi_hwi_string_set_find( set, set->at( set->pool,
+													  old[i].offset ) ) = old[i];
+	}
+	free( old );
+	return 0;
+}
+
+papi_string_slot_t *
+_papi_hwi_string_set_add( papi_string_set_t *set, const char *str )
+{
+	papi_string_slot_t *slot;
+
+	if ( 2 * ( set->count + 1 ) > set->num_slots &&
+		 string_set_grow( set ) != 0 )
+		return NULL;
+
+	slot = _papi_hwi_string_set_find( set, str );
+	if ( slot->offset == PAPI_STRING_NONE )
+		set->count++;
+	return slot;
+}
+
+void
+_papi_hwi_string_set_free( papi_string_set_t *set )
+{
+	free( set->slots );
+	set->slots = NULL;
+	set->num_slots = 0;
+	set->count = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef PAPI_HASH_H
+#define PAPI_HASH_H
+
+/* Hashes and the string set every string table of the library is
+   interned through: the name cache, the event catalog, the event
+   cache string pools, the perf_event string arena and the string pool
+   of papi_events_compile.  Built into the library and into
+   papi_events_compile, so it only uses the C library. */
+
+#include <stddef.h>
+
+#define PAPI_STRING_NONE 0xffffffffu	/* offset of a free slot */
+
+/** A slot of a string set: the offset of the string in its pool and
+    a value for the owner of the set, -1 when the slot is taken.
+    @internal */
+typedef struct _papi_string_slot {
+	unsigned int offset;
+	int value;
+} papi_string_slot_t;
+
+/** String at offset of a pool.
+    @internal */
+typedef const char *( *papi_string_at_t ) ( const void *pool,
+											 unsigned int offset );
+
+/** Set of the strings of a pool, by offset, kept at most half full.
+    The pool itself belongs to the owner, which appends the strings
+    and says through at where they are.
+    @internal */
+typedef struct _papi_string_set {
+	papi_string_slot_t *slots;	/* open addressing, a power of two */
+	unsigned int num_slots;
+	unsigned int count;
+	papi_string_at_t at;
+	const void *pool;
+} papi_string_set_t;
+
+/** 32-bit FNV-1a hash of a string.
+    @internal */
+unsigned int _papi_hwi_string_hash( const char *str );
+
+/** 64-bit FNV-1a hash of len bytes, taken a 64-bit word at a time
+    with the bytes left over after the last word one at a time.
+    @internal */
+unsigned long long _papi_hwi_hash( const void *data, size_t len );
+
+/** Start an empty set of the strings of pool.
+    @internal */
+void _papi_hwi_string_set_init( papi_string_set_t *set, papi_string_at_t at,
+								const void *pool );
+
+/** Slot of str, or the free slot it would go in; NULL if the set has
+    no slots yet.
+    @internal */
+papi_string_slot_t *_papi_hwi_string_set_find( const papi_string_set_t *set,
+												const char *str );
+
+/** Slot of str, taking a free one if str is not in the set yet.  The
+    caller then appends str to the pool and sets the offset of the
+    slot.  Returns NULL if the set can not grow.
+    @internal */
+papi_string_slot_t *_papi_hwi_string_set_add( papi_string_set_t *set,
+											   const char *str );
+
+/** Free the slots of a set.
+    @internal */
+void _papi_hwi_string_set_free( papi_string_set_t *set );
+
+#endif /* PAPI_HASH_H */
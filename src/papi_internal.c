@@ -28,11 +28,13 @@
 */
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "papi.h"
 #include "papi_internal.h"
@@ -42,6 +44,8 @@
 #include "extras.h"
 #include "papi_preset.h"
 #include "cpus.h"
+#include "papi_node.h"
+#include "papi_cache.h"
 
 #include "papi_common_strings.h"
 
@@ -73,6 +77,7 @@ THREAD_LOCAL_STORAGE_KEYWORD int _papi_hl_events_running = 0;
 /*****************************/
 
 #define NATIVE_EVENT_CHUNKSIZE 1024
+#define NATIVE_EVENT_MAX_CHUNKS 4096
 
 struct native_event_info {
   int cidx;
@@ -82,65 +87,182 @@ struct native_event_info {
 };
 
 
-// The following array is indexed by the papi event code (after the native bit has been removed)
-static struct native_event_info *_papi_native_events=NULL;
+// The following table is indexed by the papi event code (after the native bit has been removed).
+// Entries live in chunks that never move, and num_native_events is published after an entry is
+// filled in, so lookups read the table without a lock while new events are added under INTERNAL_LOCK.
+static struct native_event_info *_papi_native_events[NATIVE_EVENT_MAX_CHUNKS];
 static int num_native_events=0;
 static int num_native_chunks=0;
 
+#define NATIVE_EVENT( i ) \
+	( &_papi_native_events[( i ) / NATIVE_EVENT_CHUNKSIZE][( i ) % NATIVE_EVENT_CHUNKSIZE] )
+
+/* Entry of a native event index, NULL if it is out of range */
+static struct native_event_info *
+native_event_entry( int event_index )
+{
+	if ( event_index < 0 ||
+	     event_index >= __atomic_load_n( &num_native_events, __ATOMIC_ACQUIRE ) )
+		return NULL;
+	return NATIVE_EVENT( event_index );
+}
+
 char **_papi_errlist= NULL;
 static int num_error_chunks = 0;
 
-// pointer to event:mask string associated with last enum call to a components
-// will be NULL for non libpfm4 components
-// this is needed because libpfm4 event codes and papi event codes do not contain mask information
-char *papi_event_string = NULL;
+/*
+ * State handed between the framework and a component while an event is
+ * resolved: the PAPI event code (set before the component is called, or
+ * created by it) and the event:mask string of the last enum call, which
+ * libpfm4 components need because their codes do not carry the masks.
+ * Each lookup keeps its own papi_event_ctx_t on its stack, so lookups on
+ * different threads share nothing.  Outside of a lookup (component init)
+ * the thread's own context is used.
+ */
+#ifdef HAVE_THREAD_LOCAL_STORAGE
+static THREAD_LOCAL_STORAGE_KEYWORD papi_event_ctx_t *event_ctx = NULL;
+static THREAD_LOCAL_STORAGE_KEYWORD papi_event_ctx_t thread_event_ctx =
+	{ ( unsigned int ) -1, -1, NULL, NULL };
+
+#define EVENT_CTX         event_ctx
+#define THREAD_EVENT_CTX  ( &thread_event_ctx )
+#else
+/* Without thread local storage, a pthread key holds both per thread */
+typedef struct {
+	papi_event_ctx_t *current;      /* innermost lookup, NULL if none */
+	papi_event_ctx_t own;
+} event_ctx_tls_t;
+
+static pthread_key_t event_ctx_key;
+static pthread_once_t event_ctx_once = PTHREAD_ONCE_INIT;
+static int event_ctx_key_ok = 0;
+
+/* Only used if the key or its data cannot be allocated */
+static event_ctx_tls_t event_ctx_shared =
+	{ NULL, { ( unsigned int ) -1, -1, NULL, NULL } };
+
+static void
+event_ctx_free( void *arg )
+{
+	event_ctx_tls_t *tls = ( event_ctx_tls_t * ) arg;
+
+	free( tls->own.event_string );
+	free( tls );
+}
+
+static void
+event_ctx_key_create( void )
+{
+	event_ctx_key_ok = ( pthread_key_create( &event_ctx_key, event_ctx_free ) == 0 );
+}
+
+static event_ctx_tls_t *
+event_ctx_tls( void )
+{
+	event_ctx_tls_t *tls;
+
+	pthread_once( &event_ctx_once, event_ctx_key_create );
+	if ( !event_ctx_key_ok )
+		return &event_ctx_shared;
+
+	tls = ( event_ctx_tls_t * ) pthread_getspecific( event_ctx_key );
+	if ( tls == NULL ) {
+		tls = ( event_ctx_tls_t * ) calloc( 1, sizeof ( *tls ) );
+		if ( tls == NULL )
+			return &event_ctx_shared;
+		tls->own.event_code = ( unsigned int ) -1;
+		tls->own.event_code_changed = -1;
+		if ( pthread_setspecific( event_ctx_key, tls ) ) {
+			free( tls );
+			return &event_ctx_shared;
+		}
+	}
+	return tls;
+}
+
+#define EVENT_CTX         ( event_ctx_tls(  )->current )
+#define THREAD_EVENT_CTX  ( &event_ctx_tls(  )->own )
+#endif
+
+static papi_event_ctx_t *
+current_event_ctx( void )
+{
+	return EVENT_CTX != NULL ? EVENT_CTX : THREAD_EVENT_CTX;
+}
+
+/* Start a lookup; until the matching _papi_hwi_event_ctx_end the */
+/* papi_event_code and papi_event_string functions use ctx         */
+void
+_papi_hwi_event_ctx_begin( papi_event_ctx_t *ctx )
+{
+	ctx->event_code = ( unsigned int ) -1;
+	ctx->event_code_changed = -1;
+	ctx->event_string = NULL;
+	ctx->outer = EVENT_CTX;
+	EVENT_CTX = ctx;
+}
+
+void
+_papi_hwi_event_ctx_end( papi_event_ctx_t *ctx )
+{
+	free( ctx->event_string );
+	ctx->event_string = NULL;
+	EVENT_CTX = ctx->outer;
+}
+
 void
 _papi_hwi_set_papi_event_string (const char *event_string) {
 	INTDBG("event_string: %s\n", event_string);
-	if (papi_event_string != NULL) {
-		free (papi_event_string);
-		papi_event_string = NULL;
+	papi_event_ctx_t *ctx = current_event_ctx();
+
+	if (ctx->event_string != NULL) {
+		free (ctx->event_string);
+		ctx->event_string = NULL;
 	}
 	if (event_string != NULL) {
-		papi_event_string = strdup(event_string);
+		ctx->event_string = strdup(event_string);
 	}
 	return;
 }
 char *
 _papi_hwi_get_papi_event_string () {
-	INTDBG("papi_event_string: %s\n", papi_event_string);
-	return papi_event_string;
+	INTDBG("papi_event_string: %s\n", current_event_ctx()->event_string);
+	return current_event_ctx()->event_string;
 }
 void
 _papi_hwi_free_papi_event_string() {
-	if (papi_event_string != NULL) {
-		free(papi_event_string);
-		papi_event_string = NULL;
+	papi_event_ctx_t *ctx = current_event_ctx();
+
+	if (ctx->event_string != NULL) {
+		free(ctx->event_string);
+		ctx->event_string = NULL;
 	}
 	return;
 }
 
 void
 _papi_hwi_set_papi_event_code (unsigned int event_code, int update_flag) {
-	INTDBG("new event_code: %#x, update_flag: %d, previous event_code: %#x\n", event_code, update_flag, _papi_hwi_my_thread->tls_papi_event_code);
+	papi_event_ctx_t *ctx = current_event_ctx();
+
+	INTDBG("new event_code: %#x, update_flag: %d, previous event_code: %#x\n", event_code, update_flag, ctx->event_code);
 
 	// if call is just to reset and start over, set both flags to show nothing saved yet
 	if (update_flag < 0) {
-		_papi_hwi_my_thread->tls_papi_event_code_changed = -1;
-		_papi_hwi_my_thread->tls_papi_event_code = -1;
+		ctx->event_code_changed = -1;
+		ctx->event_code = -1;
 		return;
 	}
 
 	// if 0, it is being set prior to calling a component, if >0 it is being changed by the component
-	_papi_hwi_my_thread->tls_papi_event_code_changed = update_flag;
+	ctx->event_code_changed = update_flag;
 	// save the event code passed in
-	_papi_hwi_my_thread->tls_papi_event_code = event_code;
+	ctx->event_code = event_code;
 	return;
 }
 unsigned int
 _papi_hwi_get_papi_event_code () {
-	INTDBG("papi_event_code: %#x\n", _papi_hwi_my_thread->tls_papi_event_code);
-	return _papi_hwi_my_thread->tls_papi_event_code;
+	INTDBG("papi_event_code: %#x\n", current_event_ctx()->event_code);
+	return current_event_ctx()->event_code;
 }
 /* Get the index into the ESI->NativeInfoArray for the current PAPI event code */
 int
@@ -149,6 +271,7 @@ _papi_hwi_get_ntv_idx (unsigned int papi_evt_code) {
 
 	int result;
 	int event_index;
+	struct native_event_info *entry;
 
 	if (papi_evt_code == 0) {
 		INTDBG("EXIT: PAPI_ENOEVNT, invalid papi event code\n");
@@ -156,12 +279,12 @@ _papi_hwi_get_ntv_idx (unsigned int papi_evt_code) {
 	}
 
 	event_index=papi_evt_code&PAPI_NATIVE_AND_MASK;
-	if ((event_index<0) || (event_index>=num_native_events)) {
+	if ((entry = native_event_entry(event_index)) == NULL) {
 		INTDBG("EXIT: PAPI_ENOEVNT, invalid index into native event array\n");
 		return PAPI_ENOEVNT;
 	}
 
-	result=_papi_native_events[event_index].ntv_idx;
+	result=entry->ntv_idx;
 
 	INTDBG("EXIT: result: %d\n", result);
 	return result;
@@ -226,7 +349,8 @@ static int
 _papi_hwi_find_native_event(int cidx, int event, const char *event_name) {
   INTDBG("ENTER: cidx: %x, event: %#x, event_name: %s\n", cidx, event, event_name);
 
-  int i;
+  int i, num;
+  struct native_event_info *entry;
 
   // if no event name passed in, it can not be found
   if (event_name == NULL) {
@@ -234,19 +358,21 @@ _papi_hwi_find_native_event(int cidx, int event, const char *event_name) {
 		return PAPI_ENOEVNT;
   }
 
-  for(i=0;i<num_native_events;i++) {
+  num = __atomic_load_n(&num_native_events, __ATOMIC_ACQUIRE);
+  for(i=0;i<num;i++) {
+	entry = NATIVE_EVENT(i);
   	// if we have have not set up this event name yet, look at next
-  	if (_papi_native_events[i].evt_name == NULL) {
+  	if (entry->evt_name == NULL) {
   		continue;
   	}
 
   	// is this entry for the correct component and event code
-  	if ((_papi_native_events[i].cidx==cidx) &&
-	(_papi_native_events[i].component_event==event)) {
+  	if ((entry->cidx==cidx) &&
+	(entry->component_event==event)) {
 		// if this event name matches what we want, return its papi event code
-		if (strcmp(event_name, _papi_native_events[i].evt_name) == 0) {
+		if (strcmp(event_name, entry->evt_name) == 0) {
 			INTDBG("EXIT: event: %#x, component_event: %#x, ntv_idx: %d, event_name: %s\n",
-				i|PAPI_NATIVE_MASK, _papi_native_events[i].component_event, _papi_native_events[i].ntv_idx, _papi_native_events[i].evt_name);
+				i|PAPI_NATIVE_MASK, entry->component_event, entry->ntv_idx, entry->evt_name);
 			return i|PAPI_NATIVE_MASK;
 		}
     }
@@ -261,41 +387,54 @@ _papi_hwi_add_native_event(int cidx, int ntv_event, int ntv_idx, const char *eve
 	INTDBG("ENTER: cidx: %d, ntv_event: %#x, ntv_idx: %d, event_name: %s\n", cidx, ntv_event, ntv_idx, event_name);
 
   int new_native_event;
+  struct native_event_info *entry;
 
   _papi_hwi_lock( INTERNAL_LOCK );
 
+  // another thread may have added it since it was looked for
+  new_native_event=_papi_hwi_find_native_event(cidx, ntv_event, event_name);
+  if (new_native_event!=PAPI_ENOEVNT) {
+     goto native_alloc_early_out;
+  }
+
   if (num_native_events>=num_native_chunks*NATIVE_EVENT_CHUNKSIZE) {
-     num_native_chunks++;
-     _papi_native_events=(struct native_event_info *) realloc(_papi_native_events,
-				 num_native_chunks*NATIVE_EVENT_CHUNKSIZE*
-				 sizeof(struct native_event_info));
-     if (_papi_native_events==NULL) {
+     if (num_native_chunks>=NATIVE_EVENT_MAX_CHUNKS) {
+        new_native_event=PAPI_ENOMEM;
+	goto native_alloc_early_out;
+     }
+     _papi_native_events[num_native_chunks]=(struct native_event_info *)
+	     malloc(NATIVE_EVENT_CHUNKSIZE*sizeof(struct native_event_info));
+     if (_papi_native_events[num_native_chunks]==NULL) {
         new_native_event=PAPI_ENOMEM;
 	goto native_alloc_early_out;
      }
+     num_native_chunks++;
   }
 
-  _papi_native_events[num_native_events].cidx=cidx;
-  _papi_native_events[num_native_events].component_event=ntv_event;
-  _papi_native_events[num_native_events].ntv_idx=ntv_idx;
+  entry=NATIVE_EVENT(num_native_events);
+  entry->cidx=cidx;
+  entry->component_event=ntv_event;
+  entry->ntv_idx=ntv_idx;
   if (event_name != NULL) {
-	  _papi_native_events[num_native_events].evt_name=strdup(event_name);
-          if (_papi_native_events[num_native_events].evt_name == NULL) {
+	  entry->evt_name=strdup(event_name);
+          if (entry->evt_name == NULL) {
               new_native_event=PAPI_ENOMEM;
               goto native_alloc_early_out;
           }
   } else {
-	  _papi_native_events[num_native_events].evt_name=NULL;
+	  entry->evt_name=NULL;
   }
   new_native_event=num_native_events|PAPI_NATIVE_MASK;
 
-  num_native_events++;
+  // publish the entry to the lookups that do not take the lock
+  __atomic_store_n(&num_native_events, num_native_events+1, __ATOMIC_RELEASE);
 
 native_alloc_early_out:
 
   _papi_hwi_unlock( INTERNAL_LOCK );
 
-  INTDBG("EXIT: new_native_event: %#x, num_native_events: %d\n", new_native_event, num_native_events);
+  INTDBG("EXIT: new_native_event: %#x, num_native_events: %d\n", new_native_event,
+	  __atomic_load_n(&num_native_events, __ATOMIC_ACQUIRE));
   return new_native_event;
 }
 
@@ -441,6 +580,7 @@ _papi_hwi_component_index( int event_code ) {
 
   int cidx;
   int event_index;
+  struct native_event_info *entry;
 
   if (IS_PRESET(event_code)) {
      INTDBG("EXIT: Event %#x is a PRESET, assigning component %d\n", event_code,0);
@@ -456,12 +596,13 @@ _papi_hwi_component_index( int event_code ) {
 
   event_index=event_code&PAPI_NATIVE_AND_MASK;
 
-  if ( (event_index < 0) || (event_index>=num_native_events)) {
-     INTDBG("EXIT: Event index %#x is out of range, num_native_events: %d\n", event_index, num_native_events);
+  if ( (entry = native_event_entry(event_index)) == NULL) {
+     INTDBG("EXIT: Event index %#x is out of range, num_native_events: %d\n", event_index,
+	     __atomic_load_n( &num_native_events, __ATOMIC_ACQUIRE ));
      return PAPI_ENOEVNT;
   }
 
-  cidx=_papi_native_events[event_index].cidx;
+  cidx=entry->cidx;
 
   if ((cidx<0) || (cidx >= papi_num_components)) {
 	  INTDBG("EXIT: Component index %#x is out of range, papi_num_components: %d\n", cidx, papi_num_components);
@@ -479,7 +620,7 @@ _papi_hwi_native_to_eventcode(int cidx, int event_code, int ntv_idx, const char
 
   int result;
 
-  if (_papi_hwi_my_thread->tls_papi_event_code_changed > 0) {
+  if (current_event_ctx()->event_code_changed > 0) {
 	  result = _papi_hwi_get_papi_event_code();
 	  INTDBG("EXIT: papi_event_code: %#x set by the component\n", result);
 	  return result;
@@ -502,14 +643,15 @@ _papi_hwi_eventcode_to_native(int event_code) {
 
   int result;
   int event_index;
+  struct native_event_info *entry;
 
   event_index=event_code&PAPI_NATIVE_AND_MASK;
- if ((event_index < 0)  ||  (event_index>=num_native_events)) {
+ if ((entry = native_event_entry(event_index)) == NULL) {
     INTDBG("EXIT: PAPI_ENOEVNT\n");
     return PAPI_ENOEVNT;
   }
 
-  result=_papi_native_events[event_index].component_event;
+  result=entry->component_event;
 
   INTDBG("EXIT: result: %#x\n", result);
   return result;
@@ -840,59 +982,79 @@ default_debug_handler( int errorCode )
 	return ( PAPI_EBUG );	 /* Never get here */
 }
 
-static int
-allocate_eventset_map( DynamicArray_t * map )
+static DynamicSlot_t *
+eventset_slot( const DynamicArray_t * map, int slot )
 {
-	/* Allocate and clear the Dynamic Array structure */
-	if ( map->dataSlotArray != NULL )
-		papi_free( map->dataSlotArray );
-	memset( map, 0x00, sizeof ( DynamicArray_t ) );
+	DynamicSlot_t *chunk;
 
-	/* Allocate space for the EventSetInfo_t pointers */
+	chunk = __atomic_load_n( &map->chunks[slot / PAPI_EVENTSET_CHUNK_SLOTS],
+							 __ATOMIC_ACQUIRE );
+	return ( &chunk[slot % PAPI_EVENTSET_CHUNK_SLOTS] );
+}
 
-	map->dataSlotArray =
-		( EventSetInfo_t ** ) papi_malloc( PAPI_INIT_SLOTS *
-										   sizeof ( EventSetInfo_t * ) );
-	if ( map->dataSlotArray == NULL ) {
-		return ( PAPI_ENOMEM );
-	}
-	memset( map->dataSlotArray, 0x00,
-			PAPI_INIT_SLOTS * sizeof ( EventSetInfo_t * ) );
-	map->totalSlots = PAPI_INIT_SLOTS;
-	map->availSlots = PAPI_INIT_SLOTS;
-	map->fullSlots = 0;
+/* The lowest empty slot hint is (update count << EVENTSET_HINT_BITS) |
+   slot, in 32 bits so that every target can compare and swap it without
+   libatomic.  The slot goes up to the number of slots, one bit more than
+   a slot index. */
+#define EVENTSET_HINT_BITS ( PAPI_EVENTSET_SLOT_BITS + 1 )
+#define EVENTSET_HINT_SLOT( hint ) \
+	( ( int ) ( ( hint ) & ( ( 1u << EVENTSET_HINT_BITS ) - 1 ) ) )
+#define EVENTSET_HINT( hint, slot ) \
+	( ( ( ( hint ) >> EVENTSET_HINT_BITS ) + 1 ) << EVENTSET_HINT_BITS | \
+	  ( unsigned int ) ( slot ) )
 
-	return ( PAPI_OK );
-}
+/* Publish one more chunk of slots.  Several threads may race to do this,
+   the loser frees its chunk and uses the winner's. */
 
 static int
-expand_dynamic_array( DynamicArray_t * DA )
+add_eventset_chunk( DynamicArray_t * map, int total )
 {
-	int number;
-	EventSetInfo_t **n;
+	DynamicSlot_t *chunk, *expected = NULL;
+	int c = total / PAPI_EVENTSET_CHUNK_SLOTS;
 
-	/*realloc existing PAPI_EVENTSET_MAP.dataSlotArray */
-
-	number = DA->totalSlots * 2;
-	n = ( EventSetInfo_t ** ) papi_realloc( DA->dataSlotArray,
-											( size_t ) number *
-											sizeof ( EventSetInfo_t * ) );
-	if ( n == NULL )
+	if ( c >= PAPI_EVENTSET_MAX_CHUNKS )
 		return ( PAPI_ENOMEM );
 
-	/* Need to assign this value, what if realloc moved it? */
-
-	DA->dataSlotArray = n;
+	if ( __atomic_load_n( &map->chunks[c], __ATOMIC_ACQUIRE ) == NULL ) {
+		chunk = ( DynamicSlot_t * ) papi_calloc( PAPI_EVENTSET_CHUNK_SLOTS,
+												 sizeof ( DynamicSlot_t ) );
+		if ( chunk == NULL )
+			return ( PAPI_ENOMEM );
 
-	memset( DA->dataSlotArray + DA->totalSlots, 0x00,
-			( size_t ) DA->totalSlots * sizeof ( EventSetInfo_t * ) );
+		if ( !__atomic_compare_exchange_n( &map->chunks[c], &expected, chunk,
+										   0, __ATOMIC_RELEASE,
+										   __ATOMIC_RELAXED ) )
+			papi_free( chunk );
+	}
 
-	DA->totalSlots = number;
-	DA->availSlots = number - DA->fullSlots;
+	/* Only make the slots visible once their chunk is */
+	__atomic_compare_exchange_n( &map->totalSlots, &total,
+								 total + PAPI_EVENTSET_CHUNK_SLOTS, 0,
+								 __ATOMIC_RELEASE, __ATOMIC_RELAXED );
 
 	return ( PAPI_OK );
 }
 
+static void
+free_eventset_map( DynamicArray_t * map )
+{
+	int c;
+
+	for ( c = 0; c < PAPI_EVENTSET_MAX_CHUNKS; c++ ) {
+		if ( map->chunks[c] != NULL )
+			papi_free( map->chunks[c] );
+	}
+	memset( map, 0x00, sizeof ( DynamicArray_t ) );
+}
+
+static int
+allocate_eventset_map( DynamicArray_t * map )
+{
+	free_eventset_map( map );
+
+	return ( add_eventset_chunk( map, 0 ) );
+}
+
 static int
 EventInfoArrayLength( const EventSetInfo_t * ESI )
 {
@@ -939,6 +1101,8 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
    /* If component doesn't exist... */
    if (_papi_hwi_invalid_cmp(cidx)) return PAPI_ECMP;
 
+   _papi_hwi_init_deferred_cmp( cidx );
+
    /* Assigned at create time */
    ESI->domain.domain = _papi_hwd[cidx]->cmp_info.default_domain;
    ESI->granularity.granularity =
@@ -1062,6 +1226,7 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
 void
 _papi_hwi_free_EventSet( EventSetInfo_t * ESI )
 {
+	_papi_hwi_invalidate_bound_reader( ESI );
 	_papi_hwi_cleanup_eventset( ESI );
 
 #ifdef DEBUG
@@ -1075,33 +1240,83 @@ static int
 add_EventSet( EventSetInfo_t * ESI, ThreadInfo_t * master )
 {
 	DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
-	int i, errorCode;
-
-	_papi_hwi_lock( INTERNAL_LOCK );
+	DynamicSlot_t *slot;
+	EventSetInfo_t *expected;
+	unsigned int hint;
+	int i, total, errorCode;
+
+	ESI->master = master;
+	/* Stale handles must not match until the real one is set */
+	ESI->EventSetIndex = PAPI_NULL;
+
+	for ( ;; ) {
+		total = __atomic_load_n( &map->totalSlots, __ATOMIC_ACQUIRE );
+		hint = __atomic_load_n( &map->lowestEmptySlot, __ATOMIC_ACQUIRE );
+
+		for ( i = EVENTSET_HINT_SLOT( hint ); i < total; i++ ) {
+			slot = eventset_slot( map, i );
+			if ( __atomic_load_n( &slot->ESI, __ATOMIC_ACQUIRE ) != NULL )
+				continue;
+
+			expected = NULL;
+			if ( !__atomic_compare_exchange_n( &slot->ESI, &expected, ESI, 0,
+											   __ATOMIC_ACQ_REL,
+											   __ATOMIC_RELAXED ) )
+				continue;
+
+			/* The generation cannot change while we own the slot */
+			ESI->EventSetIndex =
+				( __atomic_load_n( &slot->generation, __ATOMIC_ACQUIRE ) <<
+				  PAPI_EVENTSET_SLOT_BITS ) | i;
+			__atomic_fetch_add( &map->fullSlots, 1, __ATOMIC_RELAXED );
+
+			/* The slots we skipped were full, but only move the hint past
+			   them if it was not updated meanwhile: a release since we
+			   read it may have freed one of them. */
+			__atomic_compare_exchange_n( &map->lowestEmptySlot, &hint,
+										 EVENTSET_HINT( hint, i + 1 ), 0,
+										 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED );
+			return ( PAPI_OK );
+		}
 
-	if ( map->availSlots == 0 ) {
-		errorCode = expand_dynamic_array( map );
-		if ( errorCode < PAPI_OK ) {
-			_papi_hwi_unlock( INTERNAL_LOCK );
+		errorCode = add_eventset_chunk( map, total );
+		if ( errorCode < PAPI_OK )
 			return ( errorCode );
-		}
 	}
+}
 
-	i = 0;
-	for ( i = 0; i < map->totalSlots; i++ ) {
-		if ( map->dataSlotArray[i] == NULL ) {
-			ESI->master = master;
-			ESI->EventSetIndex = i;
-			map->fullSlots++;
-			map->availSlots--;
-			map->dataSlotArray[i] = ESI;
-			_papi_hwi_unlock( INTERNAL_LOCK );
-			return ( PAPI_OK );
-		}
-	}
+/* Give the slot of an EventSet back and free it.  The generation is
+   bumped before the slot is cleared, so a lookup that still loads the
+   old EventSet sees the new generation after it and drops it. */
 
-	_papi_hwi_unlock( INTERNAL_LOCK );
-	return ( PAPI_EBUG );
+void
+_papi_hwi_release_EventSet_slot( EventSetInfo_t * ESI )
+{
+	DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
+	DynamicSlot_t *slot;
+	unsigned int hint, lowered;
+	int i;
+
+	i = ESI->EventSetIndex & PAPI_EVENTSET_SLOT_MASK;
+	slot = eventset_slot( map, i );
+
+	__atomic_store_n( &slot->generation,
+					  ( slot->generation + 1 ) & PAPI_EVENTSET_GEN_MASK,
+					  __ATOMIC_RELEASE );
+	__atomic_store_n( &slot->ESI, NULL, __ATOMIC_RELEASE );
+
+	_papi_hwi_free_EventSet( ESI );
+	__atomic_fetch_sub( &map->fullSlots, 1, __ATOMIC_RELAXED );
+
+	/* Always count the update, even if the hint stays, so that a create
+	   that scanned past this slot cannot move the hint above it */
+	hint = __atomic_load_n( &map->lowestEmptySlot, __ATOMIC_RELAXED );
+	do {
+		lowered = EVENTSET_HINT( hint, i < EVENTSET_HINT_SLOT( hint ) ?
+								 i : EVENTSET_HINT_SLOT( hint ) );
+	} while ( !__atomic_compare_exchange_n( &map->lowestEmptySlot, &hint,
+											 lowered, 0, __ATOMIC_ACQ_REL,
+											 __ATOMIC_RELAXED ) );
 }
 
 int
@@ -1193,22 +1408,7 @@ _papi_hwi_lookup_EventCodeIndex( const EventSetInfo_t * ESI,
 int
 _papi_hwi_remove_EventSet( EventSetInfo_t * ESI )
 {
-	DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
-	int i;
-
-	i = ESI->EventSetIndex;
-
-	_papi_hwi_lock( INTERNAL_LOCK );
-
-	_papi_hwi_free_EventSet( ESI );
-
-	/* do bookkeeping for PAPI_EVENTSET_MAP */
-
-	map->dataSlotArray[i] = NULL;
-	map->availSlots++;
-	map->fullSlots--;
-
-	_papi_hwi_unlock( INTERNAL_LOCK );
+	_papi_hwi_release_EventSet_slot( ESI );
 
 	return PAPI_OK;
 }
@@ -1400,6 +1600,8 @@ update_overflow( EventSetInfo_t * ESI )
    nevnt: pointer to array of native event table indexes to add
    size:  number of native events to add
    out:   ???
+   defer: only add them to the event set, the caller updates the
+          component once for a batch of events (_papi_hwi_add_events)
 
    return:  < 0 = error
               0 = no new events added
@@ -1407,9 +1609,9 @@ update_overflow( EventSetInfo_t * ESI )
 */
 static int
 add_native_events( EventSetInfo_t *ESI, unsigned int *nevt,
-                   int size, EventInfo_t *out )
+                   int size, EventInfo_t *out, int defer )
 {
-	INTDBG ("ENTER: ESI: %p, nevt: %p, size: %d, out: %p\n", ESI, nevt, size, out);
+	INTDBG ("ENTER: ESI: %p, nevt: %p, size: %d, out: %p, defer: %d\n", ESI, nevt, size, out, defer);
    int nidx, i, j, added_events = 0;
    int retval, retval2;
    int max_counters;
@@ -1461,6 +1663,11 @@ add_native_events( EventSetInfo_t *ESI, unsigned int *nevt,
 
    INTDBG("added_events: %d\n", added_events);
 
+   if ( defer ) {
+      INTDBG( "EXIT: deferred, added_events: %d\n", added_events);
+      return added_events ? 1 : PAPI_OK;
+   }
+
    /* if we added events we need to tell the component so it */
    /* can add them too.                                      */
    if ( added_events ) {
@@ -1508,19 +1715,31 @@ clean:
 }
 
 
-int
-_papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
+/* An event added by _papi_hwi_add_events, with the native events it is
+   made of, so it can be taken out again if the batch fails */
+typedef struct _papi_batch_event {
+	int index;			/* slot in EventInfoArray */
+	unsigned int *codes;		/* native events added for it */
+	int count;
+	unsigned int native;		/* storage for a native event */
+} papi_batch_event_t;
+
+/* add an event to the event set; with a batch record the component is
+   not updated and the event is left for _papi_hwi_add_events to commit */
+static int
+add_event( EventSetInfo_t * ESI, int EventCode, papi_batch_event_t *batch )
 {
-    INTDBG("ENTER: ESI: %p (%d), EventCode: %#x\n", ESI, ESI->EventSetIndex, EventCode);
+    INTDBG("ENTER: ESI: %p (%d), EventCode: %#x, batch: %p\n", ESI, ESI->EventSetIndex, EventCode, batch);
 
     int i, j, thisindex, remap, retval = PAPI_OK;
-    int cidx;
+    int cidx, defer = ( batch != NULL );
 
 	/* Sanity check the component */
 	cidx=_papi_hwi_component_index( EventCode );
 	if (cidx<0) {
 		return PAPI_ENOCMP;
 	}
+	_papi_hwi_init_deferred_cmp( cidx );
 	if (_papi_hwd[cidx]->cmp_info.disabled &&
         _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT) {
 		return PAPI_ECMP_DISABLED;
@@ -1548,6 +1767,9 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
     }
 
     INTDBG("Adding event to slot %d of EventSet %d\n",thisindex,ESI->EventSetIndex);
+    if ( batch ) {
+       batch->index = thisindex;
+    }
 
     /* If it is a software MPX EventSet, add it to the multiplex data structure */
     /* and this thread's multiplex list                                         */
@@ -1595,7 +1817,7 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 
 	  remap = add_native_events( ESI,
 				     _preset_ptr->code,
-				     count, &ESI->EventInfoArray[thisindex] );
+				     count, &ESI->EventInfoArray[thisindex], defer );
 	  if ( remap < 0 ) {
 	     return remap;
 	  }
@@ -1608,7 +1830,12 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 	     ESI->EventInfoArray[thisindex].ops =
 				  _preset_ptr->postfix;
              ESI->NumberOfEvents++;
-	     _papi_hwi_map_events_to_native( ESI );
+	     if ( batch ) {
+	        batch->codes = _preset_ptr->code;
+	        batch->count = count;
+	     } else {
+	        _papi_hwi_map_events_to_native( ESI );
+	     }
 
 	  }
        }
@@ -1634,7 +1861,7 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 	  /* Try to add the native event. */
 
 	  remap = add_native_events( ESI, (unsigned int *)&EventCode, 1,
-				     &ESI->EventInfoArray[thisindex] );
+				     &ESI->EventInfoArray[thisindex], defer );
 
 	  if ( remap < 0 ) {
 	     return remap;
@@ -1644,7 +1871,13 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 	     ESI->EventInfoArray[thisindex].event_code = 
 	                                   ( unsigned int ) EventCode;
              ESI->NumberOfEvents++;
-	     _papi_hwi_map_events_to_native( ESI );
+	     if ( batch ) {
+	        batch->native = ( unsigned int ) EventCode;
+	        batch->codes = &batch->native;
+	        batch->count = 1;
+	     } else {
+	        _papi_hwi_map_events_to_native( ESI );
+	     }
 
 	  }
        } else if ( IS_USER_DEFINED( EventCode ) ) {
@@ -1667,7 +1900,7 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 
 		 remap = add_native_events( ESI,
 			 user_defined_events[index].code,
-			 count, &ESI->EventInfoArray[thisindex] );
+			 count, &ESI->EventInfoArray[thisindex], defer );
 
 		 if ( remap < 0 ) {
 		   return remap;
@@ -1676,7 +1909,12 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 		   ESI->EventInfoArray[thisindex].derived = user_defined_events[index].derived_int;
 		   ESI->EventInfoArray[thisindex].ops = user_defined_events[index].postfix;
            ESI->NumberOfEvents++;
-		   _papi_hwi_map_events_to_native( ESI );
+		   if ( batch ) {
+		     batch->codes = user_defined_events[index].code;
+		     batch->count = count;
+		   } else {
+		     _papi_hwi_map_events_to_native( ESI );
+		   }
 		 }
        } else {
 
@@ -1709,12 +1947,121 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
        /* in theory this wouldn't matter anyway.                            */
     }
 
+    if ( defer ) {
+       return PAPI_OK;
+    }
+
     /* reinstate the overflows if any */
     retval=update_overflow( ESI );
 
     return retval;
 }
 
+int
+_papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
+{
+    return add_event( ESI, EventCode, NULL );
+}
+
+/* take the events of a failed batch out of the event set again,
+   last first so the native events they added come off the end */
+static void
+add_events_undo( EventSetInfo_t *ESI, papi_batch_event_t *batch, int num )
+{
+    int i, j;
+
+    for( i = num - 1; i >= 0; i-- ) {
+       for( j = batch[i].count - 1; j >= 0; j-- ) {
+          add_native_fail_clean( ESI, ( int ) batch[i].codes[j] );
+       }
+       ESI->EventInfoArray[batch[i].index].event_code = ( unsigned int ) PAPI_NULL;
+       for( j = 0; j < PAPI_EVENTS_IN_DERIVED_EVENT; j++ ) {
+          ESI->EventInfoArray[batch[i].index].pos[j] = PAPI_NULL;
+       }
+       ESI->EventInfoArray[batch[i].index].ops = NULL;
+       ESI->EventInfoArray[batch[i].index].derived = NOT_DERIVED;
+       ESI->NumberOfEvents--;
+    }
+}
+
+/** @internal
+ *  @class _papi_hwi_add_events
+ *  @brief Add a batch of events, updating the component once.
+ *
+ *  The events are added to the event set first and the component is
+ *  asked to allocate and program the whole set a single time, instead
+ *  of once per event.  Either all of the events are added or none: on
+ *  any error the event set is put back as it was and the error
+ *  returned, so the caller can add them one by one to find out which
+ *  one failed.  Software multiplexed and overflowing or profiling
+ *  event sets are not handled here (PAPI_ENOSUPP).
+ */
+int
+_papi_hwi_add_events( EventSetInfo_t *ESI, int *Events, int number )
+{
+    INTDBG("ENTER: ESI: %p (%d), Events: %p, number: %d\n", ESI, ESI->EventSetIndex, Events, number);
+
+    papi_batch_event_t *batch;
+    hwd_context_t *context;
+    int i, count, retval = PAPI_OK;
+
+    if ( _papi_hwi_is_sw_multiplex( ESI ) ||
+         ( ESI->state & ( PAPI_OVERFLOWING | PAPI_PROFILING ) ) ) {
+       return PAPI_ENOSUPP;
+    }
+
+    batch = papi_calloc( ( size_t ) number, sizeof ( papi_batch_event_t ) );
+    if ( batch == NULL ) {
+       return PAPI_ENOMEM;
+    }
+
+    count = ESI->NativeCount;
+    for( i = 0; i < number; i++ ) {
+       retval = add_event( ESI, Events[i], &batch[i] );
+       if ( retval != PAPI_OK ) {
+          INTDBG("event %d of the batch, %#x, failed: %d\n", i, Events[i], retval);
+          add_events_undo( ESI, batch, i );
+          papi_free( batch );
+          return retval;
+       }
+    }
+
+    /* all of the events are in, now tell the component, once */
+    if ( ESI->NativeCount != count ) {
+       context = _papi_hwi_get_context( ESI, NULL );
+
+       retval = _papi_hwd[ESI->CmpIdx]->allocate_registers( ESI );
+       if ( retval == PAPI_OK ) {
+          retval = _papi_hwd[ESI->CmpIdx]->update_control_state( ESI->ctl_state,
+                      ESI->NativeInfoArray, ESI->NativeCount, context );
+       } else {
+          retval = PAPI_EMISC;
+       }
+
+       if ( retval != PAPI_OK ) {
+          INTDBG("update_control_state of the batch returned: %d\n", retval);
+          add_events_undo( ESI, batch, number );
+          papi_free( batch );
+
+          /* re-establish the control state after the error */
+          if ( _papi_hwd[ESI->CmpIdx]->update_control_state( ESI->ctl_state,
+                  ESI->NativeInfoArray, ESI->NativeCount, context ) != PAPI_OK ) {
+             PAPIERROR("update_control_state failed to re-establish working events!" );
+          }
+          return retval;
+       }
+    }
+    papi_free( batch );
+
+    _papi_hwi_map_events_to_native( ESI );
+
+    /* reinstate the overflows if any */
+    retval = update_overflow( ESI );
+
+    INTDBG("EXIT: %d\n", retval);
+    return retval;
+}
+
 static int
 remove_native_events( EventSetInfo_t *ESI, int *nevt, int size )
 {
@@ -1936,6 +2283,18 @@ _papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
 	return PAPI_OK;
 }
 
+/* Detach the PAPI_bind_reader handle of an EventSet, if any.  The handle
+   itself stays allocated until PAPI_unbind_reader, but any further
+   PAPI_read_bound on it fails instead of touching a stale EventSet. */
+void
+_papi_hwi_invalidate_bound_reader( EventSetInfo_t * ESI )
+{
+	if ( ESI->bound_reader != NULL ) {
+		ESI->bound_reader->ESI = NULL;
+		ESI->bound_reader = NULL;
+	}
+}
+
 int
 _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI )
 {
@@ -2027,6 +2386,9 @@ _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI )
    if ( ESI->profile.prof )
       papi_free( ESI->profile.prof );
 
+   if ( ESI->cpu.cpus )
+      papi_free( ESI->cpu.cpus );
+
    ESI->ctl_state = NULL;
    ESI->sw_stop = NULL;
    ESI->hw_start = NULL;
@@ -2109,17 +2471,226 @@ _papi_hwi_convert_eventset_to_multiplex( _papi_int_multiplex_t * mpx )
 
 int papi_num_components = ( sizeof ( _papi_hwd ) / sizeof ( *_papi_hwd ) ) - 1;
 
+/*
+ * Components other than perf_event and perf_event_uncore are only
+ * registered by PAPI_library_init.  Their init_component runs on first
+ * use: a name lookup or enumeration of their events, an EventSet
+ * assignment, PAPI_get_component_info or PAPI_get_cmp_opt.  Until then
+ * they report PAPI_EDELAY_INIT and get no init_thread calls.  Setting
+ * PAPI_EAGER_COMPONENT_INIT initializes all of them at library init.
+ */
+static int deferred_cmp[PAPI_NUM_COMP];
+
+/* How long each init_component took, see PAPI_COMPONENT_INIT_USEC */
+static long long cmp_init_usec[PAPI_NUM_COMP];
+
+/* Weak, so that libpthread is only needed to initialize in parallel */
+#pragma weak pthread_create
+#pragma weak pthread_join
+
+#define PAPI_MAX_INIT_THREADS 16
+
+/* Set while components are initialized by several threads, so that
+   the locks they take are real ones before PAPI_thread_init */
+int _papi_hwi_init_in_parallel = 0;
+
+static int
+time_init_component( int cidx )
+{
+	long long t0;
+	int retval;
+
+	t0 = _papi_os_vector.get_real_usec(  );
+	retval = _papi_hwd[cidx]->init_component( cidx );
+	cmp_init_usec[cidx] = _papi_os_vector.get_real_usec(  ) - t0;
+
+	INTDBG( "Component %s initialized in %lld usec, retval %d\n",
+		_papi_hwd[cidx]->cmp_info.name, cmp_init_usec[cidx], retval );
+
+	return retval;
+}
+
+static void
+check_init_component( int cidx, int retval )
+{
+	/* Do some sanity checking */
+	if (retval==PAPI_OK) {
+		if (_papi_hwd[cidx]->cmp_info.num_cntrs >
+		    _papi_hwd[cidx]->cmp_info.num_mpx_cntrs) {
+			fprintf(stderr,"Warning!  num_cntrs %d is more than num_mpx_cntrs %d for component %s\n",
+				_papi_hwd[cidx]->cmp_info.num_cntrs,
+				_papi_hwd[cidx]->cmp_info.num_mpx_cntrs,
+				_papi_hwd[cidx]->cmp_info.name);
+		}
+	}
+}
+
+static void
+init_component( int cidx )
+{
+	check_init_component( cidx, time_init_component( cidx ) );
+}
+
+/* Components handed out to the threads of init_components_parallel */
+typedef struct {
+	int cmps[PAPI_NUM_COMP];
+	int retval[PAPI_NUM_COMP];
+	int num;
+	int next;
+} init_pool_t;
+
+static void *
+init_pool_worker( void *arg )
+{
+	init_pool_t *pool = ( init_pool_t * ) arg;
+	int i;
+
+	while ( ( i = __atomic_fetch_add( &pool->next, 1, __ATOMIC_RELAXED ) ) <
+		pool->num ) {
+		pool->retval[i] = time_init_component( pool->cmps[i] );
+	}
+
+	return NULL;
+}
+
+/*
+ * Run init_component of the given components on up to nthreads
+ * threads, the calling one included.  The components in the pool set
+ * cmp_info.parallel_init: they write only their own vector and static
+ * data, and what they share is papi_malloc and the PAPI locks, which
+ * are real locks while _papi_hwi_init_in_parallel is set.  The results
+ * are checked in component order once all threads are done, so the
+ * outcome does not depend on the schedule.
+ */
+static void
+init_components_parallel( init_pool_t *pool, int nthreads )
+{
+	pthread_t tids[PAPI_MAX_INIT_THREADS];
+	int i, started = 0;
+
+	if ( nthreads > PAPI_MAX_INIT_THREADS )
+		nthreads = PAPI_MAX_INIT_THREADS;
+	if ( nthreads > pool->num )
+		nthreads = pool->num;
+
+	pool->next = 0;
+	_papi_hwi_init_in_parallel = 1;
+
+	if ( pthread_create ) {
+		while ( started < nthreads - 1 &&
+			pthread_create( &tids[started], NULL, init_pool_worker, pool ) == 0 ) {
+			started++;
+		}
+	}
+	INTDBG( "Initializing %d components on %d threads\n", pool->num,
+		started + 1 );
+
+	init_pool_worker( pool );
+
+	for ( i = 0; i < started; i++ ) {
+		pthread_join( tids[i], NULL );
+	}
+
+	_papi_hwi_init_in_parallel = 0;
+
+	for ( i = 0; i < pool->num; i++ ) {
+		check_init_component( pool->cmps[i], pool->retval[i] );
+	}
+}
+
+/* Time the component took in init_component, 0 if it was not called */
+long long
+_papi_hwi_cmp_init_usec( int cidx )
+{
+	return cmp_init_usec[cidx];
+}
+
+/* Is the component still waiting for its init_component? */
+int
+_papi_hwi_cmp_deferred( int cidx )
+{
+	return __atomic_load_n( &deferred_cmp[cidx], __ATOMIC_ACQUIRE );
+}
+
+/*
+ * Finish the initialization of a deferred component: init_component,
+ * then init_thread on the contexts of every thread and cpu that already
+ * exists.  The locks are taken in the order new cpus and threads take
+ * them, so none can be created in between without its context.
+ * init_thread of the other threads runs on the calling thread, so a
+ * deferred component must not tie its context to the thread that
+ * initializes it; per-thread files are opened by the reading thread.
+ */
+int
+_papi_hwi_init_deferred_cmp( int cidx )
+{
+	int retval = PAPI_OK;
+
+	if ( !_papi_hwi_cmp_deferred( cidx ) ) {
+		return PAPI_OK;
+	}
+
+	_papi_hwi_lock( CPUS_LOCK );
+	_papi_hwi_lock( CMP_INIT_LOCK );
+
+	if ( deferred_cmp[cidx] ) {
+		INTDBG( "Deferred init of component %s\n", _papi_hwd[cidx]->cmp_info.name );
+		_papi_hwd[cidx]->cmp_info.disabled = PAPI_OK;
+		_papi_hwd[cidx]->cmp_info.disabled_reason[0] = '\0';
+
+		init_component( cidx );
+
+		if (!_papi_hwd[cidx]->cmp_info.disabled ||
+		    _papi_hwd[cidx]->cmp_info.disabled == PAPI_EDELAY_INIT) {
+			retval = _papi_hwi_init_cmp_threads( cidx );
+			if ( retval == PAPI_OK ) {
+				retval = _papi_hwi_init_cmp_cpus( cidx );
+			}
+		}
+
+		__atomic_store_n( &deferred_cmp[cidx], 0, __ATOMIC_RELEASE );
+
+		if ( _papi_hwd[cidx]->cmp_info.disabled &&
+		     _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT )
+			_papi_hwi_name_cache_invalidate( cidx );
+	}
+
+	_papi_hwi_unlock( CMP_INIT_LOCK );
+	_papi_hwi_unlock( CPUS_LOCK );
+
+	return retval;
+}
+
 /*
  * Routine that initializes all available components.
  * A component is available if a pointer to its info vector
  * appears in the NULL terminated_papi_hwd table.
  * Modified to accept an arg: 0=do not init perf_event or 
  * perf_event_uncore. 1=init ONLY perf_event or perf_event_uncore.
+ * With arg 0 the other components are only deferred, see
+ * _papi_hwi_init_deferred_cmp.  With PAPI_COMPONENT_INIT_THREADS set to
+ * more than 1 they are all initialized instead: those that set
+ * cmp_info.parallel_init on that many threads, the others first on the
+ * calling thread.
+ * With PAPI_NODE_SAMPLE_MS set, components with cmp_info.node_sampled
+ * are not deferred, so that the first process to start attaches the
+ * node segment and publishes for the node, rather than whichever
+ * process reads first.
  */
 int
 _papi_hwi_init_global( int PE_OR_PEU )
 {
         int retval, is_pe_peu, i = 0;
+        int eager = ( getenv( "PAPI_EAGER_COMPONENT_INIT" ) != NULL );
+        int node_sampling = ( getenv( "PAPI_NODE_SAMPLE_MS" ) != NULL );
+        int nthreads = 0;
+        char *env;
+        init_pool_t pool;
+
+	env = getenv( "PAPI_COMPONENT_INIT_THREADS" );
+	if ( env != NULL )
+	   nthreads = atoi( env );
+	pool.num = 0;
 
 	retval = _papi_hwi_innoculate_os_vector( &_papi_os_vector );
 	if ( retval != PAPI_OK ) {
@@ -2135,25 +2706,38 @@ _papi_hwi_init_global( int PE_OR_PEU )
 	      return retval;
 	   }
 
+	   /* Still deferred when PAPI was shut down */
+	   if ( deferred_cmp[i] && (PE_OR_PEU == is_pe_peu) ) {
+	      deferred_cmp[i] = 0;
+	      _papi_hwd[i]->cmp_info.disabled = PAPI_OK;
+	      _papi_hwd[i]->cmp_info.disabled_reason[0] = '\0';
+	   }
+
+	   if ( PE_OR_PEU == is_pe_peu )
+	      cmp_init_usec[i] = 0;
+
 	   /* We can be disabled by user before init */
 	   if (!_papi_hwd[i]->cmp_info.disabled && (PE_OR_PEU == is_pe_peu)) {
-	      retval = _papi_hwd[i]->init_component( i );
-
-	      /* Do some sanity checking */
-	      if (retval==PAPI_OK) {
-		if (_papi_hwd[i]->cmp_info.num_cntrs >
-		    _papi_hwd[i]->cmp_info.num_mpx_cntrs) {
-		  fprintf(stderr,"Warning!  num_cntrs %d is more than num_mpx_cntrs %d for component %s\n",
-                        _papi_hwd[i]->cmp_info.num_cntrs,
-                        _papi_hwd[i]->cmp_info.num_mpx_cntrs,
-                        _papi_hwd[i]->cmp_info.name);
-		}
-
+	      if ( !is_pe_peu && nthreads > 1 &&
+	           _papi_hwd[i]->cmp_info.parallel_init ) {
+	         pool.cmps[pool.num++] = i;
+	      } else if ( is_pe_peu || eager || nthreads > 1 ||
+	                  ( node_sampling && _papi_hwd[i]->cmp_info.node_sampled ) ) {
+	         init_component( i );
+	      } else {
+	         _papi_hwd[i]->cmp_info.disabled = PAPI_EDELAY_INIT;
+	         strcpy( _papi_hwd[i]->cmp_info.disabled_reason,
+	                 "Not initialized. Access component events to initialize it." );
+	         deferred_cmp[i] = 1;
 	      }
 	   }
 
 	   i++;
 	}
+
+	if ( pool.num > 0 )
+	   init_components_parallel( &pool, nthreads );
+
 	return PAPI_OK;
 }
 
@@ -2231,25 +2815,29 @@ _papi_hwi_shutdown_global_internal( void )
 
 	_papi_hwi_cleanup_errors( );
 
+	_papi_hwi_name_cache_invalidate( -1 );
+
 	_papi_hwi_lock( INTERNAL_LOCK );
 
     for( i = 0; i < num_native_events; i++){
-        free(_papi_native_events[i].evt_name);
+        free(NATIVE_EVENT(i)->evt_name);
     }
 
-    free(_papi_native_events);
-    _papi_native_events = NULL;        // In case a new library init is done.
-    num_native_events=0;               // .. 
+    for( i = 0; i < num_native_chunks; i++){
+        free(_papi_native_events[i]);
+        _papi_native_events[i] = NULL; // In case a new library init is done.
+    }
+    __atomic_store_n(&num_native_events, 0, __ATOMIC_RELEASE);
     num_native_chunks=0;               // .. 
 
     _papi_hwi_free_papi_event_string();
 
-	papi_free(  _papi_hwi_system_info.global_eventset_map.dataSlotArray );
-	memset(  &_papi_hwi_system_info.global_eventset_map,
-		 0x00, sizeof ( DynamicArray_t ) );
+	free_eventset_map( &_papi_hwi_system_info.global_eventset_map );
 
 	_papi_hwi_unlock( INTERNAL_LOCK );
 
+	_papi_node_shutdown(  );
+
 	if ( _papi_hwi_system_info.shlib_info.map ) {
 		papi_free( _papi_hwi_system_info.shlib_info.map );
 	}
@@ -2678,6 +3266,7 @@ _papi_hwi_query_native_event( unsigned int EventCode )
                                       /* but should always be big enough */
    int cidx;
    int nevt_code;
+   papi_event_ctx_t ctx;
 
    cidx = _papi_hwi_component_index( EventCode );
    if (cidx<0) {
@@ -2685,15 +3274,19 @@ _papi_hwi_query_native_event( unsigned int EventCode )
 	   return PAPI_ENOCMP;
    }
 
-   // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
-   _papi_hwi_set_papi_event_code(EventCode, 0);
-
 	if ((nevt_code = _papi_hwi_eventcode_to_native(EventCode)) < 0) {
 		INTDBG("EXIT: nevt_code: %d\n", nevt_code);
 		return nevt_code;
 	}
+
+   // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
+   _papi_hwi_event_ctx_begin(&ctx);
+   _papi_hwi_set_papi_event_code(EventCode, 0);
+
    int ret = _papi_hwd[cidx]->ntv_code_to_name( (unsigned int)nevt_code, name, sizeof(name));
 
+   _papi_hwi_event_ctx_end(&ctx);
+
    INTDBG("EXIT: ret: %d\n", ret);
    return (ret);
 }
@@ -2721,8 +3314,8 @@ void _papi_hwi_obtain_prefix(const char *full_event_name, char *prefix)
 /* Converts an ASCII name into a native event code usable by other routines
    Returns code = 0 and PAPI_OK if name not found.
    This allows for sparse native event arrays */
-int
-_papi_hwi_native_name_to_code( const char *in, int *out )
+static int
+native_name_to_code( const char *in, int *out )
 {
 	INTDBG("ENTER: in: %s, out: %p\n", in, out);
 	if (in == NULL) {
@@ -2802,6 +3395,8 @@ _papi_hwi_native_name_to_code( const char *in, int *out )
 		event_name_to_code_input = full_event_name;
 	}
 
+	_papi_hwi_init_deferred_cmp( cidx );
+
 	if (_papi_hwd[cidx]->cmp_info.disabled &&
 	    _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT) {
 		INTDBG("Component %s at index %d is currently disabled.\n", _papi_hwd[cidx]->cmp_info.name, cidx);
@@ -2870,6 +3465,163 @@ _papi_hwi_native_name_to_code( const char *in, int *out )
 	return retval;
 }
 
+int
+_papi_hwi_native_name_to_code( const char *in, int *out )
+{
+	papi_event_ctx_t ctx;
+	int retval;
+
+	_papi_hwi_event_ctx_begin( &ctx );
+	retval = native_name_to_code( in, out );
+	_papi_hwi_event_ctx_end( &ctx );
+
+	return retval;
+}
+
+/*
+ * Cache of PAPI_event_name_to_code results, keyed by the name as given.
+ * Only user defined and native events are kept: a preset name also sets
+ * the qualifiers of the preset, so it is resolved every time.  The codes
+ * index the native event table, so the cache is emptied with it at
+ * shutdown; entries of a component that gets disabled are dropped.  It
+ * is also emptied whenever presets or user defined events are loaded,
+ * since a new user event may hide a native name resolved before.
+ */
+typedef struct name_cache_entry {
+	struct name_cache_entry *next;
+	int code;
+	int cidx;                       /* -1 for a user defined event */
+	char name[];
+} name_cache_entry_t;
+
+static name_cache_entry_t **name_cache = NULL;
+static unsigned int name_cache_size = 0;   /* buckets, a power of two */
+static unsigned int name_cache_count = 0;
+
+static int
+name_cache_disabled( int cidx )
+{
+	return cidx >= 0 && _papi_hwd[cidx]->cmp_info.disabled &&
+		_papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT;
+}
+
+/* Code of a name that was resolved before, PAPI_ENOEVNT if there is none */
+int
+_papi_hwi_name_cache_lookup( const char *name, int *code )
+{
+	name_cache_entry_t *e, **prev;
+	int retval = PAPI_ENOEVNT;
+
+	_papi_hwi_lock( INTERNAL_LOCK );
+	if ( name_cache_size ) {
+		prev = &name_cache[_papi_hwi_string_hash( name ) & ( name_cache_size - 1 )];
+		for ( e = *prev; e != NULL; prev = &e->next, e = e->next ) {
+			if ( strcmp( e->name, name ) )
+				continue;
+			if ( name_cache_disabled( e->cidx ) ) {
+				*prev = e->next;
+				free( e );
+				name_cache_count--;
+			} else {
+				*code = e->code;
+				retval = PAPI_OK;
+			}
+			break;
+		}
+	}
+	_papi_hwi_unlock( INTERNAL_LOCK );
+
+	return retval;
+}
+
+/* Remember the code of a name; a failure only means it is not cached */
+void
+_papi_hwi_name_cache_insert( const char *name, int code, int cidx )
+{
+	name_cache_entry_t *e, *next, **buckets;
+	unsigned int i, h, h2, size;
+	size_t len = strlen( name ) + 1;
+
+	e = malloc( sizeof ( *e ) + len );
+	if ( e == NULL )
+		return;
+	e->code = code;
+	e->cidx = cidx;
+	memcpy( e->name, name, len );
+	h = _papi_hwi_string_hash( name );
+
+	_papi_hwi_lock( INTERNAL_LOCK );
+
+	/* keep about one entry per bucket */
+	if ( name_cache_count >= name_cache_size ) {
+		size = name_cache_size ? 2 * name_cache_size : 256;
+		buckets = calloc( size, sizeof ( *buckets ) );
+		if ( buckets != NULL ) {
+			for ( i = 0; i < name_cache_size; i++ ) {
+				while ( ( next = name_cache[i] ) != NULL ) {
+					name_cache[i] = next->next;
+					h2 = _papi_hwi_string_hash( next->name ) & ( size - 1 );
+					next->next = buckets[h2];
+					buckets[h2] = next;
+				}
+			}
+			free( name_cache );
+			name_cache = buckets;
+			name_cache_size = size;
+		}
+	}
+	if ( name_cache_size == 0 ) {
+		_papi_hwi_unlock( INTERNAL_LOCK );
+		free( e );
+		return;
+	}
+
+	/* another thread may have resolved the same name meanwhile */
+	for ( next = name_cache[h & ( name_cache_size - 1 )]; next != NULL;
+	      next = next->next ) {
+		if ( strcmp( next->name, name ) == 0 ) {
+			next->code = code;
+			next->cidx = cidx;
+			_papi_hwi_unlock( INTERNAL_LOCK );
+			free( e );
+			return;
+		}
+	}
+	e->next = name_cache[h & ( name_cache_size - 1 )];
+	name_cache[h & ( name_cache_size - 1 )] = e;
+	name_cache_count++;
+
+	_papi_hwi_unlock( INTERNAL_LOCK );
+}
+
+/* Drop the names of component cidx, or every name if cidx is -1 */
+void
+_papi_hwi_name_cache_invalidate( int cidx )
+{
+	name_cache_entry_t *e, **prev;
+	unsigned int i;
+
+	_papi_hwi_lock( INTERNAL_LOCK );
+	for ( i = 0; i < name_cache_size; i++ ) {
+		prev = &name_cache[i];
+		while ( ( e = *prev ) != NULL ) {
+			if ( cidx == -1 || e->cidx == cidx ) {
+				*prev = e->next;
+				free( e );
+				name_cache_count--;
+			} else {
+				prev = &e->next;
+			}
+		}
+	}
+	if ( cidx == -1 ) {
+		free( name_cache );
+		name_cache = NULL;
+		name_cache_size = 0;
+	}
+	_papi_hwi_unlock( INTERNAL_LOCK );
+}
+
 /* Returns event name based on native event code.
    Returns NULL if name not found */
 int
@@ -2880,21 +3632,26 @@ _papi_hwi_native_code_to_name( unsigned int EventCode,
   int cidx;
   int retval;
   int nevt_code;
+  papi_event_ctx_t ctx;
 
   cidx = _papi_hwi_component_index( EventCode );
   if (cidx<0) return PAPI_ENOEVNT;
 
   if ( EventCode & PAPI_NATIVE_MASK ) {
-	  // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
-	  _papi_hwi_set_papi_event_code(EventCode, 0);
-
 	if ((nevt_code = _papi_hwi_eventcode_to_native(EventCode)) < 0) {
 		INTDBG("EXIT: nevt_code: %d\n", nevt_code);
 		return nevt_code;
 	}
-	if ( (retval = _papi_hwd[cidx]->ntv_code_to_name(
+
+	// save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
+	_papi_hwi_event_ctx_begin(&ctx);
+	_papi_hwi_set_papi_event_code(EventCode, 0);
+	retval = _papi_hwd[cidx]->ntv_code_to_name(
 						(unsigned int)nevt_code,
-						hwi_name, len) ) == PAPI_OK ) {
+						hwi_name, len);
+	_papi_hwi_event_ctx_end(&ctx);
+
+	if ( retval == PAPI_OK ) {
 			retval = _papi_hwi_prefix_component_name( _papi_hwd[cidx]->cmp_info.short_name, 
 											 hwi_name, hwi_name, len);
 			INTDBG("EXIT: retval: %d\n", retval);
@@ -2909,10 +3666,42 @@ _papi_hwi_native_code_to_name( unsigned int EventCode,
 
 
 
-/* The native event equivalent of PAPI_get_event_info */
+/* The native event part of PAPI_enum_cmp_event: the next event of */
+/* component cidx after *EventCode, or the first one               */
 int
-_papi_hwi_get_native_event_info( unsigned int EventCode,
-				 PAPI_event_info_t *info )
+_papi_hwi_enum_native_event( int cidx, int *EventCode, int modifier )
+{
+	int event_code;
+	int retval;
+	papi_event_ctx_t ctx;
+
+	// save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
+	_papi_hwi_event_ctx_begin(&ctx);
+	_papi_hwi_set_papi_event_code(*EventCode, 0);
+
+	/* Should we check against num native events here? */
+	event_code=_papi_hwi_eventcode_to_native(*EventCode);
+	retval = _papi_hwd[cidx]->ntv_enum_events((unsigned int *)&event_code, modifier );
+
+	if (retval==PAPI_OK) {
+		*EventCode = _papi_hwi_native_to_eventcode(cidx, event_code, -1,
+							   ctx.event_string);
+	}
+	_papi_hwi_event_ctx_end(&ctx);
+
+	if (retval!=PAPI_OK) {
+		INTDBG("EXIT: PAPI_EINVAL retval=%d\n",retval);
+		return PAPI_EINVAL;
+	}
+
+	return PAPI_OK;
+}
+
+/* Fill in info for a native event.  Only the first clear bytes of */
+/* info are cleared first, the catalog reads no more than those.   */
+static int
+fill_native_event_info( unsigned int EventCode, PAPI_event_info_t *info,
+			size_t clear )
 {
 	  INTDBG("ENTER: EventCode: %#x, info: %p\n", EventCode, info);
     int retval;
@@ -2922,6 +3711,8 @@ _papi_hwi_get_native_event_info( unsigned int EventCode,
     cidx = _papi_hwi_component_index( EventCode );
     if (cidx<0) return PAPI_ENOCMP;
 
+    _papi_hwi_init_deferred_cmp( cidx );
+
     if (_papi_hwd[cidx]->cmp_info.disabled &&
         _papi_hwd[cidx]->cmp_info.disabled != PAPI_EDELAY_INIT)
         return PAPI_ENOCMP;
@@ -2931,7 +3722,8 @@ _papi_hwi_get_native_event_info( unsigned int EventCode,
         _papi_hwi_set_papi_event_code(EventCode, 0);
 
        /* clear the event info */
-       memset( info, 0, sizeof ( PAPI_event_info_t ) );
+       memset( info, 0, clear );
+       info->num_quals = 0;
        info->event_code = ( unsigned int ) EventCode;
        info->component_index = (unsigned int) cidx;
        retval = _papi_hwd[cidx]->ntv_code_to_info(
@@ -2986,25 +3778,278 @@ _papi_hwi_get_native_event_info( unsigned int EventCode,
     return PAPI_ENOEVNT;
 }
 
+static int
+get_native_event_info( unsigned int EventCode, PAPI_event_info_t *info,
+		       size_t clear )
+{
+	papi_event_ctx_t ctx;
+	int retval;
+
+	_papi_hwi_event_ctx_begin( &ctx );
+	retval = fill_native_event_info( EventCode, info, clear );
+	_papi_hwi_event_ctx_end( &ctx );
+
+	return retval;
+}
+
+/* The native event equivalent of PAPI_get_event_info */
+int
+_papi_hwi_get_native_event_info( unsigned int EventCode,
+				 PAPI_event_info_t *info )
+{
+	return get_native_event_info( EventCode, info, sizeof ( PAPI_event_info_t ) );
+}
+
+/* An event of a catalog being built, strings are pool offsets */
+typedef struct catalog_rec {
+	unsigned int event_code;
+	int component_index;
+	unsigned int symbol;
+	unsigned int short_descr;
+	unsigned int long_descr;
+	unsigned int units;
+	int num_quals;
+	unsigned int first_qual;        /* in pairs of name and description */
+} catalog_rec_t;
+
+typedef struct catalog_build {
+	papi_cache_buf_t strings;       /* each kept once */
+	papi_cache_buf_t recs;
+	papi_cache_buf_t quals;
+	int num_events;
+	int num_quals;
+	unsigned int component;         /* its name */
+	PAPI_event_info_t *info;
+} catalog_build_t;
+
+static void
+catalog_qual( catalog_build_t *b, const char *name, const char *descr )
+{
+	unsigned int q[2];
+
+	q[0] = _papi_cache_buf_str( &b->strings, name );
+	q[1] = _papi_cache_buf_str( &b->strings, descr );
+	_papi_cache_buf_add( &b->quals, q, sizeof ( q ) );
+	b->num_quals++;
+}
+
+/* Add the event in b->info, with its unit masks if cidx is not -1 */
+static void
+catalog_event( catalog_build_t *b, int cidx )
+{
+	PAPI_event_info_t *info = b->info;
+	catalog_rec_t rec;
+	const char *str;
+	size_t len;
+	int k, code;
+
+	/* components copy with strncpy, terminate where we read */
+	info->symbol[sizeof ( info->symbol ) - 1] = '\0';
+	info->short_descr[sizeof ( info->short_descr ) - 1] = '\0';
+	info->long_descr[sizeof ( info->long_descr ) - 1] = '\0';
+	info->units[sizeof ( info->units ) - 1] = '\0';
+
+	memset( &rec, 0, sizeof ( rec ) );
+	rec.event_code = info->event_code;
+	rec.component_index = info->component_index;
+	rec.symbol = _papi_cache_buf_str( &b->strings, info->symbol );
+	rec.short_descr = _papi_cache_buf_str( &b->strings, info->short_descr );
+	rec.long_descr = _papi_cache_buf_str( &b->strings, info->long_descr );
+	rec.units = _papi_cache_buf_str( &b->strings, info->units );
+	rec.first_qual = ( unsigned int ) b->num_quals;
+
+	if ( info->num_quals > PAPI_MAX_COMP_QUALS )
+		info->num_quals = PAPI_MAX_COMP_QUALS;
+	for ( k = 0; k < info->num_quals; k++ ) {
+		info->quals[k][sizeof ( info->quals[k] ) - 1] = '\0';
+		info->quals_descrs[k][sizeof ( info->quals_descrs[k] ) - 1] = '\0';
+		catalog_qual( b, info->quals[k], info->quals_descrs[k] );
+	}
+
+	/* unit masks, as ":umask" and the part of the description for it */
+	code = ( int ) info->event_code;
+	while ( cidx >= 0 && !b->strings.failed &&
+		_papi_hwi_enum_native_event( cidx, &code, PAPI_NTV_ENUM_UMASKS ) == PAPI_OK ) {
+		if ( get_native_event_info( ( unsigned int ) code, info,
+					    offsetof( PAPI_event_info_t, count ) ) != PAPI_OK )
+			continue;
+		info->symbol[sizeof ( info->symbol ) - 1] = '\0';
+		info->long_descr[sizeof ( info->long_descr ) - 1] = '\0';
+
+		str = b->strings.data + rec.symbol;
+		len = strlen( str );
+		if ( strncmp( info->symbol, str, len ) == 0 && info->symbol[len] != '\0' )
+			str = info->symbol + len;
+		else
+			str = info->symbol;
+
+		catalog_qual( b, str, strstr( info->long_descr, "masks:" ) ?
+			      strstr( info->long_descr, "masks:" ) + 6 : info->long_descr );
+	}
+
+	rec.num_quals = b->num_quals - ( int ) rec.first_qual;
+	_papi_cache_buf_add( &b->recs, &rec, sizeof ( rec ) );
+	b->num_events++;
+}
+
+/* Lay out the catalog in one allocation: the catalog, the entries, */
+/* the qualifier pointers and the strings.                          */
+static PAPI_event_catalog_t *
+catalog_finish( catalog_build_t *b, int cidx )
+{
+	PAPI_event_catalog_t *catalog;
+	PAPI_catalog_entry_t *entry;
+	const catalog_rec_t *rec;
+	const unsigned int *q;
+	const char **quals;
+	char *strings;
+	size_t size;
+	int i, k;
+
+	size = sizeof ( PAPI_event_catalog_t ) +
+		( size_t ) b->num_events * sizeof ( PAPI_catalog_entry_t ) +
+		2 * ( size_t ) b->num_quals * sizeof ( char * ) + b->strings.len;
+
+	/* the caller owns it, it may outlive PAPI_shutdown */
+	catalog = malloc( size );
+	if ( catalog == NULL )
+		return NULL;
+
+	entry = ( PAPI_catalog_entry_t * ) ( catalog + 1 );
+	quals = ( const char ** ) ( entry + b->num_events );
+	strings = ( char * ) ( quals + 2 * b->num_quals );
+	memcpy( strings, b->strings.data, b->strings.len );
+
+	catalog->component_index = cidx;
+	catalog->component = strings + b->component;
+	catalog->num_events = b->num_events;
+	catalog->num_quals = b->num_quals;
+	catalog->size = size;
+	catalog->events = entry;
+
+	rec = ( const catalog_rec_t * ) b->recs.data;
+	q = ( const unsigned int * ) b->quals.data;
+	for ( i = 0; i < b->num_events; i++, rec++, entry++ ) {
+		entry->event_code = rec->event_code;
+		entry->component_index = rec->component_index;
+		entry->symbol = strings + rec->symbol;
+		entry->short_descr = strings + rec->short_descr;
+		entry->long_descr = strings + rec->long_descr;
+		entry->units = strings + rec->units;
+		entry->num_quals = rec->num_quals;
+		entry->quals = quals + 2 * rec->first_qual;
+		entry->quals_descrs = entry->quals + rec->num_quals;
+		for ( k = 0; k < rec->num_quals; k++ ) {
+			entry->quals[k] = strings + q[2 * ( rec->first_qual + k )];
+			entry->quals_descrs[k] = strings + q[2 * ( rec->first_qual + k ) + 1];
+		}
+	}
+
+	return catalog;
+}
+
+/* Build the catalog of PAPI_get_event_catalog.  The events are found */
+/* as with PAPI_enum_cmp_event and PAPI_get_event_info, but in one    */
+/* pass, with one event info buffer, of which only the fields used    */
+/* are cleared for each event.                                        */
+int
+_papi_hwi_get_event_catalog( int cidx, int flags, PAPI_event_catalog_t **out )
+{
+	catalog_build_t b;
+	hwi_presets_t *list;
+	unsigned int junk;
+	int i, code, retval;
+
+	memset( &b, 0, sizeof ( b ) );
+	b.info = papi_malloc( sizeof ( PAPI_event_info_t ) );
+	if ( b.info == NULL )
+		return PAPI_ENOMEM;
+
+	if ( flags & PAPI_CATALOG_PRESETS ) {
+		if ( _papi_hwd[cidx]->cmp_info.disabled == PAPI_EDELAY_INIT )
+			_papi_hwd[cidx]->ntv_enum_events( &junk, PAPI_ENUM_FIRST );
+
+		list = _papi_hwi_comp_presets[cidx];
+		for ( i = 0; list != NULL && i < _papi_hwi_max_presets[cidx]; i++ ) {
+			if ( list[i].symbol == NULL || list[i].count == 0 )
+				continue;
+			code = ( int ) ( ( i + _papi_hwi_start_idx[cidx] ) | PAPI_PRESET_MASK );
+			if ( _papi_hwi_get_preset_event_info( code, b.info ) == PAPI_OK )
+				catalog_event( &b, -1 );
+		}
+	}
+
+	code = PAPI_NATIVE_MASK;
+	retval = _papi_hwi_enum_native_event( cidx, &code, PAPI_ENUM_FIRST );
+	while ( retval == PAPI_OK ) {
+		/* this event may not exist */
+		if ( get_native_event_info( ( unsigned int ) code, b.info,
+					    offsetof( PAPI_event_info_t, count ) ) == PAPI_OK )
+			catalog_event( &b, ( flags & PAPI_CATALOG_QUALIFIERS ) ? cidx : -1 );
+		retval = _papi_hwi_enum_native_event( cidx, &code, PAPI_ENUM_EVENTS );
+	}
+
+	b.component = _papi_cache_buf_str( &b.strings, _papi_hwd[cidx]->cmp_info.name );
+
+	retval = PAPI_ENOMEM;
+	if ( !b.strings.failed && !b.recs.failed && !b.quals.failed &&
+	     ( *out = catalog_finish( &b, cidx ) ) != NULL )
+		retval = PAPI_OK;
+
+	papi_free( b.info );
+	_papi_cache_buf_free( &b.strings );
+	_papi_cache_buf_free( &b.recs );
+	_papi_cache_buf_free( &b.quals );
+	return retval;
+}
+
 EventSetInfo_t *
 _papi_hwi_lookup_EventSet( int eventset )
 {
 	const DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
+	DynamicSlot_t *slot;
 	EventSetInfo_t *set;
+	int i = eventset & PAPI_EVENTSET_SLOT_MASK;
+	int generation = eventset >> PAPI_EVENTSET_SLOT_BITS;
 
-	if ( ( eventset < 0 ) || ( eventset > map->totalSlots ) )
+	if ( ( eventset < 0 ) ||
+		 ( i >= __atomic_load_n( &map->totalSlots, __ATOMIC_ACQUIRE ) ) )
 		return ( NULL );
 
-	set = map->dataSlotArray[eventset];
+	/* A release bumps the generation before it clears the slot, so the
+	   set is the one of this handle if the generation matched around
+	   the load.  Lookups only load, they share the slot cache lines. */
+	slot = eventset_slot( map, i );
+	if ( __atomic_load_n( &slot->generation, __ATOMIC_ACQUIRE ) != generation )
+		return ( NULL );
+	set = __atomic_load_n( &slot->ESI, __ATOMIC_ACQUIRE );
+	if ( __atomic_load_n( &slot->generation, __ATOMIC_RELAXED ) != generation )
+		return ( NULL );
 #ifdef DEBUG
-	if ( ( ISLEVEL( DEBUG_THREADS ) ) && ( _papi_hwi_thread_id_fn ) &&
+	if ( ( set != NULL ) && ( ISLEVEL( DEBUG_THREADS ) ) &&
+		 ( _papi_hwi_thread_id_fn ) &&
 		 ( set->master->tid != _papi_hwi_thread_id_fn(  ) ) )
-		return ( NULL );
+		set = NULL;
 #endif
 
 	return ( set );
 }
 
+/* Walk the table by slot number, for code that visits every EventSet */
+
+EventSetInfo_t *
+_papi_hwi_EventSet_in_slot( int slot )
+{
+	const DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
+
+	if ( ( slot < 0 ) ||
+		 ( slot >= __atomic_load_n( &map->totalSlots, __ATOMIC_ACQUIRE ) ) )
+		return ( NULL );
+
+	return ( __atomic_load_n( &eventset_slot( map, slot )->ESI,
+							  __ATOMIC_ACQUIRE ) );
+}
+
 int
 _papi_hwi_is_sw_multiplex(EventSetInfo_t *ESI)
 {
@@ -3082,6 +4127,10 @@ get_component_index(const char *name)
         }
     }
 
+    if (cidx < papi_num_components) {
+        _papi_hwi_init_deferred_cmp(cidx);
+    }
+
     return cidx;
 }
 
@@ -91,6 +91,7 @@ extern char **_papi_errlist;
 #define GLOBAL_LOCK          	PAPI_NUM_LOCK+6	/* papi.c for global variable (static and non) initialization/shutdown */
 #define CPUS_LOCK		PAPI_NUM_LOCK+7	/* cpus.c */
 #define NAMELIB_LOCK            PAPI_NUM_LOCK+8 /* papi_pfm4_events.c */
+#define CMP_INIT_LOCK           PAPI_NUM_LOCK+9 /* papi_internal.c deferred component init */
 
 /* extras related */
 
@@ -119,6 +120,7 @@ extern char **_papi_errlist;
 
 #include OSCONTEXT
 #include "papi_preset.h"
+#include "papi_hash.h"
 
 #ifndef inline_static
 #define inline_static inline static
@@ -148,6 +150,8 @@ typedef struct _EventSetAttachInfo {
 
 typedef struct _EventSetCpuInfo {
   unsigned int cpu_num;
+  int num_cpus;                 /**< number of cpus in the PAPI_CPU_MASK */
+  unsigned int *cpus;           /**< copy of the PAPI_CPU_MASK, or NULL */
 } EventSetCpuInfo_t;
 
 typedef struct _EventSetInheritInfo
@@ -253,6 +257,7 @@ typedef struct _threadlist {
  @internal */
 struct _ThreadInfo;
 struct _CpuInfo;
+struct _papi_bound_reader;
 
 /** Fields below are ordered by access in PAPI_read for performance
  @internal */
@@ -306,15 +311,56 @@ typedef struct _EventSetInfo {
   EventSetCpuInfo_t cpu;
   EventSetProfileInfo_t profile;
   EventSetInheritInfo_t inherit;
+
+  struct _papi_bound_reader *bound_reader; /**< Reader from PAPI_bind_reader,
+                                                invalidated by PAPI_stop */
 } EventSetInfo_t;
 
+/** State resolved once by PAPI_bind_reader so that PAPI_read_bound
+ *  can skip the EventSet lookup and validation done by PAPI_read
+ @internal */
+typedef struct _papi_bound_reader {
+   EventSetInfo_t *ESI;            /**< NULL once the EventSet was stopped */
+   hwd_context_t *context;         /**< Context the EventSet runs in */
+   hwd_control_state_t *ctl_state; /**< Component control state */
+   int ( *read ) ( hwd_context_t *, hwd_control_state_t *,
+                   long long **, int ); /**< Component read routine */
+   int num_events;                 /**< Number of events in the EventSet */
+   int direct;                     /**< No derived events, values[i] is
+                                        counters[pos[i]] */
+   int *pos;                       /**< Counter index of each event */
+} PAPI_bound_reader_t;
+
+/* EventSet handles are (generation << PAPI_EVENTSET_SLOT_BITS) | slot.
+   The generation of a slot is bumped every time it is freed, so a stale
+   handle no longer resolves once its slot has been reused. */
+#define PAPI_EVENTSET_SLOT_BITS   18
+#define PAPI_EVENTSET_SLOT_MASK   ( ( 1 << PAPI_EVENTSET_SLOT_BITS ) - 1 )
+#define PAPI_EVENTSET_GEN_MASK    ( ( 1 << ( 31 - PAPI_EVENTSET_SLOT_BITS ) ) - 1 )
+#define PAPI_EVENTSET_CHUNK_SLOTS 256
+#define PAPI_EVENTSET_MAX_CHUNKS  ( ( PAPI_EVENTSET_SLOT_MASK + 1 ) / PAPI_EVENTSET_CHUNK_SLOTS )
+
 /** @internal */
+typedef struct _dynamic_slot {
+   EventSetInfo_t *ESI;         /**< EventSet in this slot, NULL if free */
+   int generation;              /**< generation of the next handle for this slot */
+} DynamicSlot_t;
+
+/** @internal
+ *  Slots live in fixed size chunks that are never moved or freed while
+ *  the library is initialized, so lookups need no lock.  Slots are claimed
+ *  and released with atomic operations; new chunks are published with a
+ *  compare and swap.  A lookup only loads the slot: it matches the
+ *  generation of the handle before and after it loads the EventSet, and
+ *  never looks into an EventSet that may have been released.
+ *  The lowest empty slot hint carries an update count in its high bits,
+ *  so that a compare and swap from a stale hint fails. */
 typedef struct _dynamic_array {
-   EventSetInfo_t **dataSlotArray;      /**< array of ptrs to EventSets */
-   int totalSlots;              /**< number of slots in dataSlotArrays      */
-   int availSlots;              /**< number of open slots in dataSlotArrays */
-   int fullSlots;               /**< number of full slots in dataSlotArray    */
-   int lowestEmptySlot;         /**< index of lowest empty dataSlotArray    */
+   DynamicSlot_t *chunks[PAPI_EVENTSET_MAX_CHUNKS]; /**< published slot chunks */
+   int totalSlots;              /**< number of slots in published chunks    */
+   int fullSlots;               /**< number of full slots                   */
+   unsigned int lowestEmptySlot; /**< update count and a slot no free slot
+                                     is below, see EVENTSET_HINT          */
 } DynamicArray_t;
 
 /* Component option types for _papi_hwd_ctl. */
@@ -329,6 +375,17 @@ typedef struct _papi_int_cpu {
    EventSetInfo_t *ESI;
 } _papi_int_cpu_t;
 
+typedef struct _papi_int_cpu_mask {
+   int num_cpus;
+   unsigned int *cpus;
+   EventSetInfo_t *ESI;
+} _papi_int_cpu_mask_t;
+
+typedef struct _papi_int_refresh {
+   long long usec;
+   EventSetInfo_t *ESI;
+} _papi_int_refresh_t;
+
 typedef struct _papi_int_multiplex {
    int flags;
    unsigned long ns;
@@ -390,6 +447,8 @@ typedef union _papi_int_option_t {
    _papi_int_domain_t domain;
    _papi_int_attach_t attach;
    _papi_int_cpu_t cpu;
+   _papi_int_cpu_mask_t cpu_mask;
+   _papi_int_refresh_t refresh;
    _papi_int_multiplex_t multiplex;
    _papi_int_itimer_t itimer;
 	_papi_int_inherit_t inherit;
@@ -442,11 +501,27 @@ extern THREAD_LOCAL_STORAGE_KEYWORD int _papi_rate_events_running;
 extern THREAD_LOCAL_STORAGE_KEYWORD int _papi_hl_events_running;
 
 EventSetInfo_t *_papi_hwi_lookup_EventSet( int eventset );
+EventSetInfo_t *_papi_hwi_EventSet_in_slot( int slot );
+void _papi_hwi_release_EventSet_slot( EventSetInfo_t * ESI );
+/** State of one event lookup, see _papi_hwi_event_ctx_begin.
+ *	@internal */
+typedef struct _papi_event_ctx {
+	unsigned int event_code;        /* PAPI code of the event */
+	int event_code_changed;         /* -1 unset, 0 set by the framework, > 0 by the component */
+	char *event_string;             /* event:mask name set by the component */
+	struct _papi_event_ctx *outer;  /* lookup this one is nested in */
+} papi_event_ctx_t;
+
+void _papi_hwi_event_ctx_begin( papi_event_ctx_t *ctx );
+void _papi_hwi_event_ctx_end( papi_event_ctx_t *ctx );
 void _papi_hwi_set_papi_event_string (const char *event_string);
 char *_papi_hwi_get_papi_event_string (void);
 void _papi_hwi_free_papi_event_string();
 void _papi_hwi_set_papi_event_code (unsigned int event_code, int update_flag);
 unsigned int _papi_hwi_get_papi_event_code (void);
+int _papi_hwi_name_cache_lookup( const char *name, int *code );
+void _papi_hwi_name_cache_insert( const char *name, int code, int cidx );
+void _papi_hwi_name_cache_invalidate( int cidx );
 int _papi_hwi_get_ntv_idx (unsigned int papi_evt_code);
 void _papi_hwi_obtain_prefix(const char *full_event_name, char *prefix);
 int _papi_hwi_is_sw_multiplex( EventSetInfo_t * ESI );
@@ -464,12 +539,17 @@ int _papi_hwi_lookup_EventCodeIndex( const EventSetInfo_t * ESI,
 int _papi_hwi_remove_EventSet( EventSetInfo_t * ESI );
 void _papi_hwi_map_events_to_native( EventSetInfo_t *ESI);
 int _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode );
+int _papi_hwi_add_events( EventSetInfo_t * ESI, int *Events, int number );
 int _papi_hwi_remove_event( EventSetInfo_t * ESI, int EventCode );
 int _papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
 		    long long *values );
+void _papi_hwi_invalidate_bound_reader( EventSetInfo_t * ESI );
 int _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI );
 int _papi_hwi_convert_eventset_to_multiplex( _papi_int_multiplex_t * mpx );
 int _papi_hwi_init_global( int PE_OR_PEU );
+int _papi_hwi_init_deferred_cmp( int cidx );
+int _papi_hwi_cmp_deferred( int cidx );
+long long _papi_hwi_cmp_init_usec( int cidx );
 int _papi_hwi_init_global_presets( void );
 int _papi_hwi_init_global_internal( void );
 int _papi_hwi_init_os(void);
@@ -485,6 +565,8 @@ int _papi_hwi_derived_type( char *tmp, int *code );
 int _papi_hwi_query_native_event( unsigned int EventCode );
 int _papi_hwi_get_native_event_info( unsigned int EventCode,
                                      PAPI_event_info_t * info );
+int _papi_hwi_enum_native_event( int cidx, int *EventCode, int modifier );
+int _papi_hwi_get_event_catalog( int cidx, int flags, PAPI_event_catalog_t **out );
 int _papi_hwi_native_name_to_code( const char *in, int *out );
 int _papi_hwi_native_code_to_name( unsigned int EventCode, char *hwi_name,
                                    int len );
@@ -5,23 +5,50 @@
 * File:    papi_libpfm4_events.h
 */
 
+#include <stdint.h>
+
 #include "perfmon/pfmlib.h"
 #include PEINCLUDE
 
-struct native_event_t {
-  int component;
-  char *pmu;
-  int papi_event_code;
-  int libpfm4_idx;
-  char *allocated_name;
-  char *base_name;
-  char *mask_string;
-  char *event_description;
-  char *mask_description;
-  char *pmu_plus_name;
-  int cpu;
-  int users;
-  perf_event_attr_t attr;
+#include "papi_hash.h"
+
+/* The native event table keeps each field of its events in an array of */
+/* its own (papi_event_code[], libpfm4_idx[], ...), in chunks of        */
+/* NATIVE_EVENT_CHUNK events, so a scan over one field does not drag    */
+/* the others through the cache.  Chunks are never moved or freed       */
+/* before shutdown, readers do not need the lock.                       */
+/*                                                                      */
+/* The names are interned once in a string arena and referred to by     */
+/* 32 bit offsets: the high bits pick a block of the arena, the low     */
+/* NATIVE_STRING_BLOCK_BITS the byte in it.  Offset 0 is "".            */
+/* Descriptions are not kept, they are asked from libpfm4 when needed.  */
+/* For an event with a single mask the attribute index of the mask is   */
+/* kept so its description is one libpfm4 call away.                    */
+
+#define NATIVE_EVENT_CHUNK        1024
+#define NATIVE_EVENT_MAX_CHUNKS   1024
+#define NATIVE_STRING_BLOCK_BITS  16
+#define NATIVE_STRING_BLOCK       (1 << NATIVE_STRING_BLOCK_BITS)
+#define NATIVE_STRING_MAX_BLOCKS  1024
+
+struct native_event_chunk_t {
+  int papi_event_code[NATIVE_EVENT_CHUNK];
+  int libpfm4_idx[NATIVE_EVENT_CHUNK];
+  int cpu[NATIVE_EVENT_CHUNK];
+  int mask_attr[NATIVE_EVENT_CHUNK];	/* libpfm4 attribute of a single mask */
+  uint32_t allocated_name[NATIVE_EVENT_CHUNK];
+  uint32_t pmu[NATIVE_EVENT_CHUNK];
+  uint32_t base_name[NATIVE_EVENT_CHUNK];
+  uint32_t mask_string[NATIVE_EVENT_CHUNK];
+  uint32_t pmu_plus_name[NATIVE_EVENT_CHUNK];
+  perf_event_attr_t attr[NATIVE_EVENT_CHUNK];
+};
+
+struct native_string_arena_t {
+  char *blocks[NATIVE_STRING_MAX_BLOCKS];
+  uint32_t next;			/* offset of the first free byte */
+  papi_string_set_t set;		/* value: the event a string is the */
+				/* allocated name of, or -1         */
 };
 
 #define PMU_TYPE_CORE   1
@@ -29,13 +56,25 @@ struct native_event_t {
 #define PMU_TYPE_OS     4
 
 struct native_event_table_t {
-   struct native_event_t *native_events;
+   struct native_event_chunk_t *chunks[NATIVE_EVENT_MAX_CHUNKS];
    int num_native_events;
    int allocated_native_events;
+   struct native_string_arena_t strings;
    pfm_pmu_info_t default_pmu;
    int pmu_type;
 };
 
+/* field of event idx of the table, e.g. NATIVE_EVENT_FIELD(t, cpu, i) */
+#define NATIVE_EVENT_FIELD(table, field, idx) \
+	((table)->chunks[(idx) / NATIVE_EVENT_CHUNK]->field[(idx) % NATIVE_EVENT_CHUNK])
+
+static inline const char *
+native_event_string(const struct native_event_table_t *table, uint32_t offset)
+{
+	return table->strings.blocks[offset >> NATIVE_STRING_BLOCK_BITS] +
+		(offset & (NATIVE_STRING_BLOCK - 1));
+}
+
 
 /* Prototypes for libpfm name library access */
 
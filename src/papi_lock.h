@@ -12,9 +12,10 @@
 #define GLOBAL_LOCK             PAPI_NUM_LOCK+6 /* papi.c for global variable (static and non) initialization/shutdown */
 #define CPUS_LOCK               PAPI_NUM_LOCK+7 /* cpus.c */
 #define NAMELIB_LOCK            PAPI_NUM_LOCK+8 /* papi_pfm4_events.c */
+#define CMP_INIT_LOCK           PAPI_NUM_LOCK+9 /* papi_internal.c deferred component init */
 
 
-#define NUM_INNER_LOCK  9
+#define NUM_INNER_LOCK  10
 #define PAPI_MAX_LOCK   (NUM_INNER_LOCK + PAPI_NUM_LOCK + PAPI_NUM_COMP)
 
 #include OSLOCK
@@ -0,0 +1,512 @@
+/****************************/
+/* THIS IS OPEN SOURCE CODE */
+/****************************/
+
+/*
+* File:    papi_node.c
+*
+* Node-wide sampling of /proc and /sys files, see papi_node.h.
+*
+* The segment is named /papi_node.<uid> (PAPI_NODE_SHM_NAME overrides
+* it).  The first process to create it starts the publisher thread;
+* later processes attach to it.  If the publishing process goes away,
+* the next process to resolve a source, e.g. at PAPI_start, notices the
+* stale heartbeat and takes over.  The
+* segment counts the processes attached to it, and the last one to
+* detach removes it.  A process that dies without PAPI_shutdown keeps
+* it in /dev/shm; the next PAPI process of the user reuses it.
+* PAPI_NODE_SAMPLE_ROOT is prepended to every path the publisher
+* opens, so tests can feed it fake /proc and /sys trees.  The root is
+* kept in the segment, and a process with another root does not use
+* the segment but reads the files itself.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_internal.h"
+#include "papi_node.h"
+
+#define PAPI_NODE_MAGIC       0x504e0003   /* "PN", layout version 3 */
+#define PAPI_NODE_CACHE_SIZE  256          /* > PAPI_NODE_MAX_SOURCES */
+
+typedef struct _node_source {
+	unsigned int seq;                /* odd while the publisher writes */
+	int len;                         /* bytes in data, -1 if unreadable */
+	char path[PAPI_NODE_PATH_LEN];
+	char data[PAPI_NODE_DATA_LEN];
+} NodeSource_t;
+
+typedef struct _node_segment {
+	unsigned int magic;              /* stored last by the creator */
+	int period_ms;
+	int publisher;                   /* pid sampling the sources, 0 if none */
+	pthread_mutex_t lock;            /* serializes registration, robust */
+	int users;                       /* processes attached */
+	long long heartbeat;             /* usec of the last sampling pass */
+	char root[PAPI_NODE_PATH_LEN];   /* PAPI_NODE_SAMPLE_ROOT of the creator */
+	int num_sources;
+	NodeSource_t source[PAPI_NODE_MAX_SOURCES];
+} NodeSegment_t;
+
+static pthread_mutex_t node_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t node_wake = PTHREAD_COND_INITIALIZER;
+static int node_state = 0;           /* 0 not tried, 1 attached, -1 off */
+static NodeSegment_t *node_seg = NULL;
+static char node_root[PAPI_NODE_PATH_LEN];
+static char node_name[PAPI_NODE_PATH_LEN];
+static int node_publishing = 0;
+static pthread_t node_thread;
+static int node_atfork_done = 0;
+
+/* path hash -> source index + 1 */
+static int node_cache[PAPI_NODE_CACHE_SIZE];
+
+static long long
+node_usec( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( long long ) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* Take the segment lock.  It is robust: if a process died holding it,
+   the next one gets it, and a half done registration is simply
+   redone since num_sources is published last. */
+static int
+node_seg_lock( void )
+{
+	int ret;
+
+	ret = pthread_mutex_lock( &node_seg->lock );
+	if ( ret == EOWNERDEAD ) {
+		SUBDBG( "Recovering the lock of node segment %s\n", node_name );
+		ret = pthread_mutex_consistent( &node_seg->lock );
+	}
+
+	return ret;
+}
+
+/* Reread one file into its slot under the slot's seqlock */
+static void
+node_publish_source( NodeSource_t *src, int *fd, char *buf )
+{
+	char path[2 * PAPI_NODE_PATH_LEN];
+	int len = 0, n;
+
+	if ( *fd < 0 ) {
+		snprintf( path, sizeof ( path ), "%s%s", node_root, src->path );
+		*fd = open( path, O_RDONLY );
+	}
+
+	if ( *fd < 0 ) {
+		len = -1;
+	} else {
+		while ( len < PAPI_NODE_DATA_LEN ) {
+			n = pread( *fd, buf + len, PAPI_NODE_DATA_LEN - len, len );
+			if ( n < 0 ) {
+				len = -1;
+				break;
+			}
+			if ( n == 0 )
+				break;
+			len += n;
+		}
+	}
+
+	__atomic_fetch_add( &src->seq, 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+	if ( len > 0 )
+		memcpy( src->data, buf, len );
+	src->len = len;
+	__atomic_fetch_add( &src->seq, 1, __ATOMIC_RELEASE );
+}
+
+static void *
+node_publisher( void *arg )
+{
+	int fd[PAPI_NODE_MAX_SOURCES];
+	struct timespec deadline;
+	char *buf;
+	int i, n, period;
+
+	( void ) arg;
+
+	buf = malloc( PAPI_NODE_DATA_LEN );
+	if ( buf == NULL )
+		return NULL;
+	for ( i = 0; i < PAPI_NODE_MAX_SOURCES; i++ )
+		fd[i] = -1;
+	period = node_seg->period_ms;
+
+	pthread_mutex_lock( &node_lock );
+	while ( node_publishing ) {
+		pthread_mutex_unlock( &node_lock );
+
+		n = __atomic_load_n( &node_seg->num_sources, __ATOMIC_ACQUIRE );
+		for ( i = 0; i < n; i++ )
+			node_publish_source( &node_seg->source[i], &fd[i], buf );
+		__atomic_store_n( &node_seg->heartbeat, node_usec(  ),
+						  __ATOMIC_RELEASE );
+
+		clock_gettime( CLOCK_REALTIME, &deadline );
+		deadline.tv_sec += period / 1000;
+		deadline.tv_nsec += ( long ) ( period % 1000 ) * 1000000L;
+		if ( deadline.tv_nsec >= 1000000000L ) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock( &node_lock );
+		if ( node_publishing )
+			pthread_cond_timedwait( &node_wake, &node_lock, &deadline );
+	}
+	pthread_mutex_unlock( &node_lock );
+
+	for ( i = 0; i < PAPI_NODE_MAX_SOURCES; i++ ) {
+		if ( fd[i] >= 0 )
+			close( fd[i] );
+	}
+	free( buf );
+
+	return NULL;
+}
+
+/* The publisher thread does not survive fork, the mapping does */
+static void
+node_atfork_child( void )
+{
+	node_publishing = 0;
+	if ( node_seg != NULL )
+		__atomic_fetch_add( &node_seg->users, 1, __ATOMIC_ACQ_REL );
+}
+
+/* Called with node_lock held, after this process became the publisher */
+static void
+node_start_publisher( void )
+{
+	node_publishing = 1;
+	if ( pthread_create( &node_thread, NULL, node_publisher, NULL ) ) {
+		node_publishing = 0;
+		__atomic_store_n( &node_seg->publisher, 0, __ATOMIC_RELEASE );
+		return;
+	}
+	SUBDBG( "Publishing node samples every %d ms\n", node_seg->period_ms );
+}
+
+/* Take over from a publisher that went away, called with node_lock held */
+static void
+node_check_publisher( void )
+{
+	long long stale;
+	int pid;
+
+	if ( node_publishing )
+		return;
+
+	pid = __atomic_load_n( &node_seg->publisher, __ATOMIC_ACQUIRE );
+	stale = 10000LL * node_seg->period_ms;
+	if ( stale < 1000000LL )
+		stale = 1000000LL;
+
+	if ( pid != 0 ) {
+		if ( node_usec(  ) -
+			 __atomic_load_n( &node_seg->heartbeat, __ATOMIC_ACQUIRE ) < stale )
+			return;
+		/* only replace a publisher that is gone, two would corrupt slots */
+		if ( kill( pid, 0 ) == 0 || errno != ESRCH )
+			return;
+	}
+
+	if ( __atomic_compare_exchange_n( &node_seg->publisher, &pid, getpid(  ),
+									  0, __ATOMIC_ACQ_REL,
+									  __ATOMIC_ACQUIRE ) ) {
+		SUBDBG( "Taking over node sampling from pid %d\n", pid );
+		node_start_publisher(  );
+	}
+}
+
+/* Create or attach to the segment, called with node_lock held */
+static int
+node_attach( void )
+{
+	char *name = node_name;
+	struct stat st;
+	char *env;
+	void *seg;
+	int fd, created = 0, period, tries;
+
+	env = getenv( "PAPI_NODE_SAMPLE_MS" );
+	if ( env == NULL || ( period = atoi( env ) ) <= 0 )
+		return -1;
+
+	env = getenv( "PAPI_NODE_SAMPLE_ROOT" );
+	snprintf( node_root, sizeof ( node_root ), "%s", env ? env : "" );
+
+	env = getenv( "PAPI_NODE_SHM_NAME" );
+	if ( env != NULL )
+		snprintf( node_name, sizeof ( node_name ), "%s", env );
+	else
+		snprintf( node_name, sizeof ( node_name ), "/papi_node.%d",
+				  ( int ) getuid(  ) );
+
+	fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+	if ( fd >= 0 ) {
+		created = 1;
+		if ( ftruncate( fd, sizeof ( NodeSegment_t ) ) ) {
+			close( fd );
+			shm_unlink( name );
+			return -1;
+		}
+	} else if ( errno == EEXIST ) {
+		fd = shm_open( name, O_RDWR, 0 );
+		if ( fd < 0 )
+			return -1;
+		/* the creator may not have sized it yet */
+		for ( tries = 0; tries < 1000; tries++ ) {
+			if ( fstat( fd, &st ) == 0 &&
+				 st.st_size >= ( off_t ) sizeof ( NodeSegment_t ) )
+				break;
+			usleep( 1000 );
+		}
+		if ( tries == 1000 ) {
+			close( fd );
+			return -1;
+		}
+	} else {
+		return -1;
+	}
+
+	seg = mmap( NULL, sizeof ( NodeSegment_t ), PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( seg == MAP_FAILED )
+		return -1;
+	node_seg = ( NodeSegment_t * ) seg;
+
+	if ( !node_atfork_done ) {
+		pthread_atfork( NULL, NULL, node_atfork_child );
+		node_atfork_done = 1;
+	}
+
+	if ( created ) {
+		pthread_mutexattr_t attr;
+
+		if ( pthread_mutexattr_init( &attr ) ||
+			 pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED ) ||
+			 pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST ) ||
+			 pthread_mutex_init( &node_seg->lock, &attr ) ) {
+			munmap( node_seg, sizeof ( NodeSegment_t ) );
+			node_seg = NULL;
+			shm_unlink( name );
+			return -1;
+		}
+		pthread_mutexattr_destroy( &attr );
+		node_seg->period_ms = period;
+		node_seg->publisher = getpid(  );
+		node_seg->users = 1;
+		node_seg->heartbeat = node_usec(  );
+		strcpy( node_seg->root, node_root );
+		__atomic_store_n( &node_seg->magic, PAPI_NODE_MAGIC, __ATOMIC_RELEASE );
+		node_start_publisher(  );
+		return 1;
+	}
+
+	for ( tries = 0; tries < 1000; tries++ ) {
+		if ( __atomic_load_n( &node_seg->magic, __ATOMIC_ACQUIRE ) ==
+			 PAPI_NODE_MAGIC )
+			break;
+		usleep( 1000 );
+	}
+	if ( tries == 1000 ) {
+		SUBDBG( "Node segment %s has an unknown layout\n", name );
+		munmap( node_seg, sizeof ( NodeSegment_t ) );
+		node_seg = NULL;
+		return -1;
+	}
+
+	/* the snapshots are of files under the creator's root */
+	if ( strcmp( node_seg->root, node_root ) ) {
+		SUBDBG( "Node segment %s samples under \"%s\", not \"%s\"\n",
+				name, node_seg->root, node_root );
+		munmap( node_seg, sizeof ( NodeSegment_t ) );
+		node_seg = NULL;
+		return -1;
+	}
+
+	__atomic_fetch_add( &node_seg->users, 1, __ATOMIC_ACQ_REL );
+	node_check_publisher(  );
+	return 1;
+}
+
+/* Index of the slot of path, registering it if needed.
+   Called with node_lock held. */
+static int
+node_source( const char *path )
+{
+	unsigned int h;
+	int i, n, idx = -1;
+
+	if ( strlen( path ) >= PAPI_NODE_PATH_LEN )
+		return -1;
+
+	h = _papi_hwi_string_hash( path ) % PAPI_NODE_CACHE_SIZE;
+	while ( node_cache[h] ) {
+		if ( !strcmp( node_seg->source[node_cache[h] - 1].path, path ) )
+			return node_cache[h] - 1;
+		h = ( h + 1 ) % PAPI_NODE_CACHE_SIZE;
+	}
+
+	if ( node_seg_lock(  ) )
+		return -1;
+
+	n = node_seg->num_sources;
+	for ( i = 0; i < n; i++ ) {
+		if ( !strcmp( node_seg->source[i].path, path ) ) {
+			idx = i;
+			break;
+		}
+	}
+	if ( idx < 0 && n < PAPI_NODE_MAX_SOURCES ) {
+		strcpy( node_seg->source[n].path, path );
+		__atomic_store_n( &node_seg->num_sources, n + 1, __ATOMIC_RELEASE );
+		idx = n;
+	}
+
+	pthread_mutex_unlock( &node_seg->lock );
+
+	if ( idx >= 0 )
+		node_cache[h] = idx + 1;
+
+	return idx;
+}
+
+int
+_papi_node_source( const char *path )
+{
+	NodeSource_t *src;
+	int idx = -1, waited, timeout;
+
+	pthread_mutex_lock( &node_lock );
+	if ( node_state == 0 )
+		node_state = ( node_attach(  ) > 0 ) ? 1 : -1;
+	if ( node_state > 0 ) {
+		node_check_publisher(  );
+		idx = node_source( path );
+	}
+	pthread_mutex_unlock( &node_lock );
+
+	if ( idx < 0 )
+		return -1;
+
+	/* a new source shows up after the next sampling pass */
+	src = &node_seg->source[idx];
+	timeout = 2 * node_seg->period_ms + 100;
+	for ( waited = 0; __atomic_load_n( &src->seq, __ATOMIC_ACQUIRE ) == 0 &&
+		  waited < timeout; waited++ )
+		usleep( 1000 );
+
+	return idx;
+}
+
+int
+_papi_node_read_source( int source, char *buf, int len )
+{
+	NodeSource_t *src;
+	unsigned int seq;
+	int n = -1;
+
+	if ( source < 0 || node_seg == NULL )
+		return -1;
+
+	src = &node_seg->source[source];
+	do {
+		seq = __atomic_load_n( &src->seq, __ATOMIC_ACQUIRE );
+		if ( seq == 0 )
+			return -1;
+		if ( seq & 1 )
+			continue;
+		n = src->len;
+		if ( n > len )
+			n = len;
+		if ( n > 0 )
+			memcpy( buf, src->data, n );
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+	} while ( ( seq & 1 ) || __atomic_load_n( &src->seq, __ATOMIC_RELAXED ) != seq );
+
+	return ( n < 0 ) ? -1 : n;
+}
+
+/* Only meant for reading a file once, e.g. to list events at init:
+   reads that happen per PAPI_read use _papi_node_read_source on a
+   buffer of their own. */
+FILE *
+_papi_node_fopen( const char *path )
+{
+	FILE *fp;
+	char *buf;
+	int len;
+
+	buf = malloc( PAPI_NODE_DATA_LEN );
+	if ( buf == NULL )
+		return fopen( path, "r" );
+
+	len = _papi_node_read_source( _papi_node_source( path ), buf,
+								  PAPI_NODE_DATA_LEN );
+	if ( len < 0 ) {
+		free( buf );
+		return fopen( path, "r" );
+	}
+
+	fp = fmemopen( NULL, len + 1, "w+" );
+	if ( fp != NULL ) {
+		if ( len > 0 )
+			fwrite( buf, 1, len, fp );
+		rewind( fp );
+	}
+	free( buf );
+
+	return fp;
+}
+
+void
+_papi_node_shutdown( void )
+{
+	pthread_mutex_lock( &node_lock );
+
+	if ( node_publishing ) {
+		node_publishing = 0;
+		pthread_cond_signal( &node_wake );
+		pthread_mutex_unlock( &node_lock );
+		pthread_join( node_thread, NULL );
+		pthread_mutex_lock( &node_lock );
+
+		/* let the next reader take over right away */
+		__atomic_store_n( &node_seg->heartbeat, 0, __ATOMIC_RELEASE );
+		__atomic_store_n( &node_seg->publisher, 0, __ATOMIC_RELEASE );
+	}
+
+	if ( node_seg != NULL ) {
+		if ( __atomic_sub_fetch( &node_seg->users, 1, __ATOMIC_ACQ_REL ) == 0 ) {
+			SUBDBG( "Last user of node segment %s\n", node_name );
+			shm_unlink( node_name );
+		}
+		munmap( node_seg, sizeof ( NodeSegment_t ) );
+		node_seg = NULL;
+	}
+	node_state = 0;
+	memset( node_cache, 0, sizeof ( node_cache ) );
+
+	pthread_mutex_unlock( &node_lock );
+}
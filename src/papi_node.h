@@ -0,0 +1,44 @@
+#ifndef PAPI_NODE_H
+#define PAPI_NODE_H
+
+/* Node-wide sampling of /proc and /sys files.
+
+   With PAPI_NODE_SAMPLE_MS set, one PAPI process on the node owns a
+   publisher thread that rereads every registered file at that period
+   into a shared memory segment.  Every other PAPI process of the same
+   user reads the snapshots from the segment instead of opening the
+   files itself.  Each snapshot is protected by its own seqlock, so a
+   reader never blocks the publisher and needs no system call. */
+
+#include <stdio.h>
+
+#define PAPI_NODE_MAX_SOURCES   128      /* files sampled per node */
+#define PAPI_NODE_PATH_LEN      256
+#define PAPI_NODE_DATA_LEN      65536    /* largest snapshot kept per file */
+
+/** Open a node-wide file for reading.  Returns a stream over the
+    latest snapshot when node sampling is active, or the file itself
+    otherwise.  Close it with fclose.  This allocates and copies the
+    snapshot, use _papi_node_read_source for reads done per PAPI_read.
+    @internal */
+FILE *_papi_node_fopen( const char *path );
+
+/** Register a file for node-wide sampling and wait for its first
+    snapshot.  Returns the index to read it with, or -1 if node
+    sampling is off.  Takes a lock and may take over a publisher that
+    went away, so resolve the index once, e.g. at start, not per read.
+    @internal */
+int _papi_node_source( const char *path );
+
+/** Copy the latest snapshot of a source into buf.  This is only a
+    seqlock retry loop: it takes no lock and makes no system call.
+    Returns the number of bytes copied, or -1 if source is -1 or the
+    file could not be sampled; the caller then reads the file directly.
+    @internal */
+int _papi_node_read_source( int source, char *buf, int len );
+
+/** Stop this process' publisher, if any, and detach from the segment.
+    @internal */
+void _papi_node_shutdown( void );
+
+#endif /* PAPI_NODE_H */
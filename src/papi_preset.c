@@ -12,14 +12,25 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "papi.h"
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
 #include "papi_preset.h"
+#include "papi_cache.h"
+#include "papi_preset_bin.h"
+#include "papi_preset_parse.h"
 #include "extras.h"
 
+#if PB_MAX_TERMS != PAPI_EVENTS_IN_DERIVED_EVENT
+#error "papi_preset_bin.h does not match PAPI_EVENTS_IN_DERIVED_EVENT"
+#endif
+
 
 // A place to put user defined events
 extern hwi_presets_t user_defined_events[];
@@ -167,76 +178,6 @@ _papi_hwi_cleanup_all_presets( void )
 #define PAPI_EVENT_FILE "papi_events.csv"
 
 
-/*  Trims blank space from both ends of a string (in place).
-    Returns pointer to new start address */
-static inline char *
-trim_string( char *in )
-{
-	int len, i = 0;
-	char *start = in;
-
-	if ( in == NULL )
-		return ( in );
-	len = ( int ) strlen( in );
-	if ( len == 0 )
-		return ( in );
-
-	/* Trim left */
-	while ( i < len ) {
-		if ( isblank( in[i] ) ) {
-			in[i] = '\0';
-			start++;
-		} else
-			break;
-		i++;
-	}
-
-	/* Trim right */
-	i = ( int ) strlen( start ) - 1;
-	while ( i >= 0 ) {
-		if ( isblank( start[i] ) )
-			start[i] = '\0';
-		else
-			break;
-		i--;
-	}
-	return ( start );
-}
-
-
-/*  Calls trim_string to remove blank space;
-    Removes paired punctuation delimiters from
-    beginning and end of string. If the same punctuation
-    appears first and last (quotes, slashes) they are trimmed;
-    Also checks for the following pairs: () <> {} [] */
-static inline char *
-trim_note( char *in )
-{
-	int len;
-	char *note, start, end;
-
-	note = trim_string( in );
-	if ( note != NULL ) {
-                len = ( int ) strlen( note );
-		if ( len > 0 ) {
-			if ( ispunct( *note ) ) {
-				start = *note;
-				end = note[len - 1];
-				if ( ( start == end )
-					 || ( ( start == '(' ) && ( end == ')' ) )
-					 || ( ( start == '<' ) && ( end == '>' ) )
-					 || ( ( start == '{' ) && ( end == '}' ) )
-					 || ( ( start == '[' ) && ( end == ']' ) ) ) {
-					note[len - 1] = '\0';
-					*note = '\0';
-					note++;
-				}
-			}
-		}
-	}
-	return note;
-}
-
 static inline int
 find_event_index(hwi_presets_t *array, int size, char *tmp) {
 	SUBDBG("ENTER: array: %p, size: %d, tmp: %s\n", array, size, tmp);
@@ -768,9 +709,11 @@ is_event(char *event_name, int derived_type, hwi_presets_t* results, int token_i
 	return 0;
 }
 
-/* Static version of the events file. */
+/* Static version of the events file, as text for the component */
+/* presets and compiled by papi_events_compile for the CPU presets. */
 #if defined(STATIC_PAPI_EVENTS_TABLE)
 #include "papi_events_table.h"
+#include "papi_events_bin.h"
 #else
 static char *papi_events_table = NULL;
 #endif
@@ -790,6 +733,9 @@ int _papi_load_preset_table(char *pmu_str, int pmu_type, int cidx) {
 	// go load the user defined event definitions if any are defined
 	retval = papi_load_derived_events(pmu_str, pmu_type, cidx, 0);
 
+	// a new event may now hide a name resolved before
+	_papi_hwi_name_cache_invalidate( -1 );
+
 	SUBDBG("EXIT: retval: %d\n", retval);
 	return retval;
 }
@@ -801,6 +747,7 @@ int _papi_load_preset_table_component(char *comp_str, char *arch_str, int cidx)
 
 	// go load papi preset events for component index 'cidx'
 	retval = papi_load_derived_events_component(comp_str, arch_str, cidx);
+	_papi_hwi_name_cache_invalidate( -1 );
 	if (retval != PAPI_OK) {
 		SUBDBG("EXIT: retval: %d\n", retval);
 		return retval;
@@ -810,119 +757,727 @@ int _papi_load_preset_table_component(char *comp_str, char *arch_str, int cidx)
 	return retval;
 }
 
-// global variables
-static char stack[2*PAPI_HUGE_STR_LEN]; // stack
-static int stacktop = -1; // stack length
-
-// priority: This function returns the priority of the operator
-static
-int priority( char symbol ) {
-        switch( symbol ) {
-        case '@':
-                return -1;
-        case '(':
-                return 0;
-	case '+':
-	case '-':
-                return 1;
-	case '*':
-	case '/':
-	case '%':
-		return 2;
-	default :
-		return 0;
-	} // end switch symbol
-} // end priority
-
-static
-int push( char symbol ) {
-  if (stacktop >= 2*PAPI_HUGE_STR_LEN - 1) {
-    INTDBG("stack overflow converting algebraic expression (%d,%c)\n", stacktop,symbol );
-    return -1;  //***TODO: Figure out how to exit gracefully
-  } // end if stacktop>MAX
-  stack[++stacktop] = symbol;
-  return 0;
-} // end push
-
-// pop from stack
-static
-char pop() {
-  if( stacktop < 0 ) {
-    INTDBG("stack underflow converting algebraic expression\n" );
-    return '\0';  //***TODO: Figure out how to exit gracefully
-  } // end if empty
-  return( stack[stacktop--] );
-} // end pop
-
-/* infix_to_postfix:
-   routine that will be called with parameter:
-   char *in characters of infix notation (algebraic formula)
-   returns: char * pointer to string of returned postfix */
+int _papi_load_user_event_table(char *pmu_str, int pmu_type, int cidx) {
+	SUBDBG("ENTER: pmu_str: %s, pmu_type: %d, cidx: %d\n", pmu_str, pmu_type, cidx);
+
+	int retval;
+
+	// only the user defined events, the presets came from the event cache
+	retval = papi_load_derived_events(pmu_str, pmu_type, cidx, 0);
+	_papi_hwi_name_cache_invalidate( -1 );
+
+	SUBDBG("EXIT: retval: %d\n", retval);
+	return retval;
+}
+
+/* A preset as stored in the event cache, strings are offsets into */
+/* the string pool of the table.                                   */
+typedef struct preset_cache_rec {
+	int32_t index;
+	int32_t derived_int;
+	uint32_t count;
+	uint32_t symbol;
+	uint32_t short_descr;
+	uint32_t long_descr;
+	uint32_t note;
+	uint32_t postfix;
+	uint32_t code[PAPI_MAX_INFO_TERMS];
+	uint32_t default_code[PAPI_MAX_INFO_TERMS];
+	uint32_t name[PAPI_MAX_INFO_TERMS];
+	uint32_t base_name[PAPI_MAX_INFO_TERMS];
+	uint32_t default_name[PAPI_MAX_INFO_TERMS];
+} preset_cache_rec_t;
+
+/* Describe where papi_load_derived_events gets the presets from, */
+/* so that an edited event file invalidates the event cache.       */
+int _papi_preset_cache_key(char *key, int len) {
+	char path[PATH_MAX];
+	char *file;
+	struct stat st;
+
+	if ((file = getenv("PAPI_CSV_EVENT_FILE")) && (strlen(file) > 0)) {
+		;
+	} else if ((file = getenv("PAPI_BIN_EVENT_FILE")) && (strlen(file) > 0)) {
+		;
+	} else if (papi_events_table) {
+#if defined(STATIC_PAPI_EVENTS_TABLE)
+		/* the table may change without changing size */
+		snprintf(key, len, "presets builtin bin %llx",
+			_papi_hwi_hash(papi_events_bin, sizeof(papi_events_bin)));
+#else
+		snprintf(key, len, "presets builtin %llx",
+			_papi_hwi_hash(papi_events_table, strlen(papi_events_table)));
+#endif
+		return PAPI_OK;
+	} else {
+#ifdef PAPI_DATADIR
+		snprintf( path, sizeof(path), "%s/%s", PAPI_DATADIR, PAPI_EVENT_FILE );
+#else
+		snprintf( path, sizeof(path), "%s", PAPI_EVENT_FILE );
+#endif
+		file = path;
+	}
+
+	if (stat(file, &st) < 0) {
+		return PAPI_ESYS;
+	}
+	if (snprintf(key, len, "presets %s %lld %lld", file, (long long)st.st_size,
+		     (long long)st.st_mtime) >= len) {
+		return PAPI_EINVAL;
+	}
+	return PAPI_OK;
+}
+
+/* Stage the presets of component cidx for the event cache. All of  */
+/* their terms must be native events of that component, which the   */
+/* component restores with the same codes before the presets.       */
+int _papi_preset_cache_save(int cidx) {
+	papi_cache_buf_t records, strings;
+	preset_cache_rec_t rec;
+	hwi_presets_t *p;
+	unsigned int count = 0, j;
+	int i, retval;
+
+	memset(&records, 0, sizeof(records));
+	memset(&strings, 0, sizeof(strings));
+
+	for (i = 0; i < PAPI_MAX_PRESET_EVENTS; i++) {
+		p = &_papi_hwi_presets[i];
+
+		// only entries the event table filled in
+		if ((p->symbol == NULL) || (p->component_index != cidx) ||
+		    ((p->count == 0) && (p->postfix == NULL) && (p->note == NULL))) {
+			continue;
+		}
+		if (p->count > PAPI_MAX_INFO_TERMS) {
+			retval = PAPI_EBUG;
+			goto out;
+		}
+
+		memset(&rec, 0, sizeof(rec));
+		rec.index = i;
+		rec.derived_int = p->derived_int;
+		rec.count = p->count;
+		rec.symbol = _papi_cache_buf_str(&strings, p->symbol);
+		rec.short_descr = _papi_cache_buf_str(&strings, p->short_descr);
+		rec.long_descr = _papi_cache_buf_str(&strings, p->long_descr);
+		rec.note = _papi_cache_buf_str(&strings, p->note);
+		rec.postfix = _papi_cache_buf_str(&strings, p->postfix);
+		for (j = 0; j < PAPI_MAX_INFO_TERMS; j++) {
+			rec.code[j] = p->code[j];
+			rec.default_code[j] = p->default_code[j];
+			rec.name[j] = PAPI_CACHE_NULL;
+			rec.base_name[j] = PAPI_CACHE_NULL;
+			rec.default_name[j] = PAPI_CACHE_NULL;
+		}
+		for (j = 0; j < p->count; j++) {
+			if (_papi_hwi_component_index(p->code[j]) != cidx) {
+				SUBDBG("%s uses %#x, not cached\n", p->symbol, p->code[j]);
+				retval = PAPI_ENOSUPP;
+				goto out;
+			}
+			rec.name[j] = _papi_cache_buf_str(&strings, p->name[j]);
+			rec.base_name[j] = _papi_cache_buf_str(&strings, p->base_name[j]);
+			rec.default_name[j] = _papi_cache_buf_str(&strings, p->default_name[j]);
+		}
+		_papi_cache_buf_add(&records, &rec, sizeof(rec));
+		count++;
+	}
+
+	retval = _papi_cache_stage_table(PAPI_CACHE_PRESETS, &records, count,
+					 sizeof(rec), &strings);
+	if (retval == PAPI_OK) {
+		retval = _papi_cache_stage(PAPI_CACHE_PRESET_COUNT,
+					   &_papi_hwd[cidx]->cmp_info.num_preset_events,
+					   sizeof(int));
+	}
+
+out:
+	_papi_cache_buf_free(&records);
+	_papi_cache_buf_free(&strings);
+	return retval;
+}
+
+/* Restore the presets of component cidx from the event cache. The */
+/* table is checked completely before the first preset is touched, */
+/* so on failure the caller can still load the event table.        */
+int _papi_preset_cache_load(int cidx) {
+	const preset_cache_rec_t *recs, *rec;
+	papi_cache_table_t table;
+	const int *num_presets;
+	const char *str;
+	hwi_presets_t *p;
+	unsigned int i, j;
+	size_t len;
+
+	if (_papi_cache_table(PAPI_CACHE_PRESETS, sizeof(*rec), &table) != PAPI_OK) {
+		return PAPI_ENOEVNT;
+	}
+	num_presets = _papi_cache_section(PAPI_CACHE_PRESET_COUNT, &len);
+	if ((num_presets == NULL) || (len != sizeof(int))) {
+		return PAPI_ENOEVNT;
+	}
+	recs = (const preset_cache_rec_t *)table.records;
+
+	for (i = 0; i < table.count; i++) {
+		rec = &recs[i];
+		if ((rec->index < 0) || (rec->index >= PAPI_MAX_PRESET_EVENTS) ||
+		    (rec->count > PAPI_MAX_INFO_TERMS)) {
+			return PAPI_ENOEVNT;
+		}
+		str = _papi_cache_str(&table, rec->symbol);
+		p = &_papi_hwi_presets[rec->index];
+		if ((str == NULL) || ((p->symbol != NULL) && strcmp(p->symbol, str))) {
+			return PAPI_ENOEVNT;
+		}
+		for (j = 0; j < rec->count; j++) {
+			if (_papi_hwi_component_index((int)rec->code[j]) != cidx) {
+				return PAPI_ENOEVNT;
+			}
+		}
+	}
+
+	for (i = 0; i < table.count; i++) {
+		rec = &recs[i];
+		p = &_papi_hwi_presets[rec->index];
+
+		if (p->symbol == NULL) {
+			p->symbol = papi_strdup(_papi_cache_str(&table, rec->symbol));
+		}
+		// the static table has the standard descriptions already
+		str = _papi_cache_str(&table, rec->short_descr);
+		if ((str != NULL) && ((p->short_descr == NULL) || strcmp(p->short_descr, str))) {
+			p->short_descr = papi_strdup(str);
+		}
+		str = _papi_cache_str(&table, rec->long_descr);
+		if ((str != NULL) && ((p->long_descr == NULL) || strcmp(p->long_descr, str))) {
+			p->long_descr = papi_strdup(str);
+		}
+		if ((str = _papi_cache_str(&table, rec->note)) != NULL) {
+			p->note = papi_strdup(str);
+		}
+		if ((str = _papi_cache_str(&table, rec->postfix)) != NULL) {
+			p->postfix = papi_strdup(str);
+		}
+
+		p->component_index = cidx;
+		p->derived_int = rec->derived_int;
+		p->count = rec->count;
+		for (j = 0; j < PAPI_MAX_INFO_TERMS; j++) {
+			p->code[j] = rec->code[j];
+			p->default_code[j] = rec->default_code[j];
+		}
+		for (j = 0; j < rec->count; j++) {
+			// names of a preset with a missing term were freed
+			if ((str = _papi_cache_str(&table, rec->name[j])) != NULL) {
+				p->name[j] = strdup(str);
+			}
+			if ((str = _papi_cache_str(&table, rec->base_name[j])) != NULL) {
+				p->base_name[j] = strdup(str);
+			}
+			if ((str = _papi_cache_str(&table, rec->default_name[j])) != NULL) {
+				p->default_name[j] = strdup(str);
+			}
+		}
+	}
+
+	_papi_hwd[cidx]->cmp_info.num_preset_events = *num_presets;
+
+	SUBDBG("EXIT: %u presets from the event cache\n", table.count);
+	return PAPI_OK;
+}
+
+/* One PRESET or EVENT line split into its fields, from the csv text */
+/* or from a compiled event table.  Missing fields are NULL.         */
+typedef struct preset_def {
+	const char *symbol;
+	const char *derived;
+	const char *postfix;
+	const char *terms[PAPI_EVENTS_IN_DERIVED_EVENT];
+	int count;
+	const char *short_descr;
+	const char *long_descr;
+	const char *note;
+} preset_def_t;
+
+/* where add_derived_event puts the events of papi_load_derived_events */
+typedef struct preset_dest {
+	const char *name;           /* of the event file, for the messages */
+	int cidx;
+	int preset_flag;
+	int event_type_bits;
+	hwi_presets_t *results;
+	int result_size;
+	int *event_count;
+} preset_dest_t;
+
 static char *
-infix_to_postfix( char *infix ) {
-	INTDBG("ENTER: in: %s, size: %zu\n", infix, strlen(infix));
-	static char postfix[2*PAPI_HUGE_STR_LEN];	// output
-        unsigned int index;
-        int postfixlen;
-        char token;
-        if ( strlen(infix) > PAPI_HUGE_STR_LEN ) 
-            PAPIERROR("A infix string (probably in user-defined presets) is too big (max allowed %d): %s", PAPI_HUGE_STR_LEN, infix );
-
-        // initialize stack
-	memset(stack, 0, 2*PAPI_HUGE_STR_LEN);
-	stacktop = -1; 
-	push('#'); 
-        stacktop = 0; // after initialization of stack to #
-        /* initialize output string */
-	memset(postfix,0,2*PAPI_HUGE_STR_LEN);
-        postfixlen = 0;
-
-	for( index=0; index<strlen(infix); index++ ) {
-                token = infix[index];
-                INTDBG("INTDBG: in: %s, length: %zu, index: %d token %c\n", infix, strlen( infix ), index, token);
-		switch( token ) {
-		case '(':
-			push( token );
+next_token( char **tok_save_ptr )
+{
+	char *t = _papi_preset_trim_string(strtok_r(NULL, ",", tok_save_ptr));
+
+	if ((t == NULL) || (strlen(t) == 0))
+		return NULL;
+	return t;
+}
+
+/* Split the rest of a PRESET line.  Only the fields that a valid */
+/* event definition has are looked at, as before.                 */
+static void
+parse_event_line( char **tok_save_ptr, preset_def_t *def )
+{
+	char *t, *field;
+	int derived;
+
+	memset(def, 0, sizeof(*def));
+
+	if ((def->symbol = next_token(tok_save_ptr)) == NULL)
+		return;
+	if ((def->derived = next_token(tok_save_ptr)) == NULL)
+		return;
+	if (_papi_hwi_derived_type((char *)def->derived, &derived) != PAPI_OK)
+		return;
+	if ((derived == DERIVED_POSTFIX) || (derived == DERIVED_INFIX)) {
+		if ((def->postfix = next_token(tok_save_ptr)) == NULL)
+			return;
+	}
+
+	do {
+		t = next_token(tok_save_ptr);
+		if ((t == NULL) || (strcasecmp(t, "NOTE") == 0) ||
+		    (strcasecmp(t, "LDESC") == 0) || (strcasecmp(t, "SDESC") == 0))
 			break;
-		case ')':
-                        if (postfix[postfixlen-1]!='|') postfix[postfixlen++] = '|';
-                        while ( stack[stacktop] != '(' ) {
-                                postfix[postfixlen++] = pop();
-                                postfix[postfixlen++] = '|';
-                        }
-                        token = pop();  /* pop the '(' character */
+		def->terms[def->count++] = t;
+	} while (def->count < PAPI_EVENTS_IN_DERIVED_EVENT);
+
+	if (def->count == PAPI_EVENTS_IN_DERIVED_EVENT)
+		t = next_token(tok_save_ptr);
+
+	// optional short descriptions, long descriptions and notes
+	while (t != NULL) {
+		field = t;
+		t = _papi_preset_trim_note(strtok_r(NULL, ",", tok_save_ptr));
+		if ((t == NULL) || (strlen(t) == 0))
 			break;
-		case '+':
-		case '-':
-		case '*':
-		case '/':
-		case '%':
-		case '^':       /* if an operator */
-                        if (postfix[postfixlen-1]!='|') postfix[postfixlen++] = '|';
-                        while ( priority(stack[stacktop]) > priority(token) ) {
-                                postfix[postfixlen++] = pop();
-                                postfix[postfixlen++] = '|';
-                        }
-                        push( token ); /* save current operator */
-                        break;
-		default: // if alphanumeric character which is not parenthesis or an operator
-                        postfix[postfixlen++] = token;
+		if (strcasecmp(field, "SDESC") == 0)
+			def->short_descr = t;
+		if (strcasecmp(field, "LDESC") == 0)
+			def->long_descr = t;
+		if (strcasecmp(field, "NOTE") == 0)
+			def->note = t;
+		t = next_token(tok_save_ptr);
+	}
+}
+
+/* Define the event of one PRESET line, found at line_no */
+static void
+add_derived_event( const preset_def_t *def, int line_no, const preset_dest_t *dest )
+{
+	hwi_presets_t *results = dest->results;
+	const char *name = dest->name;
+	char postfix[2 * PAPI_PRESET_MAX_FORMULA + 2];
+	char *t;
+	int derived = 0;
+	int res_idx;
+	int preset;
+	int invalid_event;
+	int i;
+
+	if (def->symbol == NULL) {
+		PAPIERROR("Expected name after PRESET token at line %d of %s -- ignoring", line_no, name);
+		return;
+	}
+
+	SUBDBG( "Examining event %s\n", def->symbol);
+
+	// see if this event already exists in the results array, if not already known it sets up event in unused entry
+	if ((res_idx = find_event_index (results, dest->result_size, (char *)def->symbol)) < 0) {
+		PAPIERROR("No room left for event %s -- ignoring", def->symbol);
+		return;
+	}
+
+	// add the proper event bits (preset or user defined bits)
+	preset = res_idx | dest->event_type_bits;
+	(void) preset;
+
+	SUBDBG( "Use event code: %#x for %s\n", preset, def->symbol);
+	_papi_hwi_presets[res_idx].component_index = dest->cidx;
+
+	if (def->derived == NULL) {
+		// got an error, make this entry unused
+		if (results[res_idx].symbol != NULL){
+			papi_free (results[res_idx].symbol);
+			results[res_idx].symbol = NULL;
+		}
+		PAPIERROR("Expected derived type after PRESET token at line %d of %s -- ignoring", line_no, name);
+		return;
+	}
+
+	if (_papi_hwi_derived_type((char *)def->derived, &derived) != PAPI_OK) {
+		// got an error, make this entry unused
+		if (results[res_idx].symbol != NULL){
+			papi_free (results[res_idx].symbol);
+			results[res_idx].symbol = NULL;
+		}
+		PAPIERROR("Invalid derived name %s after PRESET token at line %d of %s -- ignoring", def->derived, line_no, name);
+		return;
+	}
+
+	/****************************************/
+	/* Have an event, let's start assigning */
+	/****************************************/
+
+	SUBDBG( "Adding event: %s, code: %#x, derived: %d results[%d]: %p.\n", def->derived, preset, derived, res_idx, &results[res_idx]);
+
+	/* results[res_idx].event_code = preset; */
+	results[res_idx].derived_int = derived;
+
+	/* Derived support starts here */
+	/* Special handling for postfix and infix */
+	if ((derived == DERIVED_POSTFIX)  || (derived == DERIVED_INFIX)) {
+		if (def->postfix == NULL) {
+			// got an error, make this entry unused
+			if (results[res_idx].symbol != NULL){
+				papi_free (results[res_idx].symbol);
+				results[res_idx].symbol = NULL;
+			}
+			PAPIERROR("Expected Operation string after derived type DERIVED_POSTFIX or DERIVED_INFIX at line %d of %s -- ignoring", line_no, name);
+			return;
+		}
+
+		// if it is an algebraic formula, we need to convert it to postfix
+		t = (char *)def->postfix;
+		if (derived == DERIVED_INFIX) {
+			SUBDBG( "Converting InFix operations %s\n", t);
+			t = _papi_preset_infix_to_postfix( t, postfix, sizeof(postfix) );
+			if (t == NULL) {
+				if (results[res_idx].symbol != NULL){
+					papi_free (results[res_idx].symbol);
+					results[res_idx].symbol = NULL;
+				}
+				PAPIERROR("Infix formula longer than %d characters at line %d of %s -- ignoring", PAPI_PRESET_MAX_FORMULA, line_no, name);
+				return;
+			}
+			results[res_idx].derived_int = DERIVED_POSTFIX;
+		}
+
+		SUBDBG( "Saving PostFix operations %s\n", t);
+		results[res_idx].postfix = papi_strdup(t);
+	}
+
+	/* All derived terms collected here */
+	invalid_event = 0;
+	results[res_idx].count = 0;
+	for (i = 0; i < def->count; i++) {
+		t = (char *)def->terms[i];
+
+		SUBDBG( "Adding term (%d) %s to derived event %#x, current native event count: %d.\n", i, t, preset, results[res_idx].count);
+
+		// make sure that this term in the derived event is a valid event name
+		// this call replaces preset and user event names with the equivalent native events in our results table
+		// it also updates formulas for derived events so that they refer to the correct native event index
+		if (is_event(t, results[res_idx].derived_int, &results[res_idx], i) == 0) {
+			invalid_event = 1;
+			PAPIERROR("Missing event %s, used in derived event %s", t, results[res_idx].symbol);
 			break;
-		} // end switch symbol
-	} // end while
-
-        /* Write any remaining operators */
-        if (postfix[postfixlen-1]!='|') postfix[postfixlen++] = '|';
-        while ( stacktop>0 ) {
-                postfix[postfixlen++] = pop();
-                postfix[postfixlen++] = '|';
-        }
-        postfix[postfixlen++] = '\0';
-	stacktop = -1; 
+		}
+
+		/* If it is a valid event, then update the preset fields here. */
+		/* Initially, the event name should be those with a default, mandatory qualifiers. */
+		results[res_idx].name[results[res_idx].count]         = strdup(t);
+		results[res_idx].base_name[results[res_idx].count]    = strdup(t);
+		results[res_idx].default_name[results[res_idx].count] = strdup(t);
+		results[res_idx].default_code[results[res_idx].count] = results[res_idx].code[results[res_idx].count];
+		results[res_idx].count++;
+	}
+
+	/* preset code list must be PAPI_NULL terminated */
+	if (i < PAPI_EVENTS_IN_DERIVED_EVENT) {
+		results[res_idx].code[results[res_idx].count] = PAPI_NULL;
+	}
+
+	if (invalid_event) {
+		// got an error, make this entry unused
+		// preset table is statically allocated, user defined is dynamic
+		unsigned int j;
+		for (j = 0; j < results[res_idx].count; j++){
+			if (results[res_idx].name[j] != NULL){
+				papi_free( results[res_idx].name[j] );
+				results[res_idx].name[j] = NULL;
+			}
+		}
+
+		if (!dest->preset_flag){
+			if(results[res_idx].symbol != NULL){
+				papi_free (results[res_idx].symbol);
+				results[res_idx].symbol = NULL;
+			}
+		}
+
+		return;
+	}
+
+	/* End of derived support */
+
+	// if we did not find any terms to base this derived event on, report error
+	if (i == 0) {
+		// got an error, make this entry unused
+		if (!dest->preset_flag){
+			if(results[res_idx].symbol != NULL){
+				papi_free (results[res_idx].symbol);
+				results[res_idx].symbol = NULL;
+			}
+		}
+		PAPIERROR("Expected PFM event after DERIVED token at line %d of %s -- ignoring", line_no, name);
+		return;
+	}
+
+	// Handle optional short descriptions, long descriptions and notes
+	if (def->short_descr != NULL) {
+		results[res_idx].short_descr = papi_strdup(def->short_descr);
+	}
+	if (def->long_descr != NULL) {
+		results[res_idx].long_descr = papi_strdup(def->long_descr);
+	}
+	if (def->note != NULL) {
+		results[res_idx].note = papi_strdup(def->note);
+	}
+
+	(*dest->event_count)++;
+}
+
+/* A string of a compiled event table, NULL for PB_NONE */
+static const char *
+bin_str( const unsigned char *table, uint32_t off )
+{
+	if (off == PB_NONE)
+		return NULL;
+	return (const char *)table + pb_word(table + PB_MAGIC_LEN + 4 * PB_HDR_STRINGS) + off;
+}
+
+/* Check all of a compiled event table of len bytes before any of it */
+/* is used, so that a damaged or foreign file cannot crash the load. */
+static int
+check_bin_table( const unsigned char *table, size_t len )
+{
+	const unsigned char *hdr = table + PB_MAGIC_LEN, *rec;
+	uint32_t num_records, num_sections, num_terms, strings_len, i, j;
+	uint64_t records, sections, terms, strings;
+	static const int event_strs[] = { PB_REC_SYMBOL, PB_REC_DERIVED, PB_REC_POSTFIX,
+		PB_REC_SHORT_DESCR, PB_REC_LONG_DESCR, PB_REC_NOTE };
+
+	if ((len < PB_MAGIC_LEN + 4 * PB_HDR_WORDS) ||
+	    (memcmp(table, PB_MAGIC, PB_MAGIC_LEN) != 0) ||
+	    (pb_word(hdr + 4 * PB_HDR_VERSION) != PB_VERSION) ||
+	    (pb_word(hdr + 4 * PB_HDR_SIZE) != len)) {
+		return PAPI_EINVAL;
+	}
+
+	num_records = pb_word(hdr + 4 * PB_HDR_NUM_RECORDS);
+	num_sections = pb_word(hdr + 4 * PB_HDR_NUM_SECTIONS);
+	num_terms = pb_word(hdr + 4 * PB_HDR_NUM_TERMS);
+	strings_len = pb_word(hdr + 4 * PB_HDR_STRINGS_LEN);
+	records = pb_word(hdr + 4 * PB_HDR_RECORDS);
+	sections = pb_word(hdr + 4 * PB_HDR_SECTIONS);
+	terms = pb_word(hdr + 4 * PB_HDR_TERMS);
+	strings = pb_word(hdr + 4 * PB_HDR_STRINGS);
+
+	if ((records + 4ULL * PB_REC_WORDS * num_records > len) ||
+	    (sections + 4ULL * PB_SEC_WORDS * num_sections > len) ||
+	    (terms + 4ULL * num_terms > len) ||
+	    (strings + strings_len > len) ||
+	    ((strings_len > 0) && (table[strings + strings_len - 1] != '\0'))) {
+		return PAPI_EINVAL;
+	}
+
+#define BIN_STR_OK(off) (((off) == PB_NONE) || ((off) < strings_len))
+	for (i = 0; i < num_records; i++) {
+		rec = table + records + 4 * PB_REC_WORDS * i;
+		switch (pb_word(rec + 4 * PB_REC_TYPE)) {
+		case PB_HEADER:
+			if (!BIN_STR_OK(pb_word(rec + 4 * PB_REC_KIND)) ||
+			    !BIN_STR_OK(pb_word(rec + 4 * PB_REC_NAME))) {
+				return PAPI_EINVAL;
+			}
+			break;
+		case PB_EVENT:
+			for (j = 0; j < sizeof(event_strs) / sizeof(event_strs[0]); j++) {
+				if (!BIN_STR_OK(pb_word(rec + 4 * event_strs[j]))) {
+					return PAPI_EINVAL;
+				}
+			}
+			if ((pb_word(rec + 4 * PB_REC_NUM_TERMS) > PB_MAX_TERMS) ||
+			    ((uint64_t)pb_word(rec + 4 * PB_REC_FIRST_TERM) +
+			     pb_word(rec + 4 * PB_REC_NUM_TERMS) > num_terms)) {
+				return PAPI_EINVAL;
+			}
+			break;
+		default:
+			return PAPI_EINVAL;
+		}
+	}
+	for (i = 0; i < num_terms; i++) {
+		if (pb_word(table + terms + 4 * i) >= strings_len) {
+			return PAPI_EINVAL;
+		}
+	}
+	for (i = 0; i < num_sections; i++) {
+		rec = table + sections + 4 * PB_SEC_WORDS * i;
+		if ((pb_word(rec + 4 * PB_SEC_KEY) >= strings_len) ||
+		    (pb_word(rec + 4 * PB_SEC_FIRST) >= num_records)) {
+			return PAPI_EINVAL;
+		}
+	}
+#undef BIN_STR_OK
+
+	return PAPI_OK;
+}
+
+/* The first record of the CPU lines for pmu_name, PB_NONE if none */
+static uint32_t
+find_bin_section( const unsigned char *table, const char *pmu_name )
+{
+	const unsigned char *hdr = table + PB_MAGIC_LEN, *sec;
+	char key[PAPI_MIN_STR_LEN + 8], *p;
+	uint32_t lo = 0, hi = pb_word(hdr + 4 * PB_HDR_NUM_SECTIONS), mid;
+	int cmp;
+
+	snprintf(key, sizeof(key), "cpu,%s", pmu_name);
+	for (p = key; *p; p++)
+		*p = tolower(*p);
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		sec = table + pb_word(hdr + 4 * PB_HDR_SECTIONS) + 4 * PB_SEC_WORDS * mid;
+		cmp = strcmp(key, bin_str(table, pb_word(sec + 4 * PB_SEC_KEY)));
+		if (cmp == 0)
+			return pb_word(sec + 4 * PB_SEC_FIRST);
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return PB_NONE;
+}
+
+/* Load the presets of pmu_name from a checked compiled event table. */
+/* The records are the lines of the csv file, already split, so this */
+/* is the loop of papi_load_derived_events without the parsing.      */
+static int
+load_bin_events( const unsigned char *table, const char *pmu_name, int pmu_type, const preset_dest_t *dest )
+{
+	const unsigned char *hdr = table + PB_MAGIC_LEN, *rec, *terms;
+	const char *kind, *str;
+	uint32_t num_records, r, i;
+	preset_def_t def;
+	int line_no;
+	int get_events = 0;
+	int found_events = 0;
+	int breakAfter = 0;
+
+	num_records = pb_word(hdr + 4 * PB_HDR_NUM_RECORDS);
+	terms = table + pb_word(hdr + 4 * PB_HDR_TERMS);
+
+	r = find_bin_section(table, pmu_name);
+	if (r == PB_NONE) {
+		SUBDBG("EXIT: No presets for %s in %s.\n", pmu_name, dest->name);
+		return PAPI_OK;
+	}
+
+	for (; r < num_records; r++) {
+		rec = table + pb_word(hdr + 4 * PB_HDR_RECORDS) + 4 * PB_REC_WORDS * r;
+		line_no = (int)pb_word(rec + 4 * PB_REC_LINE);
+
+		if (pb_word(rec + 4 * PB_REC_TYPE) == PB_HEADER) {
+			kind = bin_str(table, pb_word(rec + 4 * PB_REC_KIND));
+			if ((kind == NULL) || (strcasecmp(kind, "CPU") != 0)) {
+				if (breakAfter)
+					break;
+				continue;
+			}
+
+			if (get_events != 0 && found_events != 0) {
+				SUBDBG( "Ending event scanning at line %d of %s.\n", line_no, dest->name);
+				get_events = 0;
+				found_events = 0;
+			}
+
+			if ((str = bin_str(table, pb_word(rec + 4 * PB_REC_NAME))) == NULL) {
+				PAPIERROR("Expected name after CPU token at line %d of %s -- ignoring", line_no, dest->name);
+				continue;
+			}
+			if (strcasecmp(str, pmu_name) != 0)
+				continue;
+
+			breakAfter = 1;
+			switch (pb_word(rec + 4 * PB_REC_QUAL)) {
+			case PB_QUAL_NONE:
+				get_events = 1;
+				break;
+			case PB_QUAL_NUMBER:
+				if ((int)pb_word(rec + 4 * PB_REC_QUAL_VALUE) == pmu_type)
+					get_events = 1;
+				break;
+			}
+			continue;
+		}
+
+		if (get_events == 0)
+			continue;
+		found_events = 1;
+
+		def.symbol = bin_str(table, pb_word(rec + 4 * PB_REC_SYMBOL));
+		def.derived = bin_str(table, pb_word(rec + 4 * PB_REC_DERIVED));
+		def.postfix = bin_str(table, pb_word(rec + 4 * PB_REC_POSTFIX));
+		def.count = (int)pb_word(rec + 4 * PB_REC_NUM_TERMS);
+		for (i = 0; i < (uint32_t)def.count; i++) {
+			def.terms[i] = bin_str(table, pb_word(terms +
+				4 * (pb_word(rec + 4 * PB_REC_FIRST_TERM) + i)));
+		}
+		def.short_descr = bin_str(table, pb_word(rec + 4 * PB_REC_SHORT_DESCR));
+		def.long_descr = bin_str(table, pb_word(rec + 4 * PB_REC_LONG_DESCR));
+		def.note = bin_str(table, pb_word(rec + 4 * PB_REC_NOTE));
+
+		add_derived_event(&def, line_no, dest);
+	}
+
+	SUBDBG("EXIT: Done processing %s.\n", dest->name);
+	return PAPI_OK;
+}
+
+/* Load the presets from the compiled event table in file path. */
+/* Returns PAPI_ESYS if it cannot be read, PAPI_EINVAL if it is  */
+/* not a valid table; then nothing has been loaded.              */
+static int
+load_bin_file( char *path, const char *pmu_name, int pmu_type, preset_dest_t *dest )
+{
+	struct stat st;
+	void *table;
+	int fd, retval;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return PAPI_ESYS;
+	}
+	if ((fstat(fd, &st) < 0) || (st.st_size <= 0)) {
+		close(fd);
+		return PAPI_ESYS;
+	}
+	table = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED) {
+		return PAPI_ESYS;
+	}
+
+	retval = check_bin_table(table, st.st_size);
+	if (retval == PAPI_OK) {
+		dest->name = path;
+		retval = load_bin_events(table, pmu_name, pmu_type, dest);
+	}
+
+	munmap(table, st.st_size);
+	return retval;
+}
 
-	INTDBG("EXIT: postfix: %s, size: %zu\n", postfix, strlen(postfix));
-	return (postfix);
-} // end infix_to_postfix
 
 /*
  * This function will load event definitions from either a file or an in memory table.  It is used to load both preset events
@@ -944,9 +1499,10 @@ infix_to_postfix( char *infix ) {
  *      If the 'process events' flag is not set, the line is ignored and we get the next input line.
  *      If the 'process events' flag is set, the event is processed and the event information is put into the next slot in the results array.
  *
- * There are three possible sources of input for preset event definitions.  The code will first look for the environment variable
+ * There are four possible sources of input for preset event definitions.  The code will first look for the environment variable
  * "PAPI_CSV_EVENT_FILE".  If found its value will be used as the pathname of where to get the preset information.  If not found,
- * the code will look for a built in table containing preset events.  If the built in table was not created during the build of
+ * the environment variable "PAPI_BIN_EVENT_FILE" can name a file written by papi_events_compile, which is mapped and used as is.
+ * Otherwise the code will look for a built in table containing preset events, the compiled one if there is.  If the built in table was not created during the build of
  * PAPI then the code will build a pathname of the form "PAPI_DATADIR/PAPI_EVENT_FILE".  Each of these are build variables, the
  * PAPI_DATADIR variable can be given a value during the configure of PAPI at build time, and the PAPI_EVENT_FILE variable has a
  * hard coded value of "papi_events.csv".
@@ -975,57 +1531,80 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 	char name[PATH_MAX] = "builtin papi_events_table";
 	char *event_file_path=NULL;
 	char *event_table_ptr=NULL;
-	int event_type_bits = 0;
 	char *tmpn;
 	char *tok_save_ptr=NULL;
 	FILE *event_file = NULL;
-	hwi_presets_t *results=NULL;
-	int result_size = 0;
-	int *event_count = NULL;
-	int invalid_event;
+	preset_dest_t dest;
+	preset_def_t def;
 	int line_no = 0;  /* count of lines read from event definition input */
-	int derived = 0;
-	int res_idx = 0;  /* index into results array for where to store next event */
-	int preset = 0;
 	int get_events = 0; /* only process derived events after CPU type they apply to is identified      */
 	int found_events = 0; /* flag to track if event definitions (PRESETS) are found since last CPU declaration */
     int breakAfter = 0; /* flag to break parsing events file if component 'arch' has already been parsed */
 	char path[PATH_MAX];
 
+	/* copy the pmu identifier, stripping commas if found */
+	tmpn = pmu_name;
+	while (*pmu_str) {
+		if (*pmu_str != ',')
+			*tmpn++ = *pmu_str;
+		pmu_str++;
+	}
+	*tmpn = '\0';
+
+	dest.name = name;
+	dest.cidx = cidx;
+	dest.preset_flag = preset_flag;
 
 	if (preset_flag) {
+		dest.event_type_bits = PAPI_PRESET_MASK;
+		dest.results = &_papi_hwi_presets[0];
+		dest.result_size = PAPI_MAX_PRESET_EVENTS;
+		dest.event_count = &_papi_hwd[cidx]->cmp_info.num_preset_events;
+
 		/* try the environment variable first */
 		if ((tmpn = getenv("PAPI_CSV_EVENT_FILE")) && (strlen(tmpn) > 0)) {
 			event_file_path = tmpn;
 		}
-		/* if no valid environment variable, look for built-in table */
-		else if (papi_events_table) {
-			event_table_ptr = papi_events_table;
-		}
-		/* if no env var and no built-in, search for default file */
+		/* then a compiled table, from a file or built in */
 		else {
+			if ((tmpn = getenv("PAPI_BIN_EVENT_FILE")) && (strlen(tmpn) > 0)) {
+				if (load_bin_file(tmpn, pmu_name, pmu_type, &dest) == PAPI_OK) {
+					return PAPI_OK;
+				}
+				PAPIERROR("Cannot use the compiled event table %s -- ignoring", tmpn);
+				dest.name = name;
+			}
+#if defined(STATIC_PAPI_EVENTS_TABLE)
+			if (check_bin_table(papi_events_bin, sizeof(papi_events_bin)) == PAPI_OK) {
+				dest.name = "builtin papi_events_bin";
+				return load_bin_events(papi_events_bin, pmu_name, pmu_type, &dest);
+			}
+#endif
+			/* if no valid environment variable, look for built-in table */
+			if (papi_events_table) {
+				event_table_ptr = papi_events_table;
+			}
+			/* if no env var and no built-in, search for default file */
+			else {
 #ifdef PAPI_DATADIR
-			sprintf( path, "%s/%s", PAPI_DATADIR, PAPI_EVENT_FILE );
+				sprintf( path, "%s/%s", PAPI_DATADIR, PAPI_EVENT_FILE );
 #else
-			sprintf( path, "%s", PAPI_EVENT_FILE );
+				sprintf( path, "%s", PAPI_EVENT_FILE );
 #endif
 
-			event_file_path = path;
+				event_file_path = path;
+			}
 		}
-		event_type_bits = PAPI_PRESET_MASK;
-		results = &_papi_hwi_presets[0];
-		result_size = PAPI_MAX_PRESET_EVENTS;
-		event_count = &_papi_hwd[cidx]->cmp_info.num_preset_events;
 	} else {
 		if ((event_file_path = getenv( "PAPI_USER_EVENTS_FILE" )) == NULL ) {
 			SUBDBG("EXIT: User event definition file not provided.\n");
 			return PAPI_OK;
 		}
 
-		event_type_bits = PAPI_UE_MASK;
-		results = &user_defined_events[0];
-		result_size = PAPI_MAX_USER_EVENTS;
-		event_count = &user_defined_events_count;
+		dest.event_type_bits = PAPI_UE_MASK;
+		dest.results = &user_defined_events[0];
+		dest.result_size = PAPI_MAX_USER_EVENTS;
+		dest.event_count = &user_defined_events_count;
 	}
 
 	// if we have an event file pathname, open it and read event definitions from the file
@@ -1043,24 +1622,14 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 		return PAPI_ESYS;
 	}
 
-	/* copy the pmu identifier, stripping commas if found */
-	tmpn = pmu_name;
-	while (*pmu_str) {
-		if (*pmu_str != ',')
-			*tmpn++ = *pmu_str;
-		pmu_str++;
-	}
-	*tmpn = '\0';
-
 	/* at this point we have either a valid file pointer or built-in table pointer */
 	while (get_event_line(line, event_file, &event_table_ptr)) {
 		char *t;
-		int i;
 
 		// increment number of lines we have read
 		line_no++;
 
-		t = trim_string(strtok_r(line, ",", &tok_save_ptr));
+		t = _papi_preset_trim_string(strtok_r(line, ",", &tok_save_ptr));
 
 		/* Skip blank lines */
 		if ((t == NULL) || (strlen(t) == 0))
@@ -1078,7 +1647,7 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 				found_events = 0;
 			}
 
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+			t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 			if ((t == NULL) || (strlen(t) == 0)) {
 				PAPIERROR("Expected name after CPU token at line %d of %s -- ignoring", line_no, name);
 				continue;
@@ -1091,7 +1660,7 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 
 				SUBDBG( "Process events for PMU %s found at line %d of %s.\n", t, line_no, name);
 
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+				t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 				if ((t == NULL) || (strlen(t) == 0)) {
 					SUBDBG("No additional qualifier found, matching on string.\n");
 					get_events = 1;
@@ -1109,204 +1678,8 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 				continue;
 
 			found_events = 1;
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-
-			if ((t == NULL) || (strlen(t) == 0)) {
-				PAPIERROR("Expected name after PRESET token at line %d of %s -- ignoring", line_no, name);
-				continue;
-			}
-
-			SUBDBG( "Examining event %s\n", t);
-
-			// see if this event already exists in the results array, if not already known it sets up event in unused entry
-			if ((res_idx = find_event_index (results, result_size, t)) < 0) {
-				PAPIERROR("No room left for event %s -- ignoring", t);
-				continue;
-			}
-
-			// add the proper event bits (preset or user defined bits)
-			preset = res_idx | event_type_bits;
-			(void) preset;
-
-			SUBDBG( "Use event code: %#x for %s\n", preset, t);
-	        _papi_hwi_presets[res_idx].component_index = cidx;
-
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-			if ((t == NULL) || (strlen(t) == 0)) {
-				// got an error, make this entry unused
-                if (results[res_idx].symbol != NULL){
-                    papi_free (results[res_idx].symbol);
-                    results[res_idx].symbol = NULL;
-                }
-				PAPIERROR("Expected derived type after PRESET token at line %d of %s -- ignoring", line_no, name);
-				continue;
-			}
-
-			if (_papi_hwi_derived_type(t, &derived) != PAPI_OK) {
-				// got an error, make this entry unused
-                if (results[res_idx].symbol != NULL){
-                    papi_free (results[res_idx].symbol);
-                    results[res_idx].symbol = NULL;
-                }
-				PAPIERROR("Invalid derived name %s after PRESET token at line %d of %s -- ignoring", t, line_no, name);
-				continue;
-			}
-
-			/****************************************/
-			/* Have an event, let's start assigning */
-			/****************************************/
-
-			SUBDBG( "Adding event: %s, code: %#x, derived: %d results[%d]: %p.\n", t, preset, derived, res_idx, &results[res_idx]);
-
-			/* results[res_idx].event_code = preset; */
-			results[res_idx].derived_int = derived;
-
-			/* Derived support starts here */
-			/* Special handling for postfix and infix */
-			if ((derived == DERIVED_POSTFIX)  || (derived == DERIVED_INFIX)) {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-				if ((t == NULL) || (strlen(t) == 0)) {
-					// got an error, make this entry unused
-                    if (results[res_idx].symbol != NULL){
-                        papi_free (results[res_idx].symbol);
-                        results[res_idx].symbol = NULL;
-                    }
-					PAPIERROR("Expected Operation string after derived type DERIVED_POSTFIX or DERIVED_INFIX at line %d of %s -- ignoring", line_no, name);
-					continue;
-				}
-
-				// if it is an algebraic formula, we need to convert it to postfix
-				if (derived == DERIVED_INFIX) {
-					SUBDBG( "Converting InFix operations %s\n", t);
-					t = infix_to_postfix( t );
-					results[res_idx].derived_int = DERIVED_POSTFIX;
-				}
-
-				SUBDBG( "Saving PostFix operations %s\n", t);
-				results[res_idx].postfix = papi_strdup(t);
-			}
-
-			/* All derived terms collected here */
-			i = 0;
-			invalid_event = 0;
-			results[res_idx].count = 0;
-			do {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-				if ((t == NULL) || (strlen(t) == 0))
-					break;
-				if (strcasecmp(t, "NOTE") == 0)
-					break;
-				if (strcasecmp(t, "LDESC") == 0)
-					break;
-				if (strcasecmp(t, "SDESC") == 0)
-					break;
-
-				SUBDBG( "Adding term (%d) %s to derived event %#x, current native event count: %d.\n", i, t, preset, results[res_idx].count);
-
-				// show that we do not have an event code yet (the component may create one and update this info)
-				// this also clears any values left over from a previous call
-				_papi_hwi_set_papi_event_code(-1, -1);
-
-				// make sure that this term in the derived event is a valid event name
-				// this call replaces preset and user event names with the equivalent native events in our results table
-				// it also updates formulas for derived events so that they refer to the correct native event index
-				if (is_event(t, results[res_idx].derived_int, &results[res_idx], i) == 0) {
-					invalid_event = 1;
-					PAPIERROR("Missing event %s, used in derived event %s", t, results[res_idx].symbol);
-					break;
-				}
-
-                /* If it is a valid event, then update the preset fields here. */
-                /* Initially, the event name should be those with a default, mandatory qualifiers. */
-                results[res_idx].name[results[res_idx].count]         = strdup(t);
-                results[res_idx].base_name[results[res_idx].count]    = strdup(t);
-                results[res_idx].default_name[results[res_idx].count] = strdup(t);
-                results[res_idx].default_code[results[res_idx].count] = results[res_idx].code[results[res_idx].count];
-                results[res_idx].count++;
-
-				i++;
-			} while (results[res_idx].count < PAPI_EVENTS_IN_DERIVED_EVENT);
-
-			/* preset code list must be PAPI_NULL terminated */
-			if (i < PAPI_EVENTS_IN_DERIVED_EVENT) {
-				results[res_idx].code[results[res_idx].count] = PAPI_NULL;
-			}
-
-			if (invalid_event) {
-				// got an error, make this entry unused
-			        // preset table is statically allocated, user defined is dynamic
-                unsigned int j;
-                for (j = 0; j < results[res_idx].count; j++){
-                    if (results[res_idx].name[j] != NULL){
-                        papi_free( results[res_idx].name[j] );
-                        results[res_idx].name[j] = NULL;
-                    }
-                }
-
-                if (!preset_flag){
-                    if(results[res_idx].symbol != NULL){
-                        papi_free (results[res_idx].symbol);
-                        results[res_idx].symbol = NULL;
-                    }
-                }
-
-				continue;
-			}
-
-			/* End of derived support */
-
-			// if we did not find any terms to base this derived event on, report error
-			if (i == 0) {
-				// got an error, make this entry unused
-                if (!preset_flag){
-                    if(results[res_idx].symbol != NULL){
-                        papi_free (results[res_idx].symbol);
-                        results[res_idx].symbol = NULL;
-                    }
-                }
-                PAPIERROR("Expected PFM event after DERIVED token at line %d of %s -- ignoring", line_no, name);
-				continue;
-			}
-
-			if (i == PAPI_EVENTS_IN_DERIVED_EVENT) {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-			}
-
-			// if something was provided following the list of events to be used by the operation, process it
-			if ( t!= NULL  && strlen(t) > 0 ) {
-				do {
-					// save the field name
-					char *fptr = papi_strdup(t);
-
-					// get the value to be used with this field
-					t = trim_note(strtok_r(NULL, ",", &tok_save_ptr));
-					if ( t== NULL  || strlen(t) == 0 ) {
-						papi_free(fptr);
-						break;
-					}
-
-					// Handle optional short descriptions, long descriptions and notes
-					if (strcasecmp(fptr, "SDESC") == 0) {
-						results[res_idx].short_descr = papi_strdup(t);
-					}
-					if (strcasecmp(fptr, "LDESC") == 0) {
-						results[res_idx].long_descr = papi_strdup(t);
-					}
-					if (strcasecmp(fptr, "NOTE") == 0) {
-						results[res_idx].note = papi_strdup(t);
-					}
-
-					SUBDBG( "Found %s (%s) on line %d\n", fptr, t, line_no);
-					papi_free (fptr);
-
-					// look for another field name
-					t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
-					if ( t== NULL  || strlen(t) == 0 ) {
-						break;
-					}
-				} while (t != NULL);
-			}
-			(*event_count)++;
+			parse_event_line(&tok_save_ptr, &def);
+			add_derived_event(&def, line_no, &dest);
 
 			continue;
 		} else {
@@ -1331,6 +1704,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 
 	char arch_name[PAPI_MIN_STR_LEN];
 	char line[LINE_MAX];
+	char postfix[2 * PAPI_PRESET_MAX_FORMULA + 2];
 	char name[PATH_MAX] = "builtin papi_events_table";
 	char *event_file_path=NULL;
 	char *event_table_ptr=NULL;
@@ -1407,7 +1781,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 		// increment number of lines we have read
 		line_no++;
 
-		t = trim_string(strtok_r(line, ",", &tok_save_ptr));
+		t = _papi_preset_trim_string(strtok_r(line, ",", &tok_save_ptr));
 
 		/* Skip blank lines */
 		if ((t == NULL) || (strlen(t) == 0))
@@ -1425,7 +1799,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 				found_events = 0;
 			}
 
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+			t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 			if ((t == NULL) || (strlen(t) == 0)) {
 				PAPIERROR("Expected name after component-name token at line %d of %s -- ignoring", line_no, name);
 				continue;
@@ -1437,7 +1811,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 
 				SUBDBG( "Process events for ARCH %s found at line %d of %s.\n", t, line_no, name);
 
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+				t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 				if ((t == NULL) || (strlen(t) == 0)) {
 					SUBDBG("No additional qualifier found, matching on string.\n");
 					get_events = 1;
@@ -1450,7 +1824,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 				continue;
 
 			found_events = 1;
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+			t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 
 			if ((t == NULL) || (strlen(t) == 0)) {
 				PAPIERROR("Expected name after PRESET token at line %d of %s -- ignoring", line_no, name);
@@ -1473,7 +1847,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 			SUBDBG( "Use event code: %#x for %s\n", preset, t);
 	        _papi_hwi_comp_presets[cidx][res_idx].component_index = cidx;
 
-			t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+			t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 			if ((t == NULL) || (strlen(t) == 0)) {
 				// got an error, make this entry unused
                 if (results[res_idx].symbol != NULL){
@@ -1505,7 +1879,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 			/* Derived support starts here */
 			/* Special handling for postfix and infix */
 			if ((derived == DERIVED_POSTFIX)  || (derived == DERIVED_INFIX)) {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+				t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 				if ((t == NULL) || (strlen(t) == 0)) {
 					// got an error, make this entry unused
                     if (results[res_idx].symbol != NULL){
@@ -1519,7 +1893,15 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 				// if it is an algebraic formula, we need to convert it to postfix
 				if (derived == DERIVED_INFIX) {
 					SUBDBG( "Converting InFix operations %s\n", t);
-					t = infix_to_postfix( t );
+					t = _papi_preset_infix_to_postfix( t, postfix, sizeof(postfix) );
+					if (t == NULL) {
+						if (results[res_idx].symbol != NULL){
+							papi_free (results[res_idx].symbol);
+							results[res_idx].symbol = NULL;
+						}
+						PAPIERROR("Infix formula longer than %d characters at line %d of %s -- ignoring", PAPI_PRESET_MAX_FORMULA, line_no, name);
+						continue;
+					}
 					results[res_idx].derived_int = DERIVED_POSTFIX;
 				}
 
@@ -1533,7 +1915,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 			results[res_idx].count = 0;
             int firstTerm = 1;
 			do {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+				t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 				if ((t == NULL) || (strlen(t) == 0))
 					break;
 				if (strcasecmp(t, "NOTE") == 0)
@@ -1545,10 +1927,6 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 
 				SUBDBG( "Adding term (%d) %s to derived event %#x, current native event count: %d.\n", i, t, preset, results[res_idx].count);
 
-				// show that we do not have an event code yet (the component may create one and update this info)
-				// this also clears any values left over from a previous call
-				_papi_hwi_set_papi_event_code(-1, -1);
-
                 int eventCode;
                 char *tmpEvent, *tmpQuals;
                 char *qualDelim = ":";
@@ -1742,7 +2120,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 			}
 
 			if (i == PAPI_EVENTS_IN_DERIVED_EVENT) {
-				t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+				t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 			}
 
 			// if something was provided following the list of events to be used by the operation, process it
@@ -1752,7 +2130,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 					char *fptr = papi_strdup(t);
 
 					// get the value to be used with this field
-					t = trim_note(strtok_r(NULL, ",", &tok_save_ptr));
+					t = _papi_preset_trim_note(strtok_r(NULL, ",", &tok_save_ptr));
 					if ( t== NULL  || strlen(t) == 0 ) {
 						papi_free(fptr);
 						break;
@@ -1773,7 +2151,7 @@ papi_load_derived_events_component (char *comp_str, char *arch_str, int cidx) {
 					papi_free (fptr);
 
 					// look for another field name
-					t = trim_string(strtok_r(NULL, ",", &tok_save_ptr));
+					t = _papi_preset_trim_string(strtok_r(NULL, ",", &tok_save_ptr));
 					if ( t== NULL  || strlen(t) == 0 ) {
 						break;
 					}
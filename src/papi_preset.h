@@ -57,6 +57,10 @@ int _papi_hwi_cleanup_all_presets( void );
 int _xml_papi_hwi_setup_all_presets( char *arch);
 int _papi_load_preset_table( char *name, int type, int cidx );
 int _papi_load_preset_table_component( char *comp_str, char *name, int cidx );
+int _papi_load_user_event_table( char *name, int type, int cidx );
+int _papi_preset_cache_key( char *key, int len );
+int _papi_preset_cache_save( int cidx );
+int _papi_preset_cache_load( int cidx );
 
 extern hwi_presets_t _papi_hwi_presets[PAPI_MAX_PRESET_EVENTS];
 extern hwi_presets_t *_papi_hwi_comp_presets[];
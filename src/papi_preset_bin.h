@@ -0,0 +1,88 @@
+#ifndef PAPI_PRESET_BIN_H
+#define PAPI_PRESET_BIN_H
+
+/* Binary form of a preset event file (papi_events.csv).
+
+   papi_events_compile converts the csv file at build time.  Every line
+   that is not blank or a comment becomes a record with its fields
+   already split and trimmed, infix formulas converted to postfix, and
+   the strings kept once in a string pool.  A section index gives the
+   first record of each CPU (or component) name, so loading the presets
+   of a PMU starts at its records instead of scanning the whole file.
+
+   All values are 32 bit little endian words, strings are offsets into
+   the string pool.  The file starts with an 8 byte magic followed by
+   PB_HDR_WORDS header words; records, sections and terms are arrays
+   of words at the offsets given in the header. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PB_MAGIC            "PAPIPST"     /* 8 bytes with the NUL */
+#define PB_MAGIC_LEN        8
+#define PB_VERSION          1
+#define PB_NONE             0xffffffffu   /* no string */
+
+/* terms of an event, must be PAPI_EVENTS_IN_DERIVED_EVENT */
+#define PB_MAX_TERMS        12
+
+/* header words, after the magic */
+#define PB_HDR_VERSION      0
+#define PB_HDR_SIZE         1   /* of the whole file */
+#define PB_HDR_NUM_RECORDS  2
+#define PB_HDR_RECORDS      3   /* offset from the start of the file */
+#define PB_HDR_NUM_SECTIONS 4
+#define PB_HDR_SECTIONS     5
+#define PB_HDR_NUM_TERMS    6
+#define PB_HDR_TERMS        7
+#define PB_HDR_STRINGS_LEN  8
+#define PB_HDR_STRINGS      9
+#define PB_HDR_WORDS        10
+
+/* record words */
+#define PB_REC_WORDS        10
+#define PB_REC_TYPE         0   /* PB_HEADER or PB_EVENT */
+#define PB_REC_LINE         1   /* line in the csv file */
+
+#define PB_HEADER           1   /* CPU,<name>[,<qualifier>] or <component>,<arch> */
+#define PB_REC_KIND         2   /* CPU or the component name */
+#define PB_REC_NAME         3
+#define PB_REC_QUAL         4   /* PB_QUAL_* */
+#define PB_REC_QUAL_VALUE   5   /* qualifier, if PB_QUAL_NUMBER */
+
+#define PB_QUAL_NONE        0
+#define PB_QUAL_NUMBER      1
+#define PB_QUAL_OTHER       2
+
+#define PB_EVENT            2   /* PRESET or EVENT line */
+#define PB_REC_SYMBOL       2
+#define PB_REC_DERIVED      3   /* derived type name, infix is converted */
+#define PB_REC_POSTFIX      4
+#define PB_REC_FIRST_TERM   5   /* index into the terms */
+#define PB_REC_NUM_TERMS    6
+#define PB_REC_SHORT_DESCR  7
+#define PB_REC_LONG_DESCR   8
+#define PB_REC_NOTE         9
+
+/* section words, sorted by key: "<kind>,<name>" in lower case */
+#define PB_SEC_WORDS        2
+#define PB_SEC_KEY          0
+#define PB_SEC_FIRST        1   /* first record with that kind and name */
+
+static inline uint32_t
+pb_word( const unsigned char *p )
+{
+	return ( uint32_t ) p[0] | ( uint32_t ) p[1] << 8 |
+		( uint32_t ) p[2] << 16 | ( uint32_t ) p[3] << 24;
+}
+
+static inline void
+pb_put_word( unsigned char *p, uint32_t w )
+{
+	p[0] = ( unsigned char ) w;
+	p[1] = ( unsigned char ) ( w >> 8 );
+	p[2] = ( unsigned char ) ( w >> 16 );
+	p[3] = ( unsigned char ) ( w >> 24 );
+}
+
+#endif /* PAPI_PRESET_BIN_H */
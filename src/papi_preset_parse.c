@@ -0,0 +1,135 @@
+/*
+* File:    papi_preset_parse.c
+*
+* Field parsing of preset event files, see papi_preset_parse.h.
+*/
+
+#include <string.h>
+#include <ctype.h>
+
+#include "papi_preset_parse.h"
+
+char *
+_papi_preset_trim_string( char *in )
+{
+	char *end;
+
+	if ( in == NULL )
+		return NULL;
+	while ( isblank( ( unsigned char ) *in ) )
+		in++;
+	end = in + strlen( in );
+	while ( end > in && isblank( ( unsigned char ) end[-1] ) )
+		*--end = '\0';
+	return in;
+}
+
+char *
+_papi_preset_trim_note( char *in )
+{
+	char *note = _papi_preset_trim_string( in );
+	size_t len;
+	char start, end;
+
+	if ( note == NULL || ( len = strlen( note ) ) == 0 ||
+		 !ispunct( ( unsigned char ) *note ) )
+		return note;
+	start = *note;
+	end = note[len - 1];
+	if ( ( start == end ) || ( ( start == '(' ) && ( end == ')' ) )
+		 || ( ( start == '<' ) && ( end == '>' ) )
+		 || ( ( start == '{' ) && ( end == '}' ) )
+		 || ( ( start == '[' ) && ( end == ']' ) ) ) {
+		note[len - 1] = '\0';
+		note++;
+	}
+	return note;
+}
+
+/* operators of higher priority are written out first */
+static int
+priority( char symbol )
+{
+	switch ( symbol ) {
+	case '@':
+		return -1;
+	case '(':
+		return 0;
+	case '+':
+	case '-':
+		return 1;
+	case '*':
+	case '/':
+	case '%':
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+char *
+_papi_preset_infix_to_postfix( const char *infix, char *postfix, size_t size )
+{
+	char stack[PAPI_PRESET_MAX_FORMULA + 1];
+	size_t i, n, len = 0;
+	int stacktop = 0;
+	char token;
+
+	n = strlen( infix );
+	if ( n > PAPI_PRESET_MAX_FORMULA )
+		return NULL;
+
+	stack[0] = '#';
+
+	/* every step writes at most 2 characters, plus the final NUL */
+#define ROOM() if ( len + 3 > size ) return NULL
+#define SEPARATE() if ( len > 0 && postfix[len - 1] != '|' ) postfix[len++] = '|'
+	for ( i = 0; i < n; i++ ) {
+		token = infix[i];
+		ROOM(  );
+		switch ( token ) {
+		case '(':
+			stack[++stacktop] = token;
+			break;
+		case ')':
+			SEPARATE(  );
+			while ( stacktop > 0 && stack[stacktop] != '(' ) {
+				ROOM(  );
+				postfix[len++] = stack[stacktop--];
+				postfix[len++] = '|';
+			}
+			if ( stacktop > 0 )
+				stacktop--;
+			break;
+		case '+':
+		case '-':
+		case '*':
+		case '/':
+		case '%':
+		case '^':
+			SEPARATE(  );
+			while ( priority( stack[stacktop] ) > priority( token ) ) {
+				ROOM(  );
+				postfix[len++] = stack[stacktop--];
+				postfix[len++] = '|';
+			}
+			stack[++stacktop] = token;
+			break;
+		default:
+			postfix[len++] = token;
+			break;
+		}
+	}
+	ROOM(  );
+	SEPARATE(  );
+	while ( stacktop > 0 ) {
+		ROOM(  );
+		postfix[len++] = stack[stacktop--];
+		postfix[len++] = '|';
+	}
+#undef SEPARATE
+#undef ROOM
+	postfix[len] = '\0';
+
+	return postfix;
+}
@@ -0,0 +1,33 @@
+#ifndef PAPI_PRESET_PARSE_H
+#define PAPI_PRESET_PARSE_H
+
+/* Field parsing shared by papi_preset.c, which reads preset and user
+   event files at run time, and papi_events_compile, which compiles
+   papi_events.csv at build time.  Built into both, so it only uses
+   the C library. */
+
+#include <stddef.h>
+
+/* longest DERIVED_INFIX formula, the postfix form needs twice that */
+#define PAPI_PRESET_MAX_FORMULA 1024
+
+/** Trim blank space from both ends of a string, in place.
+    Returns the new start, NULL for NULL.
+    @internal */
+char *_papi_preset_trim_string( char *in );
+
+/** _papi_preset_trim_string, then remove a pair of punctuation
+    delimiters from the ends: the same character at both ends (quotes,
+    slashes) or one of () <> {} [].
+    @internal */
+char *_papi_preset_trim_note( char *in );
+
+/** Convert an algebraic (DERIVED_INFIX) formula to the '|' separated
+    DERIVED_POSTFIX form, in postfix of size bytes.  Returns postfix,
+    or NULL if the formula is longer than PAPI_PRESET_MAX_FORMULA or
+    the result does not fit.
+    @internal */
+char *_papi_preset_infix_to_postfix( const char *infix, char *postfix,
+									 size_t size );
+
+#endif /* PAPI_PRESET_PARSE_H */
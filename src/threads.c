@@ -287,18 +287,21 @@ _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid )
 		return PAPI_ENOMEM;
 	}
 
-   /* init event memory variables, used by papi_internal.c  */
-   thread->tls_papi_event_code = -1;
-   thread->tls_papi_event_code_changed = -1;
+	/* Call the component to fill in anything special.  Deferred
+	   components get init_thread when they are initialized, the
+	   lock keeps that from missing this thread. */
 
-	/* Call the component to fill in anything special. */
+	_papi_hwi_lock( CMP_INIT_LOCK );
 
 	for ( i = 0; i < papi_num_components; i++ ) {
 	    if (_papi_hwd[i]->cmp_info.disabled &&
             _papi_hwd[i]->cmp_info.disabled != PAPI_EDELAY_INIT)
             continue;
+	    if ( _papi_hwi_cmp_deferred( i ) )
+	       continue;
 	    retval = _papi_hwd[i]->init_thread( thread->context[i] );
 	    if ( retval ) {
+	       _papi_hwi_unlock( CMP_INIT_LOCK );
 	       free_thread( &thread );
 	       *dest = NULL;
 	       return retval;
@@ -307,10 +310,37 @@ _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid )
 
 	insert_thread( thread, tid );
 
+	_papi_hwi_unlock( CMP_INIT_LOCK );
+
 	*dest = thread;
 	return PAPI_OK;
 }
 
+/* Call init_thread of a component that was just initialized for
+   every thread that already exists.  Called with CMP_INIT_LOCK held,
+   see _papi_hwi_init_deferred_cmp. */
+int
+_papi_hwi_init_cmp_threads( int cidx )
+{
+	ThreadInfo_t *foo;
+	int retval = PAPI_OK;
+
+	_papi_hwi_lock( THREADS_LOCK );
+
+	for ( foo = ( ThreadInfo_t * ) _papi_hwi_thread_head; foo != NULL;
+	      foo = foo->next ) {
+		retval = _papi_hwd[cidx]->init_thread( foo->context[cidx] );
+		if ( retval != PAPI_OK )
+			break;
+		if ( foo->next == _papi_hwi_thread_head )
+			break;
+	}
+
+	_papi_hwi_unlock( THREADS_LOCK );
+
+	return retval;
+}
+
 #if defined(ANY_THREAD_GETS_SIGNAL)
 
 /* This is ONLY defined for systems that enable ANY_THREAD_GETS_SIGNAL
@@ -392,25 +422,20 @@ static int _papi_hwi_thread_free_eventsets(long tid) {
 
    EventSetInfo_t *ESI;
    ThreadInfo_t *master;
-   DynamicArray_t *map = &_papi_hwi_system_info.global_eventset_map;
    int i;
 
    master = _papi_hwi_lookup_thread( tid );
 
    _papi_hwi_lock( INTERNAL_LOCK );
 
-   for( i = 0; i < map->totalSlots; i++ ) {
-      ESI = map->dataSlotArray[i];
+   for( i = 0; i < _papi_hwi_system_info.global_eventset_map.totalSlots; i++ ) {
+      ESI = _papi_hwi_EventSet_in_slot( i );
       if ( ( ESI ) && (ESI->master!=NULL) ) {
 
 	 if ( ESI->master == master ) {
 	    THRDBG("Attempting to remove %d from tid %ld\n",ESI->EventSetIndex,tid);
 
-	    /* Code copied from _papi_hwi_remove_EventSet(ESI);      */
-	    _papi_hwi_free_EventSet( ESI );
-	    map->dataSlotArray[i] = NULL;
-	    map->availSlots++;
-	    map->fullSlots--;
+	    _papi_hwi_release_EventSet_slot( ESI );
 	 }
       }
    }
@@ -428,10 +453,6 @@ _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force_shutdown )
 	unsigned long tid;
 	int i, failure = 0;
 
-   /* Clear event memory variables */
-   thread->tls_papi_event_code = -1;
-   thread->tls_papi_event_code_changed = -1;
-
    /* Get thread id */
 	if ( _papi_hwi_thread_id_fn )
 		tid = ( *_papi_hwi_thread_id_fn ) (  );
@@ -447,15 +468,19 @@ _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force_shutdown )
 
                 _papi_hwi_thread_free_eventsets(tid);
 
+		_papi_hwi_lock( CMP_INIT_LOCK );
 		remove_thread( thread );
 		THRDBG( "Shutting down thread %ld at %p\n", thread->tid, thread );
 		for( i = 0; i < papi_num_components; i++ ) {
 		   if (_papi_hwd[i]->cmp_info.disabled &&
                _papi_hwd[i]->cmp_info.disabled != PAPI_EDELAY_INIT)
                continue;
+		   if ( _papi_hwi_cmp_deferred( i ) )
+		      continue;
 		   retval = _papi_hwd[i]->shutdown_thread( thread->context[i]);
 		   if ( retval != PAPI_OK ) failure = retval;
 		}
+		_papi_hwi_unlock( CMP_INIT_LOCK );
 		free_thread( &thread );
 		return ( failure );
 	}
@@ -30,11 +30,6 @@ typedef struct _ThreadInfo
 	EventSetInfo_t **running_eventset;
 	EventSetInfo_t *from_esi;          /* ESI used for last update this control state */
 	int wants_signal;
-
-   // The current event code can be stored here prior to 
-   // component calls and cleared after the component returns.
-   unsigned int tls_papi_event_code;
-   int tls_papi_event_code_changed;
 } ThreadInfo_t;
 
 /** The list of threads, gets initialized to master process with TID of getpid() 
@@ -58,8 +53,14 @@ extern unsigned long int ( *_papi_hwi_thread_id_fn ) ( void );
 
 extern int ( *_papi_hwi_thread_kill_fn ) ( int, int );
 
+/** Set while components are initialized in parallel, see papi_internal.c
+ *	@internal */
+
+extern int _papi_hwi_init_in_parallel;
+
 extern int _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid );
 extern int _papi_hwi_init_global_threads( void );
+extern int _papi_hwi_init_cmp_threads( int cidx );
 extern int _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force );
 extern int _papi_hwi_shutdown_global_threads( void );
 extern int _papi_hwi_broadcast_signal( unsigned int mytid );
@@ -68,7 +69,7 @@ extern int _papi_hwi_set_thread_id_fn( unsigned long int ( *id_fn ) ( void ) );
 inline_static int
 _papi_hwi_lock( int lck )
 {
-	if ( _papi_hwi_thread_id_fn ) {
+	if ( _papi_hwi_thread_id_fn || _papi_hwi_init_in_parallel ) {
 		_papi_hwd_lock( lck );
 		THRDBG( "Lock %d\n", lck );
 	} else {
@@ -82,7 +83,7 @@ _papi_hwi_lock( int lck )
 inline_static int
 _papi_hwi_unlock( int lck )
 {
-	if ( _papi_hwi_thread_id_fn ) {
+	if ( _papi_hwi_thread_id_fn || _papi_hwi_init_in_parallel ) {
 		_papi_hwd_unlock( lck );
 		THRDBG( "Unlock %d\n", lck );
 	} else {
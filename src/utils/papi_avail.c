@@ -126,6 +126,13 @@
  *        export PAPI_CSV_EVENT_FILE=$PWD/my_preset_events.csv
  *        @endcode
  *
+ *        The build compiles papi_events.csv into a binary table with papi_events_compile, which is built into the library.
+ *        A table compiled from another file can be used without rebuilding PAPI by exporting PAPI_BIN_EVENT_FILE:
+ *        @code
+ *        papi_events_compile my_preset_events.csv my_preset_events.bin
+ *        export PAPI_BIN_EVENT_FILE=$PWD/my_preset_events.bin
+ *        @endcode
+ *
  *        To add your own user-defined event definitions, you must export PAPI_USER_EVENTS_FILE to a .csv file containing your list of event definitions.
  *        As an example:
  *        @code
@@ -9,7 +9,8 @@
   *
   *	@section Description
   *		papi_cost is a PAPI utility program that computes the min / max / mean / std. deviation
-  *		of execution times for PAPI start/stop pairs and for PAPI reads.
+  *		of execution times for PAPI start/stop pairs and for PAPI reads,
+  *		both through PAPI_read and through a handle from PAPI_bind_reader.
   *		This information provides the basic operating cost to a user's program
   *		for collecting hardware counter data.
   *		Command line options control display capabilities.
@@ -110,7 +111,8 @@ print_stats( int i, long long min, long long max, double average, double std )
 		"PAPI_accum (2 counters)",
 		"PAPI_reset (2 counters)",
 		"PAPI_read (1 derived_postfix counter)",
-		"PAPI_read (1 derived_[add|sub] counter)"
+		"PAPI_read (1 derived_[add|sub] counter)",
+		"PAPI_read_bound (2 counters)"
 	};
 
 	printf( "\nTotal cost for %s over %d iterations\n",
@@ -205,6 +207,7 @@ main( int argc, char **argv )
 	long long *array;
 	int event;
 	PAPI_event_info_t info;
+	PAPI_reader_t reader;
 	int c;
 
 	/* Check command-line arguments */
@@ -351,6 +354,33 @@ main( int argc, char **argv )
 
 	do_output( 2, array, bins, show_std_dev, show_dist, show_percent );
 
+	/* Start the bound read eval */
+	printf( "\nPerforming bound read test...\n" );
+
+	if ( ( retval = PAPI_start( EventSet ) ) != PAPI_OK ) {
+		fprintf(stderr,"PAPI_start");
+		exit(retval);
+	}
+	if ( ( retval = PAPI_bind_reader( EventSet, &reader ) ) != PAPI_OK ) {
+		fprintf(stderr,"PAPI_bind_reader");
+		exit(retval);
+	}
+	PAPI_read_bound( reader, values );
+
+	for ( i = 0; i < num_iters; i++ ) {
+		totcyc = PAPI_get_real_cyc(  );
+		PAPI_read_bound( reader, values );
+		totcyc = PAPI_get_real_cyc(  ) - totcyc;
+		array[i] = totcyc;
+	}
+	if ( ( retval = PAPI_stop( EventSet, values ) ) != PAPI_OK ) {
+		fprintf(stderr,"PAPI_stop");
+		exit(retval);
+	}
+	PAPI_unbind_reader( &reader );
+
+	do_output( 8, array, bins, show_std_dev, show_dist, show_percent );
+
 	/* Start the read with timestamp eval */
 	printf( "\nPerforming read with timestamp test...\n" );
 
@@ -0,0 +1,600 @@
+/** file papi_read_cost.c
+  * @brief papi_read_cost utility.
+  *	@page papi_read_cost
+  * @section  NAME
+  *		papi_read_cost - computes the cost of every PAPI read path across
+  *		event and thread counts.
+  *
+  *	@section Synopsis
+  *		papi_read_cost [-h] [-e events] [-m min] [-x max] [-T threads]
+  *		[-t iterations] [-p paths] [-o file]
+  *
+  *	@section Description
+  *		papi_read_cost is a PAPI utility program that times the ways an
+  *		application can read a running EventSet.  For the perf_event
+  *		component each path exercises a different read routine:
+  *		read (rdpmc when available, otherwise one FORMAT_GROUP read),
+  *		read_bound (PAPI_read_bound), read_attached (FORMAT_GROUP read of
+  *		an EventSet attached to the calling thread), read_inherit (one
+  *		read per event), read_kernel_mpx (kernel multiplexing), read_sw_mpx
+  *		(PAPI software multiplexing), read_derived (a derived preset) and
+  *		hl_region (a PAPI_hl_region_begin/end pair).
+  *		Every path is run for 1..max events and for 1, 2, 4, ... threads up
+  *		to the requested thread count; each thread reads its own EventSet.
+  *		Percentiles of the cost in cycles are printed, and with -o the
+  *		results are also written as CSV so that releases can be compared.
+  *		Paths the component or kernel cannot provide are reported as skipped.
+  *		The hl_region path writes the usual high-level report at exit,
+  *		see PAPI_OUTPUT_DIRECTORY.
+  *
+  *	@section Options
+  *	<ul>
+  *		<li>-e events	Comma separated list of events to use. By default
+  *			native events of the first component that can be counted
+  *			together are picked.
+  *		<li>-h	Display help information about this utility.
+  *		<li>-m min	Minimum number of events. The default is 1.
+  *		<li>-o file	Write CSV results to file.
+  *		<li>-p paths	Comma separated list of paths to run. The default
+  *			is all of them.
+  *		<li>-t iterations	Number of reads per thread. The default is 10,000.
+  *		<li>-T threads	Maximum number of threads. The default is the
+  *			number of online CPUs.
+  *		<li>-x max	Maximum number of events. The default is 4.
+  *	</ul>
+  *
+  *	@section Bugs
+  *		There are no known bugs in this utility. If you find a bug,
+  *		it should be reported to the PAPI Mailing List at <ptools-perfapi@icl.utk.edu>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "papi.h"
+
+#define MAX_EVENTS 64
+
+enum {
+	PATH_READ,
+	PATH_READ_BOUND,
+	PATH_ATTACHED,
+	PATH_INHERIT,
+	PATH_KERNEL_MPX,
+	PATH_SW_MPX,
+	PATH_DERIVED,
+	PATH_HL,
+	NUM_PATHS
+};
+
+static const char *path_names[NUM_PATHS] = {
+	"read",
+	"read_bound",
+	"read_attached",
+	"read_inherit",
+	"read_kernel_mpx",
+	"read_sw_mpx",
+	"read_derived",
+	"hl_region"
+};
+
+typedef struct {
+	int min;
+	int max;
+	int threads;
+	int iters;
+	int paths[NUM_PATHS];
+	FILE *csv;
+} options_t;
+
+static options_t options;
+
+static int events[MAX_EVENTS];
+static char event_names[MAX_EVENTS][PAPI_MAX_STR_LEN];
+static int num_events;
+static int derived_event = PAPI_NULL;
+
+static pthread_barrier_t barrier;
+
+typedef struct {
+	pthread_t thread;
+	int path;
+	int num_events;
+	long long *samples;
+	int retval;
+} worker_t;
+
+static void
+print_help( void )
+{
+	printf( "This is the PAPI read path cost program.\n" );
+	printf( "It times every PAPI read path for a range of event and thread counts.  Usage:\n\n" );
+	printf( "    papi_read_cost [options]\n\n" );
+	printf( "Options:\n\n" );
+	printf( "  -e EVENTS     comma separated list of events to use\n" );
+	printf( "  -h            print this help message\n" );
+	printf( "  -m MIN        minimum number of events. Default: 1\n" );
+	printf( "  -o FILE       write CSV results to FILE\n" );
+	printf( "  -p PATHS      comma separated list of paths to run. Default: all\n" );
+	printf( "                " );
+	for ( int i = 0; i < NUM_PATHS; i++ )
+		printf( "%s%s", path_names[i], i < NUM_PATHS - 1 ? " " : "\n" );
+	printf( "  -t ITERS      number of reads per thread. Default: 10,000\n" );
+	printf( "  -T THREADS    maximum number of threads. Default: online CPUs\n" );
+	printf( "  -x MAX        maximum number of events. Default: 4\n" );
+	printf( "\n" );
+}
+
+static int
+parse_paths( char *list )
+{
+	char *tok, *save = NULL;
+	int i, found;
+
+	memset( options.paths, 0, sizeof ( options.paths ) );
+
+	for ( tok = strtok_r( list, ",", &save ); tok != NULL;
+	      tok = strtok_r( NULL, ",", &save ) ) {
+		found = 0;
+		for ( i = 0; i < NUM_PATHS; i++ ) {
+			if ( strcmp( tok, path_names[i] ) == 0 ) {
+				options.paths[i] = 1;
+				found = 1;
+			}
+		}
+		if ( !found ) {
+			fprintf( stderr, "Unknown path %s\n", tok );
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Add the named events; all of them must be countable together */
+static int
+use_named_events( char *list )
+{
+	char *tok, *save = NULL;
+	int EventSet = PAPI_NULL, retval;
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	for ( tok = strtok_r( list, ",", &save );
+	      ( tok != NULL ) && ( num_events < MAX_EVENTS );
+	      tok = strtok_r( NULL, ",", &save ) ) {
+		retval = PAPI_event_name_to_code( tok, &events[num_events] );
+		if ( retval == PAPI_OK )
+			retval = PAPI_add_event( EventSet, events[num_events] );
+		if ( retval != PAPI_OK ) {
+			fprintf( stderr, "Cannot add %s: %s\n", tok,
+				 PAPI_strerror( retval ) );
+			return retval;
+		}
+		strncpy( event_names[num_events], tok, PAPI_MAX_STR_LEN - 1 );
+		num_events++;
+	}
+
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+	return PAPI_OK;
+}
+
+/* Pick native events of component 0 that can be started together */
+static int
+find_native_events( int max )
+{
+	int EventSet = PAPI_NULL, event, retval;
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	event = 0 | PAPI_NATIVE_MASK;
+	if ( PAPI_enum_cmp_event( &event, PAPI_ENUM_FIRST, 0 ) != PAPI_OK )
+		return PAPI_ENOEVNT;
+
+	do {
+		if ( PAPI_add_event( EventSet, event ) != PAPI_OK )
+			continue;
+		if ( PAPI_start( EventSet ) != PAPI_OK ) {
+			PAPI_remove_event( EventSet, event );
+			continue;
+		}
+		PAPI_stop( EventSet, NULL );
+		events[num_events] = event;
+		PAPI_event_code_to_name( event, event_names[num_events] );
+		num_events++;
+	} while ( ( num_events < max ) &&
+		  ( PAPI_enum_cmp_event( &event, PAPI_ENUM_EVENTS, 0 ) == PAPI_OK ) );
+
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+
+	return num_events ? PAPI_OK : PAPI_ENOEVNT;
+}
+
+/* Find an available preset that is computed from several counters */
+static int
+find_derived( void )
+{
+	PAPI_event_info_t info;
+	int i = 0 | PAPI_PRESET_MASK;
+
+	if ( PAPI_enum_event( &i, PAPI_ENUM_FIRST ) != PAPI_OK )
+		return PAPI_NULL;
+
+	do {
+		if ( ( PAPI_get_event_info( i, &info ) == PAPI_OK ) &&
+		     ( info.count > 1 ) &&
+		     ( strcmp( info.derived, "NOT_DERIVED" ) != 0 ) ) {
+			return i;
+		}
+	} while ( PAPI_enum_event( &i, PAPI_PRESET_ENUM_AVAIL ) == PAPI_OK );
+
+	return PAPI_NULL;
+}
+
+static int
+setup_eventset( int path, int n, int *EventSet )
+{
+	PAPI_option_t opt;
+	int i, retval;
+
+	retval = PAPI_create_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	if ( path == PATH_DERIVED ) {
+		return PAPI_add_event( *EventSet, derived_event );
+	}
+
+	retval = PAPI_assign_eventset_component( *EventSet,
+				PAPI_get_event_component( events[0] ) );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	switch ( path ) {
+	case PATH_ATTACHED:
+		retval = PAPI_attach( *EventSet,
+				      ( unsigned long ) syscall( SYS_gettid ) );
+		break;
+	case PATH_INHERIT:
+		memset( &opt, 0, sizeof ( opt ) );
+		opt.inherit.eventset = *EventSet;
+		opt.inherit.inherit = PAPI_INHERIT_ALL;
+		retval = PAPI_set_opt( PAPI_INHERIT, &opt );
+		break;
+	case PATH_KERNEL_MPX:
+		retval = PAPI_set_multiplex( *EventSet );
+		break;
+	case PATH_SW_MPX:
+		memset( &opt, 0, sizeof ( opt ) );
+		opt.multiplex.eventset = *EventSet;
+		opt.multiplex.flags = PAPI_MULTIPLEX_FORCE_SW;
+		retval = PAPI_set_opt( PAPI_MULTIPLEX, &opt );
+		break;
+	default:
+		break;
+	}
+	if ( retval != PAPI_OK )
+		return retval;
+
+	for ( i = 0; i < n; i++ ) {
+		retval = PAPI_add_event( *EventSet, events[i] );
+		if ( retval != PAPI_OK )
+			return retval;
+	}
+	return PAPI_OK;
+}
+
+static void *
+worker( void *arg )
+{
+	worker_t *w = arg;
+	int EventSet = PAPI_NULL;
+	long long values[MAX_EVENTS], cyc;
+	PAPI_reader_t reader = NULL;
+	int i, retval;
+
+	if ( w->path == PATH_HL ) {
+		/* The high-level API owns its EventSet, it is set up on the */
+		/* first region begin of each thread.                        */
+		retval = PAPI_hl_region_begin( "papi_read_cost" );
+		if ( retval == PAPI_OK )
+			retval = PAPI_hl_region_end( "papi_read_cost" );
+	} else {
+		retval = setup_eventset( w->path, w->num_events, &EventSet );
+		if ( retval == PAPI_OK )
+			retval = PAPI_start( EventSet );
+		if ( ( retval == PAPI_OK ) && ( w->path == PATH_READ_BOUND ) )
+			retval = PAPI_bind_reader( EventSet, &reader );
+	}
+	w->retval = retval;
+
+	pthread_barrier_wait( &barrier );
+
+	if ( retval == PAPI_OK ) {
+		for ( i = 0; i < options.iters; i++ ) {
+			cyc = PAPI_get_real_cyc(  );
+			switch ( w->path ) {
+			case PATH_READ_BOUND:
+				PAPI_read_bound( reader, values );
+				break;
+			case PATH_HL:
+				PAPI_hl_region_begin( "papi_read_cost" );
+				PAPI_hl_region_end( "papi_read_cost" );
+				break;
+			default:
+				PAPI_read( EventSet, values );
+				break;
+			}
+			w->samples[i] = PAPI_get_real_cyc(  ) - cyc;
+		}
+	}
+
+	if ( w->path == PATH_HL ) {
+		PAPI_hl_stop(  );
+	} else if ( EventSet != PAPI_NULL ) {
+		PAPI_stop( EventSet, NULL );
+		if ( reader != NULL )
+			PAPI_unbind_reader( &reader );
+		PAPI_cleanup_eventset( EventSet );
+		PAPI_destroy_eventset( &EventSet );
+	}
+	PAPI_unregister_thread(  );
+
+	return NULL;
+}
+
+static int
+cmp_ll( const void *a, const void *b )
+{
+	long long x = *( const long long * ) a, y = *( const long long * ) b;
+
+	return ( x > y ) - ( x < y );
+}
+
+static long long
+percentile( long long *sorted, long n, double p )
+{
+	long i = ( long ) ( p * ( double ) ( n - 1 ) );
+
+	return sorted[i];
+}
+
+static void
+report( int path, int n, int threads, long long *samples, long count )
+{
+	double mean = 0;
+	long i;
+
+	qsort( samples, ( size_t ) count, sizeof ( long long ), cmp_ll );
+	for ( i = 0; i < count; i++ )
+		mean += ( double ) samples[i];
+	mean /= ( double ) count;
+
+	printf( "%-16s %6d %7d %8lld %8lld %8lld %8lld %8lld %10lld %10.1f\n",
+		path_names[path], n, threads, samples[0],
+		percentile( samples, count, 0.50 ),
+		percentile( samples, count, 0.90 ),
+		percentile( samples, count, 0.99 ),
+		percentile( samples, count, 0.999 ),
+		samples[count - 1], mean );
+
+	if ( options.csv ) {
+		fprintf( options.csv, "%s,%d,%d,%ld,%lld,%lld,%lld,%lld,%lld,%lld,%.1f\n",
+			 path_names[path], n, threads, count, samples[0],
+			 percentile( samples, count, 0.50 ),
+			 percentile( samples, count, 0.90 ),
+			 percentile( samples, count, 0.99 ),
+			 percentile( samples, count, 0.999 ),
+			 samples[count - 1], mean );
+		fflush( options.csv );
+	}
+}
+
+static void
+run( int path, int n, int threads )
+{
+	worker_t *w;
+	long long *all;
+	long count = 0;
+	int i, failed = PAPI_OK;
+
+	w = calloc( ( size_t ) threads, sizeof ( worker_t ) );
+	all = malloc( ( size_t ) threads * ( size_t ) options.iters *
+		      sizeof ( long long ) );
+	if ( ( w == NULL ) || ( all == NULL ) ) {
+		fprintf( stderr, "Error allocating memory for results\n" );
+		exit( 1 );
+	}
+
+	pthread_barrier_init( &barrier, NULL, ( unsigned ) threads );
+
+	for ( i = 0; i < threads; i++ ) {
+		w[i].path = path;
+		w[i].num_events = n;
+		w[i].samples = all + ( long ) i * options.iters;
+		if ( pthread_create( &w[i].thread, NULL, worker, &w[i] ) != 0 ) {
+			fprintf( stderr, "pthread_create failed\n" );
+			exit( 1 );
+		}
+	}
+	for ( i = 0; i < threads; i++ ) {
+		pthread_join( w[i].thread, NULL );
+		if ( w[i].retval != PAPI_OK ) {
+			failed = w[i].retval;
+			continue;
+		}
+		/* keep the samples of the threads that ran */
+		memmove( all + count, w[i].samples,
+			 ( size_t ) options.iters * sizeof ( long long ) );
+		count += options.iters;
+	}
+
+	pthread_barrier_destroy( &barrier );
+
+	if ( failed != PAPI_OK ) {
+		printf( "%-16s %6d %7d skipped: %s\n", path_names[path], n,
+			threads, PAPI_strerror( failed ) );
+	} else {
+		report( path, n, threads, all, count );
+	}
+
+	free( all );
+	free( w );
+}
+
+int
+main( int argc, char **argv )
+{
+	char *event_list = NULL, *hl_events;
+	const PAPI_component_info_t *cmpinfo;
+	int c, i, n, t, retval, len;
+
+	options.min = 1;
+	options.max = 4;
+	options.iters = 10000;
+	options.threads = ( int ) sysconf( _SC_NPROCESSORS_ONLN );
+	for ( i = 0; i < NUM_PATHS; i++ )
+		options.paths[i] = 1;
+
+	while ( ( c = getopt( argc, argv, "he:m:x:T:t:p:o:" ) ) != -1 ) {
+		switch ( c ) {
+		case 'e':
+			event_list = optarg;
+			break;
+		case 'm':
+			options.min = atoi( optarg );
+			break;
+		case 'x':
+			options.max = atoi( optarg );
+			break;
+		case 'T':
+			options.threads = atoi( optarg );
+			break;
+		case 't':
+			options.iters = atoi( optarg );
+			break;
+		case 'p':
+			if ( parse_paths( optarg ) ) {
+				print_help(  );
+				exit( 1 );
+			}
+			break;
+		case 'o':
+			options.csv = fopen( optarg, "w" );
+			if ( options.csv == NULL ) {
+				fprintf( stderr, "Unable to open %s\n", optarg );
+				exit( 1 );
+			}
+			break;
+		case 'h':
+		default:
+			print_help(  );
+			exit( 1 );
+		}
+	}
+
+	if ( options.min < 1 ) options.min = 1;
+	if ( options.max > MAX_EVENTS ) options.max = MAX_EVENTS;
+	if ( options.threads < 1 ) options.threads = 1;
+	if ( ( options.iters < 1 ) || ( options.min > options.max ) ) {
+		print_help(  );
+		exit( 1 );
+	}
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		fprintf( stderr, "PAPI_library_init\n" );
+		exit( retval );
+	}
+	PAPI_set_debug( PAPI_QUIET );
+
+	retval = PAPI_thread_init( ( unsigned long ( * )( void ) ) pthread_self );
+	if ( retval != PAPI_OK ) {
+		fprintf( stderr, "PAPI_thread_init\n" );
+		exit( retval );
+	}
+
+	if ( PAPI_multiplex_init(  ) != PAPI_OK )
+		options.paths[PATH_SW_MPX] = 0;
+
+	cmpinfo = PAPI_get_component_info( 0 );
+	if ( ( cmpinfo == NULL ) || !cmpinfo->kernel_multiplex )
+		options.paths[PATH_KERNEL_MPX] = 0;
+
+	if ( event_list != NULL )
+		retval = use_named_events( event_list );
+	else
+		retval = find_native_events( options.max );
+	if ( retval != PAPI_OK ) {
+		fprintf( stderr, "No usable events found\n" );
+		exit( 1 );
+	}
+	if ( options.max > num_events )
+		options.max = num_events;
+	if ( options.min > options.max )
+		options.min = options.max;
+
+	derived_event = find_derived(  );
+	if ( derived_event == PAPI_NULL )
+		options.paths[PATH_DERIVED] = 0;
+
+	printf( "Cost of PAPI read paths, %d reads per thread, in cycles.\n",
+		options.iters );
+	printf( "Events:" );
+	for ( i = 0; i < options.max; i++ )
+		printf( " %s", event_names[i] );
+	printf( "\n\n%-16s %6s %7s %8s %8s %8s %8s %8s %10s %10s\n",
+		"path", "events", "threads", "min", "p50", "p90", "p99",
+		"p99.9", "max", "mean" );
+
+	if ( options.csv )
+		fprintf( options.csv, "path,events,threads,samples,min,p50,"
+			 "p90,p99,p999,max,mean\n" );
+
+	for ( i = 0; i < PATH_HL; i++ ) {
+		if ( !options.paths[i] )
+			continue;
+		for ( n = options.min; n <= options.max; n++ ) {
+			/* a derived preset is a single event */
+			if ( ( i == PATH_DERIVED ) && ( n > 1 ) )
+				break;
+			for ( t = 1; t < options.threads; t *= 2 )
+				run( i, n, t );
+			run( i, n, options.threads );
+		}
+	}
+
+	/* The high-level API reads its events from PAPI_EVENTS once, */
+	/* so it only runs with the full event list and runs last.    */
+	if ( options.paths[PATH_HL] ) {
+		len = 0;
+		hl_events = calloc( ( size_t ) options.max, PAPI_MAX_STR_LEN + 1 );
+		if ( hl_events == NULL ) {
+			fprintf( stderr, "Error allocating memory\n" );
+			exit( 1 );
+		}
+		for ( i = 0; i < options.max; i++ )
+			len += sprintf( hl_events + len, "%s%s", i ? "," : "",
+					event_names[i] );
+		setenv( "PAPI_EVENTS", hl_events, 1 );
+		free( hl_events );
+
+		for ( t = 1; t < options.threads; t *= 2 )
+			run( PATH_HL, options.max, t );
+		run( PATH_HL, options.max, options.threads );
+	}
+
+	if ( options.csv )
+		fclose( options.csv );
+
+	return 0;
+}